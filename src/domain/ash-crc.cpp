@@ -0,0 +1,137 @@
+/**
+ * @file ash-crc.cpp
+ *
+ * @brief CRC-CCITT engine used by the ASH framing layer
+ */
+
+#include "ash-crc.h"
+#include "index-list.h"
+
+namespace {
+
+const uint16_t CRC_POLYNOMIAL = 0x1021; // 0001 0000 0010 0001 (0, 5, 12)
+
+/**
+ * @brief Shift a 16-bit CRC register left @p bits times, applying the polynomial (C++11 constexpr, hence recursive)
+ */
+constexpr uint16_t crcShift(uint16_t reg, unsigned int bits) {
+    return (bits == 0) ? reg :
+        crcShift(static_cast<uint16_t>((reg & 0x8000U) ? ((reg << 1) ^ CRC_POLYNOMIAL) : (reg << 1)), bits - 1);
+}
+
+/**
+ * @brief Append one null byte to a CRC register (register computed with a null initial value)
+ */
+constexpr uint16_t crcAppendNullByte(uint16_t reg) {
+    return static_cast<uint16_t>((reg << 8) ^ crcShift(static_cast<uint16_t>(reg & 0xFF00U), 8));
+}
+
+/**
+ * @brief Entry @p index of slice table @p slice
+ *
+ * Table 0 is the CRC of byte @p index, table k is the CRC of byte @p index followed by k null bytes.
+ */
+constexpr uint16_t crcSliceEntry(unsigned int slice, unsigned int index) {
+    return (slice == 0) ? crcShift(static_cast<uint16_t>(index << 8), 8) :
+        crcAppendNullByte(crcSliceEntry(slice - 1, index));
+}
+
+template<unsigned int Slice, typename Indexes> struct CrcSliceTable;
+
+template<unsigned int Slice, unsigned int... Is>
+struct CrcSliceTable<Slice, IndexList<Is...> > {
+    static constexpr uint16_t values[sizeof...(Is)] = { crcSliceEntry(Slice, Is)... };
+};
+
+template<unsigned int Slice, unsigned int... Is>
+constexpr uint16_t CrcSliceTable<Slice, IndexList<Is...> >::values[sizeof...(Is)];
+
+template<unsigned int Slice> struct CrcTable : CrcSliceTable<Slice, MakeIndexList<256>::type> { };
+
+static_assert(CrcTable<0>::values[0x01] == 0x1021, "Unexpected CRC table content");
+static_assert(CrcTable<0>::values[0xFF] == 0x1EF0, "Unexpected CRC table content");
+
+inline uint16_t crcByteStep(uint16_t crc, uint8_t byte) {
+    return static_cast<uint16_t>((crc << 8) ^ CrcTable<0>::values[((crc >> 8) ^ byte) & 0xFF]);
+}
+
+} // namespace
+
+CAshCrc::CAshCrc() :
+    crc(INIT_VALUE)
+{
+}
+
+void CAshCrc::reset()
+{
+    crc = INIT_VALUE;
+}
+
+void CAshCrc::update(uint8_t i_byte)
+{
+    crc = crcByteStep(crc, i_byte);
+}
+
+void CAshCrc::update(const uint8_t* i_data, std::size_t i_len)
+{
+    uint16_t lcrc = crc;
+
+    // Slice-by-8: the two CRC bytes are merged with the first two data bytes, the 8 table lookups are independent
+    while (i_len >= 8)
+    {
+        lcrc = static_cast<uint16_t>( CrcTable<7>::values[((lcrc >> 8) ^ i_data[0]) & 0xFF] ^
+                                      CrcTable<6>::values[(lcrc ^ i_data[1]) & 0xFF] ^
+                                      CrcTable<5>::values[i_data[2]] ^
+                                      CrcTable<4>::values[i_data[3]] ^
+                                      CrcTable<3>::values[i_data[4]] ^
+                                      CrcTable<2>::values[i_data[5]] ^
+                                      CrcTable<1>::values[i_data[6]] ^
+                                      CrcTable<0>::values[i_data[7]] );
+        i_data += 8;
+        i_len -= 8;
+    }
+    while (i_len > 0)
+    {
+        lcrc = crcByteStep(lcrc, *i_data++);
+        i_len--;
+    }
+
+    crc = lcrc;
+}
+
+uint16_t CAshCrc::compute(const uint8_t* i_data, std::size_t i_len)
+{
+    CAshCrc lcrc;
+
+    lcrc.update(i_data, i_len);
+    return lcrc.get();
+}
+
+uint16_t CAshCrc::computeBitwise(const uint8_t* i_data, std::size_t i_len)
+{
+    uint16_t lo_crc = INIT_VALUE;
+
+    for (std::size_t cnt = 0; cnt < i_len; cnt++) {
+        for (auto i = 0; i < 8; i++) {
+            bool bit = ((i_data[cnt] >> (7 - i) & 1) == 1);
+            bool c15 = ((lo_crc >> 15 & 1) == 1);
+            lo_crc = static_cast<uint16_t>(lo_crc << 1U);
+            if (c15 ^ bit) {
+                lo_crc ^= CRC_POLYNOMIAL;
+            }
+        }
+    }
+
+    return lo_crc;
+}
+
+uint16_t CAshCrc::computeBytewise(const uint8_t* i_data, std::size_t i_len)
+{
+    uint16_t lo_crc = INIT_VALUE;
+
+    for (std::size_t cnt = 0; cnt < i_len; cnt++) {
+        lo_crc = crcByteStep(lo_crc, i_data[cnt]);
+    }
+
+    return lo_crc;
+}
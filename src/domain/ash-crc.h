@@ -0,0 +1,83 @@
+/**
+ * @file ash-crc.h
+ *
+ * @brief CRC-CCITT engine used by the ASH framing layer
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Incremental CRC-CCITT (polynomial 0x1021, initial value 0xFFFF, MSB first) as used by ASH
+ *
+ * Lookup tables are generated at compile time. Bulk updates are processed 8 bytes at a time (slice-by-8), remaining bytes
+ * are processed one at a time using the first table.
+ *
+ * A frame is valid when the CRC computed over its content followed by its two CRC bytes is 0.
+ */
+class CAshCrc
+{
+public:
+    static const uint16_t INIT_VALUE = 0xFFFF;
+
+    CAshCrc();
+
+    /**
+     * @brief Restart a new CRC computation
+     */
+    void reset();
+
+    /**
+     * @brief Feed one more byte into the CRC computation
+     *
+     * @param i_byte The byte to add
+     */
+    void update(uint8_t i_byte);
+
+    /**
+     * @brief Feed a buffer into the CRC computation
+     *
+     * @param i_data Pointer to the first byte to add
+     * @param i_len Number of bytes to add
+     */
+    void update(const uint8_t* i_data, std::size_t i_len);
+
+    /**
+     * @brief Get the CRC of all bytes fed since the last reset()
+     */
+    uint16_t get() const { return crc; }
+
+    /**
+     * @brief Compute the CRC of a buffer in one go
+     *
+     * @param i_data Pointer to the first byte of the buffer
+     * @param i_len Number of bytes in the buffer
+     *
+     * @return The CRC
+     */
+    static uint16_t compute(const uint8_t* i_data, std::size_t i_len);
+
+    /**
+     * @brief Reference bit-by-bit implementation (slow, kept for tests and benchmarks)
+     */
+    static uint16_t computeBitwise(const uint8_t* i_data, std::size_t i_len);
+
+    /**
+     * @brief Byte-by-byte implementation using a single 256-entry table (kept for tests and benchmarks)
+     */
+    static uint16_t computeBytewise(const uint8_t* i_data, std::size_t i_len);
+
+private:
+    uint16_t crc;
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
@@ -0,0 +1,95 @@
+/**
+ * @file ash-randomiser.cpp
+ *
+ * @brief Data field randomisation used by the ASH framing layer
+ */
+
+#include <cstring>
+
+#include "ash-randomiser.h"
+#include "index-list.h"
+
+namespace {
+
+const uint8_t RANDOM_SEED = 0x42;
+
+/**
+ * @brief Next state of the randomisation LFSR
+ */
+constexpr uint8_t lfsrNext(uint8_t rand) {
+    return static_cast<uint8_t>((rand & 0x01) ? ((rand >> 1) ^ 0xB8) : (rand >> 1));
+}
+
+/**
+ * @brief Byte @p index of the pseudo-random sequence (C++11 constexpr, hence recursive)
+ */
+constexpr uint8_t lfsrValue(unsigned int index) {
+    return (index == 0) ? RANDOM_SEED : lfsrNext(lfsrValue(index - 1));
+}
+
+template<typename Indexes> struct RandomSequence;
+
+template<unsigned int... Is>
+struct RandomSequence<IndexList<Is...> > {
+    static constexpr uint8_t values[sizeof...(Is)] = { lfsrValue(Is)... };
+};
+
+template<unsigned int... Is>
+constexpr uint8_t RandomSequence<IndexList<Is...> >::values[sizeof...(Is)];
+
+typedef RandomSequence<MakeIndexList<CAshRandomiser::SEQUENCE_LENGTH>::type> Sequence;
+
+static_assert(Sequence::values[0] == 0x42 && Sequence::values[1] == 0x21 && Sequence::values[2] == 0xA8, "Unexpected random sequence content");
+static_assert(CAshRandomiser::SEQUENCE_LENGTH % 8 == 0, "Random sequence must be made of whole 64-bit words");
+
+} // namespace
+
+const std::size_t CAshRandomiser::SEQUENCE_LENGTH;
+
+void CAshRandomiser::apply(uint8_t* io_data, std::size_t i_len)
+{
+    std::size_t l_len = (i_len < SEQUENCE_LENGTH) ? i_len : SEQUENCE_LENGTH;
+    std::size_t cnt = 0;
+
+    // 8 bytes at a time (memcpy compiles to plain unaligned loads and stores, without aliasing issues)
+    for (; cnt + 8 <= l_len; cnt += 8)
+    {
+        uint64_t l_word;
+        uint64_t l_rand;
+        std::memcpy(&l_word, io_data + cnt, sizeof(l_word));
+        std::memcpy(&l_rand, Sequence::values + cnt, sizeof(l_rand));
+        l_word ^= l_rand;
+        std::memcpy(io_data + cnt, &l_word, sizeof(l_word));
+    }
+    for (; cnt < l_len; cnt++)
+    {
+        io_data[cnt] = static_cast<uint8_t>(io_data[cnt] ^ Sequence::values[cnt]);
+    }
+
+    // not expected with valid ASH frames: continue the sequence past the precomputed part
+    if (cnt < i_len)
+    {
+        uint8_t rand = lfsrNext(Sequence::values[SEQUENCE_LENGTH - 1]);
+        for (; cnt < i_len; cnt++)
+        {
+            io_data[cnt] = static_cast<uint8_t>(io_data[cnt] ^ rand);
+            rand = lfsrNext(rand);
+        }
+    }
+}
+
+void CAshRandomiser::applyBytewise(uint8_t* io_data, std::size_t i_len)
+{
+    uint8_t rand = RANDOM_SEED;
+
+    for (std::size_t cnt = 0; cnt < i_len; cnt++)
+    {
+        io_data[cnt] = static_cast<uint8_t>(io_data[cnt] ^ rand);
+
+        if ((rand & 0x01) == 0) {
+            rand = static_cast<uint8_t>(rand >> 1);
+        } else {
+            rand = static_cast<uint8_t>((rand >> 1) ^ 0xb8);
+        }
+    }
+}
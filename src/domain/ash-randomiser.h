@@ -0,0 +1,45 @@
+/**
+ * @file ash-randomiser.h
+ *
+ * @brief Data field randomisation used by the ASH framing layer
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief XOR of the ASH DATA frame data field with its pseudo-random sequence
+ *
+ * The sequence (LFSR seeded with 0x42, polynomial 0xB8) is the same for every frame, so it is generated at compile time.
+ * Buffers are processed in place, 8 bytes at a time. Applying the sequence twice gives back the original data, so the
+ * same functions both randomise and de-randomise.
+ */
+class CAshRandomiser
+{
+public:
+    static const std::size_t SEQUENCE_LENGTH = 136; /*!< Precomputed sequence length, covers a whole ASH frame (131 bytes) in 8-byte words */
+
+    /**
+     * @brief Apply the pseudo-random sequence to a data field, in place
+     *
+     * @param io_data Pointer to the first byte of the data field
+     * @param i_len Number of bytes in the data field
+     */
+    static void apply(uint8_t* io_data, std::size_t i_len);
+
+    /**
+     * @brief Reference implementation running the LFSR byte by byte (kept for tests and benchmarks)
+     */
+    static void applyBytewise(uint8_t* io_data, std::size_t i_len);
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
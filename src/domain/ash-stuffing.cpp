@@ -0,0 +1,178 @@
+/**
+ * @file ash-stuffing.cpp
+ *
+ * @brief Reserved byte scanning and byte stuffing used by the ASH framing layer
+ */
+
+#include <cstring>
+
+#include "ash-stuffing.h"
+#include "index-list.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASH_STUFFING_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint8_t ASH_ESCAPE_BYTE = 0x7D;
+
+constexpr bool isReservedByte(unsigned int byte) {
+    return (byte == 0x7E) || (byte == 0x7D) || (byte == 0x11) || (byte == 0x13) || (byte == 0x18) || (byte == 0x1A);
+}
+
+template<typename Indexes> struct ReservedTable;
+
+template<unsigned int... Is>
+struct ReservedTable<IndexList<Is...> > {
+    static constexpr bool values[sizeof...(Is)] = { isReservedByte(Is)... };
+};
+
+template<unsigned int... Is>
+constexpr bool ReservedTable<IndexList<Is...> >::values[sizeof...(Is)];
+
+typedef ReservedTable<MakeIndexList<256>::type> Reserved;
+
+std::size_t findReservedScalar(const uint8_t* i_data, std::size_t i_len) {
+    std::size_t cnt = 0;
+    while (cnt < i_len && !Reserved::values[i_data[cnt]]) {
+        cnt++;
+    }
+    return cnt;
+}
+
+#ifdef ASH_STUFFING_X86_SIMD
+/*
+ * Reserved bytes are matched with 4 comparisons instead of 6: 0x11/0x13 and 0x18/0x1A only differ by bit 1, so they are
+ * compared with bit 1 cleared.
+ */
+__attribute__((target("sse2")))
+std::size_t findReservedSse2(const uint8_t* i_data, std::size_t i_len) {
+    const __m128i flag = _mm_set1_epi8(0x7E);
+    const __m128i escape = _mm_set1_epi8(0x7D);
+    const __m128i xonXoff = _mm_set1_epi8(0x11);
+    const __m128i substituteCancel = _mm_set1_epi8(0x18);
+    const __m128i clearBit1 = _mm_set1_epi8(static_cast<char>(0xFD));
+    std::size_t cnt = 0;
+
+    for (; cnt + 16 <= i_len; cnt += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i_data + cnt));
+        __m128i masked = _mm_and_si128(bytes, clearBit1);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, flag), _mm_cmpeq_epi8(bytes, escape)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(masked, xonXoff), _mm_cmpeq_epi8(masked, substituteCancel)));
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return cnt + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned int>(mask)));
+        }
+    }
+    return cnt + findReservedScalar(i_data + cnt, i_len - cnt);
+}
+
+__attribute__((target("avx2")))
+std::size_t findReservedAvx2(const uint8_t* i_data, std::size_t i_len) {
+    const __m256i flag = _mm256_set1_epi8(0x7E);
+    const __m256i escape = _mm256_set1_epi8(0x7D);
+    const __m256i xonXoff = _mm256_set1_epi8(0x11);
+    const __m256i substituteCancel = _mm256_set1_epi8(0x18);
+    const __m256i clearBit1 = _mm256_set1_epi8(static_cast<char>(0xFD));
+    std::size_t cnt = 0;
+
+    for (; cnt + 32 <= i_len; cnt += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i_data + cnt));
+        __m256i masked = _mm256_and_si256(bytes, clearBit1);
+        __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, flag), _mm256_cmpeq_epi8(bytes, escape)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(masked, xonXoff), _mm256_cmpeq_epi8(masked, substituteCancel)));
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(match));
+        if (mask != 0) {
+            return cnt + static_cast<std::size_t>(__builtin_ctz(mask));
+        }
+    }
+    /* Short frames are common, finish with 16-byte blocks. The compiler does not clear the upper AVX state before calling
+       non-VEX code, and the resulting SSE/AVX transitions would cost more than the scan itself */
+    _mm256_zeroupper();
+    return cnt + findReservedSse2(i_data + cnt, i_len - cnt);
+}
+#endif // ASH_STUFFING_X86_SIMD
+
+bool cpuSupports(CAshStuffing::EScanner i_scanner) {
+#ifdef ASH_STUFFING_X86_SIMD
+    __builtin_cpu_init();
+    switch (i_scanner) {
+        case CAshStuffing::SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case CAshStuffing::SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+        default:
+            break;
+    }
+#endif // ASH_STUFFING_X86_SIMD
+    return (i_scanner == CAshStuffing::SCAN_SCALAR);
+}
+
+/*
+ * AVX2 is not selected: clean runs in ASH frames are a few dozen bytes long, and on such short runs it was measured
+ * slightly slower than SSE2 (see bench_ash_stuffing()).
+ */
+CAshStuffing::EScanner selectScanner() {
+    return cpuSupports(CAshStuffing::SCAN_SSE2) ? CAshStuffing::SCAN_SSE2 : CAshStuffing::SCAN_SCALAR;
+}
+
+} // namespace
+
+bool CAshStuffing::isReserved(uint8_t i_byte)
+{
+    return Reserved::values[i_byte];
+}
+
+CAshStuffing::EScanner CAshStuffing::getSelectedScanner(void)
+{
+    static const EScanner selected = selectScanner();
+    return selected;
+}
+
+CAshStuffing::ScanFunction CAshStuffing::getScanFunction(EScanner i_scanner)
+{
+    if (!cpuSupports(i_scanner)) {
+        return nullptr;
+    }
+    switch (i_scanner) {
+#ifdef ASH_STUFFING_X86_SIMD
+        case SCAN_SSE2:
+            return &findReservedSse2;
+        case SCAN_AVX2:
+            return &findReservedAvx2;
+#endif // ASH_STUFFING_X86_SIMD
+        default:
+            return &findReservedScalar;
+    }
+}
+
+std::size_t CAshStuffing::findReserved(const uint8_t* i_data, std::size_t i_len)
+{
+    static const ScanFunction scan = getScanFunction(getSelectedScanner());
+    return scan(i_data, i_len);
+}
+
+std::size_t CAshStuffing::stuff(const uint8_t* i_data, std::size_t i_len, uint8_t* o_out)
+{
+    uint8_t* l_out = o_out;
+
+    while (i_len > 0)
+    {
+        // copy the clean run in one go, then escape the reserved byte following it
+        std::size_t l_run = findReserved(i_data, i_len);
+        std::memcpy(l_out, i_data, l_run);
+        l_out += l_run;
+        i_data += l_run;
+        i_len -= l_run;
+        if (i_len > 0)
+        {
+            *l_out++ = ASH_ESCAPE_BYTE;
+            *l_out++ = static_cast<uint8_t>(*i_data++ ^ 0x20);
+            i_len--;
+        }
+    }
+
+    return static_cast<std::size_t>(l_out - o_out);
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ash-stuffing.h
+ *
+ * @brief Reserved byte scanning and byte stuffing used by the ASH framing layer
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Lookup of ASH reserved bytes (0x7E, 0x7D, 0x11, 0x13, 0x18, 0x1A)
+ *
+ * Once randomised, most data fields contain few reserved bytes, so both stuffing and unstuffing look for the next
+ * reserved byte and process the clean run before it in bulk. On x86, the scan uses SSE2 when the running CPU supports
+ * it (checked once, at first use). Other targets use a table-driven scalar loop. An AVX2 scanner is also available
+ * through getScanFunction(), for comparison.
+ */
+class CAshStuffing
+{
+public:
+    typedef enum {
+        SCAN_SCALAR,
+        SCAN_SSE2,
+        SCAN_AVX2
+    } EScanner;
+
+    typedef std::size_t (*ScanFunction)(const uint8_t* i_data, std::size_t i_len);
+
+    /**
+     * @brief Check if a byte has to be escaped
+     */
+    static bool isReserved(uint8_t i_byte);
+
+    /**
+     * @brief Find the first reserved byte in a buffer, using the best scanner available
+     *
+     * @return Its index, or @p i_len if there is none
+     */
+    static std::size_t findReserved(const uint8_t* i_data, std::size_t i_len);
+
+    /**
+     * @brief Get a specific scanner implementation (for tests and benchmarks)
+     *
+     * @return The scan function, nullptr if not supported by this build or this CPU
+     */
+    static ScanFunction getScanFunction(EScanner i_scanner);
+
+    /**
+     * @brief Get the scanner used by findReserved()
+     */
+    static EScanner getSelectedScanner(void);
+
+    /**
+     * @brief Stuff a buffer: reserved bytes are replaced by an escape byte followed by the byte with bit 5 inverted
+     *
+     * @param i_data Pointer to the first byte to stuff
+     * @param i_len Number of bytes to stuff
+     * @param o_out Output buffer, at least 2 * @p i_len bytes
+     *
+     * @return The number of bytes written to @p o_out
+     */
+    static std::size_t stuff(const uint8_t* i_data, std::size_t i_len, uint8_t* o_out);
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
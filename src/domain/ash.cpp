@@ -5,8 +5,12 @@
 #include <iostream>
 #include <list>
 #include <map>
+#include <algorithm>
 
 #include "ash.h"
+#include "ash-crc.h"
+#include "ash-randomiser.h"
+#include "ash-stuffing.h"
 
 #include "../spi/GenericLogger.h"
 
@@ -24,18 +28,39 @@ using namespace std;
 #define ASH_SUBSTITUTE_BYTE 0x18
 #define ASH_XON_BYTE        0x11
 #define ASH_OFF_BYTE        0x13
+#define ASH_ESCAPE_BYTE     0x7D
 #define ASH_TIMEOUT         -1
 
-#define ASH_MAX_LENGTH 131
+const std::size_t CAsh::ASH_MAX_LENGTH;
+const std::size_t CAsh::ASH_MAX_ENCODED_LENGTH;
+const uint8_t CAsh::ASH_MAX_TX_WINDOW;
+const uint8_t CAsh::ASH_MAX_TIMEOUTS;
 
 CAsh::CAsh(CAshCallback *ipCb, ITimerFactory &i_timer_factory) :
 	ackNum(0),
 	frmNum(0),
 	seq_num(0),
 	stateConnected(false),
+	timer_factory(i_timer_factory),
 	timer(i_timer_factory.create()),
 	pCb(ipCb),
-	in_msg()
+	in_msg(),
+	in_msg_len(0),
+	in_escape(false),
+	in_error(false),
+	in_crc(),
+	txWindow(1),
+	txAckNum(0),
+	txPending(0),
+	txData(),
+	txDataLen(),
+	txTime(),
+	txRetransmitted(),
+	rxAckTimeout(T_RX_ACK_INIT),
+	lastRtt(0),
+	consecutiveTimeouts(0),
+	ackPending(false),
+	stats()
 {
 }
 
@@ -48,6 +73,24 @@ void CAsh::Timeout(void)
             pCb->ashCbInfo(ASH_RESET_FAILED);
         }
     }
+    else if( txPending > 0 )
+    {
+        stats.increment(LINK_ACK_TIMEOUTS);
+        consecutiveTimeouts++;
+        if( consecutiveTimeouts > ASH_MAX_TIMEOUTS )
+        {
+            clogE << "CAsh::Timeout NCP does not acknowledge anymore, link lost" << std::endl;
+            txPending = 0;
+            stateConnected = false;
+            if( nullptr != pCb ){ pCb->ashCbInfo(ASH_STATE_CHANGE); }
+        }
+        else
+        {
+            // exponential backoff, then ask for retransmission
+            rxAckTimeout = static_cast<uint16_t>(std::min(2 * rxAckTimeout, T_RX_ACK_MAX));
+            if( nullptr != pCb ){ pCb->ashCbInfo(ASH_ACK_TIMEOUT); }
+        }
+    }
 }
 
 vector<uint8_t> CAsh::resetNCPFrame(void)
@@ -55,26 +98,24 @@ vector<uint8_t> CAsh::resetNCPFrame(void)
     ackNum = 0;
     frmNum = 0;
     seq_num = 0;
+    txAckNum = 0;
+    txPending = 0;
+    ackPending = false;
+    rxAckTimeout = T_RX_ACK_INIT;
+    consecutiveTimeouts = 0;
     stateConnected = false;
-    vector<uint8_t> lo_msg;
+    uint8_t l_frame[ASH_MAX_ENCODED_LENGTH];
 
     timer->stop();
     if( nullptr != pCb ){ pCb->ashCbInfo(ASH_STATE_CHANGE); }
 
-    lo_msg.push_back(0xC0);
-
-    uint16_t crc = computeCRC(lo_msg);
-    lo_msg.push_back(static_cast<uint8_t>(crc>>8));
-    lo_msg.push_back(static_cast<uint8_t>(crc&0xFF));
-
-    lo_msg = stuffedOutputData(lo_msg);
-
-    lo_msg.insert( lo_msg.begin(), ASH_CANCEL_BYTE );
+    l_frame[0] = ASH_CANCEL_BYTE;
+    std::size_t l_len = 1 + encodeFrame(0xC0, nullptr, 0, l_frame + 1);
 
     // start timer
     timer->start( T_RX_ACK_INIT, [&](ITimer *ipTimer){this->Timeout();} );
 
-    return lo_msg;
+    return vector<uint8_t>(l_frame, l_frame + l_len);
 }
 
 std::string CAsh::EAshInfoToString( EAshInfo in )
@@ -84,6 +125,7 @@ std::string CAsh::EAshInfoToString( EAshInfo in )
         { ASH_ACK, "ASH_ACK" },
         { ASH_NACK, "ASH_NACK" },
         { ASH_STATE_CHANGE, "ASH_STATE_CHANGE" },
+        { ASH_ACK_TIMEOUT, "ASH_ACK_TIMEOUT" },
     };
     auto   it  = MyEnumStrings.find(in);
     return it == MyEnumStrings.end() ? "OUT_OF_RANGE" : it->second;      
@@ -91,183 +133,153 @@ std::string CAsh::EAshInfoToString( EAshInfo in )
 
 std::vector<uint8_t> CAsh::AckFrame(void)
 {
-  std::vector<uint8_t> lo_msg;
+  uint8_t l_frame[ASH_MAX_ENCODED_LENGTH];
+  std::size_t l_len = AckFrame(l_frame);
 
-  lo_msg.push_back(static_cast<uint8_t>(0x80+ackNum));
-
-  uint16_t crc = computeCRC(lo_msg);
-  lo_msg.push_back(static_cast<uint8_t>(crc>>8));
-  lo_msg.push_back(static_cast<uint8_t>(crc&0xFF));
+  return std::vector<uint8_t>(l_frame, l_frame + l_len);
+}
 
-  lo_msg = stuffedOutputData(lo_msg);
+std::size_t CAsh::AckFrame(uint8_t *o_frame)
+{
+  ackPending = false;
+  stats.increment(LINK_ACK_FRAMES_SENT);
+  return encodeFrame(static_cast<uint8_t>(0x80+ackNum), nullptr, 0, o_frame);
+}
 
-  // start timer
-  timer->start( T_RX_ACK_INIT, [&](ITimer *ipTimer){this->Timeout();} );
+std::vector<uint8_t> CAsh::DataFrame(std::vector<uint8_t> i_data)
+{
+  uint8_t l_frame[ASH_MAX_ENCODED_LENGTH];
+  std::size_t l_len = DataFrame(i_data.at(0), i_data.data() + 1, i_data.size() - 1, l_frame);
 
-  return lo_msg;
+  return std::vector<uint8_t>(l_frame, l_frame + l_len);
 }
 
-std::vector<uint8_t> CAsh::DataFrame(std::vector<uint8_t> i_data)
+std::size_t CAsh::DataFrame(uint8_t i_cmd, const uint8_t *i_params, std::size_t i_params_len, uint8_t *o_frame)
 {
-  std::vector<uint8_t> lo_msg;
+  // callers check canSendData() first: all unacknowledged frames must stay available for retransmission
+  if( !canSendData() )
+  {
+    clogE << "CAsh::DataFrame TX window full, frame not sent" << std::endl;
+    return 0;
+  }
+  // the NCP would get a malformed command if parameters were cut to fit
+  std::size_t l_header_len = (0 != i_cmd) ? 5 : 3;
+  if( i_params_len > ASH_MAX_LENGTH - 3 - l_header_len )
+  {
+    clogE << "CAsh::DataFrame " << i_params_len << " parameter bytes do not fit in a DATA frame, frame not sent" << std::endl;
+    return 0;
+  }
+
+  uint8_t l_control = static_cast<uint8_t>((frmNum << 4) + ackNum);
+  uint8_t l_frm = frmNum;
+
+  // our ack number is piggybacked
+  if( ackPending )
+  {
+    ackPending = false;
+    stats.increment(LINK_ACK_FRAMES_SAVED);
+  }
 
-  lo_msg.push_back(static_cast<uint8_t>((frmNum << 4) + ackNum) );
   frmNum = (frmNum + 1) & 0x07;
 
-  if( 0 != i_data.at(0) )
+  // build the data field in the retransmission buffer
+  uint8_t *l_data = txData[l_frm];
+  std::size_t l_len = 0;
+
+  l_data[l_len++] = seq_num++;
+  l_data[l_len++] = 0; // frame control
+  if( 0 != i_cmd )
   {
     // WARNING for all frames except "VersionRequest" frame, add exteded header
-    i_data.insert(i_data.begin(),0);
-    i_data.insert(i_data.begin(),0xFF);
+    l_data[l_len++] = 0xFF;
+    l_data[l_len++] = 0;
+  }
+  l_data[l_len++] = i_cmd;
+  std::copy(i_params, i_params + i_params_len, l_data + l_len);
+  l_len += i_params_len;
+
+  CAshRandomiser::apply(l_data, l_len);
+  txDataLen[l_frm] = l_len;
+  txTime[l_frm] = timer_factory.now();
+  txRetransmitted[l_frm] = false;
+  txPending++;
+  stats.increment(LINK_DATA_FRAMES_SENT);
+
+  // start timer, unless already running for a previous frame
+  if( !timer->isRunning() )
+  {
+    startAckTimer();
   }
 
-  // insert frm control
-  i_data.insert(i_data.begin(),0);
-  // insert seq number
-  i_data.insert(i_data.begin(),seq_num++);
+  return encodeFrame(l_control, l_data, l_len, o_frame);
+}
 
+std::vector<uint8_t> CAsh::RetransmitFrames(void)
+{
+  std::vector<uint8_t> lo_buffer;
 
-  i_data = dataRandomise(i_data,0);
-  for (auto &val : i_data)
+  for( uint8_t loop = 0; loop < txPending; loop++ )
   {
-      lo_msg.push_back(val);
-  }
+    uint8_t l_frm = (txAckNum + loop) & 0x07;
+    std::size_t l_offset = lo_buffer.size();
 
-  uint16_t crc = computeCRC(lo_msg);
-  lo_msg.push_back(static_cast<uint8_t>(crc>>8));
-  lo_msg.push_back(static_cast<uint8_t>(crc&0xFF));
+    // same frame number and data, with reTx flag and our current ack number
+    lo_buffer.resize(l_offset + ASH_MAX_ENCODED_LENGTH);
+    std::size_t l_len = encodeFrame(static_cast<uint8_t>((l_frm << 4) | 0x08 | ackNum), txData[l_frm], txDataLen[l_frm], lo_buffer.data() + l_offset);
+    lo_buffer.resize(l_offset + l_len);
 
-  lo_msg = stuffedOutputData(lo_msg);
+    txRetransmitted[l_frm] = true;
+    stats.increment(LINK_RETRANSMITTED_FRAMES);
+  }
 
-  // start timer
-  timer->start( T_RX_ACK_INIT, [&](ITimer *ipTimer){this->Timeout();} );
+  if( !lo_buffer.empty() )
+  {
+    startAckTimer();
+  }
 
-  return lo_msg;
+  return lo_buffer;
 }
 
-std::vector<uint8_t> CAsh::decode(std::vector<uint8_t> &i_data)
+void CAsh::setTxWindow(uint8_t i_window)
 {
-  bool inputError = false;
-  //std::list<uint8_t> li_data;
-  std::vector<uint8_t> lo_msg;
-  uint8_t val;
+  txWindow = std::max(static_cast<uint8_t>(1), std::min(i_window, ASH_MAX_TX_WINDOW));
+}
 
-  while( !i_data.empty() && lo_msg.empty() )
+bool CAsh::canSendData(void) const
+{
+  return txPending < txWindow;
+}
+
+void CAsh::decode(const uint8_t *i_data, std::size_t i_len)
+{
+  for( std::size_t cnt = 0; cnt < i_len; cnt++ )
   {
-    val = i_data.front();
-    i_data.erase(i_data.begin());
+    uint8_t val = i_data[cnt];
     switch( val )
     {
       case ASH_CANCEL_BYTE:
           // Cancel Byte: Terminates a frame in progress. A Cancel Byte causes all data received since the
           // previous Flag Byte to be ignored. Note that as a special case, RST and RSTACK frames are preceded
           // by Cancel Bytes to ignore any link startup noise.
-          in_msg.clear();
-          inputError = false;
+          stats.increment(LINK_CANCEL_BYTES);
+          resetInputFrame();
           break;
       case ASH_FLAG_BYTE:
-            //-- clogD << "CAsh::decode ASH_FLAG_BYTE" << std::endl;
           // Flag Byte: Marks the end of a frame.When a Flag Byte is received, the data received since the
           // last Flag Byte or Cancel Byte is tested to see whether it is a valid frame.
-          //LOGGER(logTRACE) << "<-- RX ASH frame: VIEW ASH_FLAG_BYTE";
-          if (!inputError && !in_msg.empty()) {
-            if( in_msg.size() >= 3 )
+          if( !in_error && (in_msg_len > 0) )
+          {
+            if( in_msg_len >= 3 )
             {
-              // Remove byte stuffing
-              bool escape = false;
-              for (auto &data : in_msg) {
-                  if (escape) {
-                      escape = false;
-                      if ((data & 0x20) == 0) {
-                          data = static_cast<uint8_t>(data + 0x20);
-                      } else {
-                          data = static_cast<uint8_t>(data & 0xDF);
-                      }
-                  } else if (data == 0x7D) {
-                      escape = true;
-                      continue;
-                  }
-                  lo_msg.push_back(data);
-              }
-
-              // Check CRC
-              if (computeCRC(lo_msg) != 0) {
-                  lo_msg.clear();
-                  clogD << "CAsh::decode Wrong CRC" << std::endl;
+              // CRC computed over the frame and its own CRC is 0 for a valid frame
+              if( 0 != in_crc.get() )
+              {
+                clogD << "CAsh::decode Wrong CRC" << std::endl;
+                stats.increment(LINK_CRC_ERRORS);
               }
               else
               {
-                if ((lo_msg.at(0) & 0x80) == 0) {
-                  // DATA;
-                  //-- clogD << "CAsh::decode DATA" << std::endl;
-
-                  // update ack number, use incoming frm number
-                  ackNum = ((lo_msg.at(0)>>4&0x07) + 1) & 0x07;
-
-
-                  lo_msg = dataRandomise(lo_msg,1);
-
-                  if( 0xFF == lo_msg.at(2) )
-                  {
-                    // WARNING for all frames except "VersionRequest" frame, add exteded header
-                    lo_msg.erase(lo_msg.begin()+2);
-                    lo_msg.erase(lo_msg.begin()+2);
-                  }
-
-                }
-                else if ((lo_msg.at(0) & 0x60) == 0x00) {
-                  // ACK;
-                  //-- clogD << "CAsh::decode ACK" << std::endl;
-                  //LOGGER(logTRACE) << "<-- RX ASH ACK Frame !! ";
-                  lo_msg.clear();
-                  timer->stop();
-
-                  if( nullptr != pCb ) { pCb->ashCbInfo(ASH_ACK); }
-                }
-                else if ((lo_msg.at(0) & 0x60) == 0x20) {
-                  // NAK;
-                  frmNum = lo_msg.at(0) & 0x07;
-
-                  clogD << "CAsh::decode NACK" << std::endl;
-
-                  //LOGGER(logTRACE) << "<-- RX ASH NACK Frame !! : 0x" << QString::number(lo_msg.at(0),16).toUpper().rightJustified(2,'0');
-                  lo_msg.clear();
-                  timer->stop();
-
-                  if( nullptr != pCb ) { pCb->ashCbInfo(ASH_NACK); }
-                }
-                else if (lo_msg.at(0) == 0xC0) {
-                  // RST;
-                  lo_msg.clear();
-                  //LOGGER(logTRACE) << "<-- RX ASH RST Frame !! ";
-                  clogD << "CAsh::decode RST" << std::endl;
-                }
-                else if (lo_msg.at(0) == 0xC1) {
-                  // RSTACK;
-                  //LOGGER(logTRACE) << "<-- RX ASH RSTACK Frame !! ";
-                  clogD << "CAsh::decode RSTACK" << std::endl;
-
-                  lo_msg.clear();
-                  if( !stateConnected )
-                  {
-                    /** \todo : add some test to verify it is a software reset and ash protocol version is 2 */
-                    timer->stop();
-                    stateConnected = true;
-                    if( nullptr != pCb ){ pCb->ashCbInfo(ASH_STATE_CHANGE); }
-                  }
-                }
-                else if (lo_msg.at(0) == 0xC2) {
-                  // ERROR;
-                  //LOGGER(logTRACE) << "<-- RX ASH ERROR Frame !! ";
-                  clogD << "CAsh::decode ERROR" << std::endl;
-                  lo_msg.clear();
-                }
-                else
-                {
-                  //LOGGER(logTRACE) << "<-- RX ASH Unknown !! ";
-                  clogD << "CAsh::decode UNKNOWN" << std::endl;
-                  lo_msg.clear();
-                }
+                processInputFrame();
               }
             }
             else
@@ -275,14 +287,14 @@ std::vector<uint8_t> CAsh::decode(std::vector<uint8_t> &i_data)
               //LOGGER(logTRACE) << "<-- RX ASH too short !! ";
             }
           }
-          in_msg.clear();
-          inputError = false;
+          resetInputFrame();
           break;
       case ASH_SUBSTITUTE_BYTE:
           // Substitute Byte: Replaces a byte received with a low-level communication error (e.g., framing
           // error) from the UART.When a Substitute Byte is processed, the data between the previous and the
           // next Flag Bytes is ignored.
-          inputError = true;
+          stats.increment(LINK_SUBSTITUTE_BYTES);
+          in_error = true;
           break;
       case ASH_XON_BYTE:
           // XON: Resume transmissionUsed in XON/XOFF flow control. Always ignored if received by the NCP.
@@ -290,22 +302,41 @@ std::vector<uint8_t> CAsh::decode(std::vector<uint8_t> &i_data)
       case ASH_OFF_BYTE:
           // XOFF: Stop transmissionUsed in XON/XOFF flow control. Always ignored if received by the NCP.
           break;
-/*          
-      case ASH_TIMEOUT:
+      case ASH_ESCAPE_BYTE:
+          // Escape Byte: the next byte is a reserved value with bit 5 inverted
+          in_escape = true;
           break;
-*/          
       default:
-          if (in_msg.size() >= ASH_MAX_LENGTH) {
-              in_msg.clear();
-              inputError = true;
+          if( !in_escape && !in_error && (in_msg_len < ASH_MAX_LENGTH) )
+          {
+            // plain byte: take the whole run up to the next reserved byte at once
+            std::size_t l_run = CAshStuffing::findReserved(i_data + cnt, std::min(i_len - cnt, ASH_MAX_LENGTH - in_msg_len));
+            std::copy(i_data + cnt, i_data + cnt + l_run, in_msg + in_msg_len);
+            in_crc.update(i_data + cnt, l_run);
+            in_msg_len += l_run;
+            cnt += l_run - 1;
+            break;
+          }
+          if( in_escape )
+          {
+            val = static_cast<uint8_t>(val ^ 0x20);
+            in_escape = false;
+          }
+          if( in_msg_len >= ASH_MAX_LENGTH )
+          {
+            // too long, drop the whole frame up to the next flag byte
+            stats.increment(LINK_OVERSIZED_FRAMES);
+            in_msg_len = 0;
+            in_error = true;
+          }
+          else if( !in_error )
+          {
+            in_msg[in_msg_len++] = val;
+            in_crc.update(val);
           }
-          in_msg.push_back(val);
           break;
     }
-
   }
-
-  return lo_msg;
 }
 
 
@@ -313,83 +344,160 @@ std::vector<uint8_t> CAsh::decode(std::vector<uint8_t> &i_data)
  * PRIVATE FUNCTION
  */
 
-uint16_t CAsh::computeCRC( vector<uint8_t> i_msg )
+void CAsh::handleAckNumber(uint8_t i_ack_num)
 {
-  uint16_t lo_crc = 0xFFFF; // initial value
-  uint16_t polynomial = 0x1021; // 0001 0000 0010 0001 (0, 5, 12)
-
-  for (std::size_t cnt = 0; cnt < i_msg.size(); cnt++) {
-      for (auto i = 0; i < 8; i++) {
-          bool bit = ((i_msg.at(cnt) >> (7 - i) & 1) == 1);
-          bool c15 = ((lo_crc >> 15 & 1) == 1);
-          lo_crc = static_cast<uint16_t>(lo_crc << 1U);
-          if (c15 ^ bit) {
-              lo_crc ^= polynomial;
-          }
-      }
+  // the NCP ack number is the next frame it expects, all frames before it are acknowledged
+  uint8_t l_acked = (i_ack_num - txAckNum) & 0x07;
+
+  if( (l_acked > 0) && (l_acked <= txPending) )
+  {
+    uint8_t l_last = (i_ack_num - 1) & 0x07;
+
+    // adapt the timeout to the round trip time (not measurable on retransmitted frames): t = 7/8 t + 1/2 rtt
+    if( !txRetransmitted[l_last] )
+    {
+      auto l_rtt = std::chrono::duration_cast<std::chrono::milliseconds>(timer_factory.now() - txTime[l_last]).count();
+      lastRtt = static_cast<uint16_t>(std::min<long long>(l_rtt, T_RX_ACK_MAX));
+      rxAckTimeout = static_cast<uint16_t>( (7 * rxAckTimeout) / 8 + lastRtt / 2 );
+      rxAckTimeout = static_cast<uint16_t>( std::max(T_RX_ACK_MIN, std::min(static_cast<int>(rxAckTimeout), T_RX_ACK_MAX)) );
+    }
+
+    txAckNum = i_ack_num;
+    txPending = static_cast<uint8_t>(txPending - l_acked);
+    consecutiveTimeouts = 0;
+
+    // restart timer for the frames still pending
+    if( 0 == txPending )
+    {
+      timer->stop();
+    }
+    else
+    {
+      startAckTimer();
+    }
   }
+}
 
-  lo_crc &= 0xffff;
+void CAsh::startAckTimer(void)
+{
+  timer->start( rxAckTimeout, [&](ITimer *ipTimer){this->Timeout();} );
+}
 
-  return lo_crc;
+void CAsh::resetInputFrame(void)
+{
+  in_msg_len = 0;
+  in_escape = false;
+  in_error = false;
+  in_crc.reset();
 }
 
-vector<uint8_t> CAsh::stuffedOutputData(vector<uint8_t> i_msg)
+void CAsh::processInputFrame(void)
 {
-  vector<uint8_t> lo_msg;
-
-  for (std::size_t cnt = 0; cnt < i_msg.size(); cnt++) {
-      switch (i_msg.at(cnt)) {
-          case 0x7E:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x5E );
-              break;
-          case 0x7D:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x5D );
-              break;
-          case 0x11:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x31 );
-              break;
-          case 0x13:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x33 );
-              break;
-          case 0x18:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x38 );
-              break;
-          case 0x1A:
-              lo_msg.push_back( 0x7D );
-              lo_msg.push_back( 0x3A );
-              break;
-          default:
-              lo_msg.push_back( i_msg.at(cnt) );
-              break;
-      }
+  uint8_t control = in_msg[0];
+  // data bytes are located between the control byte and the CRC
+  uint8_t *data = &in_msg[1];
+  std::size_t data_len = in_msg_len - 3;
+
+  if ((control & 0x80) == 0) {
+    // DATA;
+    stats.increment(LINK_DATA_FRAMES_RECEIVED);
+    //-- clogD << "CAsh::decode DATA" << std::endl;
+
+    // update ack number, use incoming frm number, a single acknowledgement will cover all frames received since the last one
+    ackNum = ((control>>4&0x07) + 1) & 0x07;
+    if( ackPending )
+    {
+      stats.increment(LINK_ACK_FRAMES_SAVED);
+    }
+    ackPending = true;
+    // piggybacked acknowledgement of our own frames
+    handleAckNumber(control & 0x07);
+
+    CAshRandomiser::apply(data, data_len);
+
+    if( (txWindow <= 1) && (data_len >= 2) && (0 == (data[1] & 0x18)) )
+    {
+      // stop-and-wait: an EZSP response (callback type bits cleared in frame control) implies all our frames were received
+      handleAckNumber(frmNum);
+    }
+
+    if( (data_len >= 3) && (0xFF == data[2]) )
+    {
+      // WARNING for all frames except "VersionRequest" frame, remove exteded header: move sequence number and frame control
+      // over it
+      data[3] = data[1];
+      data[2] = data[0];
+      data += 2;
+      data_len -= 2;
+    }
+
+    if( data_len >= 3 )
+    {
+      if( nullptr != pCb ) { pCb->ashCbData(data, data_len); }
+    }
+    else
+    {
+      clogD << "CAsh::decode DATA too short" << std::endl;
+    }
+  }
+  else if ((control & 0x60) == 0x00) {
+    // ACK;
+    stats.increment(LINK_ACK_FRAMES_RECEIVED);
+    //-- clogD << "CAsh::decode ACK" << std::endl;
+    handleAckNumber(control & 0x07);
+
+    if( nullptr != pCb ) { pCb->ashCbInfo(ASH_ACK); }
   }
-  lo_msg.push_back( 0x7E );
+  else if ((control & 0x60) == 0x20) {
+    // NAK; frames before the NAK ack number are acknowledged, the following ones are to be retransmitted (see RetransmitFrames())
+    stats.increment(LINK_NAK_FRAMES_RECEIVED);
+    handleAckNumber(control & 0x07);
 
+    clogD << "CAsh::decode NACK" << std::endl;
+
+    if( nullptr != pCb ) { pCb->ashCbInfo(ASH_NACK); }
+  }
+  else if (control == 0xC0) {
+    // RST;
+    clogD << "CAsh::decode RST" << std::endl;
+  }
+  else if (control == 0xC1) {
+    // RSTACK;
+    clogD << "CAsh::decode RSTACK" << std::endl;
 
-  return lo_msg;
+    if( !stateConnected )
+    {
+      /** \todo : add some test to verify it is a software reset and ash protocol version is 2 */
+      timer->stop();
+      stateConnected = true;
+      if( nullptr != pCb ){ pCb->ashCbInfo(ASH_STATE_CHANGE); }
+    }
+  }
+  else if (control == 0xC2) {
+    // ERROR;
+    clogD << "CAsh::decode ERROR" << std::endl;
+  }
+  else
+  {
+    clogD << "CAsh::decode UNKNOWN" << std::endl;
+  }
 }
 
-vector<uint8_t> CAsh::dataRandomise(vector<uint8_t> i_data, uint8_t start)
+
+std::size_t CAsh::encodeFrame(uint8_t i_control, const uint8_t *i_data, std::size_t i_len, uint8_t *o_frame)
 {
-    vector<uint8_t> lo_data;
+  CAshCrc l_crc;
+  uint8_t *l_out = o_frame;
 
-    // Randomise the data
-    uint8_t rand = 0x42;
-    for (uint8_t cnt = start; cnt < i_data.size(); cnt++) {
-        lo_data.push_back(i_data.at(cnt) ^ rand);
+  l_crc.update(i_control);
+  l_crc.update(i_data, i_len);
+  uint16_t crc = l_crc.get();
+  const uint8_t l_crc_bytes[2] = { static_cast<uint8_t>(crc>>8), static_cast<uint8_t>(crc&0xFF) };
 
-        if ((rand & 0x01) == 0) {
-            rand = static_cast<uint8_t>(rand >> 1);
-        } else {
-            rand = static_cast<uint8_t>((rand >> 1) ^ 0xb8);
-        }
-    }
+  l_out += CAshStuffing::stuff(&i_control, 1, l_out);
+  l_out += CAshStuffing::stuff(i_data, i_len, l_out);
+  l_out += CAshStuffing::stuff(l_crc_bytes, 2, l_out);
+  *l_out++ = ASH_FLAG_BYTE;
 
-    return lo_data;
+  return static_cast<std::size_t>(l_out - o_frame);
 }
@@ -2,16 +2,21 @@
 
 #include <cstdint>
 #include <vector>
+#include <cstddef>
 #include <memory>	// For std::unique_ptr
+#include <chrono>
 
 #include "../spi/ITimerFactory.h"
+#include "ash-crc.h"
+#include "ezsp-link-stats.h"
 
 
 typedef enum {
   ASH_RESET_FAILED,
   ASH_ACK,
   ASH_NACK,
-  ASH_STATE_CHANGE
+  ASH_STATE_CHANGE,
+  ASH_ACK_TIMEOUT /* DATA frames were not acknowledged in time, they must be sent again (see CAsh::RetransmitFrames()) */
 }EAshInfo;
 
 class CAshCallback
@@ -19,6 +24,15 @@ class CAshCallback
 public:
     virtual ~CAshCallback() { }
     virtual void ashCbInfo( EAshInfo info ) = 0;
+
+    /**
+     * @brief Invoked by CAsh::decode() for each valid DATA frame received
+     *
+     * @param i_data EZSP frame (sequence number, frame control, command id, parameters), already de-randomised and without
+     *               extended header nor CRC. This buffer is only valid during the call
+     * @param i_len Number of bytes in @p i_data
+     */
+    virtual void ashCbData( const uint8_t *i_data, std::size_t i_len ) = 0;
 };
 
 class CAsh
@@ -39,26 +53,149 @@ public:
 
     std::vector<uint8_t> AckFrame(void);
 
+    /**
+     * @brief Encode an ACK frame for the last DATA frame received
+     *
+     * @param o_frame Output buffer, at least ASH_MAX_ENCODED_LENGTH bytes
+     *
+     * @return The number of bytes written to @p o_frame
+     */
+    std::size_t AckFrame(uint8_t *o_frame);
+
     std::vector<uint8_t> DataFrame(std::vector<uint8_t> i_data);
 
-    std::vector<uint8_t> decode(std::vector<uint8_t> &i_data);
+    /**
+     * @brief Encode an EZSP command in a DATA frame
+     *
+     * The EZSP header and the data field are built directly in the retransmission buffer, then encoded (CRC and byte
+     * stuffing) in a single pass, without any allocation.
+     *
+     * @param i_cmd EZSP command id
+     * @param i_params EZSP command parameters
+     * @param i_params_len Number of bytes in @p i_params
+     * @param o_frame Output buffer, at least ASH_MAX_ENCODED_LENGTH bytes
+     *
+     * @return The number of bytes written to @p o_frame, 0 if the frame was not sent because the TX window is full (see
+     *         canSendData()) or if @p i_params do not fit in a DATA frame
+     */
+    std::size_t DataFrame(uint8_t i_cmd, const uint8_t *i_params, std::size_t i_params_len, uint8_t *o_frame);
+
+    /**
+     * @brief Encode again all DATA frames not yet acknowledged by the NCP, with their retransmit flag set
+     *
+     * To be invoked after an ASH_NACK or ASH_ACK_TIMEOUT notification. Frames are returned in order, concatenated in a
+     * single buffer
+     *
+     * @return The encoded frames, empty if there is nothing to retransmit
+     */
+    std::vector<uint8_t> RetransmitFrames(void);
+
+    /**
+     * @brief Set the maximum number of DATA frames that can be sent without being acknowledged by the NCP
+     *
+     * @param i_window The window size, between 1 (default) and ASH_MAX_TX_WINDOW
+     *
+     * @note With a window of 1, the link is stop-and-wait: an EZSP response (as opposed to a callback) implies the NCP got
+     *       our frame, so it also acknowledges it
+     */
+    void setTxWindow(uint8_t i_window);
+
+    uint8_t getTxWindow(void) const { return txWindow; }
+
+    /**
+     * @brief Get the EZSP sequence number the next DataFrame() will use
+     */
+    uint8_t getNextSeqNum(void) const { return seq_num; }
+
+    /**
+     * @brief Get the number of DATA frames sent and not yet acknowledged by the NCP
+     */
+    uint8_t getTxPendingFrames(void) const { return txPending; }
+
+    /**
+     * @brief Check if a new DATA frame can be sent without exceeding the TX window
+     *
+     * To be checked before each DataFrame(), which refuses to send beyond the window rather than drop a frame that may
+     * have to be retransmitted
+     */
+    bool canSendData(void) const;
+
+    /**
+     * @brief Get the current acknowledgement timeout (in ms), adapted to the measured round trip time
+     */
+    uint16_t getRxAckTimeout(void) const { return rxAckTimeout; }
+
+    /**
+     * @brief Get the last round trip time measured between a DATA frame and its acknowledgement (in ms)
+     */
+    uint16_t getLastRtt(void) const { return lastRtt; }
+
+    /**
+     * @brief Check if DATA frames were received and not yet acknowledged (by an ACK frame or a DATA frame we sent)
+     */
+    bool isAckPending(void) const { return ackPending; }
+
+    /**
+     * @brief Get the link statistics (frame and error counters), also used by the EZSP layer for its own statistics
+     */
+    const CEzspLinkStats& getStats(void) const { return stats; }
+    CEzspLinkStats& getStats(void) { return stats; }
+
+    /**
+     * @brief Decode bytes received from the NCP
+     *
+     * Bytes are consumed in one pass, whatever their chunking: frames may span several calls and a call may contain several
+     * frames. Each valid DATA frame is reported through CAshCallback::ashCbData()
+     *
+     * @param i_data Received bytes
+     * @param i_len Number of bytes in @p i_data
+     */
+    void decode(const uint8_t *i_data, std::size_t i_len);
 
     bool isConnected(void){ return stateConnected; }
 
     static std::string EAshInfoToString( EAshInfo in );
 
+    static const std::size_t ASH_MAX_LENGTH = 131; /*!< Maximum size of an unstuffed frame (control byte, data and CRC) */
+    static const std::size_t ASH_MAX_ENCODED_LENGTH = 2 * ASH_MAX_LENGTH + 2; /*!< Maximum size of an encoded frame (all bytes stuffed, flag byte and leading cancel byte) */
+    static const uint8_t ASH_MAX_TX_WINDOW = 7; /*!< Maximum number of unacknowledged DATA frames allowed by ASH */
+    static const uint8_t ASH_MAX_TIMEOUTS = 4; /*!< Consecutive acknowledgement timeouts after which the link is considered lost */
+
 private:
     uint8_t ackNum;
     uint8_t frmNum;
     uint8_t seq_num;
     bool stateConnected;
+    ITimerFactory &timer_factory; /*!< Creates our timer, and provides the clock round trip times are measured on */
     std::unique_ptr<ITimer> timer;
     CAshCallback *pCb;
 
-    std::vector<uint8_t> in_msg;
-
-    uint16_t computeCRC( std::vector<uint8_t> i_msg );
-    std::vector<uint8_t> stuffedOutputData(std::vector<uint8_t> i_msg);
-    std::vector<uint8_t> dataRandomise(std::vector<uint8_t> i_data, uint8_t start);
+    uint8_t in_msg[ASH_MAX_LENGTH]; /*!< Unstuffed bytes of the frame being received */
+    std::size_t in_msg_len; /*!< Number of bytes in in_msg */
+    bool in_escape; /*!< Previous byte received was an escape byte */
+    bool in_error; /*!< Frame being received is to be discarded */
+    CAshCrc in_crc; /*!< CRC of the frame being received, updated on each byte */
+
+    uint8_t txWindow; /*!< Maximum number of unacknowledged DATA frames */
+    uint8_t txAckNum; /*!< Frame number of the oldest unacknowledged DATA frame */
+    uint8_t txPending; /*!< Number of unacknowledged DATA frames, starting from txAckNum */
+    uint8_t txData[8][ASH_MAX_LENGTH]; /*!< Randomised data field of sent DATA frames, indexed by frame number, kept for retransmission */
+    std::size_t txDataLen[8]; /*!< Number of bytes in each txData entry */
+    std::chrono::steady_clock::time_point txTime[8]; /*!< When each txData entry was sent */
+    bool txRetransmitted[8]; /*!< Each txData entry was retransmitted, so its acknowledgement gives no valid round trip time */
+
+    uint16_t rxAckTimeout; /*!< Current acknowledgement timeout (t_rx_ack), in ms */
+    uint16_t lastRtt; /*!< Last measured round trip time, in ms */
+    uint8_t consecutiveTimeouts; /*!< Acknowledgement timeouts since the last acknowledgement */
+
+    bool ackPending; /*!< DATA frames received since our last acknowledgement */
+
+    CEzspLinkStats stats; /*!< Link statistics */
+
+    static std::size_t encodeFrame(uint8_t i_control, const uint8_t *i_data, std::size_t i_len, uint8_t *o_frame);
+    void handleAckNumber(uint8_t i_ack_num);
+    void startAckTimer(void);
+    void resetInputFrame(void);
+    void processInputFrame(void);
     void Timeout(void);
 };
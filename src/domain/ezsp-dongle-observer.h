@@ -8,6 +8,7 @@
 
 #include <vector>
 #include "ezsp-protocol/ezsp-enum.h"
+#include "ezsp-frame-buffer.h"
 
 class CEzspDongleObserver {
 public:
@@ -24,8 +25,30 @@ public:
     /**
      * @brief Method that will be invoked on incoming EZSP messages
      *
+     * The payload is shared by all observers, without copy. The default implementation gives a copy of it to
+     * handleEzspRxMessage(), for observers not overriding this method
+     *
+     * @param i_cmd The EZSP command
+     * @param i_msg_receive The payload of the message
+     */
+    virtual void handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive ) { handleEzspRxMessage(i_cmd, i_msg_receive.toVector()); }
+
+    /**
+     * @brief Method that will be invoked on incoming EZSP messages, with a copy of their payload
+     *
+     * @deprecated Override handleEzspRxFrame() instead, to avoid copying each payload for each observer
+     *
      * @param i_cmd The EZSP command
      * @param i_msg_receive The payload of the message
      */
-    virtual void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive ) = 0;
+    virtual void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive ) { }
+
+    /**
+     * @brief Method that will be invoked when a command sent without completion callback got no response in time
+     *
+     * The dongle has given up on the command and moved on to the next one
+     *
+     * @param i_cmd The EZSP command
+     */
+    virtual void handleEzspCommandTimeout( EEzspCmd i_cmd ) { }
 };
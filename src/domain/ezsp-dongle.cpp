@@ -2,17 +2,197 @@
  * @file ezsp-dongle.cpp
  */
 
+#include <algorithm>
+
 #include "ezsp-dongle.h"
 #include "../spi/GenericLogger.h"
 
+const uint16_t CEzspDongle::DEFAULT_COMMAND_TIMEOUT;
+const uint8_t CEzspDongle::PRIORITY_WEIGHTS[EZSP_PRIORITY_COUNT] = { 4, 2, 1 };
+const uint8_t CEzspDongle::TX_STAGING_FRAMES;
+
+namespace {
+/**
+ * @brief Number of dongle entry points (UART data, timers, application calls) being run by the current thread, which must
+ *        then never wait for room in the send queue
+ */
+thread_local unsigned int t_dispatch_depth = 0;
+
+/**
+ * @brief Flags the current thread as running dongle code, during its lifetime
+ */
+struct DispatchGuard {
+    DispatchGuard() { t_dispatch_depth++; }
+    ~DispatchGuard() { t_dispatch_depth--; }
+};
+}
+
+/**
+ * @brief Progress of a command batch, shared by the completion callbacks of its steps
+ */
+struct CEzspDongle::SBatch {
+    SBatch(std::vector<SEzspBatchStep> i_steps, FEzspBatchCallback i_on_done, EEzspCmdPriority i_priority) :
+        steps(std::move(i_steps)),
+        onDone(std::move(i_on_done)),
+        priority(i_priority),
+        nextStep(0),
+        responses(),
+        finished(false)
+    {
+    }
+
+    std::vector<SEzspBatchStep> steps; /*!< The commands to send */
+    FEzspBatchCallback onDone; /*!< Batch result callback */
+    EEzspCmdPriority priority; /*!< Priority of all steps */
+    std::size_t nextStep; /*!< Index of the next step to send */
+    std::vector<CEzspFrameBuffer> responses; /*!< Responses of the steps completed, in order */
+    bool finished; /*!< onDone was invoked, all other completions are ignored */
+};
+
+/**
+ * @brief Stages the frames encoded during its lifetime, to write them to the UART at once (in a single system call) when
+ *        the outermost batch ends
+ */
+struct CEzspDongle::STxBatch {
+    explicit STxBatch(CEzspDongle& i_dongle) : dongle(i_dongle) { dongle.txBatchDepth++; }
+    ~STxBatch() { if( 0 == --dongle.txBatchDepth ) { dongle.flushTx(); } }
+    STxBatch(const STxBatch&) = delete; /* No copy construction allowed (reference data member) */
+    STxBatch& operator=(const STxBatch&) = delete; /* No assignment allowed (reference data member) */
+
+    CEzspDongle& dongle;
+};
+
+/**
+ * @brief Serialises the dongle activity during its lifetime: holds dongleMutex if there is no executor (the executor thread
+ *        needs no lock), and flags the current thread as running dongle code
+ */
+struct CEzspDongle::SDongleLock {
+    explicit SDongleLock(CEzspDongle& i_dongle) : lock(i_dongle.dongleMutex, std::defer_lock), guard()
+    {
+        if( nullptr == i_dongle.pExecutor )
+        {
+            lock.lock();
+        }
+    }
+
+    std::unique_lock<std::recursive_mutex> lock;
+    DispatchGuard guard;
+};
+
+/**
+ * @brief Timer of the dongle (or of its ASH layer), running its callback serialised with the rest of the dongle activity
+ *        (see runSerialised())
+ *
+ * An expired callback that could not run at once (posted to the executor, or waiting for dongleMutex) is dropped if the
+ * timer was stopped or restarted meanwhile, as TimerWheelFactory does. Only used with the dongle activity serialised.
+ */
+class CEzspDongle::CDongleTimer : public ITimer
+{
+public:
+    CDongleTimer(CEzspDongle& i_dongle, std::unique_ptr<ITimer> i_timer) : dongle(i_dongle), generation(0), timer(std::move(i_timer)) { }
+    CDongleTimer(const CDongleTimer&) = delete; /* No copy construction allowed (reference data member) */
+    CDongleTimer& operator=(const CDongleTimer&) = delete; /* No assignment allowed (reference data member) */
+
+    ~CDongleTimer()
+    {
+        // an expired callback waiting for dongleMutex is dropped once it gets it, destroying timer then waits for it
+        SDongleLock l_lock(dongle);
+        stop();
+    }
+
+    bool start(uint16_t i_timeout, std::function<void (ITimer* triggeringTimer)> i_callback)
+    {
+        if( !i_callback )
+        {
+            return false;
+        }
+        uint64_t l_generation = ++generation;
+        started = true;
+        duration = i_timeout;
+        return timer->start(i_timeout, [this, l_generation, i_callback](ITimer *ipTimer) {
+            dongle.runSerialised([this, l_generation, i_callback]() {
+                if( l_generation == generation )
+                {
+                    started = false;
+                    i_callback(this);
+                }
+            });
+        });
+    }
+
+    bool stop()
+    {
+        bool lo_running = started;
+
+        generation++;
+        started = false;
+        duration = 0;
+        timer->stop();
+        return lo_running;
+    }
+
+    bool isRunning() { return started; }
+
+private:
+    CEzspDongle& dongle;
+    uint64_t generation; /*!< Incremented on each start() and stop(), the callbacks of previous generations are dropped */
+    std::unique_ptr<ITimer> timer; /*!< The actual timer, destroyed first */
+};
+
+/**
+ * @brief Factory of the timers of the dongle and of its ASH layer, wrapping those of the application factory
+ */
+class CEzspDongle::CDongleTimerFactory : public ITimerFactory
+{
+public:
+    CDongleTimerFactory(CEzspDongle& i_dongle, ITimerFactory& i_timer_factory) : dongle(i_dongle), timerFactory(i_timer_factory) { }
+    CDongleTimerFactory(const CDongleTimerFactory&) = delete; /* No copy construction allowed (reference data members) */
+    CDongleTimerFactory& operator=(const CDongleTimerFactory&) = delete; /* No assignment allowed (reference data members) */
+
+    std::unique_ptr<ITimer> create() const { return std::unique_ptr<ITimer>(new CDongleTimer(dongle, timerFactory.create())); }
+    std::chrono::steady_clock::time_point now() const { return timerFactory.now(); }
+
+private:
+    CEzspDongle& dongle;
+    ITimerFactory& timerFactory;
+};
+
 CEzspDongle::CEzspDongle( ITimerFactory &i_timer_factory, CEzspDongleObserver* ip_observer ) :
 	timer_factory(i_timer_factory),
 	pUart(nullptr),
-	ash(new CAsh(static_cast<CAshCallback*>(this), timer_factory)),
+	pExecutor(nullptr),
+	dongleMutex(),
+	pTimerFactory(new CDongleTimerFactory(*this, i_timer_factory)),
+	ash(new CAsh(static_cast<CAshCallback*>(this), *pTimerFactory)),
 	uartIncomingDataHandler(),
-	sendingMsgQueue(),
-	wait_rsp(false),
-	observers()
+	sendingMsgQueues(),
+	laneCredits(),
+	queueCapacity(0),
+	queuePolicy(QUEUE_REJECT),
+	pQueueBlockingLock(nullptr),
+	queueBlockingTimeout(0),
+	queueMutex(),
+	queueRoomCv(),
+	queueRoomDepth(0),
+	queuePostedCount(0),
+	queueHighWatermark(0),
+	queueLowWatermark(0),
+	queueCongestionCb(),
+	queueCongested(false),
+	waitingRspMsgs(),
+	ackDelay(0),
+	ackTimer(pTimerFactory->create()),
+	cmdTimeouts(),
+	defaultCmdTimeout(DEFAULT_COMMAND_TIMEOUT),
+	cmdRetries(0),
+	cmdTimer(pTimerFactory->create()),
+	cmdTimerDeadline(),
+	txFrames(),
+	txFrameLens(),
+	txFrameCount(0),
+	txBatchDepth(0),
+	observers(),
+	rxDispatch()
 {
     if( nullptr != ip_observer )
     {
@@ -22,6 +202,11 @@ CEzspDongle::CEzspDongle( ITimerFactory &i_timer_factory, CEzspDongleObserver* i
 
 CEzspDongle::~CEzspDongle()
 {
+    {
+        SDongleLock l_lock(*this);
+        ackTimer->stop();
+        cmdTimer->stop();
+    }
     pUart = nullptr;
     delete ash;
 }
@@ -32,6 +217,7 @@ bool CEzspDongle::open(IUartDriver *ipUart)
     std::vector<uint8_t> l_buffer;
     size_t l_size;
 
+    SDongleLock l_lock(*this);
     if( nullptr == ipUart )
     {
         lo_success = false;
@@ -40,6 +226,11 @@ bool CEzspDongle::open(IUartDriver *ipUart)
     {
         pUart = ipUart;
 
+        // listen before resetting, a fast ncp may answer before write() returns
+        clogD << "CEzspDongle::open register uart !" << std::endl;
+        uartIncomingDataHandler.registerObserver(this);
+        pUart->setIncomingDataHandler(&uartIncomingDataHandler);
+
         // reset ash ncp
         l_buffer = ash->resetNCPFrame();
 
@@ -57,12 +248,6 @@ bool CEzspDongle::open(IUartDriver *ipUart)
                 lo_success = false;
                 pUart = nullptr;
             }
-            else
-            {
-                clogD << "CEzspDongle::open register uart !" << std::endl;
-                uartIncomingDataHandler.registerObserver(this);
-                pUart->setIncomingDataHandler(&uartIncomingDataHandler);
-            }
         }
     }
 
@@ -71,9 +256,26 @@ bool CEzspDongle::open(IUartDriver *ipUart)
 
 void CEzspDongle::ashCbInfo( EAshInfo info ) 
 { 
+    DispatchGuard l_guard;
     clogD <<  "ashCbInfo : " << CAsh::EAshInfoToString(info) << std::endl;
 
-    if( ASH_STATE_CHANGE == info )
+    if( ASH_ACK == info )
+    {
+        // window may have room for more frames
+        sendNextMsg();
+    }
+    else if( (ASH_NACK == info) || (ASH_ACK_TIMEOUT == info) )
+    {
+        // resend all frames not acknowledged, after the ones already staged
+        std::vector<uint8_t> l_buffer = ash->RetransmitFrames();
+        flushTx();
+        if( (nullptr != pUart) && !l_buffer.empty() )
+        {
+            size_t l_size;
+            pUart->write(l_size, l_buffer.data(), l_buffer.size());
+        }
+    }
+    else if( ASH_STATE_CHANGE == info )
     {
         // inform upper layer that dongle is ready !
         if( ash->isConnected() )
@@ -88,69 +290,239 @@ void CEzspDongle::ashCbInfo( EAshInfo info )
 }
 
 void CEzspDongle::handleInputData(const unsigned char* dataIn, const size_t dataLen)
- {
-    std::vector<uint8_t> li_data;
-    std::vector<uint8_t> lo_msg;
+{
+    if( mustPost() )
+    {
+        // the driver reuses its buffer, bytes are moved into the task
+        pExecutor->post(std::bind([this](const std::vector<uint8_t>& i_bytes) { handleInputData(i_bytes.data(), i_bytes.size()); },
+                                  std::vector<uint8_t>(dataIn, dataIn+dataLen)));
+        return;
+    }
+
+    // acknowledgements and commands triggered by all the frames of this chunk are written at once
+    SDongleLock l_lock(*this);
+    STxBatch l_tx_batch(*this);
+    ash->decode(dataIn, dataLen);
+}
+
+void CEzspDongle::ashCbData( const uint8_t *i_data, std::size_t i_len )
+{
+    //clogD << "CEzspDongle::ashCbData ash message decoded" << std::endl;
 
-    li_data.clear();
-    for( size_t loop=0; loop< dataLen; loop++ )
+    // send ack, unless delayed
+    if( 0 == ackDelay )
     {
-        li_data.push_back(dataIn[loop]);
+        sendAck();
     }
 
-    while( !li_data.empty())
+    // ezsp frame: sequence number, frame control, command id, parameters
+    uint8_t l_seq = i_data[0];
+    bool l_is_response = (0 == (i_data[1] & 0x18)); // callback type bits cleared
+    EEzspCmd l_cmd = static_cast<EEzspCmd>(i_data[2]);
+    // keep only payload, shared by all its receivers
+    CEzspFrameBuffer lo_msg(i_data+3, i_len-3);
+
+    // response to a sending command, matched by sequence number only
+    FEzspResponseCallback l_on_response;
+    bool l_unmatched = false;
+    if( l_is_response )
     {
-        lo_msg = ash->decode(li_data);
+        auto it = std::find_if(waitingRspMsgs.begin(), waitingRspMsgs.end(),
+                               [l_seq](const SMsg& i_msg){ return i_msg.seq == l_seq; });
+        if( waitingRspMsgs.end() != it )
+        {
+            ash->getStats().recordLatency(l_cmd, std::chrono::duration_cast<std::chrono::microseconds>(timer_factory.now() - it->sentTime));
+            l_on_response = std::move(it->onResponse);
 
-        // send incomming mesage to application
-        if( !lo_msg.empty() )
+            // remove waiting message
+            waitingRspMsgs.erase(it);
+        }
+        else
         {
-            size_t l_size;
+            // late response to a command that already timed out, it must not be taken for the one of a newer command
+            l_unmatched = true;
+        }
+    }
 
-            //clogD << "CEzspDongle::handleInputData ash message decoded" << std::endl;
+    // deliver responses to their requester, everything else to observers
+    if( l_on_response )
+    {
+        l_on_response(EZSP_CMD_SUCCESS, l_cmd, lo_msg);
+    }
+    else if( l_unmatched )
+    {
+        clogW << "CEzspDongle::ashCbData no pending command for response " << CEzspEnum::EEzspCmdToString(l_cmd) << " seq " << static_cast<unsigned int>(l_seq) << ", dropped" << std::endl;
+        ash->getStats().increment(LINK_UNMATCHED_RESPONSES);
+    }
+    else
+    {
+        notifyObserversOfEzspRxMessage( l_cmd, lo_msg );
+    }
 
-            // send ack
-            std::vector<uint8_t> l_msg = ash->AckFrame();
-            pUart->write(l_size, l_msg.data(), l_msg.size());
+    // send next, the response or its acknowledgement may have freed room in the window
+    sendNextMsg();
 
-            // call handler
+    // nothing sent to carry our acknowledgement, send it later, along with the ones of the following frames
+    if( ash->isAckPending() && !ackTimer->isRunning() )
+    {
+        ackTimer->start( ackDelay, [this](ITimer *ipTimer){ this->sendAck(); } );
+    }
+}
 
-            // ezsp
-            // extract ezsp command
-            EEzspCmd l_cmd = static_cast<EEzspCmd>(lo_msg.at(2));
-            // keep only payload
-            lo_msg.erase(lo_msg.begin(),lo_msg.begin()+3);    
+bool CEzspDongle::sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload )
+{
+    return sendCommand(i_cmd, std::move(i_cmd_payload), FEzspResponseCallback());
+}
+
+bool CEzspDongle::sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload, EEzspCmdPriority i_priority)
+{
+    return sendCommand(i_cmd, std::move(i_cmd_payload), FEzspResponseCallback(), 0, i_priority);
+}
 
-            // notify observers
-            notifyObserversOfEzspRxMessage( l_cmd, lo_msg );
+bool CEzspDongle::sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload, FEzspResponseCallback i_on_response, uint16_t i_timeout,
+                              EEzspCmdPriority i_priority)
+{
+    sMsg l_msg;
 
+    if( i_priority >= EZSP_PRIORITY_COUNT )
+    {
+        i_priority = EZSP_PRIORITY_INTERACTIVE;
+    }
+    l_msg.i_cmd = i_cmd;
+    l_msg.payload = std::move(i_cmd_payload);
+    l_msg.onResponse = std::move(i_on_response);
+    l_msg.timeout = i_timeout;
+    l_msg.priority = i_priority;
 
-            // response to a sending command
-            if( !sendingMsgQueue.empty() )
+    if( mustPost() )
+    {
+        // admitted here against the commands queued and already posted, then queued by a task of the executor
+        if( !reserveQueueRoom() )
+        {
+            rejectCommand(i_cmd);
+            return false;
+        }
+        pExecutor->post(std::bind([this](SMsg& i_msg) {
+            SDongleLock l_lock(*this);
+            bool l_queued = queueCommand(i_msg, nullptr);
+            releaseQueueRoom();
+            // room made for the reservation may have been taken meanwhile (retried commands)
+            if( !l_queued && i_msg.onResponse )
             {
-				sMsg l_msgQ = sendingMsgQueue.front();
-				if( l_msgQ.i_cmd == l_cmd ) // Bug
-				{
-					// remove waiting message and send next
-					sendingMsgQueue.pop();
-					wait_rsp = false;
-					sendNextMsg();
-				}
+                i_msg.onResponse(EZSP_CMD_REJECTED, i_msg.i_cmd, CEzspFrameBuffer());
             }
+        }, std::move(l_msg)));
+        return true;
+    }
+
+    // only the outermost call may wait for room, no dongle lock is held by this thread then, except its own one
+    bool l_may_wait = (0 == t_dispatch_depth) && (nullptr == pExecutor);
+    SDongleLock l_lock(*this);
+    return queueCommand(l_msg, l_may_wait ? &l_lock : nullptr);
+}
+
+
+void CEzspDongle::setTxWindow(uint8_t i_window)
+{
+    if( mustPost() )
+    {
+        pExecutor->post([this, i_window]() { setTxWindow(i_window); });
+        return;
+    }
+
+    SDongleLock l_lock(*this);
+    ash->setTxWindow(i_window);
+    sendNextMsg();
+}
+
+void CEzspDongle::sendBatch(std::vector<SEzspBatchStep> i_steps, FEzspBatchCallback i_on_done, EEzspCmdPriority i_priority)
+{
+    if( mustPost() )
+    {
+        pExecutor->post(std::bind([this, i_priority](std::vector<SEzspBatchStep>& i_batch_steps, FEzspBatchCallback& i_batch_on_done) {
+            sendBatch(std::move(i_batch_steps), std::move(i_batch_on_done), i_priority);
+        }, std::move(i_steps), std::move(i_on_done)));
+        return;
+    }
+
+    SDongleLock l_lock(*this);
+    std::shared_ptr<SBatch> l_batch = std::make_shared<SBatch>(std::move(i_steps), std::move(i_on_done), i_priority);
+
+    l_batch->responses.reserve(l_batch->steps.size());
+    if( l_batch->steps.empty() )
+    {
+        l_batch->finished = true;
+        if( l_batch->onDone )
+        {
+            l_batch->onDone(EZSP_CMD_SUCCESS, 0, l_batch->responses);
         }
-    }    
+        return;
+    }
+    runBatch(l_batch);
 }
 
-void CEzspDongle::sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload )
+void CEzspDongle::setCommandTimeout(EEzspCmd i_cmd, uint16_t i_timeout)
 {
-    sMsg l_msg;
+    if( 0 == i_timeout )
+    {
+        cmdTimeouts.erase(i_cmd);
+    }
+    else
+    {
+        cmdTimeouts[i_cmd] = i_timeout;
+    }
+}
 
-    l_msg.i_cmd = i_cmd;
-    l_msg.payload = i_cmd_payload;
-    
-    sendingMsgQueue.push(l_msg);
+void CEzspDongle::setDefaultCommandTimeout(uint16_t i_timeout)
+{
+    defaultCmdTimeout = i_timeout;
+}
 
-    sendNextMsg();
+uint16_t CEzspDongle::getCommandTimeout(EEzspCmd i_cmd) const
+{
+    auto it = cmdTimeouts.find(i_cmd);
+    return (cmdTimeouts.end() == it) ? defaultCmdTimeout : it->second;
+}
+
+void CEzspDongle::setCommandRetries(uint8_t i_retries)
+{
+    cmdRetries = i_retries;
+}
+
+void CEzspDongle::setQueueCapacity(std::size_t i_capacity, EEzspQueuePolicy i_policy)
+{
+    queueCapacity = i_capacity;
+    queuePolicy = i_policy;
+}
+
+void CEzspDongle::setQueueBlockingLock(std::mutex *ip_lock, uint16_t i_timeout)
+{
+    pQueueBlockingLock = ip_lock;
+    queueBlockingTimeout = i_timeout;
+}
+
+void CEzspDongle::setQueueWatermarks(std::size_t i_high, std::size_t i_low, FEzspQueueCongestionCallback i_callback)
+{
+    queueHighWatermark = i_high;
+    queueLowWatermark = i_low;
+    queueCongestionCb = std::move(i_callback);
+    queueCongested = false;
+}
+
+void CEzspDongle::setAckDelay(uint16_t i_delay)
+{
+    if( mustPost() )
+    {
+        pExecutor->post([this, i_delay]() { setAckDelay(i_delay); });
+        return;
+    }
+
+    SDongleLock l_lock(*this);
+    ackDelay = i_delay;
+    if( 0 == ackDelay )
+    {
+        sendAck();
+    }
 }
 
 
@@ -160,34 +532,428 @@ void CEzspDongle::sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload
  * 
  */
 
-void CEzspDongle::sendNextMsg( void )
+void CEzspDongle::runBatch( const std::shared_ptr<SBatch>& i_batch )
 {
-    if( (!wait_rsp) && (!sendingMsgQueue.empty()) )
+    // keep the window full with this batch steps, no more: the following ones are not sent if a step fails
+    STxBatch l_tx_batch(*this);
+    while( !i_batch->finished && (i_batch->nextStep < i_batch->steps.size()) &&
+           (i_batch->nextStep - i_batch->responses.size() < ash->getTxWindow()) )
+    {
+        std::size_t l_step = i_batch->nextStep++;
+        std::shared_ptr<SBatch> l_batch = i_batch;
+        bool l_queued = sendCommand(i_batch->steps[l_step].i_cmd, i_batch->steps[l_step].payload,
+                                    [this, l_batch, l_step](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response){
+                                        this->completeBatchStep(l_batch, l_step, i_status, i_response);
+                                    }, 0, i_batch->priority);
+        if( !l_queued )
+        {
+            completeBatchStep(i_batch, l_step, EZSP_CMD_REJECTED, CEzspFrameBuffer());
+        }
+    }
+}
+
+void CEzspDongle::completeBatchStep( const std::shared_ptr<SBatch>& i_batch, std::size_t i_step, EEzspCmdStatus i_status, const CEzspFrameBuffer& i_response )
+{
+    if( i_batch->finished )
+    {
+        return;
+    }
+
+    if( (EZSP_CMD_SUCCESS == i_status) && i_batch->steps[i_step].validator && !i_batch->steps[i_step].validator(i_response) )
+    {
+        i_status = EZSP_CMD_INVALID_RESPONSE;
+    }
+    // steps complete in order, unless an earlier one is being retried after a timeout
+    if( (EZSP_CMD_SUCCESS == i_status) && (i_step != i_batch->responses.size()) )
     {
-        sMsg l_msg = sendingMsgQueue.front();
+        clogW << "CEzspDongle::completeBatchStep step " << i_step << " completed before step " << i_batch->responses.size() << std::endl;
+        i_status = EZSP_CMD_INVALID_RESPONSE;
+    }
 
-        // encode command using ash and write to uart
-        std::vector<uint8_t> li_data;
-        std::vector<uint8_t> l_enc_data;
-        size_t l_size;
+    if( EZSP_CMD_SUCCESS != i_status )
+    {
+        clogE << "CEzspDongle::completeBatchStep batch failed at step " << i_step << " ("
+              << CEzspEnum::EEzspCmdToString(i_batch->steps[i_step].i_cmd) << ")" << std::endl;
+        i_batch->finished = true;
+        if( i_batch->onDone )
+        {
+            i_batch->onDone(i_status, i_step, i_batch->responses);
+        }
+        return;
+    }
 
-        li_data.clear();
-        li_data.push_back(static_cast<uint8_t>(l_msg.i_cmd));
-        for( size_t loop=0; loop< l_msg.payload.size(); loop++ )
+    i_batch->responses.push_back(i_response);
+    if( i_batch->responses.size() == i_batch->steps.size() )
+    {
+        i_batch->finished = true;
+        if( i_batch->onDone )
         {
-            li_data.push_back(l_msg.payload.at(loop));
+            i_batch->onDone(EZSP_CMD_SUCCESS, i_batch->steps.size(), i_batch->responses);
         }
+        return;
+    }
+    runBatch(i_batch);
+}
+
+std::size_t CEzspDongle::getSendingQueueDepth( void ) const
+{
+    std::size_t lo_depth = 0;
+
+    for( const auto& l_queue : sendingMsgQueues )
+    {
+        lo_depth += l_queue.size();
+    }
+
+    return lo_depth;
+}
+
+bool CEzspDongle::admitCommand( EEzspCmdPriority i_priority, SDongleLock* ip_waiting_lock )
+{
+    if( (0 == queueCapacity) || (getSendingQueueDepth() < queueCapacity) )
+    {
+        return true;
+    }
+
+    if( (QUEUE_BLOCK == queuePolicy) && (nullptr != pQueueBlockingLock) && (nullptr != ip_waiting_lock) )
+    {
+        // the caller holds the application lock and ours: release them so that responses can be delivered, and wait on
+        // queueMutex, as room can also be made by timers (command timeouts), which run without the application lock
+        std::chrono::steady_clock::time_point l_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(queueBlockingTimeout);
+        do
+        {
+            ip_waiting_lock->lock.unlock();
+            pQueueBlockingLock->unlock();
+            {
+                std::unique_lock<std::mutex> l_lock(queueMutex);
+                queueRoomCv.wait_until(l_lock, l_deadline, [this](){ return queueRoomDepth < queueCapacity; });
+            }
+            pQueueBlockingLock->lock();
+            ip_waiting_lock->lock.lock();
+            // another application thread may have filled the queue again before we got the application lock back
+            if( getSendingQueueDepth() < queueCapacity )
+            {
+                return true;
+            }
+        } while( std::chrono::steady_clock::now() < l_deadline );
+        return false;
+    }
+
+    if( QUEUE_DROP_OLDEST == queuePolicy )
+    {
+        // make room in the lowest priority queue not above the new command one
+        for( int l_lane = EZSP_PRIORITY_COUNT - 1; l_lane >= static_cast<int>(i_priority); l_lane-- )
+        {
+            std::deque<SMsg>& l_queue = sendingMsgQueues[l_lane];
+            if( !l_queue.empty() )
+            {
+                SMsg l_dropped = std::move(l_queue.front());
+                l_queue.pop_front();
+                ash->getStats().increment(LINK_COMMANDS_DROPPED);
+                clogW << "CEzspDongle::sendCommand queue full, " << CEzspEnum::EEzspCmdToString(l_dropped.i_cmd) << " dropped" << std::endl;
+                if( l_dropped.onResponse )
+                {
+                    l_dropped.onResponse(EZSP_CMD_DROPPED, l_dropped.i_cmd, CEzspFrameBuffer());
+                }
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool CEzspDongle::reserveQueueRoom( void )
+{
+    std::chrono::steady_clock::time_point l_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(queueBlockingTimeout);
+    std::unique_lock<std::mutex> l_lock(queueMutex);
+
+    // making room by dropping the oldest command is up to the task queueing the command
+    while( (0 != queueCapacity) && (QUEUE_DROP_OLDEST != queuePolicy) && (queueRoomDepth + queuePostedCount >= queueCapacity) )
+    {
+        if( (QUEUE_BLOCK != queuePolicy) || (nullptr == pQueueBlockingLock) || (std::chrono::steady_clock::now() >= l_deadline) )
+        {
+            return false;
+        }
+        // the caller holds the application lock, which the tasks making room may need: release it while waiting (it is
+        // taken before queueMutex)
+        l_lock.unlock();
+        pQueueBlockingLock->unlock();
+        {
+            std::unique_lock<std::mutex> l_wait_lock(queueMutex);
+            queueRoomCv.wait_until(l_wait_lock, l_deadline, [this](){ return queueRoomDepth + queuePostedCount < queueCapacity; });
+        }
+        pQueueBlockingLock->lock();
+        l_lock.lock();
+    }
+    queuePostedCount++;
+
+    return true;
+}
+
+void CEzspDongle::releaseQueueRoom( void )
+{
+    {
+        std::lock_guard<std::mutex> l_lock(queueMutex);
+        queuePostedCount--;
+    }
+    queueRoomCv.notify_all();
+}
+
+bool CEzspDongle::queueCommand( SMsg& io_msg, SDongleLock* ip_waiting_lock )
+{
+    if( !admitCommand(io_msg.priority, ip_waiting_lock) )
+    {
+        rejectCommand(io_msg.i_cmd);
+        return false;
+    }
+
+    if( 0 == io_msg.timeout )
+    {
+        io_msg.timeout = getCommandTimeout(io_msg.i_cmd);
+    }
+    io_msg.retries = cmdRetries;
+
+    sendingMsgQueues[io_msg.priority].push_back(std::move(io_msg));
+    updateSendingQueueDepth();
+
+    sendNextMsg();
+
+    return true;
+}
+
+void CEzspDongle::rejectCommand( EEzspCmd i_cmd )
+{
+    clogW << "CEzspDongle::sendCommand queue full, " << CEzspEnum::EEzspCmdToString(i_cmd) << " rejected" << std::endl;
+    ash->getStats().increment(LINK_COMMANDS_REJECTED);
+}
+
+void CEzspDongle::updateSendingQueueDepth( void )
+{
+    std::size_t l_depth = getSendingQueueDepth();
+
+    ash->getStats().updateQueueDepth(l_depth);
+    {
+        std::lock_guard<std::mutex> l_lock(queueMutex);
+        queueRoomDepth = l_depth;
+    }
+    queueRoomCv.notify_all();
+
+    if( !queueCongestionCb )
+    {
+        return;
+    }
+    if( !queueCongested && (l_depth >= queueHighWatermark) )
+    {
+        queueCongested = true;
+        queueCongestionCb(true);
+    }
+    else if( queueCongested && (l_depth <= queueLowWatermark) )
+    {
+        queueCongested = false;
+        queueCongestionCb(false);
+    }
+}
+
+std::deque<SMsg>* CEzspDongle::selectSendingQueue( void )
+{
+    for( uint8_t l_round = 0; l_round < 2; l_round++ )
+    {
+        for( uint8_t l_lane = 0; l_lane < EZSP_PRIORITY_COUNT; l_lane++ )
+        {
+            if( !sendingMsgQueues[l_lane].empty() && (laneCredits[l_lane] > 0) )
+            {
+                laneCredits[l_lane]--;
+                return &sendingMsgQueues[l_lane];
+            }
+        }
+
+        // all waiting commands are in lanes that used up their credits: start a new round
+        std::copy(PRIORITY_WEIGHTS, PRIORITY_WEIGHTS + EZSP_PRIORITY_COUNT, laneCredits);
+    }
+
+    return nullptr;
+}
+
+void CEzspDongle::sendNextMsg( void )
+{
+    std::deque<SMsg>* l_queue;
+    STxBatch l_tx_batch(*this);
+
+    while( (nullptr != pUart) && (waitingRspMsgs.size() < ash->getTxWindow()) && ash->canSendData() &&
+           (nullptr != (l_queue = selectSendingQueue())) )
+    {
+        waitingRspMsgs.push_back(std::move(l_queue->front()));
+        l_queue->pop_front();
+        updateSendingQueueDepth();
+
+        // encode command using ash, in a staged buffer written to uart along with the other frames of this batch
+        sMsg& l_msg = waitingRspMsgs.back();
+        uint8_t *l_enc_data = beginTxFrame();
 
         //-- clogD << "CEzspDongle::sendCommand ash->DataFrame" << std::endl;
-        l_enc_data = ash->DataFrame(li_data);
-        if( nullptr != pUart )
+        l_msg.seq = ash->getNextSeqNum();
+        size_t l_enc_len = ash->DataFrame(static_cast<uint8_t>(l_msg.i_cmd), l_msg.payload.data(), l_msg.payload.size(), l_enc_data);
+        if( 0 == l_enc_len )
         {
-            //-- clogD << "CEzspDongle::sendCommand pUart->write" << std::endl;
-            pUart->write(l_size, l_enc_data.data(), l_enc_data.size());
+            // refused by ash (parameters too long), nothing was sent
+            SMsg l_failed = std::move(l_msg);
+            waitingRspMsgs.pop_back();
+            failCommand(l_failed, EZSP_CMD_INVALID_COMMAND);
+            continue;
+        }
+        l_msg.sentTime = timer_factory.now();
+        commitTxFrame(l_enc_len);
+
+        startCommandTimer();
+    }
+}
 
-            wait_rsp = true;
+
+void CEzspDongle::failCommand( SMsg& i_msg, EEzspCmdStatus i_status )
+{
+    if( i_msg.onResponse )
+    {
+        i_msg.onResponse(i_status, i_msg.i_cmd, CEzspFrameBuffer());
+    }
+    else
+    {
+        // observers only learn about failed commands through timeouts
+        notifyObserversOfEzspCommandTimeout(i_msg.i_cmd);
+    }
+}
+
+
+void CEzspDongle::startCommandTimer( void )
+{
+    if( waitingRspMsgs.empty() )
+    {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point l_deadline = std::chrono::steady_clock::time_point::max();
+    for( const SMsg& l_msg : waitingRspMsgs )
+    {
+        l_deadline = std::min(l_deadline, l_msg.sentTime + std::chrono::milliseconds(l_msg.timeout));
+    }
+
+    // an earlier deadline is already watched, it will restart the timer for the next ones when it expires
+    if( cmdTimer->isRunning() && (cmdTimerDeadline <= l_deadline) )
+    {
+        return;
+    }
+
+    auto l_delay = std::chrono::duration_cast<std::chrono::milliseconds>(l_deadline - timer_factory.now()).count();
+    cmdTimerDeadline = l_deadline;
+    cmdTimer->start( static_cast<uint16_t>(std::max<decltype(l_delay)>(1, std::min<decltype(l_delay)>(l_delay, UINT16_MAX))),
+                     [this](ITimer *ipTimer){ this->handleCommandTimeout(); } );
+}
+
+
+void CEzspDongle::handleCommandTimeout( void )
+{
+    std::chrono::steady_clock::time_point l_now = timer_factory.now();
+    std::deque<SMsg> l_retried;
+    std::deque<SMsg> l_failed;
+
+    // commands may already have got their response since the timer was started
+    for( auto it = waitingRspMsgs.begin(); it != waitingRspMsgs.end(); )
+    {
+        if( l_now < it->sentTime + std::chrono::milliseconds(it->timeout) )
+        {
+            ++it;
+        }
+        else
+        {
+            if( it->retries > 0 )
+            {
+                it->retries--;
+                ash->getStats().increment(LINK_COMMAND_RETRIES);
+                l_retried.push_back(std::move(*it));
+            }
+            else
+            {
+                ash->getStats().increment(LINK_COMMAND_TIMEOUTS);
+                l_failed.push_back(std::move(*it));
+            }
+            it = waitingRspMsgs.erase(it);
+        }
+    }
+
+    // retried commands are sent again first within their priority, in their original order
+    for( auto it = l_retried.rbegin(); it != l_retried.rend(); ++it )
+    {
+        sendingMsgQueues[it->priority].push_front(std::move(*it));
+    }
+    updateSendingQueueDepth();
+
+    for( SMsg& l_msg : l_failed )
+    {
+        clogE << "CEzspDongle::handleCommandTimeout no response to " << CEzspEnum::EEzspCmdToString(l_msg.i_cmd) << " within " << l_msg.timeout << "ms" << std::endl;
+        failCommand(l_msg, EZSP_CMD_TIMEOUT);
+    }
+
+    // the window has room for the next commands
+    sendNextMsg();
+    startCommandTimer();
+}
+
+
+void CEzspDongle::runSerialised( std::function<void (void)> i_task )
+{
+    if( mustPost() )
+    {
+        pExecutor->post(std::move(i_task));
+        return;
+    }
+
+    SDongleLock l_lock(*this);
+    i_task();
+}
+
+
+void CEzspDongle::sendAck( void )
+{
+    if( (nullptr != pUart) && ash->isAckPending() )
+    {
+        uint8_t *l_ack = beginTxFrame();
+
+        commitTxFrame(ash->AckFrame(l_ack));
+    }
+}
+
+uint8_t* CEzspDongle::beginTxFrame( void )
+{
+    if( TX_STAGING_FRAMES == txFrameCount )
+    {
+        flushTx();
+    }
+    return txFrames[txFrameCount];
+}
+
+void CEzspDongle::commitTxFrame( std::size_t i_len )
+{
+    txFrameLens[txFrameCount++] = i_len;
+    if( 0 == txBatchDepth )
+    {
+        flushTx();
+    }
+}
+
+void CEzspDongle::flushTx( void )
+{
+    UartIoVec l_iov[TX_STAGING_FRAMES];
+    size_t l_size;
+
+    if( (nullptr != pUart) && (txFrameCount > 0) )
+    {
+        for( uint8_t l_frame = 0; l_frame < txFrameCount; l_frame++ )
+        {
+            l_iov[l_frame].buf = txFrames[l_frame];
+            l_iov[l_frame].cnt = txFrameLens[l_frame];
         }
+        pUart->writev(l_size, l_iov, txFrameCount);
     }
+    txFrameCount = 0;
 }
 
 
@@ -196,22 +962,74 @@ void CEzspDongle::sendNextMsg( void )
  */
 bool CEzspDongle::registerObserver(CEzspDongleObserver* observer)
 {
-    return this->observers.emplace(observer).second;
+    return registerObserver(observer, static_cast<EEzspCmd>(0x00), static_cast<EEzspCmd>(0xFF));
+}
+
+bool CEzspDongle::registerObserver(CEzspDongleObserver* observer, EEzspCmd i_cmd)
+{
+    return registerObserver(observer, i_cmd, i_cmd);
+}
+
+bool CEzspDongle::registerObserver(CEzspDongleObserver* observer, EEzspCmd i_first, EEzspCmd i_last)
+{
+    bool lo_new = this->observers.emplace(observer).second;
+
+    for( unsigned int loop = static_cast<uint8_t>(i_first); loop <= static_cast<uint8_t>(i_last); loop++ )
+    {
+        lo_new = subscribeObserver(observer, static_cast<uint8_t>(loop)) || lo_new;
+    }
+    return lo_new;
+}
+
+bool CEzspDongle::registerObserver(CEzspDongleObserver* observer, const std::vector<EEzspCmd>& i_cmds)
+{
+    bool lo_new = this->observers.emplace(observer).second;
+
+    for( EEzspCmd l_cmd : i_cmds )
+    {
+        lo_new = subscribeObserver(observer, static_cast<uint8_t>(l_cmd)) || lo_new;
+    }
+    return lo_new;
 }
 
 bool CEzspDongle::unregisterObserver(CEzspDongleObserver* observer)
 {
+    for( std::vector<CEzspDongleObserver*>& l_entry : this->rxDispatch )
+    {
+        l_entry.erase(std::remove(l_entry.begin(), l_entry.end(), observer), l_entry.end());
+    }
     return static_cast<bool>(this->observers.erase(observer));
 }
 
+bool CEzspDongle::subscribeObserver( CEzspDongleObserver* observer, uint8_t i_cmd )
+{
+    std::vector<CEzspDongleObserver*>& l_entry = this->rxDispatch[i_cmd];
+
+    if( std::find(l_entry.begin(), l_entry.end(), observer) != l_entry.end() )
+    {
+        return false;
+    }
+    l_entry.push_back(observer);
+    return true;
+}
+
 void CEzspDongle::notifyObserversOfDongleState( EDongleState i_state ) {
 	for(auto observer : this->observers) {
 		observer->handleDongleState(i_state);
 	}
 }
 
-void CEzspDongle::notifyObserversOfEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_message ) {
+void CEzspDongle::notifyObserversOfEzspRxMessage( EEzspCmd i_cmd, const CEzspFrameBuffer& i_message ) {
+	const std::vector<CEzspDongleObserver*>& l_entry = this->rxDispatch[static_cast<uint8_t>(i_cmd)];
+
+	/* Indexed loop, as an observer may register another one while being invoked */
+	for(std::size_t loop = 0; loop < l_entry.size(); loop++) {
+		l_entry[loop]->handleEzspRxFrame(i_cmd, i_message);
+	}
+}
+
+void CEzspDongle::notifyObserversOfEzspCommandTimeout( EEzspCmd i_cmd ) {
 	for(auto observer : this->observers) {
-		observer->handleEzspRxMessage(i_cmd, i_message);
+		observer->handleEzspCommandTimeout(i_cmd);
 	}
 }
@@ -3,20 +3,82 @@
 #include <string>
 #include <iostream>
 #include <vector>
-#include <queue>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 
 #include "ezsp-protocol/ezsp-enum.h"
 #include "../spi/IUartDriver.h"
 #include "ash.h"
 #include "ezsp-dongle-observer.h"
+#include "ezsp-frame-buffer.h"
 #include "../spi/ITimerFactory.h"
+#include "../spi/IExecutor.h"
 
-extern "C" {	/* Avoid compiler warning on member initialization for structs (in -Weffc++ mode) */
+typedef enum {
+  EZSP_CMD_SUCCESS, /* Response received */
+  EZSP_CMD_TIMEOUT, /* No response received in time, even after all retries */
+  EZSP_CMD_DROPPED, /* Removed from a full send queue, to make room for a newer command (QUEUE_DROP_OLDEST policy) */
+  EZSP_CMD_REJECTED, /* Not queued, the send queue being full (batch steps, and commands sent from another thread than the executor one, sendCommand() returns false instead otherwise) */
+  EZSP_CMD_INVALID_RESPONSE, /* Response refused by the validator of a batch step */
+  EZSP_CMD_INVALID_COMMAND /* Not sent, its parameters do not fit in an ASH DATA frame */
+}EEzspCmdStatus;
+
+/**
+ * @brief Result of a command batch, invoked with the status of the batch, the index of the failed step (the number of
+ *        steps if all succeeded) and the responses of all the steps completed, in order
+ */
+typedef std::function<void (EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses)> FEzspBatchCallback;
+
+typedef enum {
+  QUEUE_REJECT,     /* A command sent to a full queue is rejected */
+  QUEUE_BLOCK,      /* The caller waits for room in the queue (see CEzspDongle::setQueueBlockingLock()), its command is rejected if none is made in time */
+  QUEUE_DROP_OLDEST /* The oldest queued command of the same or a lower priority is dropped, or the new command is rejected */
+}EEzspQueuePolicy;
+
+/**
+ * @brief Send queue congestion callback, invoked with true when the queue reaches its high watermark and with false when
+ *        it is back to its low watermark
+ */
+typedef std::function<void (bool i_congested)> FEzspQueueCongestionCallback;
+
+typedef enum {
+  EZSP_PRIORITY_REALTIME,     /* Time-critical commands (GP sends with a short TX queue lifetime) */
+  EZSP_PRIORITY_INTERACTIVE,  /* Default, commands triggered by the application */
+  EZSP_PRIORITY_BULK,         /* Background commands (table sweeps) */
+  EZSP_PRIORITY_COUNT         /* Number of priorities, not a priority */
+}EEzspCmdPriority;
+
+/**
+ * @brief Completion callback of a command, invoked with its status, the command id and the response parameters (empty
+ *        unless EZSP_CMD_SUCCESS)
+ */
+typedef std::function<void (EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response)> FEzspResponseCallback;
+
+extern "C" {
+    /* Every member has a default initializer, as sMsg is default constructed (no member initialization list, in -Weffc++ mode) */
     typedef struct sMsg
+    {
+        EEzspCmd i_cmd = EZSP_VERSION;
+        std::vector<uint8_t> payload = std::vector<uint8_t>();
+        std::chrono::steady_clock::time_point sentTime = std::chrono::steady_clock::time_point(); /* When the command was written to the UART */
+        uint8_t seq = 0; /* EZSP sequence number the command was sent with */
+        FEzspResponseCallback onResponse = FEzspResponseCallback(); /* Completion callback, responses are notified to observers if not set */
+        uint16_t timeout = 0; /* Maximum delay between sending the command and its response (in ms) */
+        uint8_t retries = 0; /* Number of times the command can still be sent again on timeout */
+        EEzspCmdPriority priority = EZSP_PRIORITY_INTERACTIVE; /* Send queue lane of the command */
+    }SMsg;
+
+    typedef struct sEzspBatchStep
     {
         EEzspCmd i_cmd;
         std::vector<uint8_t> payload;
-    }SMsg;
+        std::function<bool (const CEzspFrameBuffer& i_response)> validator; /* Checks the response, any response is valid if not set */
+    }SEzspBatchStep;
 }
 
 #ifdef USE_RARITAN
@@ -42,10 +104,198 @@ public:
 
     /**
      * @brief Send Ezsp Command
+     *
+     * @return false if the command was rejected, the send queue being full (see setQueueCapacity())
+     */
+    bool sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload = std::vector<uint8_t>() );
+
+    /**
+     * @brief Send Ezsp Command, ahead of or behind commands of other priorities
+     *
+     * Commands are sent in order within a priority. Across priorities, a weighted round robin sends up to
+     * PRIORITY_WEIGHTS[p] commands of priority p per round, higher priorities first, so that lower priorities are delayed
+     * but never starved.
+     *
+     * @param i_cmd The command id
+     * @param i_cmd_payload The command parameters
+     * @param i_priority The command priority
+     *
+     * @return false if the command was rejected, the send queue being full (see setQueueCapacity())
+     */
+    bool sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload, EEzspCmdPriority i_priority);
+
+    /**
+     * @brief Send Ezsp Command, its response is given to @p i_on_response only
+     *
+     * The response is matched to the command by its EZSP sequence number only, so neither callbacks with the same
+     * command id nor a late response to a previous command that timed out can be mistaken for it (late responses are
+     * dropped, and counted as LINK_UNMATCHED_RESPONSES). Observers only get responses to commands sent without
+     * completion callback, and callbacks.
+     *
+     * @param i_cmd The command id
+     * @param i_cmd_payload The command parameters
+     * @param i_on_response Invoked with the response parameters, or with EZSP_CMD_TIMEOUT if none was received in time,
+     *                      or with EZSP_CMD_INVALID_COMMAND if the parameters are too long to be sent
+     * @param i_timeout The response timeout of this command (in ms), 0 to use the one of its command id
+     * @param i_priority The command priority
+     *
+     * @return false if the command was rejected, the send queue being full (see setQueueCapacity()), @p i_on_response
+     *         is then not invoked. From another thread than the one of the executor (see setExecutor()), the command is
+     *         admitted against the commands queued or posted before it, then queued by a task of the executor: if the
+     *         queue got full meanwhile, @p i_on_response is invoked with EZSP_CMD_REJECTED
+     */
+    bool sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload, FEzspResponseCallback i_on_response, uint16_t i_timeout = 0,
+                     EEzspCmdPriority i_priority = EZSP_PRIORITY_INTERACTIVE);
+
+    /**
+     * @brief Run a sequence of commands as one pipelined batch
+     *
+     * Steps are sent in order, as many at once as the TX window allows (see setTxWindow()), so that a start-up sequence
+     * costs about one link round trip per window instead of one per command. Each response is checked by the validator
+     * of its step, the batch stops at the first failure: the following steps are not sent, except those already in
+     * flight, whose responses are ignored.
+     *
+     * Steps never wait for room in the send queue (QUEUE_BLOCK policy): a step rejected by a full queue fails the batch
+     * with EZSP_CMD_REJECTED.
+     *
+     * @param i_steps The commands to send
+     * @param i_on_done Invoked once, when all steps succeeded or on the first failure
+     * @param i_priority The priority of all steps
+     */
+    void sendBatch(std::vector<SEzspBatchStep> i_steps, FEzspBatchCallback i_on_done, EEzspCmdPriority i_priority = EZSP_PRIORITY_INTERACTIVE);
+
+    /**
+     * @brief Set the response timeout of a command id, instead of the default one
+     *
+     * @param i_cmd The command id
+     * @param i_timeout The maximum delay between sending the command and getting its response (in ms), 0 to restore the
+     *                  default timeout
+     */
+    void setCommandTimeout(EEzspCmd i_cmd, uint16_t i_timeout);
+
+    /**
+     * @brief Set the response timeout of command ids without a timeout of their own
+     *
+     * @param i_timeout The maximum delay between sending a command and getting its response (in ms), DEFAULT_COMMAND_TIMEOUT
+     *                  by default
+     */
+    void setDefaultCommandTimeout(uint16_t i_timeout);
+
+    /**
+     * @brief Get the response timeout of a command id (in ms)
+     */
+    uint16_t getCommandTimeout(EEzspCmd i_cmd) const;
+
+    /**
+     * @brief Set how many times a command is sent again when its response timeout expires, before failing it
+     *
+     * @param i_retries The number of retries, 0 (default) to fail a command on its first timeout
+     *
+     * @note Only applies to commands sent after this call. Retries are counted in the LINK_COMMAND_RETRIES statistic and
+     *       failures in LINK_COMMAND_TIMEOUTS
+     */
+    void setCommandRetries(uint8_t i_retries);
+
+    /**
+     * @brief Limit the number of commands waiting to be sent (all priorities)
+     *
+     * Rejected and dropped commands are counted in the LINK_COMMANDS_REJECTED and LINK_COMMANDS_DROPPED statistics
+     *
+     * @param i_capacity The maximum number of queued commands, 0 (default) for an unbounded queue
+     * @param i_policy What to do with a command sent to a full queue
      */
-    void sendCommand(EEzspCmd i_cmd, std::vector<uint8_t> i_cmd_payload = std::vector<uint8_t>() );
+    void setQueueCapacity(std::size_t i_capacity, EEzspQueuePolicy i_policy = QUEUE_REJECT);
 
+    /**
+     * @brief Give the lock serialising the calls to this library, so that sendCommand() can wait for room in the queue
+     *        (QUEUE_BLOCK policy)
+     *
+     * The application may serialise its own calls to this library with a lock, held when delivering UART data as well.
+     * sendCommand() must then be invoked with this lock held: it is released while waiting (along with our internal
+     * lock, see setExecutor()), so that responses can be delivered and free room in the queue. The wait itself is
+     * synchronised with another internal lock, so that room made by timer threads (which do not hold the application
+     * lock) is noticed as well. sendCommand() never waits when invoked from a callback of this library (observers,
+     * completion callbacks), from sendBatch() or from the executor thread, as the room could only be made by the thread
+     * it would block. From another thread than the executor one, sendCommand() waits for room among the commands queued
+     * and already posted to the executor.
+     *
+     * @param ip_lock The lock held by the application when invoking this library, nullptr to reject commands instead of
+     *                waiting
+     * @param i_timeout The maximum wait (in ms), the command is rejected after it
+     */
+    void setQueueBlockingLock(std::mutex *ip_lock, uint16_t i_timeout);
+
+    /**
+     * @brief Be notified when the send queue gets congested, so that producers can throttle
+     *
+     * @param i_high Number of queued commands from which the queue is congested
+     * @param i_low Number of queued commands below which the queue is not congested anymore (less than @p i_high)
+     * @param i_callback Invoked on each congestion state change, empty to disable notifications
+     */
+    void setQueueWatermarks(std::size_t i_high, std::size_t i_low, FEzspQueueCongestionCallback i_callback);
+
+    /**
+     * @brief Get the number of commands waiting to be sent or waiting for their response
+     */
+    std::size_t getQueueDepth() const { return getSendingQueueDepth() + waitingRspMsgs.size(); }
 
+    static const uint16_t DEFAULT_COMMAND_TIMEOUT = 5000; /*!< Default response timeout (in ms), long enough for ASH to recover a few lost frames */
+    static const uint8_t PRIORITY_WEIGHTS[EZSP_PRIORITY_COUNT]; /*!< Commands sent per priority and per round robin round */
+
+
+
+    /**
+     * @brief Set the maximum number of EZSP commands (and ASH DATA frames) in flight
+     *
+     * @param i_window Number of commands sent to the NCP before getting their response, between 1 (default, stop-and-wait)
+     *                 and CAsh::ASH_MAX_TX_WINDOW
+     */
+    void setTxWindow(uint8_t i_window);
+
+    /**
+     * @brief Delay the acknowledgement of received frames
+     *
+     * A pending acknowledgement is carried by the next command sent, or sent in an ACK frame when the delay expires,
+     * so that a burst of frames (callbacks) is acknowledged at once. Saved ACK frames are counted in the
+     * LINK_ACK_FRAMES_SAVED statistic
+     *
+     * @param i_delay Maximum acknowledgement delay (in ms), 0 (default) acknowledges each frame immediately
+     *
+     * @note The NCP stops sending when its own window is full of unacknowledged frames, so the delay must stay well below
+     *       its acknowledgement timeout
+     */
+    void setAckDelay(uint16_t i_delay);
+
+    /**
+     * @brief Run all dongle activity on an executor
+     *
+     * Bytes received from the UART driver thread are copied and decoded by a task posted to @p ip_executor. Timer
+     * callbacks (unless the timers already expire on the executor thread, as those of CppThreadsEventLoop do) and calls
+     * to sendCommand(), sendBatch(), setTxWindow() and setAckDelay() from other threads are posted as well, so that the
+     * dongle is only used from the executor thread and needs no locking.
+     *
+     * Without executor, UART data, timer callbacks and these calls are serialised by an internal lock instead, which is
+     * held while invoking observers and completion callbacks: these must not wait for a thread invoking this library.
+     * When the application serialises its calls with its own lock (see setQueueBlockingLock()), it takes it before ours.
+     *
+     * @param ip_executor The executor, nullptr (default) to decode bytes on the UART driver thread. Set it before open()
+     *
+     * @note Tasks posted to the executor refer to this dongle: stop the executor before destroying the dongle
+     */
+    void setExecutor(IExecutor *ip_executor) { pExecutor = ip_executor; }
+
+    /**
+     * @brief Get the ASH link, to read its statistics (round trip time, retransmissions...)
+     */
+    const CAsh& getAsh() const { return *ash; }
+
+    /**
+     * @brief Get the link statistics: ASH frame and error counters, command queue high watermark and command to response
+     *        latency histograms
+     *
+     * @note Counters can be read from any thread
+     */
+    const CEzspLinkStats& getLinkStats() const { return ash->getStats(); }
 
     /**
      * @brief Callback invoked on UART received bytes
@@ -57,28 +307,101 @@ public:
      */
     void ashCbInfo( EAshInfo info );
 
+    /**
+     * @brief Callback invoked on each ASH DATA frame received
+     */
+    void ashCbData( const uint8_t *i_data, std::size_t i_len );
+
     /**
      * Managing Observer of this class
+     *
+     * An observer registered without command ids gets all EZSP messages. An observer registered with command ids only
+     * gets the messages with these ids (cumulated over calls), without being invoked for the others. All observers get
+     * the dongle state changes and command timeouts.
+     *
+     * @return true if the observer got at least one new subscription
      */
 	bool registerObserver(CEzspDongleObserver* observer);
+	bool registerObserver(CEzspDongleObserver* observer, EEzspCmd i_cmd);
+	bool registerObserver(CEzspDongleObserver* observer, EEzspCmd i_first, EEzspCmd i_last); /* Range of ids, bounds included */
+	bool registerObserver(CEzspDongleObserver* observer, const std::vector<EEzspCmd>& i_cmds);
 	bool unregisterObserver(CEzspDongleObserver* observer);
 
 private:
     ITimerFactory &timer_factory;
     IUartDriver *pUart;
+    IExecutor *pExecutor; /*!< Executor running all our activity, nullptr if none */
+    std::recursive_mutex dongleMutex; /*!< Serialises our activity when there is no executor (see SDongleLock) */
+    class CDongleTimerFactory;
+    std::unique_ptr<CDongleTimerFactory> pTimerFactory; /*!< Creates our timers and those of ash, wrapping timer_factory ones (see runSerialised()) */
     CAsh *ash;
     GenericAsyncDataInputObservable uartIncomingDataHandler;
-    std::queue<SMsg> sendingMsgQueue;
-    bool wait_rsp;
+    std::deque<SMsg> sendingMsgQueues[EZSP_PRIORITY_COUNT]; /*!< Commands waiting to be sent, by priority */
+    uint8_t laneCredits[EZSP_PRIORITY_COUNT]; /*!< Commands each priority can still send in the current round */
+    std::size_t queueCapacity; /*!< Maximum number of queued commands, 0 if unbounded */
+    EEzspQueuePolicy queuePolicy; /*!< What to do with a command sent to a full queue */
+    std::mutex *pQueueBlockingLock; /*!< Lock held by the application when invoking us, released while waiting for room */
+    uint16_t queueBlockingTimeout; /*!< Maximum wait for room in the queue (in ms) */
+    std::mutex queueMutex; /*!< Protects queueRoomDepth and queuePostedCount, the only queue state read by sendCommand() while it waits for room, or out of the executor thread */
+    std::condition_variable queueRoomCv; /*!< Signalled with queueMutex when queueRoomDepth changes */
+    std::size_t queueRoomDepth; /*!< Copy of the send queue depth, updated after each change of the queue */
+    std::size_t queuePostedCount; /*!< Commands admitted from other threads than the executor one, posted to it but not queued yet */
+    std::size_t queueHighWatermark; /*!< Queued commands from which the queue is congested */
+    std::size_t queueLowWatermark; /*!< Queued commands below which the queue is not congested anymore */
+    FEzspQueueCongestionCallback queueCongestionCb; /*!< Notified of congestion state changes */
+    bool queueCongested; /*!< The queue reached its high watermark and did not get back to the low one yet */
+    std::deque<SMsg> waitingRspMsgs; /*!< Commands sent, waiting for their response */
+    uint16_t ackDelay; /*!< Maximum acknowledgement delay (in ms), 0 to acknowledge immediately */
+    std::unique_ptr<ITimer> ackTimer; /*!< Sends the pending acknowledgement when the delay expires */
+    std::map<EEzspCmd, uint16_t> cmdTimeouts; /*!< Response timeouts (in ms) of command ids not using defaultCmdTimeout */
+    uint16_t defaultCmdTimeout; /*!< Response timeout (in ms) of other command ids */
+    uint8_t cmdRetries; /*!< Retries of a command on response timeout */
+    std::unique_ptr<ITimer> cmdTimer; /*!< Watchdog expiring at the earliest response deadline of waitingRspMsgs */
+    std::chrono::steady_clock::time_point cmdTimerDeadline; /*!< When cmdTimer expires, if running */
+
+    static const uint8_t TX_STAGING_FRAMES = CAsh::ASH_MAX_TX_WINDOW + 1; /*!< Frames staged at most, a full window and an ACK */
+    uint8_t txFrames[TX_STAGING_FRAMES][CAsh::ASH_MAX_ENCODED_LENGTH]; /*!< Encoded frames waiting to be written to the UART */
+    std::size_t txFrameLens[TX_STAGING_FRAMES]; /*!< Sizes of the staged frames */
+    uint8_t txFrameCount; /*!< Number of staged frames */
+    unsigned int txBatchDepth; /*!< Nesting of STxBatch scopes, frames are only staged when not 0 */
+
+    struct STxBatch;
+    uint8_t* beginTxFrame( void );
+    void commitTxFrame( std::size_t i_len );
+    void flushTx( void );
+
+    struct SBatch;
+    void runBatch( const std::shared_ptr<SBatch>& i_batch );
+    void completeBatchStep( const std::shared_ptr<SBatch>& i_batch, std::size_t i_step, EEzspCmdStatus i_status, const CEzspFrameBuffer& i_response );
+
+    struct SDongleLock;
+    class CDongleTimer;
+    bool mustPost( void ) const { return (nullptr != pExecutor) && !pExecutor->isInExecutorThread(); }
+    void runSerialised( std::function<void (void)> i_task );
 
+    std::size_t getSendingQueueDepth( void ) const;
+    bool admitCommand( EEzspCmdPriority i_priority, SDongleLock* ip_waiting_lock );
+    bool reserveQueueRoom( void );
+    void releaseQueueRoom( void );
+    bool queueCommand( SMsg& io_msg, SDongleLock* ip_waiting_lock );
+    void rejectCommand( EEzspCmd i_cmd );
+    void updateSendingQueueDepth( void );
+    std::deque<SMsg>* selectSendingQueue( void );
     void sendNextMsg( void );
+    void failCommand( SMsg& i_msg, EEzspCmdStatus i_status );
+    void sendAck( void );
+    void startCommandTimer( void );
+    void handleCommandTimeout( void );
 
     /**
      * Notify Observer of this class
      */
     std::set<CEzspDongleObserver*> observers;
+    std::vector<CEzspDongleObserver*> rxDispatch[256]; /*!< Observers of the EZSP messages, indexed by command id, in registration order */
+    bool subscribeObserver( CEzspDongleObserver* observer, uint8_t i_cmd );
     void notifyObserversOfDongleState( EDongleState i_state );
-    void notifyObserversOfEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_message );
+    void notifyObserversOfEzspRxMessage( EEzspCmd i_cmd, const CEzspFrameBuffer& i_message );
+    void notifyObserversOfEzspCommandTimeout( EEzspCmd i_cmd );
 };
 
 #ifdef USE_RARITAN
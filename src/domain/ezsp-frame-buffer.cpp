@@ -0,0 +1,246 @@
+/**
+ * @file ezsp-frame-buffer.cpp
+ *
+ * @brief Shared immutable buffer holding a received EZSP payload
+ */
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <cstring>
+#include <stdexcept>
+
+#include "ezsp-frame-buffer.h"
+
+const std::size_t CEzspFrameBuffer::POOL_BLOCK_SIZE;
+const std::size_t CEzspFrameBuffer::POOL_MAX_FREE_BLOCKS;
+
+/**
+ * @brief Storage shared by all copies of a buffer
+ */
+struct CEzspFrameBuffer::SBlock {
+    SBlock() : refs(0), heapData(nullptr), storage() { }
+
+    SBlock(const SBlock&) = delete; /* No copy construction allowed */
+
+    SBlock& operator=(const SBlock&) = delete; /* No assignment allowed */
+
+    std::atomic<unsigned int> refs; /*!< Number of buffers using this block */
+    uint8_t *heapData; /*!< Payload larger than storage, nullptr otherwise */
+    uint8_t storage[POOL_BLOCK_SIZE]; /*!< Payload up to POOL_BLOCK_SIZE bytes */
+};
+
+namespace {
+/**
+ * @brief Released blocks, kept for reuse
+ */
+class CFrameBlockPool
+{
+public:
+    CFrameBlockPool() : mutex(), freeBlocks() { freeBlocks.reserve(CEzspFrameBuffer::POOL_MAX_FREE_BLOCKS); }
+
+    CFrameBlockPool(const CFrameBlockPool&) = delete; /* No copy construction allowed */
+
+    CFrameBlockPool& operator=(const CFrameBlockPool&) = delete; /* No assignment allowed */
+
+    /**
+     * @brief Get the pool, intentionally leaked so that buffers can still be released during static destruction
+     */
+    static CFrameBlockPool& instance()
+    {
+        static CFrameBlockPool *pool = new CFrameBlockPool();
+        return *pool;
+    }
+
+    void* take(std::size_t i_size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if( !freeBlocks.empty() )
+            {
+                void *lo_block = freeBlocks.back();
+                freeBlocks.pop_back();
+                return lo_block;
+            }
+        }
+        return ::operator new(i_size);
+    }
+
+    void give(void *i_block)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if( freeBlocks.size() < CEzspFrameBuffer::POOL_MAX_FREE_BLOCKS )
+            {
+                freeBlocks.push_back(i_block);
+                return;
+            }
+        }
+        ::operator delete(i_block);
+    }
+
+    std::size_t freeCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return freeBlocks.size();
+    }
+
+private:
+    std::mutex mutex; /*!< Protects freeBlocks, as buffers can be released from any thread */
+    std::vector<void*> freeBlocks; /*!< Raw memory of released blocks */
+};
+
+/**
+ * @brief A few released blocks kept by each thread, so that a thread building and releasing buffers (the serial reader
+ *        thread, for all received frames) does not lock the shared pool
+ */
+class CFrameBlockCache
+{
+public:
+    static const std::size_t MAX_BLOCKS = 8;
+
+    CFrameBlockCache() : blocks(), count(0) { }
+
+    CFrameBlockCache(const CFrameBlockCache&) = delete; /* No copy construction allowed */
+
+    CFrameBlockCache& operator=(const CFrameBlockCache&) = delete; /* No assignment allowed */
+
+    ~CFrameBlockCache()
+    {
+        while( count > 0 )
+        {
+            CFrameBlockPool::instance().give(blocks[--count]);
+        }
+    }
+
+    void* take(std::size_t i_size)
+    {
+        if( count > 0 )
+        {
+            return blocks[--count];
+        }
+        return CFrameBlockPool::instance().take(i_size);
+    }
+
+    void give(void *i_block)
+    {
+        if( count < MAX_BLOCKS )
+        {
+            blocks[count++] = i_block;
+            return;
+        }
+        CFrameBlockPool::instance().give(i_block);
+    }
+
+    std::size_t freeCount() const { return count; }
+
+private:
+    void *blocks[MAX_BLOCKS]; /*!< Raw memory of released blocks */
+    std::size_t count; /*!< Number of entries in blocks */
+};
+
+thread_local CFrameBlockCache t_block_cache;
+}
+
+CEzspFrameBuffer::CEzspFrameBuffer() :
+    pBlock(nullptr),
+    pData(nullptr),
+    len(0)
+{
+}
+
+CEzspFrameBuffer::CEzspFrameBuffer(const uint8_t *i_data, std::size_t i_len) :
+    pBlock(nullptr),
+    pData(nullptr),
+    len(i_len)
+{
+    if( 0 == i_len )
+    {
+        return;
+    }
+
+    pBlock = new (t_block_cache.take(sizeof(SBlock))) SBlock();
+    pBlock->refs.store(1, std::memory_order_relaxed);
+    if( i_len > POOL_BLOCK_SIZE )
+    {
+        pBlock->heapData = new uint8_t[i_len];
+    }
+    uint8_t *l_data = (nullptr != pBlock->heapData) ? pBlock->heapData : pBlock->storage;
+    std::memcpy(l_data, i_data, i_len);
+    pData = l_data;
+}
+
+CEzspFrameBuffer::CEzspFrameBuffer(const std::vector<uint8_t>& i_data) :
+    CEzspFrameBuffer(i_data.data(), i_data.size())
+{
+}
+
+CEzspFrameBuffer::CEzspFrameBuffer(const CEzspFrameBuffer& other) :
+    pBlock(other.pBlock),
+    pData(other.pData),
+    len(other.len)
+{
+    if( nullptr != pBlock )
+    {
+        pBlock->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+CEzspFrameBuffer::CEzspFrameBuffer(CEzspFrameBuffer&& other) :
+    pBlock(other.pBlock),
+    pData(other.pData),
+    len(other.len)
+{
+    other.pBlock = nullptr;
+    other.pData = nullptr;
+    other.len = 0;
+}
+
+CEzspFrameBuffer& CEzspFrameBuffer::operator=(CEzspFrameBuffer other)
+{
+    std::swap(pBlock, other.pBlock);
+    std::swap(pData, other.pData);
+    std::swap(len, other.len);
+    return *this;
+}
+
+CEzspFrameBuffer::~CEzspFrameBuffer()
+{
+    release();
+}
+
+uint8_t CEzspFrameBuffer::at(std::size_t i_index) const
+{
+    if( i_index >= len )
+    {
+        throw std::out_of_range("CEzspFrameBuffer::at");
+    }
+    return pData[i_index];
+}
+
+unsigned int CEzspFrameBuffer::useCount(void) const
+{
+    return (nullptr == pBlock) ? 0 : pBlock->refs.load(std::memory_order_relaxed);
+}
+
+std::size_t CEzspFrameBuffer::getPoolFreeBlocks(void)
+{
+    return t_block_cache.freeCount() + CFrameBlockPool::instance().freeCount();
+}
+
+void CEzspFrameBuffer::release(void)
+{
+    // acquire-release, so that all uses of the block through other buffers happen before it is recycled. The last owner
+    // (the usual case) has nobody to race with, so it skips the read-modify-write
+    if( (nullptr != pBlock) &&
+        ((1 == pBlock->refs.load(std::memory_order_acquire)) || (1 == pBlock->refs.fetch_sub(1, std::memory_order_acq_rel))) )
+    {
+        delete[] pBlock->heapData;
+        pBlock->~SBlock();
+        t_block_cache.give(pBlock);
+    }
+    pBlock = nullptr;
+    pData = nullptr;
+    len = 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file ezsp-frame-buffer.h
+ *
+ * @brief Shared immutable buffer holding a received EZSP payload
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Reference-counted, read-only view of a received EZSP payload
+ *
+ * Copies share the same bytes, so a payload can be given to any number of observers without being copied. Payloads up
+ * to POOL_BLOCK_SIZE bytes (all EZSP frames) are stored in blocks recycled through a small per-thread cache backed by a
+ * shared pool, so that a frame burst does not allocate once the pool is warm. Larger payloads are allocated on the heap.
+ *
+ * The reference count is atomic: a buffer (and its copies) can be kept and released from any thread.
+ */
+class CEzspFrameBuffer
+{
+public:
+    static const std::size_t POOL_BLOCK_SIZE = 128; /*!< Maximum size of a payload stored in a pool block */
+    static const std::size_t POOL_MAX_FREE_BLOCKS = 64; /*!< Maximum number of released blocks kept in the pool for reuse */
+
+    /**
+     * @brief Build an empty buffer
+     */
+    CEzspFrameBuffer();
+
+    /**
+     * @brief Build a buffer holding a copy of @p i_len bytes from @p i_data
+     */
+    CEzspFrameBuffer(const uint8_t *i_data, std::size_t i_len);
+
+    /**
+     * @brief Build a buffer holding a copy of @p i_data
+     */
+    explicit CEzspFrameBuffer(const std::vector<uint8_t>& i_data);
+
+    CEzspFrameBuffer(const CEzspFrameBuffer& other);
+
+    CEzspFrameBuffer(CEzspFrameBuffer&& other);
+
+    CEzspFrameBuffer& operator=(CEzspFrameBuffer other);
+
+    ~CEzspFrameBuffer();
+
+    const uint8_t* data(void) const { return pData; }
+    std::size_t size(void) const { return len; }
+    bool empty(void) const { return 0 == len; }
+    const uint8_t* begin(void) const { return pData; }
+    const uint8_t* end(void) const { return pData + len; }
+    uint8_t operator[](std::size_t i_index) const { return pData[i_index]; }
+
+    /**
+     * @brief Get a byte, with bounds checking
+     *
+     * @throw std::out_of_range if @p i_index is not below size(), as std::vector::at()
+     */
+    uint8_t at(std::size_t i_index) const;
+
+    /**
+     * @brief Copy the payload in a vector, for code that needs to own or modify it
+     */
+    std::vector<uint8_t> toVector(void) const { return std::vector<uint8_t>(begin(), end()); }
+
+    /**
+     * @brief Get the number of buffers sharing these bytes (0 for an empty buffer)
+     */
+    unsigned int useCount(void) const;
+
+    /**
+     * @brief Get the number of released blocks currently kept for reuse by the calling thread (its cache and the shared pool)
+     */
+    static std::size_t getPoolFreeBlocks(void);
+
+private:
+    struct SBlock;
+
+    SBlock *pBlock; /*!< Shared storage, nullptr if empty */
+    const uint8_t *pData; /*!< First byte of the payload */
+    std::size_t len; /*!< Number of bytes in the payload */
+
+    void release(void);
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
@@ -0,0 +1,150 @@
+/**
+ * @file ezsp-link-stats.cpp
+ *
+ * @brief Statistics of the ASH/EZSP link to a dongle
+ */
+
+#include <map>
+#include <sstream>
+
+#include "ezsp-link-stats.h"
+
+const unsigned int CEzspLinkStats::LATENCY_BUCKETS;
+
+CEzspLinkStats::CEzspLinkStats() :
+    counters(),
+    queueDepth(0),
+    queueHighWatermark(0),
+    latencies()
+{
+    reset();
+}
+
+void CEzspLinkStats::updateQueueDepth(std::size_t i_depth)
+{
+    uint32_t l_depth = static_cast<uint32_t>(i_depth);
+    queueDepth.store(l_depth, std::memory_order_relaxed);
+
+    uint32_t l_max = queueHighWatermark.load(std::memory_order_relaxed);
+
+    while( (l_depth > l_max) && !queueHighWatermark.compare_exchange_weak(l_max, l_depth, std::memory_order_relaxed) )
+    {
+        // l_max was reloaded, retry while still below
+    }
+}
+
+unsigned int CEzspLinkStats::getLatencyBucket(std::chrono::microseconds i_latency)
+{
+    uint64_t l_us = (i_latency.count() > 0) ? static_cast<uint64_t>(i_latency.count()) : 0;
+    unsigned int lo_bucket = 0;
+
+    // index of the highest bit set
+    while( (l_us >> 1) != 0 )
+    {
+        l_us >>= 1;
+        lo_bucket++;
+    }
+
+    return (lo_bucket < LATENCY_BUCKETS) ? lo_bucket : LATENCY_BUCKETS - 1;
+}
+
+void CEzspLinkStats::recordLatency(EEzspCmd i_cmd, std::chrono::microseconds i_latency)
+{
+    latencies[static_cast<uint8_t>(i_cmd)][getLatencyBucket(i_latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t CEzspLinkStats::getLatencyCount(EEzspCmd i_cmd, unsigned int i_bucket) const
+{
+    if( i_bucket >= LATENCY_BUCKETS )
+    {
+        return 0;
+    }
+    return latencies[static_cast<uint8_t>(i_cmd)][i_bucket].load(std::memory_order_relaxed);
+}
+
+uint32_t CEzspLinkStats::getLatencyCount(EEzspCmd i_cmd) const
+{
+    uint32_t lo_count = 0;
+
+    for( unsigned int bucket = 0; bucket < LATENCY_BUCKETS; bucket++ )
+    {
+        lo_count += getLatencyCount(i_cmd, bucket);
+    }
+
+    return lo_count;
+}
+
+void CEzspLinkStats::reset(void)
+{
+    for( auto& counter : counters )
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    queueHighWatermark.store(0, std::memory_order_relaxed);
+    for( auto& histogram : latencies )
+    {
+        for( auto& bucket : histogram )
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string CEzspLinkStats::ELinkCounterToString( ELinkCounter in )
+{
+    const std::map<ELinkCounter,std::string> MyEnumStrings {
+        { LINK_DATA_FRAMES_SENT, "LINK_DATA_FRAMES_SENT" },
+        { LINK_DATA_FRAMES_RECEIVED, "LINK_DATA_FRAMES_RECEIVED" },
+        { LINK_ACK_FRAMES_SENT, "LINK_ACK_FRAMES_SENT" },
+        { LINK_ACK_FRAMES_SAVED, "LINK_ACK_FRAMES_SAVED" },
+        { LINK_ACK_FRAMES_RECEIVED, "LINK_ACK_FRAMES_RECEIVED" },
+        { LINK_NAK_FRAMES_RECEIVED, "LINK_NAK_FRAMES_RECEIVED" },
+        { LINK_RETRANSMITTED_FRAMES, "LINK_RETRANSMITTED_FRAMES" },
+        { LINK_ACK_TIMEOUTS, "LINK_ACK_TIMEOUTS" },
+        { LINK_CRC_ERRORS, "LINK_CRC_ERRORS" },
+        { LINK_CANCEL_BYTES, "LINK_CANCEL_BYTES" },
+        { LINK_SUBSTITUTE_BYTES, "LINK_SUBSTITUTE_BYTES" },
+        { LINK_OVERSIZED_FRAMES, "LINK_OVERSIZED_FRAMES" },
+        { LINK_COMMAND_RETRIES, "LINK_COMMAND_RETRIES" },
+        { LINK_COMMAND_TIMEOUTS, "LINK_COMMAND_TIMEOUTS" },
+        { LINK_COMMANDS_REJECTED, "LINK_COMMANDS_REJECTED" },
+        { LINK_COMMANDS_DROPPED, "LINK_COMMANDS_DROPPED" },
+        { LINK_UNMATCHED_RESPONSES, "LINK_UNMATCHED_RESPONSES" },
+    };
+    auto   it  = MyEnumStrings.find(in);
+    return it == MyEnumStrings.end() ? "OUT_OF_RANGE" : it->second;
+}
+
+std::string CEzspLinkStats::toString(void) const
+{
+    std::stringstream lo_buf;
+
+    for( unsigned int loop = 0; loop < LINK_COUNTER_COUNT; loop++ )
+    {
+        ELinkCounter l_counter = static_cast<ELinkCounter>(loop);
+        if( 0 != get(l_counter) )
+        {
+            lo_buf << ELinkCounterToString(l_counter) << ": " << get(l_counter) << std::endl;
+        }
+    }
+    lo_buf << "Queue depth: " << getQueueDepth() << " (high watermark " << getQueueHighWatermark() << ")" << std::endl;
+
+    for( unsigned int cmd = 0; cmd < 256; cmd++ )
+    {
+        EEzspCmd l_cmd = static_cast<EEzspCmd>(cmd);
+        if( 0 != getLatencyCount(l_cmd) )
+        {
+            lo_buf << CEzspEnum::EEzspCmdToString(l_cmd) << " latency (us):";
+            for( unsigned int bucket = 0; bucket < LATENCY_BUCKETS; bucket++ )
+            {
+                if( 0 != getLatencyCount(l_cmd, bucket) )
+                {
+                    lo_buf << " [" << ((bucket == 0) ? 0 : (1UL << bucket)) << "+]=" << getLatencyCount(l_cmd, bucket);
+                }
+            }
+            lo_buf << std::endl;
+        }
+    }
+
+    return lo_buf.str();
+}
@@ -0,0 +1,129 @@
+/**
+ * @file ezsp-link-stats.h
+ *
+ * @brief Statistics of the ASH/EZSP link to a dongle
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+#include "ezsp-protocol/ezsp-enum.h"
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+typedef enum {
+  LINK_DATA_FRAMES_SENT,      /* DATA frames sent for the first time */
+  LINK_DATA_FRAMES_RECEIVED,  /* Valid DATA frames received */
+  LINK_ACK_FRAMES_SENT,       /* ACK frames sent */
+  LINK_ACK_FRAMES_SAVED,      /* Acknowledgements piggybacked or coalesced, that did not need their own ACK frame */
+  LINK_ACK_FRAMES_RECEIVED,   /* ACK frames received */
+  LINK_NAK_FRAMES_RECEIVED,   /* NAK frames received */
+  LINK_RETRANSMITTED_FRAMES,  /* DATA frames sent again (after a NAK or an acknowledgement timeout) */
+  LINK_ACK_TIMEOUTS,          /* Acknowledgement timeouts */
+  LINK_CRC_ERRORS,            /* Frames received with a wrong CRC */
+  LINK_CANCEL_BYTES,          /* Cancel bytes received (frames in progress dropped) */
+  LINK_SUBSTITUTE_BYTES,      /* Substitute bytes received (UART errors reported by the NCP) */
+  LINK_OVERSIZED_FRAMES,      /* Frames received longer than CAsh::ASH_MAX_LENGTH */
+  LINK_COMMAND_RETRIES,       /* EZSP commands sent again after their response timeout */
+  LINK_COMMAND_TIMEOUTS,      /* EZSP commands given up, without response after all retries */
+  LINK_COMMANDS_REJECTED,     /* EZSP commands rejected, the send queue being full */
+  LINK_COMMANDS_DROPPED,      /* EZSP commands dropped from a full send queue, to make room for newer ones */
+  LINK_UNMATCHED_RESPONSES,   /* EZSP responses dropped, matching no pending command (received after its timeout) */
+  LINK_COUNTER_COUNT          /* Number of counters, not a counter */
+}ELinkCounter;
+
+/**
+ * @brief Counters and latency histograms of an ASH/EZSP link
+ *
+ * All updates are relaxed atomic operations (a few ns each, no lock), so statistics can stay enabled in production and
+ * be read from any thread while the link is running. Readings are not a consistent snapshot across counters.
+ *
+ * Command to response latencies are recorded per EZSP command, in buckets of powers of 2 microseconds: bucket 0 counts
+ * latencies below 2us, bucket n (n > 0) latencies in [2^n, 2^(n+1)) us, the last bucket all latencies above.
+ */
+class CEzspLinkStats
+{
+public:
+    static const unsigned int LATENCY_BUCKETS = 24; /*!< Number of histogram buckets, the last one starts at 2^23 us (8.4s) */
+
+    CEzspLinkStats();
+
+    CEzspLinkStats(const CEzspLinkStats&) = delete; /* No copy construction allowed (atomic data members) */
+
+    CEzspLinkStats& operator=(const CEzspLinkStats&) = delete; /* No assignment allowed (atomic data members) */
+
+    /**
+     * @brief Add 1 to a counter
+     */
+    void increment(ELinkCounter i_counter) { counters[i_counter].fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Get the value of a counter
+     */
+    uint32_t get(ELinkCounter i_counter) const { return counters[i_counter].load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Record the current depth of the queue of commands waiting to be sent, to keep its high watermark
+     */
+    void updateQueueDepth(std::size_t i_depth);
+
+    /**
+     * @brief Get the current depth of the queue of commands waiting to be sent
+     */
+    uint32_t getQueueDepth(void) const { return queueDepth.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get the maximum depth of the queue of commands waiting to be sent
+     */
+    uint32_t getQueueHighWatermark(void) const { return queueHighWatermark.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Record the latency between a command and its response
+     */
+    void recordLatency(EEzspCmd i_cmd, std::chrono::microseconds i_latency);
+
+    /**
+     * @brief Get the number of latencies recorded for a command in a histogram bucket
+     */
+    uint32_t getLatencyCount(EEzspCmd i_cmd, unsigned int i_bucket) const;
+
+    /**
+     * @brief Get the number of latencies recorded for a command
+     */
+    uint32_t getLatencyCount(EEzspCmd i_cmd) const;
+
+    /**
+     * @brief Get the histogram bucket a latency falls in
+     */
+    static unsigned int getLatencyBucket(std::chrono::microseconds i_latency);
+
+    /**
+     * @brief Reset all statistics, except the current queue depth
+     */
+    void reset(void);
+
+    static std::string ELinkCounterToString( ELinkCounter in );
+
+    /**
+     * @brief Human readable dump of all non-null counters and histograms
+     */
+    std::string toString(void) const;
+
+private:
+    std::atomic<uint32_t> counters[LINK_COUNTER_COUNT]; /*!< Event counters, indexed by ELinkCounter */
+    std::atomic<uint32_t> queueDepth; /*!< Current depth of the queue of commands waiting to be sent */
+    std::atomic<uint32_t> queueHighWatermark; /*!< Maximum depth of the queue of commands waiting to be sent */
+    std::atomic<uint32_t> latencies[256][LATENCY_BUCKETS]; /*!< Latency histograms, indexed by EZSP command id */
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
@@ -15,9 +15,9 @@ public:
     /**
      * @brief Method that will be invoked on incoming valid green power frames
      *
-     * @param i_gpf The green power frame received
+     * @param i_gpf The green power frame received, the same one is given to every observer
      */
-    virtual void handleRxGpFrame( CGpFrame &i_gpf ) = 0;
+    virtual void handleRxGpFrame( const CGpFrame &i_gpf ) = 0;
 
     /**
      * @brief Method that will be invoked on every green power frame receive on our radio channel
@@ -0,0 +1,12 @@
+/**
+ * @file index-list.h
+ *
+ * @brief Compile-time index lists, used to expand constexpr lookup table initializers
+ */
+
+#pragma once
+
+/* Minimal C++11 replacement for std::index_sequence: MakeIndexList<N>::type is IndexList<0, 1, ..., N-1> */
+template<unsigned int... Is> struct IndexList { };
+template<unsigned int N, unsigned int... Is> struct MakeIndexList : MakeIndexList<N - 1, N - 1, Is...> { };
+template<unsigned int... Is> struct MakeIndexList<0, Is...> { typedef IndexList<Is...> type; };
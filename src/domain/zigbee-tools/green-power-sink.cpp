@@ -88,7 +88,12 @@ CGpSink::CGpSink( CEzspDongle &i_dongle, CZigbeeMessaging &i_zb_messaging ) :
     gpd_send_list(),
     observers()
 {
-    dongle.registerObserver(this);
+    // GP commands and callbacks, sink table commands, and the few other commands we use
+    dongle.registerObserver(this, EZSP_GPEP_INCOMING_MESSAGE_HANDLER, EZSP_GP_PROXY_TABLE_PROCESS_GP_PAIRING);
+    dongle.registerObserver(this, EZSP_GP_SINK_TABLE_GET_ENTRY, EZSP_GP_SINK_TABLE_CLEAR_ALL);
+    dongle.registerObserver(this, std::vector<EEzspCmd>({ EZSP_GP_PROXY_TABLE_LOOKUP, EZSP_GP_SINK_TABLE_INIT,
+                                                          EZSP_GET_NETWORK_PARAMETERS, EZSP_SEND_RAW_MESSAGE,
+                                                          EZSP_RAW_TRANSMIT_COMPLETE_HANDLER }));
 }
 
 void CGpSink::init()
@@ -115,7 +120,7 @@ bool CGpSink::gpClearAllTables()
 
         // proxy table
         proxy_table_index = 0;
-        dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY,{proxy_table_index});
+        dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY,{proxy_table_index},EZSP_PRIORITY_BULK);
 
         // set state
         setSinkState(SINK_CLEAR_ALL);    
@@ -170,7 +175,7 @@ void CGpSink::handleDongleState( EDongleState i_state )
 {
 }
 
-void CGpSink::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive )
+void CGpSink::handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive )
 {
     switch( i_cmd )
     {
@@ -198,7 +203,7 @@ void CGpSink::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_re
         break;
         case EZSP_GET_NETWORK_PARAMETERS:
         {
-            CGetNetworkParamtersResponse l_rsp(i_msg_receive);
+            CGetNetworkParamtersResponse l_rsp(i_msg_receive.toVector());
             if( EEmberStatus::EMBER_SUCCESS == l_rsp.getStatus() ) 
             {
                 nwk_parameters = l_rsp.getParameters();
@@ -215,7 +220,7 @@ void CGpSink::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_re
             EEmberStatus l_status = static_cast<EEmberStatus>(i_msg_receive.at(0));
 
             // build gpf frame from ezsp rx message
-            CGpFrame gpf = CGpFrame(i_msg_receive);
+            CGpFrame gpf = CGpFrame(i_msg_receive.toVector());
             notifyObserversOfRxGpdId(gpf.getSourceId());
 
             clogD << "EZSP_GPEP_INCOMING_MESSAGE_HANDLER status : " << CEzspEnum::EEmberStatusToString(l_status) <<
@@ -528,7 +533,7 @@ void CGpSink::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_re
             {
                 // retrieve next entry
                 proxy_table_index++;
-                dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY,{proxy_table_index});
+                dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY,{proxy_table_index},EZSP_PRIORITY_BULK);
             }
         }
         break;
@@ -597,7 +602,7 @@ bool CGpSink::unregisterObserver(CGpObserver* observer)
     return static_cast<bool>(this->observers.erase(observer));
 }
 
-void CGpSink::notifyObserversOfRxGpFrame( CGpFrame i_gpf ) {
+void CGpSink::notifyObserversOfRxGpFrame( const CGpFrame &i_gpf ) {
     for(auto observer : this->observers) {
         observer->handleRxGpFrame( i_gpf );
     }
@@ -846,7 +851,7 @@ void CGpSink::gpSend(bool i_action, bool i_use_cca, CEmberGpAddressStruct i_gp_a
     l_payload.push_back(static_cast<uint8_t>((i_life_time_ms>>8)&0xFF));
  
     clogI << "EZSP_D_GP_SEND\n";
-    dongle.sendCommand(EZSP_D_GP_SEND,l_payload);    
+    dongle.sendCommand(EZSP_D_GP_SEND,l_payload,EZSP_PRIORITY_REALTIME);
 }
 
 void CGpSink::gpSinkTableRemoveEntry( uint8_t i_index )
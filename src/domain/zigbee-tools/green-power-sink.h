@@ -92,7 +92,7 @@ public:
      * Observer
      */
     void handleDongleState( EDongleState i_state );
-    void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive );
+    void handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive );
 
     /**
      * Managing Observer of this class
@@ -124,7 +124,7 @@ private:
      *
      * @param i_gpf The received GP frame
      */
-    void notifyObserversOfRxGpFrame( CGpFrame i_gpf );
+    void notifyObserversOfRxGpFrame( const CGpFrame &i_gpf );
 
     /**
      * @brief Notify observers of this class
@@ -11,10 +11,10 @@
 
 CZigbeeMessaging::CZigbeeMessaging( CEzspDongle &i_dongle, ITimerFactory &i_timer_factory ): dongle(i_dongle), timer_factory(i_timer_factory)
 {
-    dongle.registerObserver(this);
+    dongle.registerObserver(this, EZSP_MESSAGE_SENT_HANDLER);
 }
 
-void CZigbeeMessaging::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive )
+void CZigbeeMessaging::handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive )
 {
     switch( i_cmd )
     {
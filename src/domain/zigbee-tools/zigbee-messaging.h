@@ -37,7 +37,7 @@ public:
      * Observer
      */
     void handleDongleState( EDongleState i_state ){(void) i_state;}
-    void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive );
+    void handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive );
 
 private:
     CEzspDongle &dongle;
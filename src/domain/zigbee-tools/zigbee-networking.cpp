@@ -22,12 +22,14 @@ CZigbeeNetworking::CZigbeeNetworking( CEzspDongle &i_dongle, CZigbeeMessaging &i
     discoverCallbackFct(nullptr),
     form_channel(DEFAULT_RADIO_CHANNEL)
 {
-    dongle.registerObserver(this);
+    dongle.registerObserver(this, std::vector<EEzspCmd>({ EZSP_PERMIT_JOINING, EZSP_SEND_BROADCAST, EZSP_GET_CHILD_DATA,
+                                                          EZSP_SET_INITIAL_SECURITY_STATE, EZSP_NETWORK_INIT,
+                                                          EZSP_FORM_NETWORK, EZSP_LEAVE_NETWORK }));
 }
 
-void CZigbeeNetworking::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive )
+void CZigbeeNetworking::handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive )
 {
-    // clogD << "CZigbeeNetworking::handleEzspRxMessage : " << CEzspEnum::EEzspCmdToString(i_cmd) << std::endl;
+    // clogD << "CZigbeeNetworking::handleEzspRxFrame : " << CEzspEnum::EEzspCmdToString(i_cmd) << std::endl;
 
     switch( i_cmd )
     {
@@ -47,8 +49,7 @@ void CZigbeeNetworking::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t
             clogD << "EZSP_GET_CHILD_DATA return  at index : " << unsigned(child_idx) << ", status : " << CEzspEnum::EEmberStatusToString(static_cast<EEmberStatus>(i_msg_receive.at(0))) << std::endl;
             if( EMBER_SUCCESS == i_msg_receive.at(0) )
             {
-                i_msg_receive.erase(i_msg_receive.begin());
-                CEmberChildDataStruct l_rsp(i_msg_receive);
+                CEmberChildDataStruct l_rsp(std::vector<uint8_t>(i_msg_receive.begin()+1, i_msg_receive.end()));
                 clogD << l_rsp.String() << std::endl;
 
                 // appeler la fonction de nouveau produit
@@ -61,7 +62,7 @@ void CZigbeeNetworking::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t
                 std::vector<uint8_t> l_param;
                 child_idx++;
                 l_param.push_back(child_idx);
-                dongle.sendCommand(EZSP_GET_CHILD_DATA, l_param);
+                dongle.sendCommand(EZSP_GET_CHILD_DATA, l_param, EZSP_PRIORITY_BULK);
             }
         }
         break;
@@ -81,20 +82,6 @@ void CZigbeeNetworking::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t
             }
         }
         break;
-        case EZSP_SET_CONFIGURATION_VALUE:
-        {
-            if( 0 != i_msg_receive.at(0) ) {
-                clogD << "EZSP_SET_CONFIGURATION_VALUE RSP : " << unsigned(i_msg_receive.at(0)) << std::endl;
-            }
-        }
-        break;
-        case EZSP_ADD_ENDPOINT:
-        {
-            // configuration finished, initialize zigbee pro stack
-            clogD << "Call EZSP_NETWORK_INIT" << std::endl;
-            dongle.sendCommand(EZSP_NETWORK_INIT);
-        }
-        break;
         case EZSP_NETWORK_INIT:
         {
             // initialize zigbee pro stack finished, get the current network state
@@ -121,9 +108,10 @@ void CZigbeeNetworking::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t
 
 void CZigbeeNetworking::stackInit(const std::vector<SEzspConfig>& l_config, const std::vector<SEzspPolicy>& l_policy)
 {
+  std::vector<SEzspBatchStep> l_steps;
   std::vector<uint8_t> l_payload;
 
-  // set config
+  // set config, values refused by the NCP are only reported
   for(auto it : l_config)
   {
     l_payload.clear();
@@ -131,7 +119,16 @@ void CZigbeeNetworking::stackInit(const std::vector<SEzspConfig>& l_config, cons
     l_payload.push_back(u16_get_lo_u8(it.value));
     l_payload.push_back(u16_get_hi_u8(it.value));
     //clogD << "EZSP_SET_CONFIGURATION_VALUE : " << unsigned(l_config[loop].id) << std::endl;
-    dongle.sendCommand(EZSP_SET_CONFIGURATION_VALUE, l_payload);
+    uint8_t l_id = it.id;
+    l_steps.push_back({EZSP_SET_CONFIGURATION_VALUE, l_payload, [l_id](const CEzspFrameBuffer& i_rsp) {
+      if( i_rsp.empty() ) {
+        clogD << "EZSP_SET_CONFIGURATION_VALUE " << unsigned(l_id) << " empty RSP" << std::endl;
+      }
+      else if( 0 != i_rsp.at(0) ) {
+        clogD << "EZSP_SET_CONFIGURATION_VALUE " << unsigned(l_id) << " RSP : " << unsigned(i_rsp.at(0)) << std::endl;
+      }
+      return true;
+    }});
   }
 
   // set policy
@@ -141,9 +138,20 @@ void CZigbeeNetworking::stackInit(const std::vector<SEzspConfig>& l_config, cons
     l_payload.push_back(it.id);
     l_payload.push_back(it.decision);
     //clogD << "EZSP_SET_POLICY : " << unsigned(l_policy[loop].id) << std::endl;
-    dongle.sendCommand(EZSP_SET_POLICY, l_payload);
+    l_steps.push_back({EZSP_SET_POLICY, l_payload, nullptr});
   }
 
+  // add endpoints, an endpoint refused (eg: already added) is only reported, the stack is initialized anyway
+  auto l_check_endpoint = [](const CEzspFrameBuffer& i_rsp) {
+    if( i_rsp.empty() ) {
+      clogW << "EZSP_ADD_ENDPOINT empty RSP" << std::endl;
+    }
+    else if( 0 != i_rsp.at(0) ) {
+      clogW << "EZSP_ADD_ENDPOINT RSP : " << unsigned(i_rsp.at(0)) << std::endl;
+    }
+    return true;
+  };
+
   // add endpoint 1 : gateway device
   l_payload.clear();
   l_payload.push_back(1); // ep number
@@ -158,7 +166,7 @@ void CZigbeeNetworking::stackInit(const std::vector<SEzspConfig>& l_config, cons
   l_payload.push_back(0);
   l_payload.push_back(0); // out cluster
   l_payload.push_back(0);
-  dongle.sendCommand(EZSP_ADD_ENDPOINT, l_payload);
+  l_steps.push_back({EZSP_ADD_ENDPOINT, l_payload, l_check_endpoint});
 
   // add endpoint 242 : green power
   l_payload.clear();
@@ -174,7 +182,21 @@ void CZigbeeNetworking::stackInit(const std::vector<SEzspConfig>& l_config, cons
   l_payload.push_back(0);
   l_payload.push_back(0x21); // out cluster
   l_payload.push_back(0);
-  dongle.sendCommand(EZSP_ADD_ENDPOINT, l_payload);
+  l_steps.push_back({EZSP_ADD_ENDPOINT, l_payload, l_check_endpoint});
+
+  // all sent at once, as the TX window allows
+  dongle.sendBatch(std::move(l_steps), [this](EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses) {
+    if( EZSP_CMD_SUCCESS == i_status )
+    {
+      // configuration finished, initialize zigbee pro stack
+      clogD << "Call EZSP_NETWORK_INIT" << std::endl;
+      dongle.sendCommand(EZSP_NETWORK_INIT);
+    }
+    else
+    {
+      clogE << "CZigbeeNetworking::stackInit failed at step " << i_failed_step << ", status " << unsigned(i_status) << std::endl;
+    }
+  });
 }
 
 void CZigbeeNetworking::formHaNetwork(uint8_t channel)
@@ -291,7 +313,7 @@ void CZigbeeNetworking::startDiscoverProduct(std::function<void (EmberNodeType i
     std::vector<uint8_t> l_param;
     child_idx = 0;
     l_param.push_back(child_idx);
-    dongle.sendCommand(EZSP_GET_CHILD_DATA, l_param);
+    dongle.sendCommand(EZSP_GET_CHILD_DATA, l_param, EZSP_PRIORITY_BULK);
 
     discoverCallbackFct = i_discoverCallbackFct;
 }
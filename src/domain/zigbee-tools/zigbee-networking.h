@@ -26,6 +26,12 @@ public:
 
     CZigbeeNetworking& operator=(CZigbeeNetworking) = delete; /* No assignment allowed */
 
+    /**
+     * @brief Configure the stack and add our endpoints in a single command batch, then initialize the network
+     *
+     * @param l_config The configuration values
+     * @param l_policy The policies
+     */
     void stackInit(const std::vector<SEzspConfig>& l_config, const std::vector<SEzspPolicy>& l_policy);
 
     void formHaNetwork(uint8_t channel=DEFAULT_RADIO_CHANNEL);
@@ -58,7 +64,7 @@ public:
      * Observer
      */
     void handleDongleState( EDongleState /* i_state */ ){;}
-    void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive );
+    void handleEzspRxFrame( EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive );
 
 private:
     CEzspDongle &dongle;
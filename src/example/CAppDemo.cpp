@@ -27,7 +27,7 @@ CAppDemo::CAppDemo(IUartDriver& uartDriver,
         bool gpRemoveAllDevices,
         const std::vector<CGpDevice>& gpDevicesToAdd,
         const std::vector<uint32_t>& gpDevicesToRemove) :
-    timer(i_timer_factory.create()),
+    timer(new ExtendedTimerAdapter(i_timer_factory)),
     dongle(i_timer_factory, this),
     zb_messaging(dongle, i_timer_factory),
     zb_nwk(dongle, zb_messaging),
@@ -210,7 +210,7 @@ void CAppDemo::handleRxGpdId( uint32_t &i_gpd_id )
     // Stop DEBUG
 }
 
-void CAppDemo::handleRxGpFrame( CGpFrame &i_gpf )
+void CAppDemo::handleRxGpFrame( const CGpFrame &i_gpf )
 {
     // Start DEBUG
     clogI << "CAppDemo::handleRxGpFrame gp frame : " << i_gpf << std::endl;
@@ -291,7 +291,7 @@ void CAppDemo::handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_r
                 if(this->authorizeChRqstAnswerTimeout) {
                     gp_sink.authorizeAnswerToGpfChannelRqst(true);
                     // start timer
-                    timer->start( static_cast<uint16_t>(this->authorizeChRqstAnswerTimeout*1000), [&](ITimer *ipTimer){this->chRqstTimeout();} );
+                    timer->start( std::chrono::seconds(this->authorizeChRqstAnswerTimeout), [&](IExtendedTimer *ipTimer){this->chRqstTimeout();} );
                 }
 
                 // manage other flags
@@ -13,6 +13,7 @@
 #include "../domain/zbmessage/green-power-device.h"
 #include "../spi/IUartDriver.h"
 #include "../spi/ITimerFactory.h"
+#include "../spi/ExtendedTimerAdapter.h"
 #include "../spi/ILogger.h"
 #include "dummy_db.h"
 
@@ -49,7 +50,7 @@ public:
      */
     void handleDongleState( EDongleState i_state );
     void handleEzspRxMessage( EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive );
-    void handleRxGpFrame( CGpFrame &i_gpf );
+    void handleRxGpFrame( const CGpFrame &i_gpf );
     void handleRxGpdId( uint32_t &i_gpd_id );
 
 private:
@@ -64,7 +65,7 @@ private:
 
 
 private:
-    std::unique_ptr<ITimer> timer;
+    std::unique_ptr<IExtendedTimer> timer;
     CEzspDongle dongle;
     CZigbeeMessaging zb_messaging;
     CZigbeeNetworking zb_nwk;
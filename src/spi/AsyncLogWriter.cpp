@@ -0,0 +1,150 @@
+/**
+ * @file AsyncLogWriter.cpp
+ *
+ * @brief Background thread outputting the lines logged to LineBufferedLoggerStream objects
+ */
+
+#include "AsyncLogWriter.h"
+
+#include <cstring>
+
+/* The ring is a bounded multi-producer queue where each cell carries a sequence number (see Dmitry Vyukov's bounded MPMC
+ * queue): producers reserve a position with a compare-and-swap, fill the cell, then publish it by advancing its sequence.
+ * Being the only consumer, writerThread needs no atomic operation to pop.
+ */
+
+const size_t AsyncLogWriter::MAX_LINE_LENGTH;
+
+/**
+ * @brief Maximum time writerThread sleeps without checking the ring
+ */
+static const std::chrono::milliseconds WRITER_IDLE_POLL(100);
+
+AsyncLogWriter::AsyncLogWriter(size_t capacity) :
+		records(),
+		mask(0),
+		pushPosition(0),
+		popPosition(0),
+		droppedCount(0),
+		writerIdle(false),
+		terminate(false),
+		mutex(),
+		wakeUp(),
+		popped(),
+		writerThread() {
+	size_t size = 2;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	this->records.reset(new SRecord[size]);
+	this->mask = size - 1;
+	for (size_t position = 0; position < size; position++) {
+		this->records[position].sequence.store(position, std::memory_order_relaxed);
+	}
+	this->writerThread = std::thread(&AsyncLogWriter::writerLoop, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->terminate = true;
+	}
+	this->wakeUp.notify_one();
+	this->writerThread.join();
+}
+
+bool AsyncLogWriter::push(LineBufferedLoggerStream* stream, const SLogLine& line) {
+	size_t position = this->pushPosition.load(std::memory_order_relaxed);
+	SRecord* record;
+
+	while (true) {
+		record = &this->records[position & this->mask];
+		size_t sequence = record->sequence.load(std::memory_order_acquire);
+		if (sequence == position) {
+			if (this->pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;	/* Cell reserved */
+			}
+		}
+		else if (static_cast<ptrdiff_t>(sequence - position) < 0) {
+			this->droppedCount.fetch_add(1, std::memory_order_relaxed);	/* Full: the cell has not been popped since the previous turn */
+			return false;
+		}
+		else {
+			position = this->pushPosition.load(std::memory_order_relaxed);	/* Reserved by another producer meanwhile */
+		}
+	}
+	record->stream = stream;
+	record->level = line.level;
+	record->timestamp = line.timestamp;
+	record->threadId = line.threadId;
+	record->length = (line.length > MAX_LINE_LENGTH) ? MAX_LINE_LENGTH : line.length;
+	memcpy(record->text, line.text, record->length);
+	record->text[record->length] = '\0';
+	record->sequence.store(position + 1, std::memory_order_release);
+
+	/* Pairs with the fence of writerLoop(): either writerThread sees our record before going idle, or we see it idle */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (this->writerIdle.load(std::memory_order_relaxed) && this->writerIdle.exchange(false)) {
+		/* Only the first producer after writerThread went idle wakes it up. The mutex is only held by writerThread while it
+		 * goes idle (never while outputting), so that the notification cannot be missed */
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->wakeUp.notify_one();
+	}
+	return true;
+}
+
+bool AsyncLogWriter::flush(const std::chrono::milliseconds& timeout) {
+	const size_t target = this->pushPosition.load();
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->wakeUp.notify_one();
+	return this->popped.wait_for(lock, timeout, [this, target]() {
+		return static_cast<ptrdiff_t>(this->popPosition.load() - target) >= 0;
+	});
+}
+
+uint64_t AsyncLogWriter::getDroppedCount() const {
+	return this->droppedCount.load();
+}
+
+uint64_t AsyncLogWriter::getWrittenCount() const {
+	return this->popPosition.load();
+}
+
+bool AsyncLogWriter::popRecord() {
+	const size_t position = this->popPosition.load(std::memory_order_relaxed);
+	SRecord& record = this->records[position & this->mask];
+
+	if (record.sequence.load(std::memory_order_acquire) != position + 1) {
+		return false;	/* Empty, or the next record is still being filled */
+	}
+	record.stream->outputLine(SLogLine(record.level, record.timestamp, record.threadId, record.text, record.length));
+	record.sequence.store(position + this->mask + 1, std::memory_order_release);	/* Free for the next turn */
+	this->popPosition.store(position + 1);
+	return true;
+}
+
+void AsyncLogWriter::writerLoop() {
+	while (true) {
+		bool output = false;
+		while (this->popRecord()) {
+			output = true;
+		}
+		std::unique_lock<std::mutex> lock(this->mutex);
+		if (output) {
+			this->popped.notify_all();
+			continue;
+		}
+		if (this->terminate) {
+			break;
+		}
+		this->writerIdle = true;
+		/* Pairs with the fence of push(): storing writerIdle must not be reordered after checking for a record */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const SRecord& next = this->records[this->popPosition.load(std::memory_order_relaxed) & this->mask];
+		if (next.sequence.load(std::memory_order_acquire) != this->popPosition.load(std::memory_order_relaxed) + 1) {
+			this->wakeUp.wait_for(lock, WRITER_IDLE_POLL);
+		}
+		this->writerIdle = false;
+	}
+}
@@ -0,0 +1,140 @@
+/**
+ * @file AsyncLogWriter.h
+ *
+ * @brief Background thread outputting the lines logged to LineBufferedLoggerStream objects
+ */
+
+#pragma once
+
+#include "LineBufferedLoggerStream.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Writer outputting log lines on its own thread, so that logging never blocks the threads producing the logs
+ *
+ * Complete lines are copied into a bounded ring of records, shared by all the streams using this writer (see
+ * LineBufferedLoggerStream::setAsyncWriter()). Any number of threads can push records without taking any lock (except
+ * briefly to wake the writer thread up when it is idle), while the writer thread pops them in order and passes them to the
+ * outputLine() method of their stream.
+ *
+ * When the ring is full (the output cannot keep up with the logs), new lines are dropped rather than waited for, and
+ * counted (see getDroppedCount()). Lines longer than MAX_LINE_LENGTH are truncated.
+ */
+class AsyncLogWriter {
+public:
+	static const size_t MAX_LINE_LENGTH = 511;	/*!< Maximum number of characters kept for each line */
+
+	/**
+	 * @brief Constructor, starts the writer thread
+	 *
+	 * @param capacity The number of records the ring can hold, rounded up to a power of 2
+	 */
+	AsyncLogWriter(size_t capacity = 1024);
+
+	/**
+	 * @brief Destructor, outputs the pending records then stops the writer thread
+	 *
+	 * No stream must use this writer anymore
+	 */
+	~AsyncLogWriter();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	AsyncLogWriter(const AsyncLogWriter& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	AsyncLogWriter& operator=(const AsyncLogWriter& other) = delete;
+
+	/**
+	 * @brief Queue a line for output, never blocks
+	 *
+	 * @param stream The stream outputting the line
+	 * @param line The line (copied)
+	 *
+	 * @return false if the line was dropped because the ring is full
+	 */
+	bool push(LineBufferedLoggerStream* stream, const SLogLine& line);
+
+	/**
+	 * @brief Wait until all the lines pushed before this call are output
+	 *
+	 * @param timeout The maximum time to wait
+	 *
+	 * @return false if lines are still pending after @p timeout
+	 */
+	bool flush(const std::chrono::milliseconds& timeout = std::chrono::seconds(1));
+
+	/**
+	 * @brief Get the number of lines dropped because the ring was full
+	 */
+	uint64_t getDroppedCount() const;
+
+	/**
+	 * @brief Get the number of lines output
+	 */
+	uint64_t getWrittenCount() const;
+
+private:
+	/**
+	 * @brief A cell of the ring
+	 */
+	struct SRecord {
+		SRecord() : sequence(0), stream(nullptr), level(LOG_LEVEL::ERROR), timestamp(), threadId(), length(0), text() { }
+
+		std::atomic<size_t> sequence;	/*!< Position this cell can be pushed at (if equal to it), or popped at (if equal to it + 1) */
+		LineBufferedLoggerStream* stream;	/*!< The stream outputting the line */
+		LOG_LEVEL level;	/*!< The log level of the line */
+		std::chrono::system_clock::time_point timestamp;	/*!< The time the line was completed */
+		std::thread::id threadId;	/*!< The thread that logged the line */
+		size_t length;	/*!< The number of characters in text */
+		char text[MAX_LINE_LENGTH + 1];	/*!< The characters of the line, NUL-terminated */
+	};
+
+	/**
+	 * @brief Output the next record if it has been pushed, invoked by writerThread only
+	 *
+	 * @return false if there was no record to output
+	 */
+	bool popRecord();
+
+	/**
+	 * @brief Body of writerThread
+	 */
+	void writerLoop();
+
+	std::unique_ptr<SRecord[]> records;	/*!< The ring of records */
+	size_t mask;	/*!< Ring capacity - 1, to get the cell of a position */
+	std::atomic<size_t> pushPosition;	/*!< Position of the next record to push */
+	std::atomic<size_t> popPosition;	/*!< Position of the next record to pop, only modified by writerThread */
+	std::atomic<uint64_t> droppedCount;	/*!< Number of lines dropped */
+	std::atomic<bool> writerIdle;	/*!< Is writerThread waiting for records (reset by the producer that notifies wakeUp) */
+	std::atomic<bool> terminate;	/*!< Request writerThread to terminate once all records are output */
+	std::mutex mutex;	/*!< Mutex associated with the condition variables below */
+	std::condition_variable wakeUp;	/*!< Signalled when records are pushed while writerThread is idle */
+	std::condition_variable popped;	/*!< Signalled when writerThread has output records */
+	std::thread writerThread;	/*!< The thread outputting the records */
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
@@ -0,0 +1,131 @@
+/**
+ * @file ExtendedTimerAdapter.cpp
+ *
+ * @brief Implementation of IExtendedTimer on top of the ITimer objects of any ITimerFactory
+ */
+
+#include "ExtendedTimerAdapter.h"
+
+#include <algorithm>
+
+ExtendedTimerAdapter::ExtendedTimerAdapter(const ITimerFactory& timerFactory) :
+	timerFactory(timerFactory),
+	mutex(),
+	callBackFunction(),
+	deadline(),
+	period(0),
+	generation(0),
+	running(false),
+	lateness(0),
+	timer(timerFactory.create()) {
+}
+
+ExtendedTimerAdapter::~ExtendedTimerAdapter() {
+	this->stop();
+}
+
+bool ExtendedTimerAdapter::start(TDuration timeout, TCallback callBackFunction) {
+	return this->arm(timeout, TDuration::zero(), callBackFunction);
+}
+
+bool ExtendedTimerAdapter::startPeriodic(TDuration period, TCallback callBackFunction) {
+	if (period <= TDuration::zero()) {
+		return false;
+	}
+	return this->arm(period, period, callBackFunction);
+}
+
+bool ExtendedTimerAdapter::stop() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (!this->running) {
+			return false;
+		}
+		this->running = false;
+		this->generation++;
+	}
+	this->timer->stop();	/* Not under mutex, as it may wait for a step callback (see onStepExpired()) */
+	return true;
+}
+
+bool ExtendedTimerAdapter::isRunning() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->running;
+}
+
+IExtendedTimer::TDuration ExtendedTimerAdapter::getLateness() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->lateness;
+}
+
+bool ExtendedTimerAdapter::arm(TDuration timeout, TDuration period, TCallback callBackFunction) {
+	if (!callBackFunction) {
+		return false;
+	}
+	this->stop();	/* Restart an already running timer */
+
+	if (timeout <= TDuration::zero()) {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->lateness = TDuration::zero();
+		}
+		callBackFunction(this);
+		return true;
+	}
+	uint64_t generation;
+	TTimePoint deadline;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->callBackFunction = callBackFunction;
+		this->deadline = this->timerFactory.now() + timeout;
+		this->period = period;
+		this->running = true;
+		generation = ++this->generation;
+		deadline = this->deadline;
+	}
+	this->armStep(generation, deadline);
+	return true;
+}
+
+void ExtendedTimerAdapter::armStep(uint64_t generation, TTimePoint deadline) {
+	long long remainingUs = std::chrono::duration_cast<std::chrono::microseconds>(deadline - this->timerFactory.now()).count();
+	/* Round up to the resolution of ITimer, so that the deadline is never missed by an early expiration */
+	long long stepMs = std::max<long long>(1, std::min<long long>((remainingUs + 999) / 1000, UINT16_MAX));
+
+	this->timer->start(static_cast<uint16_t>(stepMs), [this, generation](ITimer* triggeringTimer) { this->onStepExpired(generation); });
+}
+
+void ExtendedTimerAdapter::onStepExpired(uint64_t generation) {
+	TCallback callback;
+	TTimePoint nextDeadline;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (generation != this->generation) {
+			return;	/* Stopped or restarted after this step was armed */
+		}
+		TTimePoint now = this->timerFactory.now();
+		if (now < this->deadline) {
+			nextDeadline = this->deadline;	/* Long timeout, split in several steps */
+		}
+		else {
+			this->lateness = std::chrono::duration_cast<TDuration>(now - this->deadline);
+			callback = this->callBackFunction;	/* Copied, as the callback may restart the timer with another one */
+			if (this->period > TDuration::zero()) {
+				/* Next period, skipping the ones already missed */
+				this->deadline += this->period * ((now - this->deadline) / this->period + 1);
+				nextDeadline = this->deadline;
+			}
+			else {
+				this->running = false;
+			}
+		}
+	}
+	if (callback) {
+		callback(this);
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (generation != this->generation || !this->running) {
+			return;	/* Stopped or restarted by the callback, or one-shot timer */
+		}
+	}
+	this->armStep(generation, nextDeadline);
+}
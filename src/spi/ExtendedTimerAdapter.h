@@ -0,0 +1,142 @@
+/**
+ * @file ExtendedTimerAdapter.h
+ *
+ * @brief Implementation of IExtendedTimer on top of the ITimer objects of any ITimerFactory
+ */
+
+#pragma once
+
+#include "IExtendedTimer.h"
+#include "ITimerFactory.h"
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Adapter providing an IExtendedTimer out of a timer created by an ITimerFactory (CppThreadsTimerFactory, RaritanTimerFactory, VirtualClock...)
+ *
+ * Timeouts longer than what an ITimer supports are split into steps of at most 65535ms, and periodic timers re-arm the
+ * underlying ITimer from its callback, so that no additional thread is needed. Deadlines are computed on the clock of
+ * the factory (see ITimerFactory::now()), and each step is rounded up to the 1ms resolution of ITimer: a callback can
+ * thus run up to 1ms late, but never early, and this rounding does not accumulate over periods.
+ *
+ * The timer may be restarted or stopped from its own callback, but it must not be destroyed from it. When the timer is
+ * destroyed from another thread, the destructor waits for a callback being run by the underlying timer, if any.
+ */
+class ExtendedTimerAdapter : public IExtendedTimer {
+public:
+	/**
+	 * @brief Default constructor
+	 *
+	 * Construction without arguments is not allowed
+	 */
+	ExtendedTimerAdapter() = delete;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param timerFactory The factory creating the underlying timer, and providing the clock deadlines are computed on. It must outlive this object
+	 */
+	ExtendedTimerAdapter(const ITimerFactory& timerFactory);
+
+	/**
+	 * @brief Destructor
+	 */
+	~ExtendedTimerAdapter();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	ExtendedTimerAdapter(const ExtendedTimerAdapter& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	ExtendedTimerAdapter& operator=(const ExtendedTimerAdapter& other) = delete;
+
+	/**
+	 * @brief Start a timer, run a callback once after expiration of the configured time
+	 *
+	 * @param timeout The timeout
+	 * @param callBackFunction The function to call at expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 */
+	bool start(TDuration timeout, TCallback callBackFunction);
+
+	/**
+	 * @brief Start a timer, run a callback at the end of each period, until the timer is stopped
+	 *
+	 * @param period The period (must not be 0)
+	 * @param callBackFunction The function to call at each expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 */
+	bool startPeriodic(TDuration period, TCallback callBackFunction);
+
+	/**
+	 * @brief Stop and reset the timer
+	 *
+	 * @return true if we actually could stop a running timer
+	 */
+	bool stop();
+
+	/**
+	 * @brief Is the timer currently running?
+	 *
+	 * @return true if the timer is running
+	 */
+	bool isRunning();
+
+	/**
+	 * @brief Get the lateness of the last expiration
+	 */
+	TDuration getLateness() const;
+
+private:
+	typedef std::chrono::steady_clock::time_point TTimePoint;
+
+	/**
+	 * @brief Start the timer in one-shot or periodic mode
+	 *
+	 * @param timeout The delay until the first expiration
+	 * @param period The period, 0 for a one-shot timer
+	 * @param callBackFunction The function to call at expiration of the timer
+	 */
+	bool arm(TDuration timeout, TDuration period, TCallback callBackFunction);
+
+	/**
+	 * @brief Start the underlying timer, for (at most) the remaining time until a deadline
+	 *
+	 * @param generation The generation of the start() this step belongs to
+	 * @param deadline The next expiration time
+	 */
+	void armStep(uint64_t generation, TTimePoint deadline);
+
+	/**
+	 * @brief Handle the expiration of the underlying timer: run the callback if the deadline is reached, or arm the next step
+	 *
+	 * @param generation The generation of the start() the expired step belongs to
+	 */
+	void onStepExpired(uint64_t generation);
+
+	const ITimerFactory& timerFactory;	/*!< The factory that created timer, providing the current time */
+	mutable std::mutex mutex;	/*!< Protects the attributes below */
+	TCallback callBackFunction;	/*!< The function to call at expiration */
+	TTimePoint deadline;	/*!< The time of the next expiration */
+	TDuration period;	/*!< The period of a periodic timer, 0 for a one-shot timer */
+	uint64_t generation;	/*!< Incremented on each start() and stop(), so that steps of a former start() are ignored */
+	bool running;	/*!< Is the timer currently running */
+	TDuration lateness;	/*!< The lateness of the last expiration */
+	std::unique_ptr<ITimer> timer;	/*!< The underlying timer (declared last so that it is destroyed first, while the attributes its callback uses are still valid) */
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
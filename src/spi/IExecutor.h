@@ -0,0 +1,49 @@
+/**
+ * @file IExecutor.h
+ *
+ * @brief Abstract interface to which must conforms implementations of classes that run tasks on a single thread
+ *
+ * Used as a dependency inversion paradigm
+ */
+
+#pragma once
+
+#include <functional> // For std::function
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Abstract class running tasks one at a time, in the order they were posted
+ *
+ * Objects only used from tasks of the same executor (and from its timers) need no locking
+ */
+class IExecutor {
+public:
+	/**
+	 * @brief Destructor
+	 */
+	virtual ~IExecutor() { }
+
+	/**
+	 * @brief Queue a task, to be run on the executor thread
+	 *
+	 * Can be invoked from any thread, including from a task
+	 *
+	 * @param task The task to run
+	 */
+	virtual void post(std::function<void ()> task) = 0;
+
+	/**
+	 * @brief Is the caller running on the executor thread?
+	 *
+	 * @return true if invoked from a task or a timer callback of this executor
+	 */
+	virtual bool isInExecutorThread() const = 0;
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
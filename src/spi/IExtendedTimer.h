@@ -0,0 +1,93 @@
+/**
+ * @file IExtendedTimer.h
+ *
+ * @brief Abstract interface to which must conforms implementations of classes that handle timed callbacks with std::chrono durations
+ *
+ * Used as a dependency inversion paradigm
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional> // For std::function
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+/**
+ * @brief Abstract class to execute a callback after a given timeout, or periodically
+ *
+ * Unlike ITimer, whose timeout is limited to 65535ms with a 1ms resolution, timeouts are std::chrono durations, from
+ * microseconds to hours (any duration convertible to std::chrono::microseconds can be passed).
+ * Periodic timers are re-armed by the implementation, on a fixed schedule that does not drift with the time the callbacks
+ * take to run.
+ */
+class IExtendedTimer {
+public:
+	typedef std::chrono::microseconds TDuration;
+	typedef std::function<void (IExtendedTimer* triggeringTimer)> TCallback;
+
+	/**
+	 * @brief Default constructor
+	 */
+	IExtendedTimer() { }
+
+	/**
+	 * @brief Destructor
+	 */
+	virtual ~IExtendedTimer() { }
+
+	/**
+	 * @brief Start a timer, run a callback once after expiration of the configured time
+	 *
+	 * Starting a running timer restarts it. A timeout of 0 runs the callback at once.
+	 *
+	 * @param timeout The timeout
+	 * @param callBackFunction The function to call at expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 *
+	 * @return false if callBackFunction is empty
+	 */
+	virtual bool start(TDuration timeout, TCallback callBackFunction) = 0;
+
+	/**
+	 * @brief Start a timer, run a callback at the end of each period, until the timer is stopped
+	 *
+	 * The n-th expiration is due n periods after this call. If a callback runs late by more than a period, the expirations
+	 * missed in the meantime are skipped, so that callbacks never run back to back.
+	 *
+	 * @param period The period (must not be 0)
+	 * @param callBackFunction The function to call at each expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 *
+	 * @return false if callBackFunction is empty or period is not positive
+	 */
+	virtual bool startPeriodic(TDuration period, TCallback callBackFunction) = 0;
+
+	/**
+	 * @brief Stop and reset the timer
+	 *
+	 * @return true if we actually could stop a running timer
+	 */
+	virtual bool stop() = 0;
+
+	/**
+	 * @brief Is the timer currently running?
+	 *
+	 * @return true if the timer is running (a periodic timer keeps running after each expiration)
+	 */
+	virtual bool isRunning() = 0;
+
+	/**
+	 * @brief Get the delay between the due time of the last expiration, and the time its callback was actually invoked
+	 *
+	 * Meant to be read from the callback, to compensate for (or log) the lateness of the expiration being processed.
+	 *
+	 * @return The lateness of the last expiration, 0 if the timer never expired
+	 */
+	virtual TDuration getLateness() const = 0;
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
@@ -115,16 +115,12 @@ typedef enum {
 	TRACE
 } LOG_LEVEL;
 
-/* FIXME: current implementation uses std::streambuf::overflow(), causing invokation of writes for each character, and thus forcing to re-implement line-split for Raritan's logger
- * we could use a better implementation like:
- * https://stackoverflow.com/questions/2638654/redirect-c-stdclog-to-syslog-on-unix
- */
 /**
  * @brief Abstract class to implement and ostream-compatible message logger
  *
  * Specialized loggers should derive from this virtual class in order to provide a concrete implementation of a logging mechanism.
  *
- * A concrete implementation that specializes the ILogger class should also derive logger implementations from ILoggerStream, then instanciate each of these loggers statically in their concrete implementation .cpp file:
+ * A concrete implementation that specializes the ILogger class should also derive logger implementations from ILoggerStream (or from LineBufferedLoggerStream, that splits the ostream output into lines), then instanciate each of these loggers statically in their concrete implementation .cpp file:
  * @code
  * static MyErrorLogger myErrorLoggerInstance;
  * @endcode
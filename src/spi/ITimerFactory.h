@@ -9,6 +9,7 @@
 
 #include "ITimer.h"
 #include <memory>	// For std::unique_ptr
+#include <chrono>
 
 #ifdef USE_RARITAN
 /**** Start of the official API; no includes below this point! ***************/
@@ -31,6 +32,18 @@ public:
 	 * @return The new instance allocated
 	 */
 	virtual std::unique_ptr<ITimer> create() const = 0;
+
+	/**
+	 * @brief Get the current time, on the clock the timers created by this factory run on
+	 *
+	 * The library measures durations (round trip times, command timeouts) with this clock, so that they stay consistent
+	 * with its timers. Factories of simulated timers (see VirtualClock) override it.
+	 *
+	 * @return The current time, the real monotonic time by default
+	 */
+	virtual std::chrono::steady_clock::time_point now() const {
+		return std::chrono::steady_clock::now();
+	}
 };
 
 #ifdef USE_RARITAN
@@ -16,6 +16,14 @@
 #include <pp/official_api_start.h>
 #endif // USE_RARITAN
 
+/**
+ * @brief One buffer of a vectored write (see IUartDriver::writev())
+ */
+struct UartIoVec {
+	const void* buf;	/*!< The bytes to write */
+	size_t cnt;	/*!< The number of bytes in buf */
+};
+
 /**
  * @brief Abstract class that manipulate UARTs
  */
@@ -68,6 +76,30 @@ public:
 	 */
 	virtual int write(size_t& writtenCnt, const void* buf, size_t cnt) = 0;
 
+	/**
+	 * @brief Write several byte sequences to the serial port, in order, as a single write when possible
+	 *
+	 * The default implementation invokes write() for each buffer, drivers override it to save system calls
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written, in total
+	 * @param[in] iov The buffers to write
+	 * @param[in] iovcnt The number of buffers in iov
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	virtual int writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt) {
+		writtenCnt = 0;
+		for (size_t loop = 0; loop < iovcnt; loop++) {
+			size_t bufWrittenCnt = 0;
+			int result = this->write(bufWrittenCnt, iov[loop].buf, iov[loop].cnt);
+			writtenCnt += bufWrittenCnt;
+			if (result != 0 || bufWrittenCnt != iov[loop].cnt) {
+				return result;
+			}
+		}
+		return 0;
+	}
+
 	/**
 	 * @brief Callback to close the serial port
 	 *
@@ -0,0 +1,169 @@
+/**
+ * @file LineBufferedLoggerStream.cpp
+ *
+ * @brief Base class for ILoggerStream implementations outputting whole lines rather than single characters
+ */
+
+#include "LineBufferedLoggerStream.h"
+#include "AsyncLogWriter.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Identifier of the next stream constructed (constant-initialized, so usable by static streams of any unit)
+ */
+std::atomic<uint64_t> nextStreamId(0);
+
+/**
+ * @brief Line being built by a thread on a stream
+ */
+struct SThreadLine {
+	uint64_t streamId;	/*!< The identifier of the stream the line is written to */
+	std::string text;	/*!< The characters received so far (its capacity is kept from one line to the next) */
+};
+
+/**
+ * @brief Set once threadLines of the current thread is destroyed (trivial, so never destroyed itself)
+ */
+thread_local bool threadLinesDestroyed = false;
+
+/**
+ * @brief Lines being built by the current thread, one per stream it logged to
+ *
+ * A thread only logs to a handful of streams, so a linear search is faster than any associative container
+ */
+thread_local struct SThreadLines {
+	SThreadLines() : lines() { }
+	~SThreadLines() { threadLinesDestroyed = true; }	/* Static streams are destroyed after the main thread ones */
+
+	std::vector<SThreadLine> lines;
+} threadLines;
+
+/**
+ * @brief Get the line being built by the current thread on a stream
+ *
+ * @param streamId The identifier of the stream
+ * @param unbufferedLine The line to use instead once the lines of the current thread are destroyed (the caller must then complete it itself before returning)
+ */
+std::string& getThreadLine(uint64_t streamId, std::string& unbufferedLine) {
+	if (threadLinesDestroyed) {
+		return unbufferedLine;
+	}
+	for (auto& threadLine : threadLines.lines) {
+		if (threadLine.streamId == streamId) {
+			return threadLine.text;
+		}
+	}
+	threadLines.lines.push_back(SThreadLine{streamId, std::string()});
+	return threadLines.lines.back().text;
+}
+
+/**
+ * @brief Forget the line being built by the current thread on a stream
+ */
+void removeThreadLine(uint64_t streamId) {
+	if (threadLinesDestroyed) {
+		return;
+	}
+	for (auto it = threadLines.lines.begin(); it != threadLines.lines.end(); ++it) {
+		if (it->streamId == streamId) {
+			threadLines.lines.erase(it);
+			return;
+		}
+	}
+}
+
+}
+
+LineBufferedLoggerStream::LineBufferedLoggerStream(const LOG_LEVEL setLogLevel, const bool isEnabled) :
+		ILoggerStream(setLogLevel, isEnabled),
+		asyncWriter(nullptr),
+		id(nextStreamId++) {
+}
+
+LineBufferedLoggerStream::~LineBufferedLoggerStream() {
+	/* Records still pending in a writer would refer to a destroyed stream (and outputLine() cannot be invoked anymore
+	 * once the derived class is destroyed): the writer must have been detached before */
+	assert(this->asyncWriter.load() == nullptr);
+	removeThreadLine(this->id);
+}
+
+void LineBufferedLoggerStream::setAsyncWriter(AsyncLogWriter* writer) {
+	AsyncLogWriter* previous = this->asyncWriter.exchange(writer);
+
+	if (previous && previous != writer) {
+		previous->flush();	/* No record of the previous writer refers to this stream anymore once we return */
+	}
+}
+
+int LineBufferedLoggerStream::overflow(int c) {
+	if (c != EOF && this->isOutputting()) {
+		std::string unbufferedLine;
+		std::string& line = getThreadLine(this->id, unbufferedLine);
+		if (c == '\n') {
+			if (&line != &unbufferedLine || !line.empty()) {	/* Unbuffered, the text before the '\n' is already output */
+				this->completeLine(line);
+			}
+		}
+		else {
+			line += static_cast<char>(c);
+		}
+		if (!unbufferedLine.empty()) {
+			this->completeLine(unbufferedLine);
+		}
+	}
+	return c;
+}
+
+std::streamsize LineBufferedLoggerStream::xsputn(const char* s, std::streamsize count) {
+	if (count <= 0 || !this->isOutputting()) {
+		return count;
+	}
+	std::string unbufferedLine;
+	std::string& line = getThreadLine(this->id, unbufferedLine);
+	const char* end = s + count;
+	while (s < end) {
+		const char* newLine = static_cast<const char*>(memchr(s, '\n', static_cast<size_t>(end - s)));
+		if (!newLine) {
+			line.append(s, static_cast<size_t>(end - s));
+			break;
+		}
+		line.append(s, static_cast<size_t>(newLine - s));
+		if (&line != &unbufferedLine || !line.empty()) {
+			this->completeLine(line);
+		}
+		s = newLine + 1;
+	}
+	if (!unbufferedLine.empty()) {
+		this->completeLine(unbufferedLine);
+	}
+	return count;
+}
+
+int LineBufferedLoggerStream::sync() {
+	std::string unbufferedLine;	/* Always empty here */
+	std::string& line = getThreadLine(this->id, unbufferedLine);
+	if (!line.empty()) {
+		this->completeLine(line);
+	}
+	return 0;
+}
+
+void LineBufferedLoggerStream::completeLine(std::string& line) {
+	SLogLine logLine(this->logLevel, std::chrono::system_clock::now(), std::this_thread::get_id(), line.c_str(), line.size());
+	AsyncLogWriter* writer = this->asyncWriter;
+
+	if (writer) {
+		writer->push(this, logLine);
+	}
+	else {
+		this->outputLine(logLine);
+	}
+	line.clear();
+}
@@ -0,0 +1,137 @@
+/**
+ * @file LineBufferedLoggerStream.h
+ *
+ * @brief Base class for ILoggerStream implementations outputting whole lines rather than single characters
+ */
+
+#pragma once
+
+#include "ILogger.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <ios>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef USE_RARITAN
+/**** Start of the official API; no includes below this point! ***************/
+#include <pp/official_api_start.h>
+#endif // USE_RARITAN
+
+class AsyncLogWriter;
+
+/**
+ * @brief A complete log line, with the context it was logged in
+ */
+struct SLogLine {
+	SLogLine(LOG_LEVEL level, const std::chrono::system_clock::time_point& timestamp, const std::thread::id& threadId, const char* text, size_t length) :
+		level(level), timestamp(timestamp), threadId(threadId), text(text), length(length) { }
+
+	LOG_LEVEL level;	/*!< The log level of the stream the line was logged to */
+	std::chrono::system_clock::time_point timestamp;	/*!< The time the line was completed */
+	std::thread::id threadId;	/*!< The thread that logged the line */
+	const char* text;	/*!< The text of the line, NUL-terminated, without its trailing '\n' */
+	size_t length;	/*!< The number of characters in text */
+};
+
+/**
+ * @brief ILoggerStream implementation splitting the characters written through an ostream into lines
+ *
+ * Characters are accumulated in a buffer owned by the calling thread (one per thread and per stream), so that lines
+ * logged concurrently by several threads to the same stream are never mixed. Strings inserted with operator<< are
+ * received as a whole (see xsputn()), rather than through one virtual call per character. Once the buffers of a thread
+ * are destroyed (logging from the destructor of a static object for instance), what it writes is output at once instead.
+ *
+ * A line is complete when a '\n' is written, or when the stream is flushed (std::flush, std::endl...). Complete lines are
+ * passed to outputLine(), either at once on the logging thread, or, if an AsyncLogWriter is set, on the thread of that
+ * writer, so that the logging thread never waits for the actual output.
+ *
+ * Derived classes only have to implement outputLine() (and log()).
+ */
+class LineBufferedLoggerStream : public ILoggerStream {
+	friend class AsyncLogWriter;
+
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param setLogLevel The log level handled by this logger instance. This is fixed at construction and cannot be changed afterwards
+	 * @param isEnabled Is this logger enabled (this can be reset later on using method setEnable()
+	 */
+	LineBufferedLoggerStream(const LOG_LEVEL setLogLevel, const bool isEnabled = true);
+
+	/**
+	 * @brief Destructor
+	 *
+	 * The writer must have been detached before (see setAsyncWriter()), as records pending in it refer to this stream.
+	 * The line being built by the calling thread is dropped, lines not completed by other threads are lost (their buffers
+	 * are only freed when those threads terminate, but are never used by another stream).
+	 */
+	virtual ~LineBufferedLoggerStream();
+
+	/**
+	 * @brief Set the writer complete lines are handed over to
+	 *
+	 * When replacing a writer (or detaching it with nullptr), the lines already handed over to it are output before this
+	 * method returns, so that none of its records refers to this stream anymore. Detach the writer before destroying
+	 * either the writer or this stream.
+	 *
+	 * @param writer The writer outputting the lines on its own thread, or nullptr to output lines on the logging thread. It must outlive its use by this stream
+	 */
+	void setAsyncWriter(AsyncLogWriter* writer);
+
+protected:
+	/**
+	 * @brief Output a complete line
+	 *
+	 * This method is purely virtual and should be overridden by inheriting classes defining a concrete implementation
+	 *
+	 * @note With an AsyncLogWriter, this method is invoked on the thread of the writer, and @p line is only valid during the call
+	 *
+	 * @param line The line to output
+	 */
+	virtual void outputLine(const SLogLine& line) = 0;
+
+	/**
+	 * @brief Receive one character of an output stream
+	 *
+	 * @param c The new character
+	 *
+	 * @return The character that has been received, or EOF
+	 */
+	virtual int overflow(int c);
+
+	/**
+	 * @brief Receive a sequence of characters of an output stream
+	 *
+	 * @param s The characters
+	 * @param count The number of characters in @p s
+	 *
+	 * @return The number of characters received (always @p count)
+	 */
+	virtual std::streamsize xsputn(const char* s, std::streamsize count);
+
+	/**
+	 * @brief Complete the line being built by the calling thread, if any (invoked when the ostream is flushed)
+	 *
+	 * @return 0
+	 */
+	virtual int sync();
+
+private:
+	/**
+	 * @brief Hand over the line built by the calling thread to outputLine() or to the writer, then empty it
+	 *
+	 * @param line The line built by the calling thread
+	 */
+	void completeLine(std::string& line);
+
+	std::atomic<AsyncLogWriter*> asyncWriter;	/*!< The writer outputting complete lines, nullptr to output them at once */
+	const uint64_t id;	/*!< Unique identifier of this stream, keying the lines built by each thread (unlike its address, never reused by a later stream) */
+};
+
+#ifdef USE_RARITAN
+#include <pp/official_api_end.h>
+#endif // USE_RARITAN
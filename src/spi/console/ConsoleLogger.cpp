@@ -9,7 +9,7 @@
 #include <cstdio>
 
 ConsoleStderrLogger::ConsoleStderrLogger(const LOG_LEVEL logLevel) :
-		ILoggerStream(logLevel) { /* Set the parent classes' logger's level to what has been provided as constructor's argument */
+		LineBufferedLoggerStream(logLevel) { /* Set the parent classes' logger's level to what has been provided as constructor's argument */
 }
 
 ConsoleStderrLogger::~ConsoleStderrLogger() {
@@ -25,13 +25,9 @@ void ConsoleStderrLogger::log(const char *format, ...) {
 	}
 }
 
-int ConsoleStderrLogger::overflow(int c) {
-	if (c != EOF && this->enabled && !this->muted) {
-		if (putchar(c) == EOF) {
-			return EOF;
-		}
-	}
-	return c;
+void ConsoleStderrLogger::outputLine(const SLogLine& line) {
+	/* A single call, so that lines output concurrently are not mixed */
+	printf("%.*s\n", static_cast<int>(line.length), line.text);
 }
 
 /**
@@ -53,7 +49,7 @@ ConsoleStderrLogger& ConsoleStderrLogger::operator=(ConsoleStderrLogger other) {
 }
 
 ConsoleStdoutLogger::ConsoleStdoutLogger(const LOG_LEVEL logLevel) :
-		ILoggerStream(logLevel) { /* Set the parent classes' logger's level to what has been provided as constructor's argument */
+		LineBufferedLoggerStream(logLevel) { /* Set the parent classes' logger's level to what has been provided as constructor's argument */
 }
 
 ConsoleStdoutLogger::~ConsoleStdoutLogger() {
@@ -69,13 +65,9 @@ void ConsoleStdoutLogger::log(const char *format, ...) {
 	}
 }
 
-int ConsoleStdoutLogger::overflow(int c) {
-	if (c != EOF && this->enabled && !this->muted) {
-		if (putchar(c) == EOF) {
-			return EOF;
-		}
-	}
-	return c;
+void ConsoleStdoutLogger::outputLine(const SLogLine& line) {
+	/* A single call, so that lines output concurrently are not mixed */
+	printf("%.*s\n", static_cast<int>(line.length), line.text);
 }
 
 /**
@@ -115,6 +107,14 @@ ConsoleLogger& ConsoleLogger::getInstance() {
 	return instance;
 }
 
+void ConsoleLogger::setAsyncWriter(AsyncLogWriter* writer) {
+	consoleErrorLogger.setAsyncWriter(writer);
+	consoleWarningLogger.setAsyncWriter(writer);
+	consoleInfoLogger.setAsyncWriter(writer);
+	consoleDebugLogger.setAsyncWriter(writer);
+	consoleTraceLogger.setAsyncWriter(writer);
+}
+
 /* Create unique (global) instances of each logger type, and store them inside the ILogger (singleton)'s class static attribute */
 std::ostream ILogger::loggerErrorStream(&ConsoleLogger::getInstance().errorLogger);
 std::ostream ILogger::loggerWarningStream(&ConsoleLogger::getInstance().warningLogger);
@@ -11,11 +11,12 @@
 **/
 #define SINGLETON_LOGGER_CLASS_NAME ConsoleLogger
 #include "../ILogger.h"
+#include "../LineBufferedLoggerStream.h"
 
 /**
  * @brief Class to implement error message logging
  */
-class ConsoleStderrLogger : public ILoggerStream {
+class ConsoleStderrLogger : public LineBufferedLoggerStream {
 public:
 	/**
 	 * @brief Constructor
@@ -64,19 +65,17 @@ public:
 
 protected:
 	/**
-	 * @brief Receive one character of an output stream
+	 * @brief Output a complete line logged through an ostream
 	 *
-	 * @param c The new character
-	 *
-	 * @return The character that has actually been printed out to the log
+	 * @param line The line to output
 	 */
-	virtual int overflow(int c);
+	virtual void outputLine(const SLogLine& line);
 };
 
 /**
  * @brief Class to implement debug message logging
  */
-class ConsoleStdoutLogger : public ILoggerStream {
+class ConsoleStdoutLogger : public LineBufferedLoggerStream {
 public:
 	/**
 	 * @brief Constructor
@@ -125,13 +124,11 @@ public:
 
 protected:
 	/**
-	 * @brief Receive one character of an output stream
-	 *
-	 * @param c The new character
+	 * @brief Output a complete line logged through an ostream
 	 *
-	 * @return The character that has actually been printed out to the log
+	 * @param line The line to output
 	 */
-	virtual int overflow(int c);
+	virtual void outputLine(const SLogLine& line);
 };
 
 /**
@@ -225,6 +222,13 @@ public:
 	 */
 	static ConsoleLogger& getInstance();
 
+	/**
+	 * @brief Output the lines logged through ostreams on the thread of a writer, rather than on the logging threads
+	 *
+	 * @param writer The writer to hand over complete lines to, or nullptr to output them at once. It must outlive its use by this logger
+	 */
+	void setAsyncWriter(AsyncLogWriter* writer);
+
 	/**
 	 * @brief Assignment operator
 	 *
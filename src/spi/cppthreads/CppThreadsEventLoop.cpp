@@ -0,0 +1,234 @@
+/**
+ * @file CppThreadsEventLoop.cpp
+ *
+ * @brief Concrete implementation of IExecutor using C++11 threads, also providing timers run by the same thread
+ */
+
+#include "CppThreadsEventLoop.h"
+
+/**
+ * @brief Timer whose callback is run by the event loop
+ *
+ * All members but callBackFunction's invocation are protected by the loop's timersMutex. A timer must not be destroyed
+ * by another thread while the loop may be invoking its callback (ie: destroy it from the loop, or once the loop stopped)
+ */
+class CppThreadsEventLoop::CTimer : public ITimer {
+public:
+	CTimer(CppThreadsEventLoop& eventLoop) : loop(eventLoop), callBackFunction(), position() { }
+
+	~CTimer() {
+		this->loop.cancelTimer(this);
+	}
+
+	CTimer(const CTimer& other) = delete; /* No copy construction allowed */
+
+	CTimer& operator=(const CTimer& other) = delete; /* No assignment allowed */
+
+	bool start(uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction) {
+		if (!callBackFunction) {
+			return false;
+		}
+		this->loop.cancelTimer(this);	/* Restart an already running timer (as RaritanTimer does) */
+		this->duration = timeout;
+		if (timeout == 0) {
+			callBackFunction(this);
+		}
+		else {
+			this->callBackFunction = callBackFunction;
+			this->loop.scheduleTimer(this, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout));
+		}
+		return true;
+	}
+
+	bool stop() {
+		if (!this->loop.cancelTimer(this)) {
+			return false;
+		}
+		this->duration = 0;
+		return true;
+	}
+
+	bool isRunning() {
+		std::lock_guard<std::mutex> lock(this->loop.timersMutex);
+		return this->started;
+	}
+
+	CppThreadsEventLoop& loop;	/*!< The loop running our callback */
+	std::function<void (ITimer* triggeringTimer)> callBackFunction;	/*!< The function to call at expiration */
+	std::multimap<TTimePoint, CTimer*>::iterator position;	/*!< Our entry in loop.timers, if started */
+
+	friend class CppThreadsEventLoop;
+};
+
+CppThreadsEventLoop::CppThreadsEventLoop() :
+	taskHead(nullptr),
+	taskTail(new STaskNode()),
+	sleeping(false),
+	stopRequested(false),
+	loopThreadId(std::thread::id()),
+	loopThread(),
+	wakeMutex(),
+	wakeCv(),
+	wakePending(false),
+	timersMutex(),
+	timers() {
+	this->taskHead.store(this->taskTail);
+}
+
+CppThreadsEventLoop::~CppThreadsEventLoop() {
+	this->stop();
+	while (this->taskTail != nullptr) {
+		STaskNode* node = this->taskTail;
+		this->taskTail = node->next.load();
+		delete node;
+	}
+}
+
+void CppThreadsEventLoop::run() {
+	this->loopThreadId.store(std::this_thread::get_id());
+	while (!this->stopRequested.load()) {
+		/* Only the tasks already posted, then timers, so that tasks posting tasks (or posted continuously) cannot starve
+		 * timers: those posted meanwhile are run on the next iteration */
+		STaskNode* lastTask = this->taskHead.load();
+		while (!this->stopRequested.load() && this->taskTail != lastTask && this->runNextTask()) {
+		}
+		this->runExpiredTimers();
+		this->waitForWork();
+	}
+	this->loopThreadId.store(std::thread::id());
+}
+
+void CppThreadsEventLoop::start() {
+	this->stopRequested.store(false);
+	this->loopThread = std::thread([this]() { this->run(); });
+}
+
+void CppThreadsEventLoop::stop() {
+	this->stopRequested.store(true);
+	this->wake();
+	if (this->loopThread.joinable()) {
+		if (this->loopThread.get_id() == std::this_thread::get_id()) {
+			this->loopThread.detach();	/* Invoked from a task, the thread terminates right after it */
+		}
+		else {
+			this->loopThread.join();
+		}
+	}
+}
+
+void CppThreadsEventLoop::post(std::function<void ()> task) {
+	STaskNode* node = new STaskNode();
+	node->task = std::move(task);
+	/* Producers serialize on the exchange only, then link the previous tail to the new node */
+	STaskNode* previous = this->taskHead.exchange(node);
+	previous->next.store(node, std::memory_order_release);
+	if (this->sleeping.load()) {
+		this->wake();
+	}
+}
+
+bool CppThreadsEventLoop::isInExecutorThread() const {
+	return this->loopThreadId.load() == std::this_thread::get_id();
+}
+
+std::unique_ptr<ITimer> CppThreadsEventLoop::create() const {
+	/* Timers need to update the loop, create() is only const to satisfy ITimerFactory */
+	return std::unique_ptr<ITimer>(new CTimer(const_cast<CppThreadsEventLoop&>(*this)));
+}
+
+bool CppThreadsEventLoop::runNextTask() {
+	STaskNode* tail = this->taskTail;
+	STaskNode* next = tail->next.load(std::memory_order_acquire);
+
+	if (next == nullptr) {
+		if (this->taskHead.load() == tail) {
+			return false;	/* Empty */
+		}
+		/* A producer swapped taskHead but did not link its node yet, it is about to */
+		do {
+			std::this_thread::yield();
+			next = tail->next.load(std::memory_order_acquire);
+		} while (next == nullptr);
+	}
+	/* next becomes the sentinel, once its task is taken out */
+	std::function<void ()> task = std::move(next->task);
+	next->task = nullptr;
+	this->taskTail = next;
+	delete tail;
+	task();
+	return true;
+}
+
+void CppThreadsEventLoop::runExpiredTimers() {
+	std::unique_lock<std::mutex> lock(this->timersMutex);
+	TTimePoint now = std::chrono::steady_clock::now();
+
+	while (!this->timers.empty() && this->timers.begin()->first <= now && !this->stopRequested.load()) {
+		CTimer* timer = this->timers.begin()->second;
+		this->timers.erase(this->timers.begin());
+		timer->started = false;
+		std::function<void (ITimer* triggeringTimer)> callBackFunction = timer->callBackFunction;
+		lock.unlock();	/* The callback may restart or stop this timer, or others */
+		callBackFunction(timer);
+		lock.lock();
+	}
+}
+
+void CppThreadsEventLoop::wake() {
+	{
+		std::lock_guard<std::mutex> lock(this->wakeMutex);
+		this->wakePending = true;
+	}
+	this->wakeCv.notify_one();
+}
+
+void CppThreadsEventLoop::waitForWork() {
+	/* Producers check sleeping after queuing: either they see it set and wake us, or we see their task below */
+	this->sleeping.store(true);
+	if (this->taskHead.load() != this->taskTail || this->stopRequested.load()) {
+		this->sleeping.store(false);
+		return;
+	}
+
+	bool hasDeadline;
+	TTimePoint deadline;
+	{
+		std::lock_guard<std::mutex> lock(this->timersMutex);
+		hasDeadline = !this->timers.empty();
+		deadline = hasDeadline ? this->timers.begin()->first : TTimePoint();
+	}
+
+	std::unique_lock<std::mutex> lock(this->wakeMutex);
+	if (hasDeadline) {
+		this->wakeCv.wait_until(lock, deadline, [this]() { return this->wakePending; });
+	}
+	else {
+		this->wakeCv.wait(lock, [this]() { return this->wakePending; });
+	}
+	this->wakePending = false;
+	this->sleeping.store(false);
+}
+
+void CppThreadsEventLoop::scheduleTimer(CTimer* timer, const TTimePoint& deadline) {
+	bool earliest;
+	{
+		std::lock_guard<std::mutex> lock(this->timersMutex);
+		timer->position = this->timers.emplace(deadline, timer);
+		timer->started = true;
+		earliest = (this->timers.begin() == timer->position);
+	}
+	/* The loop may be sleeping until a later deadline */
+	if (earliest && !this->isInExecutorThread()) {
+		this->wake();
+	}
+}
+
+bool CppThreadsEventLoop::cancelTimer(CTimer* timer) {
+	std::lock_guard<std::mutex> lock(this->timersMutex);
+	if (!timer->started) {
+		return false;
+	}
+	this->timers.erase(timer->position);
+	timer->started = false;
+	return true;
+}
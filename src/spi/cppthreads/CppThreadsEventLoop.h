@@ -0,0 +1,115 @@
+/**
+ * @file CppThreadsEventLoop.h
+ *
+ * @brief Concrete implementation of IExecutor using C++11 threads, also providing timers run by the same thread
+ */
+
+#pragma once
+
+#include "../IExecutor.h"
+#include "../ITimerFactory.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Event loop running posted tasks and expired timers on a single thread
+ *
+ * This is the portable counterpart of RaritanEventLoop: when the dongle (and the objects built on it) is created with
+ * this loop as timer factory and executor (see CEzspDongle::setExecutor()), all its activity (bytes received, timers,
+ * commands posted by the application) runs on the loop thread, one task at a time, without locking.
+ *
+ * Tasks are queued in a lock-free multiple producer, single consumer queue: posting never blocks on the loop. The
+ * loop only takes a mutex to go to sleep when it has nothing to do, and producers only take it to wake it up.
+ */
+class CppThreadsEventLoop : public IExecutor, public ITimerFactory {
+public:
+	/**
+	 * @brief Default constructor
+	 *
+	 * The loop is not running, see run() and start()
+	 */
+	CppThreadsEventLoop();
+
+	/**
+	 * @brief Destructor
+	 *
+	 * Stops the loop, tasks still queued are dropped without being run
+	 */
+	~CppThreadsEventLoop();
+
+	CppThreadsEventLoop(const CppThreadsEventLoop& other) = delete; /* No copy construction allowed */
+
+	CppThreadsEventLoop& operator=(const CppThreadsEventLoop& other) = delete; /* No assignment allowed */
+
+	/**
+	 * @brief Run the loop on the calling thread, until stop() is invoked
+	 */
+	void run();
+
+	/**
+	 * @brief Run the loop on a new thread, until stop() is invoked
+	 */
+	void start();
+
+	/**
+	 * @brief Make the loop return after the task or timer callback being run, if any
+	 *
+	 * If the loop runs on the thread created by start(), wait for its termination (unless invoked from the loop itself)
+	 */
+	void stop();
+
+	void post(std::function<void ()> task);
+
+	bool isInExecutorThread() const;
+
+	/**
+	 * @brief Create a new timer, its callback will be run on the loop thread
+	 *
+	 * @return The new timer created
+	 */
+	std::unique_ptr<ITimer> create() const;
+
+private:
+	class CTimer;
+	friend class CTimer;
+
+	/**
+	 * @brief Queued task, also used as the queue sentinel
+	 */
+	struct STaskNode {
+		STaskNode() : next(nullptr), task() { }
+		STaskNode(const STaskNode& other) = delete; /* No copy construction allowed */
+		STaskNode& operator=(const STaskNode& other) = delete; /* No assignment allowed */
+
+		std::atomic<STaskNode*> next;	/*!< Next task, in posting order */
+		std::function<void ()> task;	/*!< The task to run */
+	};
+
+	typedef std::chrono::steady_clock::time_point TTimePoint;
+
+	bool runNextTask();
+	void runExpiredTimers();
+	void wake();
+	void waitForWork();
+
+	/* Timer management, invoked by CTimer from any thread */
+	void scheduleTimer(CTimer* timer, const TTimePoint& deadline);
+	bool cancelTimer(CTimer* timer);
+
+	std::atomic<STaskNode*> taskHead;	/*!< Last task posted, producers append after it */
+	STaskNode* taskTail;	/*!< Sentinel whose next is the oldest task, only used by the loop */
+	std::atomic<bool> sleeping;	/*!< The loop may be waiting on wakeCv, producers must wake it */
+	std::atomic<bool> stopRequested;	/*!< stop() was invoked */
+	std::atomic<std::thread::id> loopThreadId;	/*!< Thread running the loop, default id if not running */
+	std::thread loopThread;	/*!< Thread created by start() */
+	std::mutex wakeMutex;	/*!< Protects wakePending, used with wakeCv */
+	std::condition_variable wakeCv;	/*!< Signalled to wake up the loop */
+	bool wakePending;	/*!< The loop was woken up and must check for work before sleeping again */
+	mutable std::mutex timersMutex;	/*!< Protects timers, which can be started and stopped from any thread */
+	std::multimap<TTimePoint, CTimer*> timers;	/*!< Running timers, by deadline */
+};
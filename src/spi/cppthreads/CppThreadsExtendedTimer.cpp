@@ -0,0 +1,133 @@
+/**
+ * @file CppThreadsExtendedTimer.cpp
+ *
+ * @brief Concrete implementation of IExtendedTimer using C++11 threads
+ */
+
+#include "CppThreadsExtendedTimer.h"
+
+#include <chrono>
+
+/**
+ * @brief State of a timer, shared with its waiting thread
+ */
+struct CppThreadsExtendedTimer::SState {
+	SState() : mutex(), cv(), callBackFunction(), deadline(), period(0), generation(0), started(false), threadRunning(false), lateness(0) { }
+
+	std::mutex mutex;	/*!< Protects the attributes below */
+	std::condition_variable cv;	/*!< Signalled when the timer is restarted or stopped */
+	TCallback callBackFunction;	/*!< The function to call at expiration */
+	std::chrono::steady_clock::time_point deadline;	/*!< The time of the next expiration */
+	TDuration period;	/*!< The period of a periodic timer, 0 for a one-shot timer */
+	uint64_t generation;	/*!< Incremented on each start() and stop(), to interrupt the wait of the waiting thread */
+	bool started;	/*!< Is the timer currently running */
+	bool threadRunning;	/*!< Is the waiting thread running (it terminates once the timer is not running anymore) */
+	TDuration lateness;	/*!< The lateness of the last expiration */
+};
+
+CppThreadsExtendedTimer::CppThreadsExtendedTimer() : state(std::make_shared<SState>()), waitingThread() { }
+
+CppThreadsExtendedTimer::~CppThreadsExtendedTimer() {
+	this->stop();
+	if (this->waitingThread.joinable()) {
+		if (this->waitingThread.get_id() == std::this_thread::get_id()) {
+			this->waitingThread.detach();	/* Destroyed from our own callback, the thread terminates right after it */
+		}
+		else {
+			this->waitingThread.join();
+		}
+	}
+}
+
+bool CppThreadsExtendedTimer::start(TDuration timeout, TCallback callBackFunction) {
+	return this->arm(timeout, TDuration::zero(), callBackFunction);
+}
+
+bool CppThreadsExtendedTimer::startPeriodic(TDuration period, TCallback callBackFunction) {
+	if (period <= TDuration::zero()) {
+		return false;
+	}
+	return this->arm(period, period, callBackFunction);
+}
+
+bool CppThreadsExtendedTimer::stop() {
+	{
+		std::lock_guard<std::mutex> lock(this->state->mutex);
+		if (!this->state->started) {
+			return false;
+		}
+		this->state->started = false;
+		this->state->generation++;
+	}
+	this->state->cv.notify_one();
+	return true;
+}
+
+bool CppThreadsExtendedTimer::isRunning() {
+	std::lock_guard<std::mutex> lock(this->state->mutex);
+	return this->state->started;
+}
+
+IExtendedTimer::TDuration CppThreadsExtendedTimer::getLateness() const {
+	std::lock_guard<std::mutex> lock(this->state->mutex);
+	return this->state->lateness;
+}
+
+bool CppThreadsExtendedTimer::arm(TDuration timeout, TDuration period, TCallback callBackFunction) {
+	if (!callBackFunction) {
+		return false;
+	}
+
+	if (timeout <= TDuration::zero()) {
+		this->stop();
+		{
+			std::lock_guard<std::mutex> lock(this->state->mutex);
+			this->state->lateness = TDuration::zero();
+		}
+		callBackFunction(this);
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->state->mutex);
+		this->state->callBackFunction = callBackFunction;
+		this->state->deadline = std::chrono::steady_clock::now() + timeout;
+		this->state->period = period;
+		this->state->started = true;
+		this->state->generation++;
+		if (!this->state->threadRunning) {
+			/* The previous waiting thread, if any, has left its loop and is terminating */
+			if (this->waitingThread.joinable()) {
+				this->waitingThread.join();
+			}
+			this->state->threadRunning = true;
+			this->waitingThread = std::thread(&CppThreadsExtendedTimer::run, this->state, this);
+		}
+	}
+	this->state->cv.notify_one();	/* Restarted while waiting: wait for the new deadline */
+	return true;
+}
+
+void CppThreadsExtendedTimer::run(std::shared_ptr<SState> state, IExtendedTimer* owner) {
+	std::unique_lock<std::mutex> lock(state->mutex);
+
+	while (state->started) {
+		uint64_t generation = state->generation;
+		if (state->cv.wait_until(lock, state->deadline, [&state, generation]() { return state->generation != generation; })) {
+			continue;	/* Restarted or stopped */
+		}
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		state->lateness = std::chrono::duration_cast<TDuration>(now - state->deadline);
+		TCallback callback = state->callBackFunction;	/* Copied, as the callback may restart the timer with another one */
+		if (state->period > TDuration::zero()) {
+			/* Next period, skipping the ones already missed */
+			state->deadline += state->period * ((now - state->deadline) / state->period + 1);
+		}
+		else {
+			state->started = false;
+		}
+		lock.unlock();	/* The callback may restart, stop or destroy this timer */
+		callback(owner);
+		lock.lock();
+	}
+	state->threadRunning = false;
+}
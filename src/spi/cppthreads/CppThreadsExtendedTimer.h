@@ -0,0 +1,107 @@
+/**
+ * @file CppThreadsExtendedTimer.h
+ *
+ * @brief Concrete implementation of IExtendedTimer using C++11 threads
+ */
+
+#pragma once
+
+#include "../IExtendedTimer.h"
+
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+/**
+ * @brief Concrete implementation of IExtendedTimer using C++11 threads
+ *
+ * As CppThreadsTimer, the callback is run by a waiting thread, but this thread waits on std::chrono::steady_clock deadlines
+ * with microsecond resolution, runs all the expirations of a periodic timer, and is kept when the timer is restarted from
+ * its own callback or while its callback is running, instead of being replaced.
+ */
+class CppThreadsExtendedTimer : public IExtendedTimer {
+public:
+	/**
+	 * @brief Default constructor
+	 */
+	CppThreadsExtendedTimer();
+
+	/**
+	 * @brief Destructor
+	 */
+	~CppThreadsExtendedTimer();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	CppThreadsExtendedTimer(const CppThreadsExtendedTimer& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	CppThreadsExtendedTimer& operator=(const CppThreadsExtendedTimer& other) = delete;
+
+	/**
+	 * @brief Start a timer, run a callback once after expiration of the configured time
+	 *
+	 * @param timeout The timeout
+	 * @param callBackFunction The function to call at expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 */
+	bool start(TDuration timeout, TCallback callBackFunction);
+
+	/**
+	 * @brief Start a timer, run a callback at the end of each period, until the timer is stopped
+	 *
+	 * @param period The period (must not be 0)
+	 * @param callBackFunction The function to call at each expiration of the timer, where argument will be a pointer to this timer object that invoked the callback
+	 */
+	bool startPeriodic(TDuration period, TCallback callBackFunction);
+
+	/**
+	 * @brief Stop and reset the timer
+	 *
+	 * @return true if we actually could stop a running timer
+	 */
+	bool stop();
+
+	/**
+	 * @brief Is the timer currently running?
+	 *
+	 * @return true if the timer is running
+	 */
+	bool isRunning();
+
+	/**
+	 * @brief Get the lateness of the last expiration
+	 */
+	TDuration getLateness() const;
+
+private:
+	struct SState;
+
+	/**
+	 * @brief Start the timer in one-shot or periodic mode
+	 *
+	 * @param timeout The delay until the first expiration
+	 * @param period The period, 0 for a one-shot timer
+	 * @param callBackFunction The function to call at expiration of the timer
+	 */
+	bool arm(TDuration timeout, TDuration period, TCallback callBackFunction);
+
+	/**
+	 * @brief Body of waitingThread, waiting for the deadlines and running the callbacks until the timer is stopped
+	 *
+	 * @param state The state shared with the timer
+	 * @param owner The timer, passed to the callbacks
+	 */
+	static void run(std::shared_ptr<SState> state, IExtendedTimer* owner);
+
+	std::shared_ptr<SState> state;	/*!< The state shared with waitingThread, that outlives this object if it is destroyed from its own callback */
+	std::thread waitingThread;	/*!< The thread that waits for the deadlines and runs the callback */
+};
@@ -6,18 +6,17 @@
 
 #include "CppThreadsTimer.h"
 
-#include <chrono>
-
-CppThreadsTimer::CppThreadsTimer() :  waitingThread(), cv(), cv_m() { }
+CppThreadsTimer::CppThreadsTimer() :  waitingThread(), cv(), cv_m(), firing(false), armedDeadline(), armedCallback() { }
 
 CppThreadsTimer::~CppThreadsTimer() {
 	this->stop();
+	this->releaseThread();
 }
 
 bool CppThreadsTimer::start(uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction) {
 
-	if (this->started) {
-		return false;
+	if (this->isRunning()) {
+		this->stop();	/* Restart an already running timer (as RaritanTimer does) */
 	}
 
 	if (!callBackFunction) {
@@ -27,35 +26,67 @@ bool CppThreadsTimer::start(uint16_t timeout, std::function<void (ITimer* trigge
 	this->duration = timeout;
 	if (duration == 0) {
 		callBackFunction(this);
+		return true;
 	}
-	else {
-		this->started = true;
-		this->waitingThread = std::thread([=]() {
-			std::unique_lock<std::mutex> lock(this->cv_m);
-			this->cv.wait_for(lock, std::chrono::milliseconds(timeout), [this]{return !this->started;});
-			callBackFunction(this);
-		});
+
+	std::lock_guard<std::mutex> startLock(this->cv_m);
+	this->started = true;
+	this->armedDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	this->armedCallback = callBackFunction;
+	if (this->firing) {
+		/* The waiting thread (possibly ours) waits for this new expiration once its callback has returned: waiting for
+		 * that callback here could deadlock with a caller holding a lock the callback needs */
+		return true;
 	}
+	this->releaseThread();	/* A previous expired timer thread may still be terminating, it does not need cv_m anymore */
+	this->waitingThread = std::thread(&CppThreadsTimer::waitAndRun, this);
 
 	return true;
 }
 
 bool CppThreadsTimer::stop() {
+	bool callbackRunning;
 
-	if (! this->started) {
-		return false;
-	}
-	if (this->started) {
+	{
+		std::lock_guard<std::mutex> lock(this->cv_m);
+		if (! this->started) {
+			return false;
+		}
 		this->started = false;
-		this->cv.notify_one();
+		callbackRunning = this->firing;
 	}
-	if (this->waitingThread.joinable()) {
-		this->waitingThread.join();
+	this->cv.notify_one();
+	if (!callbackRunning) {
+		this->releaseThread();
 	}
+	/* else, the waiting thread terminates once its callback has returned, and is joined later on */
 	this->duration = 0;
 	return true;
 }
 
 bool CppThreadsTimer::isRunning() {
+	std::lock_guard<std::mutex> lock(this->cv_m);
 	return this->started;
 }
+
+void CppThreadsTimer::waitAndRun() {
+	std::unique_lock<std::mutex> lock(this->cv_m);
+	while (this->started) {	/* Loop for as long as the timer is restarted while running its callback */
+		if (this->cv.wait_until(lock, this->armedDeadline, [this]{return !this->started;})) {
+			return;	/* Stopped before expiration, do not invoke the callback */
+		}
+		this->started = false;
+		this->firing = true;
+		std::function<void (ITimer* triggeringTimer)> callBackFunction = std::move(this->armedCallback);
+		lock.unlock();	/* The callback may restart or stop this timer */
+		callBackFunction(this);
+		lock.lock();
+		this->firing = false;
+	}
+}
+
+void CppThreadsTimer::releaseThread() {
+	if (this->waitingThread.joinable() && this->waitingThread.get_id() != std::this_thread::get_id()) {
+		this->waitingThread.join();
+	}
+}
@@ -9,6 +9,7 @@
 #include "../ITimer.h"
 
 #include <thread>
+#include <chrono>
 #include <condition_variable>
 
 /**
@@ -24,12 +25,18 @@ public:
 
 	/**
 	 * @brief Destructor
+	 *
+	 * Waits for the running callback, if any: the timer must not be destroyed from its own callback
 	 */
 	~CppThreadsTimer();
 
 	/**
 	 * @brief Start a timer, run a callback after expiration of the configured time
 	 *
+	 * When the timer is started while running its callback (from that callback or from another thread), the new wait
+	 * takes place in the same thread, once the callback has returned, so that two callbacks of this timer never run
+	 * concurrently. Neither start() nor stop() waits for a running callback.
+	 *
 	 * @param timeout The timeout (in ms)
 	 * @param callBackFunction The function to call at expiration of the timer (should be of type void f(ITimer*)) where argument will be a pointer to this timer object that invoked the callback
 	 */
@@ -50,7 +57,20 @@ public:
 	bool isRunning();
 
 private:
+	/**
+	 * @brief Body of the waiting thread: wait for the armed deadline, then run the armed callback (again if the timer was restarted meanwhile)
+	 */
+	void waitAndRun();
+
+	/**
+	 * @brief Wait for the termination of the waiting thread, if any (unless we are running from it)
+	 */
+	void releaseThread();
+
 	std::thread waitingThread;	/*!< The thread that will wait for the specified timeout and will then run the callback */
 	std::condition_variable cv;	/*!< A condition variable that allows to unlock the wait performed by waitingThread (this allows stopping that secondary thread) */
-	std::mutex cv_m;	/*!< A mutex to handle access to variable cv */
+	std::mutex cv_m;	/*!< A mutex to handle access to variable cv, and to started, firing, armedDeadline and armedCallback */
+	bool firing;	/*!< waitingThread is running a callback */
+	std::chrono::steady_clock::time_point armedDeadline;	/*!< The expiration waited for by waitingThread */
+	std::function<void (ITimer* triggeringTimer)> armedCallback;	/*!< The callback waitingThread will run on expiration */
 };
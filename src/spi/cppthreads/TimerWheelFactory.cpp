@@ -0,0 +1,343 @@
+/**
+ * @file TimerWheelFactory.cpp
+ *
+ * @brief Concrete implementation of ITimerFactory running all its timers on a single thread, using a hierarchical timing wheel
+ */
+
+#include "TimerWheelFactory.h"
+
+#include <limits>
+
+namespace {
+
+const uint64_t NO_TICK = std::numeric_limits<uint64_t>::max();
+
+/**
+ * @brief Number of ticks from @p from to the first set bit of a slot bit map, @p bits not being 0
+ */
+unsigned int ticksToNextSlot(uint64_t bits, unsigned int from) {
+	uint64_t rotated = (from == 0) ? bits : ((bits >> from) | (bits << (TimerWheelFactory::WHEEL_SLOTS - from)));
+	return static_cast<unsigned int>(__builtin_ctzll(rotated));
+}
+
+} // namespace
+
+/**
+ * @brief Wheel entry of a timer
+ *
+ * Shared with the callbacks posted to the executor, so that they can find out the timer was stopped or destroyed meanwhile
+ */
+struct TimerWheelFactory::STimerNode : public TimerWheelFactory::SLink, public std::enable_shared_from_this<STimerNode> {
+	STimerNode(CTimer* timer) : SLink(), timer(timer), callBackFunction(), expiry(0), generation(0), level(-1), slot(0), firing(false), firingThread() { }
+	STimerNode(const STimerNode& other) = delete; /* No copy construction allowed */
+	STimerNode& operator=(const STimerNode& other) = delete; /* No assignment allowed */
+
+	CTimer* timer;	/*!< The timer owning this node, nullptr once destroyed */
+	std::function<void (ITimer* triggeringTimer)> callBackFunction;	/*!< The function to call at expiration */
+	uint64_t expiry;	/*!< Expiration tick */
+	uint64_t generation;	/*!< Incremented on each start and stop, to drop stale expirations */
+	int level;	/*!< The wheel level we are linked in, -1 if in the expired list (or unlinked) */
+	unsigned int slot;	/*!< The slot we are linked in, in level */
+	bool firing;	/*!< The callback is running */
+	std::thread::id firingThread;	/*!< The thread running the callback */
+};
+
+/**
+ * @brief Timer served by a TimerWheelFactory
+ *
+ * Behaves as CppThreadsTimer: starting a running timer restarts it, and a 0 timeout runs the callback at once.
+ */
+class TimerWheelFactory::CTimer : public ITimer {
+public:
+	CTimer(TimerWheelFactory& factory) : factory(factory), node(std::make_shared<STimerNode>(this)) { }
+
+	~CTimer() {
+		this->factory.releaseTimer(this);
+	}
+
+	CTimer(const CTimer& other) = delete; /* No copy construction allowed */
+
+	CTimer& operator=(const CTimer& other) = delete; /* No assignment allowed */
+
+	bool start(uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction) {
+		if (!callBackFunction) {
+			return false;
+		}
+		if (timeout == 0) {
+			this->factory.stopTimer(this);
+			callBackFunction(this);
+		}
+		else {
+			this->factory.startTimer(this, timeout, std::move(callBackFunction));
+		}
+		return true;
+	}
+
+	bool stop() {
+		return this->factory.stopTimer(this);
+	}
+
+	bool isRunning() {
+		return this->factory.isTimerRunning(this);
+	}
+
+private:
+	TimerWheelFactory& factory;	/*!< The factory serving us */
+	std::shared_ptr<STimerNode> node;	/*!< Our wheel entry */
+
+	friend class TimerWheelFactory;
+};
+
+TimerWheelFactory::TimerWheelFactory(IExecutor* executor) :
+	executor(executor),
+	epoch(std::chrono::steady_clock::now()),
+	mutex(),
+	serviceCv(),
+	firedCv(),
+	wheel(),
+	occupiedSlots(),
+	expired(),
+	currentTick(0),
+	wakeTick(NO_TICK),
+	runningCount(0),
+	terminate(false),
+	serviceThread() {
+	this->serviceThread = std::thread(&TimerWheelFactory::serviceLoop, this);
+}
+
+TimerWheelFactory::~TimerWheelFactory() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->terminate = true;
+	}
+	this->serviceCv.notify_one();
+	this->serviceThread.join();
+}
+
+std::unique_ptr<ITimer> TimerWheelFactory::create() const {
+	/* Timers need to update the wheel, create() is only const to satisfy ITimerFactory */
+	return std::unique_ptr<ITimer>(new CTimer(const_cast<TimerWheelFactory&>(*this)));
+}
+
+size_t TimerWheelFactory::getRunningTimersCount() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->runningCount;
+}
+
+void TimerWheelFactory::startTimer(CTimer* timer, uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	STimerNode* node = timer->node.get();
+
+	if (node->isLinked()) {
+		this->unlink(node);	/* Restart an already running timer (as RaritanTimer does) */
+	}
+	if (!timer->started) {
+		timer->started = true;
+		this->runningCount++;
+	}
+	if (this->runningCount == 1) {
+		/* The wheel is empty, skip the ticks elapsed since it was last processed so that the timer lands in the lowest level possible */
+		uint64_t now = this->nowTick();
+		if (now > this->currentTick) {
+			this->currentTick = now;
+		}
+	}
+	timer->duration = timeout;
+	node->generation++;
+	node->callBackFunction = std::move(callBackFunction);
+	/* Round up, so that we never expire before timeout */
+	node->expiry = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->epoch + std::chrono::milliseconds(timeout) + std::chrono::microseconds(999)).count());
+	this->link(node);
+	if (this->nextEventTick() < this->wakeTick) {
+		this->serviceCv.notify_one();
+	}
+}
+
+bool TimerWheelFactory::stopTimer(CTimer* timer) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	STimerNode* node = timer->node.get();
+
+	if (!timer->started) {
+		return false;
+	}
+	if (node->isLinked()) {
+		this->unlink(node);
+	}
+	node->generation++;	/* Drops the callback if it was already posted to the executor */
+	timer->started = false;
+	timer->duration = 0;
+	this->runningCount--;
+	return true;
+}
+
+bool TimerWheelFactory::isTimerRunning(const CTimer* timer) const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return timer->started;
+}
+
+void TimerWheelFactory::releaseTimer(CTimer* timer) {
+	std::unique_lock<std::mutex> lock(this->mutex);
+	STimerNode* node = timer->node.get();
+
+	if (node->isLinked()) {
+		this->unlink(node);
+	}
+	if (timer->started) {
+		this->runningCount--;
+	}
+	node->generation++;
+	node->timer = nullptr;
+	/* Do not destroy the timer under the feet of its callback, unless it is the callback destroying it */
+	this->firedCv.wait(lock, [node]() { return !node->firing || node->firingThread == std::this_thread::get_id(); });
+}
+
+uint64_t TimerWheelFactory::nowTick() const {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->epoch).count());
+}
+
+void TimerWheelFactory::link(STimerNode* node) {
+	uint64_t expiry = (node->expiry > this->currentTick) ? node->expiry : this->currentTick;
+	uint64_t delta = expiry - this->currentTick;
+	unsigned int level = 0;
+
+	while (level < WHEEL_LEVELS - 1 && delta >= (static_cast<uint64_t>(1) << (WHEEL_SLOT_BITS * (level + 1)))) {
+		level++;
+	}
+	if (delta >= (static_cast<uint64_t>(1) << (WHEEL_SLOT_BITS * WHEEL_LEVELS))) {
+		/* Beyond the wheel range: parked in the last slot reachable, and linked again from there when cascaded */
+		expiry = this->currentTick + (static_cast<uint64_t>(1) << (WHEEL_SLOT_BITS * WHEEL_LEVELS)) - 1;
+	}
+	unsigned int slot = static_cast<unsigned int>((expiry >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1));
+	SLink& head = this->wheel[level][slot];
+
+	node->prev = head.prev;
+	node->next = &head;
+	head.prev->next = node;
+	head.prev = node;
+	node->level = static_cast<int>(level);
+	node->slot = slot;
+	this->occupiedSlots[level] |= static_cast<uint64_t>(1) << slot;
+}
+
+void TimerWheelFactory::unlink(STimerNode* node) {
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = node;
+	node->next = node;
+	if (node->level >= 0 && !this->wheel[node->level][node->slot].isLinked()) {
+		this->occupiedSlots[node->level] &= ~(static_cast<uint64_t>(1) << node->slot);
+	}
+	node->level = -1;
+}
+
+void TimerWheelFactory::cascade(unsigned int level, unsigned int slot) {
+	SLink& head = this->wheel[level][slot];
+
+	while (head.isLinked()) {
+		STimerNode* node = static_cast<STimerNode*>(head.next);
+		this->unlink(node);
+		this->link(node);	/* Lands in a lower level, currentTick having moved to the start of this slot */
+	}
+}
+
+void TimerWheelFactory::processTick() {
+	unsigned int slot = static_cast<unsigned int>(this->currentTick & (WHEEL_SLOTS - 1));
+
+	if (slot == 0) {
+		/* The lowest level completed a turn: move down the timers of the next slot of the upper level, and so on */
+		for (unsigned int level = 1; level < WHEEL_LEVELS; level++) {
+			unsigned int upperSlot = static_cast<unsigned int>((this->currentTick >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1));
+			this->cascade(level, upperSlot);
+			if (upperSlot != 0) {
+				break;
+			}
+		}
+	}
+	SLink& head = this->wheel[0][slot];
+	while (head.isLinked()) {
+		STimerNode* node = static_cast<STimerNode*>(head.next);
+		this->unlink(node);
+		node->prev = this->expired.prev;
+		node->next = &this->expired;
+		this->expired.prev->next = node;
+		this->expired.prev = node;
+	}
+	this->currentTick++;
+}
+
+uint64_t TimerWheelFactory::nextEventTick() const {
+	unsigned int slot = static_cast<unsigned int>(this->currentTick & (WHEEL_SLOTS - 1));
+	uint64_t next = NO_TICK;
+
+	if (this->occupiedSlots[0] != 0) {
+		next = this->currentTick + ticksToNextSlot(this->occupiedSlots[0], slot);
+	}
+	for (unsigned int level = 1; level < WHEEL_LEVELS; level++) {
+		if (this->occupiedSlots[level] != 0) {
+			/* Upper levels only need processing when the lowest level completes a turn */
+			uint64_t turn = (slot == 0) ? this->currentTick : this->currentTick + (WHEEL_SLOTS - slot);
+			return (turn < next) ? turn : next;
+		}
+	}
+	return next;
+}
+
+void TimerWheelFactory::fire(const std::shared_ptr<STimerNode>& node, uint64_t generation, std::unique_lock<std::mutex>& lock) {
+	if (node->timer == nullptr || node->generation != generation) {
+		return;	/* Stopped, restarted or destroyed since it expired */
+	}
+	CTimer* timer = node->timer;
+	std::function<void (ITimer* triggeringTimer)> callBackFunction;
+
+	callBackFunction.swap(node->callBackFunction);	/* The callback may restart the timer with another one */
+	timer->started = false;
+	this->runningCount--;
+	node->firing = true;
+	node->firingThread = std::this_thread::get_id();
+	lock.unlock();
+	callBackFunction(timer);
+	lock.lock();
+	node->firing = false;
+	this->firedCv.notify_all();
+}
+
+void TimerWheelFactory::serviceLoop() {
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (!this->terminate) {
+		uint64_t now = this->nowTick();
+		uint64_t next;
+		/* Only process the ticks with an occupied slot or a cascade, skip the other ones */
+		while ((next = this->nextEventTick()) <= now) {
+			this->currentTick = next;
+			this->processTick();
+		}
+		if (this->currentTick <= now) {
+			this->currentTick = now + 1;
+		}
+		while (this->expired.isLinked()) {
+			std::shared_ptr<STimerNode> node = static_cast<STimerNode*>(this->expired.next)->shared_from_this();
+			this->unlink(node.get());
+			if (this->executor != nullptr) {
+				uint64_t generation = node->generation;
+				lock.unlock();
+				this->executor->post([this, node, generation]() {
+					std::unique_lock<std::mutex> taskLock(this->mutex);
+					this->fire(node, generation, taskLock);
+				});
+				lock.lock();
+			}
+			else {
+				this->fire(node, node->generation, lock);
+			}
+		}
+		this->wakeTick = this->nextEventTick();
+		if (this->wakeTick == NO_TICK) {
+			this->serviceCv.wait(lock);
+		}
+		else if (this->wakeTick > this->nowTick()) {
+			this->serviceCv.wait_until(lock, this->epoch + std::chrono::milliseconds(this->wakeTick));
+		}
+		this->wakeTick = 0;	/* Awake, no need to be notified */
+	}
+}
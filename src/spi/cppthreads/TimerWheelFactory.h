@@ -0,0 +1,127 @@
+/**
+ * @file TimerWheelFactory.h
+ *
+ * @brief Concrete implementation of ITimerFactory running all its timers on a single thread, using a hierarchical timing wheel
+ */
+
+#pragma once
+
+#include "../ITimerFactory.h"
+#include "../IExecutor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+
+/**
+ * @brief Factory of timers all served by one thread, instead of a thread per timer (see CppThreadsTimer)
+ *
+ * Running timers are kept in a hierarchical timing wheel with a 1ms tick: 4 levels of 64 slots, each slot of a level
+ * covering a whole turn of the level below, so that 2^24ms (more than 4 hours) are covered without any sorting. Timers
+ * are linked in their slot through a node they own, so that starting, restarting and stopping a timer is O(1) and does
+ * not allocate memory (provided its callback fits in std::function small object storage, as a lambda capturing a
+ * pointer does). Timers in higher levels are moved down ("cascaded") when the lower level completes a turn.
+ *
+ * The service thread sleeps until the next occupied slot or cascade, and never later than the timer expiration. Expired
+ * callbacks are run on the service thread, or posted to an executor (see IExecutor), so that they run on the thread of the
+ * objects owning the timers. Stopping a timer never waits: a callback already posted but not run yet is dropped.
+ *
+ * The factory must outlive the timers it created. With an executor, callbacks posted but not run yet refer to the factory:
+ * the executor must be stopped before the factory is destroyed.
+ */
+class TimerWheelFactory : public ITimerFactory {
+public:
+	/**
+	 * @brief Constructor, starts the service thread
+	 *
+	 * @param executor The executor running the timer callbacks, nullptr to run them on the service thread
+	 */
+	TimerWheelFactory(IExecutor* executor = nullptr);
+
+	/**
+	 * @brief Destructor, stops the service thread
+	 */
+	~TimerWheelFactory();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	TimerWheelFactory(const TimerWheelFactory& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	TimerWheelFactory& operator=(const TimerWheelFactory& other) = delete;
+
+	/**
+	 * @brief Create a new timer, served by this factory
+	 *
+	 * @return The new timer created
+	 */
+	std::unique_ptr<ITimer> create() const;
+
+	/**
+	 * @brief Get the number of timers currently running
+	 */
+	size_t getRunningTimersCount() const;
+
+	static const unsigned int WHEEL_LEVELS = 4;	/*!< Number of levels of the wheel */
+	static const unsigned int WHEEL_SLOT_BITS = 6;	/*!< Number of bits of the tick indexing each level */
+	static const unsigned int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;	/*!< Number of slots in each level */
+
+private:
+	class CTimer;
+	struct STimerNode;
+	friend class CTimer;
+
+	/**
+	 * @brief Link of a circular doubly-linked list, unlinked when pointing to itself
+	 */
+	struct SLink {
+		SLink() : prev(this), next(this) { }
+		SLink(const SLink& other) = delete; /* No copy construction allowed */
+		SLink& operator=(const SLink& other) = delete; /* No assignment allowed */
+
+		bool isLinked() const { return this->next != this; }
+
+		SLink* prev;	/*!< Previous link, or the list head */
+		SLink* next;	/*!< Next link, or the list head */
+	};
+
+	/* Timer management, invoked by CTimer from any thread */
+	void startTimer(CTimer* timer, uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction);
+	bool stopTimer(CTimer* timer);
+	bool isTimerRunning(const CTimer* timer) const;
+	void releaseTimer(CTimer* timer);
+
+	/* Wheel management, invoked with mutex held */
+	uint64_t nowTick() const;
+	void link(STimerNode* node);
+	void unlink(STimerNode* node);
+	void cascade(unsigned int level, unsigned int slot);
+	void processTick();
+	uint64_t nextEventTick() const;
+	void fire(const std::shared_ptr<STimerNode>& node, uint64_t generation, std::unique_lock<std::mutex>& lock);
+	void serviceLoop();
+
+	IExecutor* executor;	/*!< Runs the callbacks, nullptr to run them on serviceThread */
+	std::chrono::steady_clock::time_point epoch;	/*!< Time of tick 0 */
+	mutable std::mutex mutex;	/*!< Protects the attributes below and the timer nodes */
+	std::condition_variable serviceCv;	/*!< Signalled to wake up serviceThread */
+	std::condition_variable firedCv;	/*!< Signalled when a callback returns */
+	SLink wheel[WHEEL_LEVELS][WHEEL_SLOTS];	/*!< Running timers, by expiration tick */
+	uint64_t occupiedSlots[WHEEL_LEVELS];	/*!< Bit map of the non-empty slots of each level */
+	SLink expired;	/*!< Expired timers, whose callback is to be run */
+	uint64_t currentTick;	/*!< Next tick to process */
+	uint64_t wakeTick;	/*!< Tick serviceThread sleeps until */
+	size_t runningCount;	/*!< Number of running timers */
+	bool terminate;	/*!< Request serviceThread to terminate */
+	std::thread serviceThread;	/*!< Processes the wheel, and runs the callbacks if there is no executor */
+};
@@ -16,17 +16,23 @@ MockUartScheduledByteDelivery::MockUartScheduledByteDelivery(const std::vector<u
 delay(scheduleDelay),
 byteBuffer(scheduledBuffer) { }
 
-MockUartDriver::MockUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback) :
+MockUartDriver::MockUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback, VirtualClock* virtualClock) :
+	virtualClock(virtualClock),
+	virtualDeliveries(),
+	lastVirtualDeliveryTime(),
 	readBytesThread(),
 	scheduledReadQueueMutex(),
 	scheduledReadQueue(),
 	writeMutex(),
 	dataInputObservable(nullptr),
 	onWriteCallback(onWriteCallback),
-	lastWrittenBytesTimestamp(std::chrono::time_point<std::chrono::high_resolution_clock>::min()),
+	lastWrittenBytesTimestamp(std::chrono::steady_clock::time_point::min()),
 	scheduledReadBytesCount(0),
 	deliveredReadBytesCount(0),
-	writtenBytesCount(0) { }
+	writtenBytesCount(0),
+	writeCallsCount(0),
+	writtenBuffersCount(0),
+	writevBuffer() { }
 
 MockUartDriver::~MockUartDriver() {
 	this->destroyAllScheduledIncomingChunks();
@@ -40,6 +46,10 @@ GenericAsyncDataInputObservable* MockUartDriver::getIncomingDataHandler() const
 	return this->dataInputObservable;
 }
 
+VirtualClock* MockUartDriver::getVirtualClock() const {
+	return this->virtualClock;
+}
+
 int MockUartDriver::open(const std::string& serialPortName, unsigned int baudRate) {
 	return 0;
 }
@@ -47,11 +57,11 @@ int MockUartDriver::open(const std::string& serialPortName, unsigned int baudRat
 int MockUartDriver::write(size_t& writtenCnt, const void* buf, size_t cnt) {
 	
 	std::lock_guard<std::recursive_mutex> lock(writeMutex);	/* Make sure there is only one simultaneous executiong of method write() */
-	std::chrono::time_point<std::chrono::high_resolution_clock> now =  std::chrono::high_resolution_clock::now();
+	std::chrono::steady_clock::time_point now = (this->virtualClock != nullptr) ? this->virtualClock->now() : std::chrono::steady_clock::now();
 	int result = 0;
 	if (this->onWriteCallback != nullptr) {
 		std::chrono::duration<double, std::milli> delta;
-		if (this->lastWrittenBytesTimestamp == std::chrono::time_point<std::chrono::high_resolution_clock>::min())	{ /* If we don't have any previous timestamp (these are the first bytes ever written)... */
+		if (this->lastWrittenBytesTimestamp == std::chrono::steady_clock::time_point::min())	{ /* If we don't have any previous timestamp (these are the first bytes ever written)... */
 			delta = std::chrono::duration<double, std::milli>::max();	/* ... set duration to maximum */
 		}
 		else {
@@ -63,12 +73,37 @@ int MockUartDriver::write(size_t& writtenCnt, const void* buf, size_t cnt) {
 		writtenCnt = 0;
 	}
 	this->writtenBytesCount += writtenCnt;
+	this->writeCallsCount++;
+	this->writtenBuffersCount++;
 	this->lastWrittenBytesTimestamp = now;
 	return result;
 }
 
+int MockUartDriver::writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt) {
+
+	std::lock_guard<std::recursive_mutex> lock(writeMutex);
+	this->writevBuffer.clear();
+	for (size_t loop = 0; loop < iovcnt; loop++) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(iov[loop].buf);
+		this->writevBuffer.insert(this->writevBuffer.end(), bytes, bytes + iov[loop].cnt);
+	}
+	int result = this->write(writtenCnt, this->writevBuffer.data(), this->writevBuffer.size());	/* Counted as a single buffer... */
+	this->writtenBuffersCount += iovcnt - 1;	/* ... fixed here */
+	return result;
+}
+
 void MockUartDriver::scheduleIncomingChunk(const MockUartScheduledByteDelivery& scheduledBytes) {
 	
+	if (this->virtualClock != nullptr) {
+		/* Same delays as with readBytesThread, but chained on simulated time: relative to now if the queue is empty, to the previous chunk otherwise */
+		std::lock_guard<std::mutex> lock(this->scheduledReadQueueMutex);
+		VirtualClock::TTimePoint base = this->scheduledReadQueue.empty() ? this->virtualClock->now() : this->lastVirtualDeliveryTime;
+		this->lastVirtualDeliveryTime = base + scheduledBytes.delay;
+		this->scheduledReadQueue.push(scheduledBytes);
+		this->scheduledReadBytesCount += scheduledBytes.byteBuffer.size();
+		this->virtualDeliveries.push(this->virtualClock->scheduleAt(this->lastVirtualDeliveryTime, [this]() { this->deliverNextVirtualChunk(); }));
+		return;
+	}
 	bool frontSchedule;	/*!< Was the queued chunk list empty before scheduling these new scheduledBytes? If so, we need to start a new thread. */
 	{
 		std::lock_guard<std::mutex> lock(this->scheduledReadQueueMutex);
@@ -109,6 +144,25 @@ void MockUartDriver::scheduleIncomingChunk(const MockUartScheduledByteDelivery&
 	}
 }
 
+void MockUartDriver::deliverNextVirtualChunk() {
+	struct MockUartScheduledByteDelivery nextChunk;
+	{
+		std::lock_guard<std::mutex> lock(this->scheduledReadQueueMutex);
+		if (this->scheduledReadQueue.empty()) {
+			return;
+		}
+		/* Deliveries are scheduled in queue order with non-decreasing deadlines, so we are the event of the front chunk */
+		nextChunk = this->scheduledReadQueue.front();
+		this->scheduledReadQueue.pop();
+		this->virtualDeliveries.pop();
+		this->scheduledReadBytesCount -= nextChunk.byteBuffer.size();
+		this->deliveredReadBytesCount += nextChunk.byteBuffer.size();
+	} /* scheduledReadQueueMutex released here */
+	if (this->dataInputObservable != nullptr && !nextChunk.byteBuffer.empty()) {
+		this->dataInputObservable->notifyObservers(nextChunk.byteBuffer.data(), nextChunk.byteBuffer.size());
+	}
+}
+
 std::string MockUartDriver::scheduledIncomingChunksToString() {
 	std::stringstream result;
 	std::queue<struct MockUartScheduledByteDelivery> scheduledReadQueueCopy;
@@ -139,6 +193,10 @@ void MockUartDriver::destroyAllScheduledIncomingChunks() {
 	{
 		std::lock_guard<std::mutex> lock(this->scheduledReadQueueMutex);
 		queueIsEmpty = this->scheduledReadQueue.empty();
+		while (!this->virtualDeliveries.empty()) {
+			this->virtualClock->cancel(this->virtualDeliveries.front());
+			this->virtualDeliveries.pop();
+		}
 		if (!queueIsEmpty) {
 			this->scheduledReadQueue = std::queue<struct MockUartScheduledByteDelivery>();	/* Replace the queue with a brand new (empty) one */
 			this->scheduledReadBytesCount = 0;	/* No more byte queued */
@@ -169,5 +227,15 @@ size_t MockUartDriver::getWrittenBytesCount() {
 	return this->writtenBytesCount;
 }
 
+size_t MockUartDriver::getWriteCallsCount() {
+	std::lock_guard<std::recursive_mutex> lock(writeMutex);
+	return this->writeCallsCount;
+}
+
+size_t MockUartDriver::getWrittenBuffersCount() {
+	std::lock_guard<std::recursive_mutex> lock(writeMutex);
+	return this->writtenBuffersCount;
+}
+
 void MockUartDriver::close() {
 }
@@ -8,6 +8,7 @@
 
 
 #include "../IUartDriver.h"
+#include "../virtual-clock/VirtualClock.h"
 #include <vector>
 #include <queue>
 #include <mutex>
@@ -43,8 +44,10 @@ public:
 	 *        size_t cnt: the number of bytes to write
 	 *        std::chrono::duration<double, std::milli> delta: the elapsed time since last bytes were written (in ms)
 	 *        This callback should return 0 on success, errno on failure
+	 * @param virtualClock The simulated clock to deliver scheduled incoming chunks on, instead of a real-time thread (see VirtualClock).
+	 *        Chunks are then delivered on the thread advancing the clock, and write delays are measured on simulated time.
 	 */
-	MockUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback = nullptr);
+	MockUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback = nullptr, VirtualClock* virtualClock = nullptr);
 
 	/**
 	 * @brief Destructor
@@ -79,6 +82,13 @@ public:
 	 */
 	GenericAsyncDataInputObservable* getIncomingDataHandler() const;
 
+	/**
+	 * @brief Get the simulated clock given at construction
+	 *
+	 * @return The simulated clock, or nullptr if this emulated UART runs on real time
+	 */
+	VirtualClock* getVirtualClock() const;
+
 	/**
 	 * @brief Opens the serial port
 	 *
@@ -102,6 +112,17 @@ public:
 	 */
 	int write(size_t& writtenCnt, const void* buf, size_t cnt);
 
+	/**
+	 * @brief Write several byte sequences to the serial port, given at once to the onWriteCallback function
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written, in total
+	 * @param[in] iov The buffers to write
+	 * @param[in] iovcnt The number of buffers in iov
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt);
+
 	/**
 	 * @brief Schedule a byte sequence to be ready for read on emulated serial port
 	 *
@@ -155,12 +176,29 @@ public:
 	 */
 	size_t getWrittenBytesCount();
 
+	/**
+	 * @brief Get the number of write() and writev() invocations so far (as many system calls on a real UART)
+	 */
+	size_t getWriteCallsCount();
+
+	/**
+	 * @brief Get the number of buffers written so far (one per write(), iovcnt per writev())
+	 *
+	 * @note The difference with getWriteCallsCount() is the number of system calls saved by vectored writes
+	 */
+	size_t getWrittenBuffersCount();
+
 	/**
 	 * @brief Close the serial port
 	 */
 	void close();
 
 private:
+	void deliverNextVirtualChunk();
+
+	VirtualClock* virtualClock;	/*!< The simulated clock chunks are delivered on, nullptr to use readBytesThread */
+	std::queue<VirtualClock::TEventId> virtualDeliveries;	/*!< Delivery events of the chunks in scheduledReadQueue, in virtual clock mode. Grab scheduledReadQueueMutex before accessing this */
+	VirtualClock::TTimePoint lastVirtualDeliveryTime;	/*!< Delivery time of the last chunk in scheduledReadQueue, in virtual clock mode. Grab scheduledReadQueueMutex before accessing this */
 	std::thread readBytesThread;	/*!< The thread that will generate emulated read bytes prepared in scheduledReadQueue */
 	std::mutex scheduledReadQueueMutex;	/*!< A mutex to handle access to scheduledReadQueue, scheduledReadBytesCount or deliveredReadBytesCount */
 	std::queue<struct MockUartScheduledByteDelivery> scheduledReadQueue;	/*!< The scheduled read bytes queue. Grab scheduledReadQueueMutex before accessing this */
@@ -169,8 +207,11 @@ public:
 private:
 	GenericAsyncDataInputObservable *dataInputObservable;		/*!< The observable that will notify observers when new bytes are available on the UART */
 	std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback;	/*!< Callback invoked each time bytes are written to the emulated UART, this callback must have a prototype that takes 3 parameters: size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta. delta being the time since last bytes were written (in ms) */
-	std::chrono::time_point<std::chrono::high_resolution_clock> lastWrittenBytesTimestamp;	/*!< A timestamp of the last bytes written */
+	std::chrono::steady_clock::time_point lastWrittenBytesTimestamp;	/*!< A timestamp of the last bytes written */
 	size_t scheduledReadBytesCount;	/*!< The current size of the scheduled read bytes queue. Grab scheduledReadQueueMutex before accessing this  */
 	size_t deliveredReadBytesCount;	/*!< The cumulative number of emulated read bytes delivered to the GenericAsyncDataInputObservable observer since the instanciation of this object. Grab scheduledReadQueueMutex before accessing this */
 	size_t writtenBytesCount;	/*!< The number of bytes written, as a total sum of the onWriteCallback function's successive writtenCnt returned values */
+	size_t writeCallsCount;	/*!< The number of write() and writev() invocations */
+	size_t writtenBuffersCount;	/*!< The number of buffers written by write() and writev() */
+	std::vector<unsigned char> writevBuffer;	/*!< Buffers of a writev() gathered for the onWriteCallback function */
 };
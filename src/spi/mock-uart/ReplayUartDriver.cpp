@@ -0,0 +1,106 @@
+/**
+ * @file ReplayUartDriver.cpp
+ *
+ * @brief Simulated UART driver feeding back the bytes received in a UART trace, for repeatable load tests and benchmarks
+ */
+
+#include "ReplayUartDriver.h"
+
+ReplayUartDriver::ReplayUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback) :
+	MockUartDriver(onWriteCallback),
+	reader(),
+	replayMutex(),
+	replayCv(),
+	replayRunning(false),
+	replayStopped(false),
+	replayedChunksCount(0),
+	replayedBytesCount(0),
+	replayThread() { }
+
+ReplayUartDriver::~ReplayUartDriver() {
+	this->stopReplay();
+}
+
+int ReplayUartDriver::replay(const std::string& tracePath, double speed) {
+	this->stopReplay();
+	int result = this->reader.open(tracePath);
+	if (result != 0) {
+		return result;
+	}
+	std::lock_guard<std::mutex> lock(this->replayMutex);
+	this->replayRunning = true;
+	this->replayStopped = false;
+	this->replayedChunksCount = 0;
+	this->replayedBytesCount = 0;
+	this->replayThread = std::thread(&ReplayUartDriver::replayLoop, this, speed);
+	return 0;
+}
+
+bool ReplayUartDriver::waitReplayed(const std::chrono::milliseconds& timeout) {
+	std::unique_lock<std::mutex> lock(this->replayMutex);
+	return this->replayCv.wait_for(lock, timeout, [this]() { return !this->replayRunning; });
+}
+
+void ReplayUartDriver::stopReplay() {
+	{
+		std::lock_guard<std::mutex> lock(this->replayMutex);
+		this->replayStopped = true;
+	}
+	this->replayCv.notify_all();
+	if (this->replayThread.joinable()) {
+		this->replayThread.join();
+	}
+	this->reader.close();
+}
+
+size_t ReplayUartDriver::getReplayedChunksCount() {
+	std::lock_guard<std::mutex> lock(this->replayMutex);
+	return this->replayedChunksCount;
+}
+
+size_t ReplayUartDriver::getReplayedBytesCount() {
+	std::lock_guard<std::mutex> lock(this->replayMutex);
+	return this->replayedBytesCount;
+}
+
+void ReplayUartDriver::replayLoop(double speed) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool firstChunk = true;
+	uint64_t firstTimestampNs = 0;
+	UartTraceRecord record;
+	std::unique_lock<std::mutex> lock(this->replayMutex);
+
+	while (!this->replayStopped) {
+		lock.unlock();
+		bool hasRecord = this->reader.next(record);
+		lock.lock();
+		if (!hasRecord) {
+			break;
+		}
+		if (record.direction != UART_TRACE_RX) {
+			continue;
+		}
+		if (firstChunk) {
+			firstTimestampNs = record.timestampNs;
+			firstChunk = false;
+		}
+		if (speed > 0) {
+			/* Deadlines are computed from the replay start, so that delivery delays do not add up */
+			std::chrono::nanoseconds offset(static_cast<int64_t>((record.timestampNs - firstTimestampNs) / speed));
+			std::chrono::steady_clock::time_point deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+			if (this->replayCv.wait_until(lock, deadline, [this]() { return this->replayStopped; })) {
+				break;
+			}
+		}
+		lock.unlock();
+		GenericAsyncDataInputObservable* observable = this->getIncomingDataHandler();
+		if (observable) {
+			observable->notifyObservers(record.data, record.len);
+		}
+		lock.lock();
+		this->replayedChunksCount++;
+		this->replayedBytesCount += record.len;
+	}
+	this->replayRunning = false;
+	this->replayCv.notify_all();
+}
@@ -0,0 +1,97 @@
+/**
+ * @file ReplayUartDriver.h
+ *
+ * @brief Simulated UART driver feeding back the bytes received in a UART trace, for repeatable load tests and benchmarks
+ */
+
+#pragma once
+
+#include "MockUartDriver.h"
+#include "../uart-trace/UartTrace.h"
+
+#include <condition_variable>
+
+/**
+ * @brief Emulated UART delivering the chunks received in a trace (see RecordingUartDriver) to the incoming data handler
+ *
+ * Received chunks are delivered as they were recorded (same chunking), at the original pace, at a scaled pace, or as
+ * fast as possible. Chunks written in the trace are not replayed: bytes written by the host are handled as by
+ * MockUartDriver (handed to its onWriteCallback function).
+ */
+class ReplayUartDriver : public MockUartDriver {
+public:
+	/**
+	 * @brief Default constructor
+	 *
+	 * @param onWriteCallback callback function to invoke when bytes are written to the emulated UART (see MockUartDriver)
+	 */
+	ReplayUartDriver(std::function<int (size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta)> onWriteCallback = nullptr);
+
+	/**
+	 * @brief Destructor, stops the replay
+	 */
+	~ReplayUartDriver();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	ReplayUartDriver(const ReplayUartDriver& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	ReplayUartDriver& operator=(const ReplayUartDriver& other) = delete;
+
+	/**
+	 * @brief Start delivering the chunks received in a trace, from a dedicated thread
+	 *
+	 * The first chunk is delivered at once, the next ones at their recorded time offset from the first one, divided by
+	 * @p speed. Any previous replay is stopped first.
+	 *
+	 * @param tracePath The path of the trace file
+	 * @param speed The replay speed factor (1.0 for the original pace, 2.0 for twice as fast...), 0 to deliver the chunks as fast as possible
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int replay(const std::string& tracePath, double speed = 1.0);
+
+	/**
+	 * @brief Wait for all chunks of the trace to be delivered
+	 *
+	 * @param timeout The maximum time to wait
+	 *
+	 * @return true if the replay is over
+	 */
+	bool waitReplayed(const std::chrono::milliseconds& timeout);
+
+	/**
+	 * @brief Stop the replay, the chunks not delivered yet are dropped
+	 */
+	void stopReplay();
+
+	/**
+	 * @brief Get the number of chunks delivered by the current (or last) replay
+	 */
+	size_t getReplayedChunksCount();
+
+	/**
+	 * @brief Get the number of bytes delivered by the current (or last) replay
+	 */
+	size_t getReplayedBytesCount();
+
+private:
+	void replayLoop(double speed);
+
+	UartTraceReader reader;	/*!< The trace being replayed, read by replayThread only */
+	std::mutex replayMutex;	/*!< Protects the attributes below */
+	std::condition_variable replayCv;	/*!< Signalled when the replay is over or stopped */
+	bool replayRunning;	/*!< The replay thread is delivering chunks */
+	bool replayStopped;	/*!< The replay must be stopped */
+	size_t replayedChunksCount;	/*!< Chunks delivered by the current replay */
+	size_t replayedBytesCount;	/*!< Bytes delivered by the current replay */
+	std::thread replayThread;	/*!< Delivers the chunks */
+};
@@ -9,27 +9,14 @@
 #include <cstdarg>
 
 RaritanGenericLogger::RaritanGenericLogger(const LOG_LEVEL setLogLevel) :
-		ILoggerStream(setLogLevel),
-		m_buffer()	/* TODO: pre-allocate the buffer to a default size to avoid reallocs on the fly */
-{ /* Set the parent classes' logger's level to what has been provided as constructor's argument */
+		LineBufferedLoggerStream(setLogLevel) { /* Set the parent classes' logger's level to what has been provided as constructor's argument */
 }
 
 RaritanGenericLogger::~RaritanGenericLogger() {
 }
 
-int RaritanGenericLogger::overflow(int c) {
-	if (c != EOF) {
-		if (c == '\n') {
-			this->log(this->m_buffer.c_str());
-			this->m_buffer = "";
-		}
-		else {
-			if (c>0xff)
-				return EOF;
-			this->m_buffer += static_cast<char>(c & 0xff);
-		}
-	}
-	return c;
+void RaritanGenericLogger::outputLine(const SLogLine& line) {
+	this->log("%s", line.text);	/* Not used as a format, as the line may contain '%' */
 }
 
 /**
@@ -11,7 +11,7 @@
 **/
 #define SINGLETON_LOGGER_CLASS_NAME RaritanLogger
 #include "../ILogger.h"
-#include <string>
+#include "../LineBufferedLoggerStream.h"
 
 #ifdef USE_RARITAN
 /**** Start of the official API; no includes below this point! ***************/
@@ -21,7 +21,7 @@
 /**
  * @brief Class to implement error message logging
  */
-class RaritanGenericLogger : public ILoggerStream {
+class RaritanGenericLogger : public LineBufferedLoggerStream {
 public:
 	/**
 	 * @brief Constructor
@@ -44,17 +44,11 @@ public:
 
 protected:
 	/**
-	 * @brief Receive one character of an output stream
+	 * @brief Output a complete line logged through an ostream
 	 *
-	 * @param c The new character
-	 *
-	 * @return The character that has actually been printed out to the log
+	 * @param line The line to output
 	 */
-	virtual int overflow(int c);
-
-protected:
-	/* Member variables (attributes) */
-	std::string m_buffer;	/*!< The currently built buffer (used when outputting to log using ostream's operator<< */
+	virtual void outputLine(const SLogLine& line);
 };
 
 /**
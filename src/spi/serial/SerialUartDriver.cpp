@@ -13,7 +13,8 @@ SerialUartDriver::SerialUartDriver() :
 	m_serial_port(),
 	m_data_input_observable(nullptr),
 	m_read_thread_alive(false),
-	m_read_messages_thread() { }
+	m_read_messages_thread(),
+	m_write_buffer() { }
 
 SerialUartDriver::~SerialUartDriver() {
 	if (this->m_read_thread_alive) {
@@ -87,6 +88,15 @@ int SerialUartDriver::write(size_t& writtenCnt, const void* buf, size_t cnt) {
 	return 0;
 }
 
+int SerialUartDriver::writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt) {
+	this->m_write_buffer.clear();
+	for (size_t loop = 0; loop < iovcnt; loop++) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(iov[loop].buf);
+		this->m_write_buffer.insert(this->m_write_buffer.end(), bytes, bytes + iov[loop].cnt);
+	}
+	return this->write(writtenCnt, this->m_write_buffer.data(), this->m_write_buffer.size());
+}
+
 void SerialUartDriver::close() {
 	if (this->m_serial_port.isOpen()) {
 		this->m_serial_port.flush();
@@ -10,6 +10,7 @@
 #include "../IUartDriver.h"
 
 #include <thread>
+#include <vector>
 #include "serial/serial.h"
 
 /**
@@ -69,6 +70,19 @@ public:
 	 */
 	int write(size_t& writtenCnt, const void* buf, size_t cnt);
 
+	/**
+	 * @brief Write several byte sequences to the serial port
+	 *
+	 * libserialcpp does not give access to the port file descriptor: buffers are gathered and written at once
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written, in total
+	 * @param[in] iov The buffers to write
+	 * @param[in] iovcnt The number of buffers in iov
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt);
+
 	/**
 	 * @brief Close the serial port
 	 */
@@ -79,4 +93,5 @@ private:
 	GenericAsyncDataInputObservable *m_data_input_observable;		/*!< The observable that will notify observers when new bytes are available on the UART */
 	volatile bool m_read_thread_alive;	/*!< A boolean, indicating whether the secondary thread m_read_messages_thread is running */
 	std::thread m_read_messages_thread;	/*!< The secondary thread that will block on serial read */
+	std::vector<uint8_t> m_write_buffer;	/*!< Buffers of a writev() gathered for a single write */
 };
@@ -0,0 +1,252 @@
+/**
+ * @file TermiosUartDriver.cpp
+ *
+ * @brief Concrete implementation of a UART driver using Linux termios and epoll, without external dependency
+ */
+
+#include "TermiosUartDriver.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/serial.h>
+#include "../GenericLogger.h"
+
+const size_t TermiosUartDriver::READ_BUFFER_SIZE;
+
+/**
+ * @brief Get the termios speed constant for a baudrate
+ *
+ * @return The speed constant, B0 if the baudrate is not supported
+ */
+static speed_t toTermiosSpeed(unsigned int baudRate) {
+	switch (baudRate) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return B0;
+	}
+}
+
+TermiosUartDriver::TermiosUartDriver() :
+	m_fd(-1),
+	m_epoll_fd(-1),
+	m_stop_fd(-1),
+	m_data_input_observable(nullptr),
+	m_read_messages_thread() { }
+
+TermiosUartDriver::~TermiosUartDriver() {
+	this->close();
+}
+
+void TermiosUartDriver::setIncomingDataHandler(GenericAsyncDataInputObservable* uartIncomingDataHandler) {
+	this->m_data_input_observable = uartIncomingDataHandler;
+}
+
+int TermiosUartDriver::open(const std::string& serialPortName, unsigned int baudRate) {
+	speed_t speed = toTermiosSpeed(baudRate);
+	if (speed == B0) {
+		clogE << "open() failed on port \"" << serialPortName << "\": unsupported baudrate " << baudRate << "\n";
+		return EINVAL;
+	}
+
+	this->close();	/* Reopening */
+	this->m_fd = ::open(serialPortName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (this->m_fd < 0) {
+		int errnoResult = errno;
+		clogE << "open() failed on port \"" << serialPortName << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		return errnoResult;
+	}
+
+	struct termios tio;
+	if (tcgetattr(this->m_fd, &tio) != 0) {
+		int errnoResult = errno;
+		clogE << "tcgetattr() failed on port \"" << serialPortName << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		this->close();
+		return errnoResult;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	/* Reads never block (the port is non-blocking and we wait with epoll), they return what is available */
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	if (tcsetattr(this->m_fd, TCSANOW, &tio) != 0) {
+		int errnoResult = errno;
+		clogE << "tcsetattr() failed on port \"" << serialPortName << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		this->close();
+		return errnoResult;
+	}
+	/* Lower the latency of USB serial adapters, which otherwise buffer input for several ms (not supported by all drivers) */
+	struct serial_struct serial;
+	if (ioctl(this->m_fd, TIOCGSERIAL, &serial) == 0) {
+		serial.flags |= ASYNC_LOW_LATENCY;
+		ioctl(this->m_fd, TIOCSSERIAL, &serial);
+	}
+	tcflush(this->m_fd, TCIOFLUSH);
+
+	this->m_stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	this->m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (this->m_stop_fd < 0 || this->m_epoll_fd < 0) {
+		int errnoResult = errno;
+		clogE << "Failed creating the read thread wait objects with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		this->close();
+		return errnoResult;
+	}
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = this->m_fd;
+	epoll_ctl(this->m_epoll_fd, EPOLL_CTL_ADD, this->m_fd, &ev);
+	ev.data.fd = this->m_stop_fd;
+	epoll_ctl(this->m_epoll_fd, EPOLL_CTL_ADD, this->m_stop_fd, &ev);
+
+	this->m_read_messages_thread = std::thread([this]() { this->readLoop(); });
+	return 0;
+}
+
+int TermiosUartDriver::write(size_t& writtenCnt, const void* buf, size_t cnt) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(buf);
+
+	writtenCnt = 0;
+	if (this->m_fd < 0) {
+		return EBADF;
+	}
+	while (writtenCnt < cnt) {
+		ssize_t result = ::write(this->m_fd, bytes + writtenCnt, cnt - writtenCnt);
+		if (result >= 0) {
+			writtenCnt += static_cast<size_t>(result);
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			/* Output buffer full, wait for the UART to drain it */
+			struct pollfd pfd = { this->m_fd, POLLOUT, 0 };
+			poll(&pfd, 1, -1);
+		}
+		else if (errno != EINTR) {
+			int errnoResult = errno;
+			clogE << "write() failed with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+			return errnoResult;
+		}
+	}
+	return 0;
+}
+
+int TermiosUartDriver::writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt) {
+	struct iovec vec[IOV_MAX];
+	size_t first = 0;	/* First buffer not fully written */
+	size_t firstOffset = 0;	/* Bytes of the first buffer already written */
+
+	writtenCnt = 0;
+	if (this->m_fd < 0) {
+		return EBADF;
+	}
+	while (first < iovcnt) {
+		int vecCnt = 0;
+		for (size_t loop = first; loop < iovcnt && vecCnt < IOV_MAX; loop++, vecCnt++) {
+			size_t offset = (loop == first) ? firstOffset : 0;
+			vec[vecCnt].iov_base = const_cast<unsigned char*>(static_cast<const unsigned char*>(iov[loop].buf) + offset);
+			vec[vecCnt].iov_len = iov[loop].cnt - offset;
+		}
+		ssize_t result = ::writev(this->m_fd, vec, vecCnt);
+		if (result >= 0) {
+			/* Skip the buffers written, a short write leaves us in the middle of one */
+			size_t remaining = static_cast<size_t>(result);
+			writtenCnt += remaining;
+			while (first < iovcnt && remaining >= iov[first].cnt - firstOffset) {
+				remaining -= iov[first].cnt - firstOffset;
+				first++;
+				firstOffset = 0;
+			}
+			firstOffset += remaining;
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			/* Output buffer full, wait for the UART to drain it */
+			struct pollfd pfd = { this->m_fd, POLLOUT, 0 };
+			poll(&pfd, 1, -1);
+		}
+		else if (errno != EINTR) {
+			int errnoResult = errno;
+			clogE << "writev() failed with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+			return errnoResult;
+		}
+	}
+	return 0;
+}
+
+void TermiosUartDriver::close() {
+	if (this->m_read_messages_thread.joinable()) {
+		uint64_t one = 1;
+		if (::write(this->m_stop_fd, &one, sizeof(one)) < 0) {
+			clogE << "Failed signalling the read thread\n";
+		}
+		this->m_read_messages_thread.join();
+	}
+	if (this->m_epoll_fd >= 0) {
+		::close(this->m_epoll_fd);
+		this->m_epoll_fd = -1;
+	}
+	if (this->m_stop_fd >= 0) {
+		::close(this->m_stop_fd);
+		this->m_stop_fd = -1;
+	}
+	if (this->m_fd >= 0) {
+		::close(this->m_fd);
+		this->m_fd = -1;
+	}
+}
+
+void TermiosUartDriver::readLoop() {
+	unsigned char readData[READ_BUFFER_SIZE];
+	struct epoll_event events[2];
+
+	while (true) {
+		int nbEvents = epoll_wait(this->m_epoll_fd, events, sizeof(events)/sizeof(events[0]), -1);
+		if (nbEvents < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			clogE << "epoll_wait() failed in read thread with error " << errno << ": " << strerror(errno) << "\n";
+			return;
+		}
+		bool hangup = false;
+		for (int loop = 0; loop < nbEvents; loop++) {
+			if (events[loop].data.fd == this->m_stop_fd) {
+				return;
+			}
+			hangup = hangup || (events[loop].events & (EPOLLHUP | EPOLLERR));
+		}
+		/* Drain the port, delivering each chunk as read. A short read means it is drained, with VMIN and VTIME set to 0,
+		 * read() returns 0 (or fails with EAGAIN) when no byte is available */
+		ssize_t rdcnt;
+		do {
+			rdcnt = ::read(this->m_fd, readData, sizeof(readData));
+			if (rdcnt > 0) {
+				GenericAsyncDataInputObservable* observable = this->m_data_input_observable;
+				if (observable) {
+					observable->notifyObservers(readData, static_cast<size_t>(rdcnt));
+				}
+			}
+		} while (rdcnt == static_cast<ssize_t>(sizeof(readData)) || (rdcnt < 0 && errno == EINTR));
+		if ((hangup && rdcnt <= 0) || (rdcnt < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			/* Eg: the adapter was unplugged, the port will not become readable again */
+			clogE << "Serial port read failed, stopping read thread\n";
+			return;
+		}
+	}
+}
@@ -0,0 +1,110 @@
+/**
+ * @file TermiosUartDriver.h
+ *
+ * @brief Concrete implementation of a UART driver using Linux termios and epoll, without external dependency
+ */
+
+#pragma once
+
+#include "../IUartDriver.h"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Class to interact with a UART using termios
+ *
+ * The read thread waits for input with epoll, then drains the port with non-blocking reads into a READ_BUFFER_SIZE
+ * buffer, delivering each chunk read at once to the incoming data handler (instead of one byte per read and per
+ * notification). close() wakes the read thread up through an eventfd, without waiting for input.
+ */
+class TermiosUartDriver : public IUartDriver {
+public:
+	static const size_t READ_BUFFER_SIZE = 4096;	/*!< Maximum number of bytes read and delivered at once */
+
+	/**
+	 * @brief Default constructor
+	 */
+	TermiosUartDriver();
+
+	/**
+	 * @brief Destructor
+	 */
+	~TermiosUartDriver();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	TermiosUartDriver(const TermiosUartDriver& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	TermiosUartDriver& operator=(const TermiosUartDriver& other) = delete;
+
+	/**
+	 * @brief Set the incoming data handler (a derived class of GenericAsyncDataInputObservable) that will notify observers when new bytes are available on the UART
+	 *
+	 * @param uartIncomingDataHandler A pointer to the new handler (the eventual previous handler that might have been set at construction will be dropped)
+	 */
+	void setIncomingDataHandler(GenericAsyncDataInputObservable* uartIncomingDataHandler);
+
+	/**
+	 * @brief Opens the serial port
+	 *
+	 * The port is set to raw mode, 8 data bits, no parity, one stop bit, no flow control. The low latency flag is set
+	 * when the underlying driver supports it.
+	 *
+	 * @param serialPortName The name of the serial port to open (eg: "/dev/ttyUSB0")
+	 * @param baudRate The baudrate to enforce on the serial port
+	 *
+	 * @return 0 on success, errno on failure (EINVAL for an unsupported baudrate)
+	 */
+	int open(const std::string& serialPortName, unsigned int baudRate = 57600);
+
+	/**
+	 * @brief Write a byte sequence to the serial port
+	 *
+	 * Waits for room in the output buffer if needed, so that all bytes are written unless an error occurs
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written
+	 * @param[in] buf data buffer to write
+	 * @param[in] cnt byte count of data to write
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int write(size_t& writtenCnt, const void* buf, size_t cnt);
+
+	/**
+	 * @brief Write several byte sequences to the serial port, in a single writev() system call when the output buffer has
+	 *        room for them
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written, in total
+	 * @param[in] iov The buffers to write
+	 * @param[in] iovcnt The number of buffers in iov
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt);
+
+	/**
+	 * @brief Close the serial port, after stopping the read thread
+	 */
+	void close();
+
+private:
+	/**
+	 * @brief Body of the read thread
+	 */
+	void readLoop();
+
+	int m_fd;	/*!< The serial port file descriptor, -1 if closed */
+	int m_epoll_fd;	/*!< The epoll instance the read thread waits on */
+	int m_stop_fd;	/*!< An eventfd signalled to stop the read thread */
+	std::atomic<GenericAsyncDataInputObservable*> m_data_input_observable;	/*!< The observable that will notify observers when new bytes are available on the UART (read by the read thread) */
+	std::thread m_read_messages_thread;	/*!< The secondary thread that will wait for incoming bytes */
+};
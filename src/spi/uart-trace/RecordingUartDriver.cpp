@@ -0,0 +1,52 @@
+/**
+ * @file RecordingUartDriver.cpp
+ *
+ * @brief UART driver decorator recording all bytes received and written into a UART trace
+ */
+
+#include "RecordingUartDriver.h"
+
+RecordingUartDriver::RecordingUartDriver(IUartDriver& target, UartTraceWriter& trace) :
+	target(target),
+	trace(trace),
+	targetDataInput(),
+	dataInputObservable(nullptr) {
+	this->targetDataInput.registerObserver(this);
+	this->target.setIncomingDataHandler(&this->targetDataInput);
+}
+
+RecordingUartDriver::~RecordingUartDriver() {
+	this->target.setIncomingDataHandler(nullptr);
+}
+
+void RecordingUartDriver::setIncomingDataHandler(GenericAsyncDataInputObservable* uartIncomingDataHandler) {
+	this->dataInputObservable = uartIncomingDataHandler;
+}
+
+int RecordingUartDriver::open(const std::string& serialPortName, unsigned int baudRate) {
+	return this->target.open(serialPortName, baudRate);
+}
+
+int RecordingUartDriver::write(size_t& writtenCnt, const void* buf, size_t cnt) {
+	int result = this->target.write(writtenCnt, buf, cnt);
+	this->trace.append(UART_TRACE_TX, buf, writtenCnt);
+	return result;
+}
+
+int RecordingUartDriver::writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt) {
+	int result = this->target.writev(writtenCnt, iov, iovcnt);
+	this->trace.append(UART_TRACE_TX, iov, iovcnt, writtenCnt);
+	return result;
+}
+
+void RecordingUartDriver::close() {
+	this->target.close();
+}
+
+void RecordingUartDriver::handleInputData(const unsigned char* dataIn, const size_t dataLen) {
+	this->trace.append(UART_TRACE_RX, dataIn, dataLen);
+	GenericAsyncDataInputObservable* observable = this->dataInputObservable;
+	if (observable) {
+		observable->notifyObservers(dataIn, dataLen);
+	}
+}
@@ -0,0 +1,109 @@
+/**
+ * @file RecordingUartDriver.h
+ *
+ * @brief UART driver decorator recording all bytes received and written into a UART trace
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "../IUartDriver.h"
+#include "UartTrace.h"
+
+/**
+ * @brief Decorator around any UART driver, recording each chunk received and each write into a UartTraceWriter
+ *
+ * All calls are forwarded to the decorated driver. Chunks received are recorded (from the read thread of the decorated
+ * driver) before they are handed to the incoming data handler, writes are recorded once done, with the bytes actually
+ * written (a writev() is recorded as a single chunk, as it is on the line).
+ *
+ * The resulting trace can be fed back to the host with ReplayUartDriver.
+ */
+class RecordingUartDriver : public IUartDriver, public IAsyncDataInputObserver {
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param target The UART driver to decorate, that must outlive this object
+	 * @param trace The trace to record into (opened by the caller), that must outlive this object
+	 */
+	RecordingUartDriver(IUartDriver& target, UartTraceWriter& trace);
+
+	/**
+	 * @brief Destructor
+	 */
+	~RecordingUartDriver();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	RecordingUartDriver(const RecordingUartDriver& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	RecordingUartDriver& operator=(const RecordingUartDriver& other) = delete;
+
+	/**
+	 * @brief Set the incoming data handler (a derived class of GenericAsyncDataInputObservable) that will notify observers when new bytes are available on the UART
+	 *
+	 * @param uartIncomingDataHandler A pointer to the new handler (the eventual previous handler that might have been set at construction will be dropped)
+	 */
+	void setIncomingDataHandler(GenericAsyncDataInputObservable* uartIncomingDataHandler);
+
+	/**
+	 * @brief Opens the serial port, through the decorated driver
+	 *
+	 * @param serialPortName The name of the serial port to open (eg: "/dev/ttyUSB0")
+	 * @param baudRate The baudrate to enforce on the serial port
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int open(const std::string& serialPortName, unsigned int baudRate);
+
+	/**
+	 * @brief Write a byte sequence to the serial port, through the decorated driver, and record the bytes written
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written
+	 * @param[in] buf data buffer to write
+	 * @param[in] cnt byte count of data to write
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int write(size_t& writtenCnt, const void* buf, size_t cnt);
+
+	/**
+	 * @brief Write several byte sequences to the serial port, through the decorated driver, and record the bytes written as a single chunk
+	 *
+	 * @param[out] writtenCnt How many bytes were actually written, in total
+	 * @param[in] iov The buffers to write
+	 * @param[in] iovcnt The number of buffers in iov
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int writev(size_t& writtenCnt, const UartIoVec* iov, size_t iovcnt);
+
+	/**
+	 * @brief Close the serial port, through the decorated driver
+	 */
+	void close();
+
+	/**
+	 * @brief Handler invoked for each chunk received by the decorated driver
+	 *
+	 * @param dataIn The pointer to the incoming bytes buffer
+	 * @param dataLen The size of the data to read inside dataIn
+	 */
+	void handleInputData(const unsigned char* dataIn, const size_t dataLen);
+
+private:
+	IUartDriver& target;	/*!< The decorated driver */
+	UartTraceWriter& trace;	/*!< The trace chunks are recorded into */
+	GenericAsyncDataInputObservable targetDataInput;	/*!< Incoming data handler set on the decorated driver, notifying us */
+	std::atomic<GenericAsyncDataInputObservable*> dataInputObservable;	/*!< The incoming data handler chunks are forwarded to (set from the caller thread, used from the read thread) */
+};
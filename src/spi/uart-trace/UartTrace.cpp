@@ -0,0 +1,228 @@
+/**
+ * @file UartTrace.cpp
+ *
+ * @brief Binary trace of the bytes exchanged on a UART, with monotonic timestamps, for offline replay
+ */
+
+#include "UartTrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../GenericLogger.h"
+
+UartTraceWriter::UartTraceWriter() :
+	mutex(),
+	fd(-1),
+	map(nullptr),
+	capacity(0),
+	used(0),
+	nbRecords(0),
+	start() { }
+
+UartTraceWriter::~UartTraceWriter() {
+	this->close();
+}
+
+int UartTraceWriter::open(const std::string& tracePath) {
+	this->close();	/* Reopening */
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->fd = ::open(tracePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (this->fd < 0) {
+		int errnoResult = errno;
+		clogE << "Failed creating UART trace \"" << tracePath << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		return errnoResult;
+	}
+	if (ftruncate(this->fd, UART_TRACE_GROW_SIZE) != 0) {
+		int errnoResult = errno;
+		clogE << "Failed sizing UART trace \"" << tracePath << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		::close(this->fd);
+		this->fd = -1;
+		return errnoResult;
+	}
+	void* mapping = mmap(nullptr, UART_TRACE_GROW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (mapping == MAP_FAILED) {
+		int errnoResult = errno;
+		clogE << "Failed mapping UART trace \"" << tracePath << "\" with error " << errnoResult << ": " << strerror(errnoResult) << "\n";
+		::close(this->fd);
+		this->fd = -1;
+		return errnoResult;
+	}
+	this->map = static_cast<uint8_t*>(mapping);
+	this->capacity = UART_TRACE_GROW_SIZE;
+
+	uint32_t version = UART_TRACE_VERSION;
+	uint32_t reserved = 0;
+	memcpy(this->map, UART_TRACE_MAGIC, sizeof(UART_TRACE_MAGIC));
+	memcpy(this->map + 8, &version, sizeof(version));
+	memcpy(this->map + 12, &reserved, sizeof(reserved));
+	this->used = UART_TRACE_HEADER_SIZE;
+	this->nbRecords = 0;
+	this->start = std::chrono::steady_clock::now();
+	return 0;
+}
+
+uint8_t* UartTraceWriter::reserve(size_t len) {
+	if (this->map == nullptr) {
+		return nullptr;
+	}
+	if (this->used + len > this->capacity) {
+		/* Grow geometrically (but by at least UART_TRACE_GROW_SIZE), so that large traces are not remapped too often */
+		size_t newCapacity = this->capacity + std::max(this->capacity, UART_TRACE_GROW_SIZE);
+		while (this->used + len > newCapacity) {
+			newCapacity += UART_TRACE_GROW_SIZE;
+		}
+		if (ftruncate(this->fd, static_cast<off_t>(newCapacity)) != 0) {
+			clogE << "Failed growing UART trace with error " << errno << ": " << strerror(errno) << ", dropping chunk\n";
+			return nullptr;
+		}
+		void* mapping = mremap(this->map, this->capacity, newCapacity, MREMAP_MAYMOVE);
+		if (mapping == MAP_FAILED) {
+			clogE << "Failed remapping UART trace with error " << errno << ": " << strerror(errno) << ", dropping chunk\n";
+			return nullptr;
+		}
+		this->map = static_cast<uint8_t*>(mapping);
+		this->capacity = newCapacity;
+	}
+	uint8_t* result = this->map + this->used;
+	this->used += len;
+	return result;
+}
+
+void UartTraceWriter::append(EUartTraceDirection direction, const void* buf, size_t cnt) {
+	UartIoVec iov = { buf, cnt };
+	this->append(direction, &iov, 1, cnt);
+}
+
+void UartTraceWriter::append(EUartTraceDirection direction, const UartIoVec* iov, size_t iovcnt, size_t cnt) {
+	if (cnt == 0) {
+		return;	/* A zero length marks the end of the trace */
+	}
+	uint64_t timestampNs = 0;
+	uint32_t lenAndDirection = static_cast<uint32_t>(cnt << 1) | static_cast<uint32_t>(direction);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	/* Timestamped with the mutex held, so that timestamps never go backwards in the trace */
+	timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count());
+	uint8_t* record = this->reserve(UART_TRACE_RECORD_HEADER_SIZE + cnt);
+	if (record == nullptr) {
+		return;
+	}
+	memcpy(record, &timestampNs, sizeof(timestampNs));
+	memcpy(record + 8, &lenAndDirection, sizeof(lenAndDirection));
+	record += UART_TRACE_RECORD_HEADER_SIZE;
+	for (size_t loop = 0; loop < iovcnt && cnt > 0; loop++) {
+		size_t bufCnt = std::min(iov[loop].cnt, cnt);
+		memcpy(record, iov[loop].buf, bufCnt);
+		record += bufCnt;
+		cnt -= bufCnt;
+	}
+	this->nbRecords++;
+}
+
+uint64_t UartTraceWriter::getRecordCount() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->nbRecords;
+}
+
+void UartTraceWriter::close() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->map != nullptr) {
+		munmap(this->map, this->capacity);
+		this->map = nullptr;
+	}
+	if (this->fd >= 0) {
+		if (ftruncate(this->fd, static_cast<off_t>(this->used)) != 0) {
+			clogE << "Failed trimming UART trace with error " << errno << ": " << strerror(errno) << "\n";	/* Still readable, with trailing zeroes */
+		}
+		::close(this->fd);
+		this->fd = -1;
+	}
+	this->capacity = 0;
+	this->used = 0;
+}
+
+UartTraceReader::UartTraceReader() :
+	map(nullptr),
+	size(0),
+	offset(0) { }
+
+UartTraceReader::~UartTraceReader() {
+	this->close();
+}
+
+int UartTraceReader::open(const std::string& tracePath) {
+	this->close();	/* Reopening */
+
+	int fd = ::open(tracePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return errno;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int errnoResult = errno;
+		::close(fd);
+		return errnoResult;
+	}
+	if (static_cast<size_t>(st.st_size) < UART_TRACE_HEADER_SIZE) {
+		::close(fd);
+		return EINVAL;
+	}
+	void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	int errnoResult = errno;
+	::close(fd);	/* The mapping stays valid */
+	if (mapping == MAP_FAILED) {
+		return errnoResult;
+	}
+	this->map = static_cast<const uint8_t*>(mapping);
+	this->size = static_cast<size_t>(st.st_size);
+
+	uint32_t version;
+	memcpy(&version, this->map + 8, sizeof(version));
+	if (memcmp(this->map, UART_TRACE_MAGIC, sizeof(UART_TRACE_MAGIC)) != 0 || version != UART_TRACE_VERSION) {
+		clogE << "\"" << tracePath << "\" is not a supported UART trace\n";
+		this->close();
+		return EINVAL;
+	}
+	this->rewind();
+	return 0;
+}
+
+bool UartTraceReader::next(UartTraceRecord& record) {
+	uint64_t timestampNs;
+	uint32_t lenAndDirection;
+
+	if (this->map == nullptr || this->size - this->offset < UART_TRACE_RECORD_HEADER_SIZE) {
+		return false;
+	}
+	memcpy(&timestampNs, this->map + this->offset, sizeof(timestampNs));
+	memcpy(&lenAndDirection, this->map + this->offset + 8, sizeof(lenAndDirection));
+	size_t len = lenAndDirection >> 1;
+	if (len == 0 || this->size - this->offset - UART_TRACE_RECORD_HEADER_SIZE < len) {
+		return false;	/* End of an unclosed trace, or truncated record */
+	}
+	record.timestampNs = timestampNs;
+	record.direction = (lenAndDirection & 1) ? UART_TRACE_TX : UART_TRACE_RX;
+	record.data = this->map + this->offset + UART_TRACE_RECORD_HEADER_SIZE;
+	record.len = len;
+	this->offset += UART_TRACE_RECORD_HEADER_SIZE + len;
+	return true;
+}
+
+void UartTraceReader::rewind() {
+	this->offset = UART_TRACE_HEADER_SIZE;
+}
+
+void UartTraceReader::close() {
+	if (this->map != nullptr) {
+		munmap(const_cast<uint8_t*>(this->map), this->size);
+		this->map = nullptr;
+	}
+	this->size = 0;
+	this->offset = 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file UartTrace.h
+ *
+ * @brief Binary trace of the bytes exchanged on a UART, with monotonic timestamps, for offline replay
+ */
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+
+#include "../IUartDriver.h"
+
+/**
+ * @brief Direction of a traced UART chunk
+ */
+typedef enum {
+	UART_TRACE_RX = 0,	/* Bytes received from the UART */
+	UART_TRACE_TX = 1	/* Bytes written to the UART */
+} EUartTraceDirection;
+
+/**
+ * @brief One traced UART chunk, as read by UartTraceReader
+ */
+struct UartTraceRecord {
+	uint64_t timestampNs;	/*!< Time elapsed between the start of the trace and this chunk (in ns, monotonic) */
+	EUartTraceDirection direction;	/*!< Whether the bytes were received or written */
+	const uint8_t* data;	/*!< The bytes, pointing into the trace file mapping (valid until the reader is closed) */
+	size_t len;	/*!< The number of bytes in data */
+};
+
+/**
+ * @brief Trace file layout
+ *
+ * A UART_TRACE_HEADER_SIZE bytes header (UART_TRACE_MAGIC, then the format version and a reserved field, as 32-bit
+ * integers), followed by records: a 64-bit timestamp (ns since the trace start), a 32-bit word holding the chunk length
+ * shifted left by one and the direction in its lowest bit, then the chunk bytes. Integers are stored in host order.
+ *
+ * The file is grown by UART_TRACE_GROW_SIZE steps while recording and trimmed to its content on close. A trace left
+ * unclosed (eg: the recording process crashed) ends with zeroes, read as the end of the trace.
+ */
+static const char UART_TRACE_MAGIC[8] = { 'U', 'A', 'R', 'T', 'T', 'R', 'C', '\0' };	/*!< Trace file signature */
+static const uint32_t UART_TRACE_VERSION = 1;	/*!< Trace format version */
+static const size_t UART_TRACE_HEADER_SIZE = 16;	/*!< Size of the trace file header */
+static const size_t UART_TRACE_RECORD_HEADER_SIZE = 12;	/*!< Size of the header of each record */
+static const size_t UART_TRACE_GROW_SIZE = 1 << 20;	/*!< The trace file is grown by at least this many bytes at once */
+
+/**
+ * @brief Append-only UART trace file writer, through a shared memory mapping of the file
+ *
+ * Recording a chunk is a copy to the mapping (no system call, except when the file must be grown), it can be done from
+ * the UART read thread without delaying the delivery of the bytes much.
+ */
+class UartTraceWriter {
+public:
+	/**
+	 * @brief Default constructor
+	 */
+	UartTraceWriter();
+
+	/**
+	 * @brief Destructor, closes the trace
+	 */
+	~UartTraceWriter();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	UartTraceWriter(const UartTraceWriter& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	UartTraceWriter& operator=(const UartTraceWriter& other) = delete;
+
+	/**
+	 * @brief Create (or truncate) a trace file and start the trace clock
+	 *
+	 * @param tracePath The path of the trace file
+	 *
+	 * @return 0 on success, errno on failure
+	 */
+	int open(const std::string& tracePath);
+
+	/**
+	 * @brief Record a chunk, timestamped now
+	 *
+	 * @param direction Whether the bytes were received or written
+	 * @param buf The bytes
+	 * @param cnt The number of bytes in buf, nothing is recorded if 0
+	 *
+	 * @note Can be invoked from several threads
+	 */
+	void append(EUartTraceDirection direction, const void* buf, size_t cnt);
+
+	/**
+	 * @brief Record the first @p cnt bytes of several buffers as a single chunk, timestamped now
+	 *
+	 * @param direction Whether the bytes were received or written
+	 * @param iov The buffers
+	 * @param iovcnt The number of buffers in iov
+	 * @param cnt The number of bytes to record, nothing is recorded if 0
+	 *
+	 * @note Can be invoked from several threads
+	 */
+	void append(EUartTraceDirection direction, const UartIoVec* iov, size_t iovcnt, size_t cnt);
+
+	/**
+	 * @brief Get the number of chunks recorded since open()
+	 */
+	uint64_t getRecordCount();
+
+	/**
+	 * @brief Trim the trace file to its content and close it
+	 */
+	void close();
+
+private:
+	uint8_t* reserve(size_t len);
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	int fd;	/*!< The trace file descriptor, -1 if closed */
+	uint8_t* map;	/*!< Shared mapping of the trace file */
+	size_t capacity;	/*!< Size of the trace file and of its mapping */
+	size_t used;	/*!< Number of bytes of the trace file written so far */
+	uint64_t nbRecords;	/*!< Number of chunks recorded */
+	std::chrono::steady_clock::time_point start;	/*!< Trace start time, timestamps are relative to it */
+};
+
+/**
+ * @brief UART trace file reader, through a read-only memory mapping of the file
+ */
+class UartTraceReader {
+public:
+	/**
+	 * @brief Default constructor
+	 */
+	UartTraceReader();
+
+	/**
+	 * @brief Destructor, closes the trace
+	 */
+	~UartTraceReader();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	UartTraceReader(const UartTraceReader& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	UartTraceReader& operator=(const UartTraceReader& other) = delete;
+
+	/**
+	 * @brief Open a trace file, positioned on its first chunk
+	 *
+	 * @param tracePath The path of the trace file
+	 *
+	 * @return 0 on success, errno on failure (EINVAL if the file is not a trace in a supported format)
+	 */
+	int open(const std::string& tracePath);
+
+	/**
+	 * @brief Read the next chunk
+	 *
+	 * @param[out] record The chunk read, its data pointing into the file mapping
+	 *
+	 * @return false at the end of the trace
+	 */
+	bool next(UartTraceRecord& record);
+
+	/**
+	 * @brief Get back to the first chunk
+	 */
+	void rewind();
+
+	/**
+	 * @brief Close the trace, the data of the records read becomes invalid
+	 */
+	void close();
+
+private:
+	const uint8_t* map;	/*!< Read-only mapping of the trace file, nullptr if closed */
+	size_t size;	/*!< Size of the trace file and of its mapping */
+	size_t offset;	/*!< Offset of the next record in the mapping */
+};
@@ -0,0 +1,160 @@
+/**
+ * @file VirtualClock.cpp
+ *
+ * @brief Simulated clock and timers, advanced explicitly by the test code, so that timing scenarios run faster than real time
+ */
+
+#include "VirtualClock.h"
+
+/**
+ * @brief Timer expiring on the simulated time of a VirtualClock
+ *
+ * Behaves as CppThreadsTimer: starting a running timer restarts it, and a 0 timeout runs the callback at once.
+ */
+class VirtualClock::CTimer : public ITimer {
+public:
+	CTimer(VirtualClock& clock) : clock(clock), eventId(0) { }
+
+	~CTimer() {
+		this->stop();
+	}
+
+	CTimer(const CTimer& other) = delete; /* No copy construction allowed */
+
+	CTimer& operator=(const CTimer& other) = delete; /* No assignment allowed */
+
+	bool start(uint16_t timeout, std::function<void (ITimer* triggeringTimer)> callBackFunction) {
+		if (!callBackFunction) {
+			return false;
+		}
+		this->stop();
+		this->duration = timeout;
+		if (timeout == 0) {
+			callBackFunction(this);
+		}
+		else {
+			this->started = true;
+			this->eventId = this->clock.schedule(std::chrono::milliseconds(timeout), [this, callBackFunction]() {
+				this->started = false;
+				callBackFunction(this);
+			});
+		}
+		return true;
+	}
+
+	bool stop() {
+		if (!this->started) {
+			return false;
+		}
+		this->clock.cancel(this->eventId);
+		this->started = false;
+		this->duration = 0;
+		return true;
+	}
+
+	bool isRunning() {
+		return this->started;
+	}
+
+private:
+	VirtualClock& clock;	/*!< The clock we expire on */
+	TEventId eventId;	/*!< Our expiration event, if started */
+};
+
+VirtualClock::VirtualClock() :
+	mutex(),
+	currentTime(),
+	nextEventId(1),
+	events(),
+	eventDeadlines(),
+	runEventsCount(0) { }
+
+VirtualClock::~VirtualClock() { }
+
+std::unique_ptr<ITimer> VirtualClock::create() const {
+	/* Timers need to update the clock, create() is only const to satisfy ITimerFactory */
+	return std::unique_ptr<ITimer>(new CTimer(const_cast<VirtualClock&>(*this)));
+}
+
+VirtualClock::TTimePoint VirtualClock::now() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->currentTime;
+}
+
+VirtualClock::TEventId VirtualClock::schedule(const std::chrono::nanoseconds& delay, std::function<void ()> event) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TEventId eventId = this->nextEventId++;
+	TTimePoint deadline = this->currentTime + std::chrono::duration_cast<TTimePoint::duration>(delay);
+	this->events.insert(std::make_pair(TEventKey(deadline, eventId), std::move(event)));
+	this->eventDeadlines.insert(std::make_pair(eventId, deadline));
+	return eventId;
+}
+
+VirtualClock::TEventId VirtualClock::scheduleAt(const TTimePoint& deadline, std::function<void ()> event) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	TEventId eventId = this->nextEventId++;
+	this->events.insert(std::make_pair(TEventKey(deadline, eventId), std::move(event)));
+	this->eventDeadlines.insert(std::make_pair(eventId, deadline));
+	return eventId;
+}
+
+bool VirtualClock::cancel(TEventId eventId) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->eventDeadlines.find(eventId);
+	if (it == this->eventDeadlines.end()) {
+		return false;
+	}
+	this->events.erase(TEventKey(it->second, eventId));
+	this->eventDeadlines.erase(it);
+	return true;
+}
+
+unsigned int VirtualClock::advance(const std::chrono::nanoseconds& duration) {
+	TTimePoint target = this->now() + std::chrono::duration_cast<TTimePoint::duration>(duration);
+	unsigned int count = 0;
+	while (this->runNext(target)) {
+		count++;
+	}
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->currentTime < target) {
+		this->currentTime = target;
+	}
+	return count;
+}
+
+bool VirtualClock::runUntilIdle(const std::chrono::nanoseconds& limit) {
+	TTimePoint target = this->now() + std::chrono::duration_cast<TTimePoint::duration>(limit);
+	while (this->runNext(target)) {
+	}
+	return this->getPendingEventsCount() == 0;
+}
+
+size_t VirtualClock::getPendingEventsCount() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->events.size();
+}
+
+uint64_t VirtualClock::getRunEventsCount() const {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->runEventsCount;
+}
+
+bool VirtualClock::runNext(const TTimePoint& limit) {
+	std::function<void ()> event;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto next = this->events.begin();
+		if (next == this->events.end() || next->first.first > limit) {
+			return false;
+		}
+		if (this->currentTime < next->first.first) {
+			this->currentTime = next->first.first;	/* Events scheduled in the past run at the current time */
+		}
+		event = std::move(next->second);
+		this->eventDeadlines.erase(next->first.second);
+		this->events.erase(next);
+		this->runEventsCount++;
+	}	/* Released while running the event, which may schedule or cancel other ones */
+	event();
+	return true;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file VirtualClock.h
+ *
+ * @brief Simulated clock and timers, advanced explicitly by the test code, so that timing scenarios run faster than real time
+ */
+
+#pragma once
+
+#include "../ITimerFactory.h"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <stdint.h>
+
+/**
+ * @brief Simulated time source, providing timers (see ITimerFactory) and scheduled events running on simulated time
+ *
+ * Time does not flow by itself: it only moves forward when the test code invokes advance(), runNext() or runUntilIdle().
+ * These run the events that become due (timer expirations, bytes delivered by a MockUartDriver or a MockNcp sharing this
+ * clock...) one at a time, on the calling thread, in deadline order, with now() set to the deadline of the event being
+ * run. Events due at the same time are run in the order they were scheduled, so that a scenario always unfolds the same
+ * way, however fast the host is.
+ *
+ * A one-minute scenario thus completes as soon as its events are processed, and a timeout is hit exactly after its
+ * duration of simulated time.
+ *
+ * Events can be scheduled and cancelled from any thread (including from the events themselves), but time must only be
+ * advanced by one thread at a time.
+ */
+class VirtualClock : public ITimerFactory {
+public:
+	typedef std::chrono::steady_clock::time_point TTimePoint;
+	typedef uint64_t TEventId;
+
+	/**
+	 * @brief Default constructor
+	 *
+	 * Simulated time starts at the epoch of std::chrono::steady_clock
+	 */
+	VirtualClock();
+
+	/**
+	 * @brief Destructor
+	 *
+	 * Events still scheduled are dropped without being run
+	 */
+	~VirtualClock();
+
+	/**
+	 * @brief Copy constructor
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	VirtualClock(const VirtualClock& other) = delete;
+
+	/**
+	 * @brief Assignment operator
+	 *
+	 * Copy construction is forbidden on this class
+	 */
+	VirtualClock& operator=(const VirtualClock& other) = delete;
+
+	/**
+	 * @brief Create a new timer, expiring on simulated time
+	 *
+	 * @return The new timer created
+	 */
+	std::unique_ptr<ITimer> create() const;
+
+	/**
+	 * @brief Get the current simulated time
+	 */
+	TTimePoint now() const;
+
+	/**
+	 * @brief Schedule an event after a simulated delay
+	 *
+	 * @param delay The delay from now()
+	 * @param event The function to run
+	 *
+	 * @return An identifier of the event, to cancel it
+	 */
+	TEventId schedule(const std::chrono::nanoseconds& delay, std::function<void ()> event);
+
+	/**
+	 * @brief Schedule an event at a simulated time
+	 *
+	 * @param deadline When to run the event (events in the past are run by the next advance())
+	 * @param event The function to run
+	 *
+	 * @return An identifier of the event, to cancel it
+	 */
+	TEventId scheduleAt(const TTimePoint& deadline, std::function<void ()> event);
+
+	/**
+	 * @brief Cancel a scheduled event
+	 *
+	 * @param eventId The event identifier returned by schedule() or scheduleAt()
+	 *
+	 * @return false if the event was not scheduled anymore (already run or cancelled)
+	 */
+	bool cancel(TEventId eventId);
+
+	/**
+	 * @brief Advance simulated time, running all events becoming due
+	 *
+	 * @param duration The simulated duration to let elapse
+	 *
+	 * @return The number of events run
+	 */
+	unsigned int advance(const std::chrono::nanoseconds& duration);
+
+	/**
+	 * @brief Advance simulated time up to the next scheduled event and run it
+	 *
+	 * @param limit Do not run the next event if it is due after this time
+	 *
+	 * @return false if there was no event scheduled (before @p limit)
+	 */
+	bool runNext(const TTimePoint& limit = TTimePoint::max());
+
+	/**
+	 * @brief Run scheduled events until there are none left, or the next one is more than @p limit ahead of the current time
+	 *
+	 * @param limit The maximum simulated duration to let elapse
+	 *
+	 * @return true if no event is scheduled anymore
+	 */
+	bool runUntilIdle(const std::chrono::nanoseconds& limit);
+
+	/**
+	 * @brief Get the number of events scheduled and not run yet
+	 */
+	size_t getPendingEventsCount() const;
+
+	/**
+	 * @brief Get the total number of events run so far
+	 */
+	uint64_t getRunEventsCount() const;
+
+private:
+	class CTimer;
+
+	typedef std::pair<TTimePoint, TEventId> TEventKey;	/* Events due at the same time are ordered by identifier, that is by scheduling order */
+
+	mutable std::mutex mutex;	/*!< Protects the attributes below, never held while running an event */
+	TTimePoint currentTime;	/*!< The current simulated time */
+	TEventId nextEventId;	/*!< Identifier of the next event scheduled */
+	std::map<TEventKey, std::function<void ()> > events;	/*!< Scheduled events, in running order */
+	std::map<TEventId, TTimePoint> eventDeadlines;	/*!< Deadlines of the scheduled events, to find them back by identifier */
+	uint64_t runEventsCount;	/*!< The number of events run */
+};
@@ -0,0 +1,37 @@
+#ifndef __BENCHHARNESS_H__
+#define __BENCHHARNESS_H__
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+/**
+ * @brief Prevent the compiler from optimizing away a value computed inside a benchmark loop
+ */
+template<typename T> inline void benchKeep(const T& value) {
+	static volatile T sink;
+	sink = value;
+	(void)sink;
+}
+
+/**
+ * @brief Run @p func @p iterations times and print the average time spent per call
+ *
+ * @param name A label printed in front of the result
+ * @param iterations How many times @p func is invoked
+ * @param func The code to measure
+ *
+ * @return The average duration of one call, in nanoseconds
+ */
+template<typename F> inline double benchRun(const char* name, unsigned long iterations, F func) {
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long loop = 0; loop < iterations; loop++) {
+		func();
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	double nsPerCall = elapsed.count() / static_cast<double>(iterations);
+	printf("%-48s %12.1f ns/call\n", name, nsPerCall);
+	return nsPerCall;
+}
+
+#endif // __BENCHHARNESS_H__
@@ -0,0 +1,349 @@
+/**
+ * @file MockNcp.cpp
+ *
+ * @brief Emulated EZSP NCP answering ASH frames written to a MockUartDriver (or to a pseudo-terminal, see PtyNcp), for unit
+ *        tests and benchmarks
+ */
+
+#include "MockNcp.h"
+
+#include "../domain/ash-crc.h"
+#include "../spi/GenericAsyncDataInputObservable.h"
+
+namespace {
+
+const uint8_t ASH_CANCEL_BYTE = 0x1A;
+const uint8_t ASH_FLAG_BYTE = 0x7E;
+const uint8_t ASH_ESCAPE_BYTE = 0x7D;
+
+/**
+ * @brief Apply (or remove) the ASH data field pseudo-random sequence
+ */
+void randomise(std::vector<uint8_t>::iterator begin, std::vector<uint8_t>::iterator end) {
+	uint8_t rand = 0x42;
+	for (auto it = begin; it != end; ++it) {
+		*it = static_cast<uint8_t>(*it ^ rand);
+		rand = static_cast<uint8_t>((rand & 0x01) ? ((rand >> 1) ^ 0xB8) : (rand >> 1));
+	}
+}
+
+/**
+ * @brief Append the CRC to an unstuffed frame, stuff it and terminate it with a flag byte
+ */
+std::vector<uint8_t> finaliseFrame(std::vector<uint8_t> frame) {
+	uint16_t crc = CAshCrc::compute(frame.data(), frame.size());
+	frame.push_back(static_cast<uint8_t>(crc >> 8));
+	frame.push_back(static_cast<uint8_t>(crc & 0xFF));
+
+	std::vector<uint8_t> stuffed;
+	for (uint8_t byte : frame) {
+		if (byte == 0x7E || byte == 0x7D || byte == 0x11 || byte == 0x13 || byte == 0x18 || byte == 0x1A) {
+			stuffed.push_back(ASH_ESCAPE_BYTE);
+			byte = static_cast<uint8_t>(byte ^ 0x20);
+		}
+		stuffed.push_back(byte);
+	}
+	stuffed.push_back(ASH_FLAG_BYTE);
+	return stuffed;
+}
+
+} // namespace
+
+MockNcp::MockNcp(MockUartDriver& uartDriver, const std::chrono::microseconds& responseLatency) :
+	MockNcp([&uartDriver](const std::vector<uint8_t>& bytes) {
+		GenericAsyncDataInputObservable* handler = uartDriver.getIncomingDataHandler();
+		if (handler == nullptr) {
+			/* Nobody listening yet (the host writes RST before registering its handler) */
+			return false;
+		}
+		handler->notifyObservers(bytes.data(), bytes.size());
+		return true;
+	}, responseLatency, uartDriver.getVirtualClock()) {
+}
+
+MockNcp::MockNcp(Output output, const std::chrono::microseconds& responseLatency, VirtualClock* virtualClock) :
+	deliveryMutex(),
+	nbDataFrames(0),
+	nbRetransmittedFrames(0),
+	nbDiscardedFrames(0),
+	nbAckFrames(0),
+	maxPendingResponses(0),
+	output(output),
+	latency(responseLatency),
+	responder([](uint8_t cmd, const std::vector<uint8_t>& params) { return std::vector<uint8_t>({ 0x00 }); }),
+	rxFrame(),
+	rxExpectedFrmNum(0),
+	txFrmNum(0),
+	callbackSeq(0),
+	nakCount(0),
+	dropCount(0),
+	ignoreCount(0),
+	queueMutex(),
+	queueCv(),
+	scheduled(),
+	delivering(false),
+	terminate(false),
+	deliveryThread(),
+	virtualClock(virtualClock),
+	virtualDeliveries() {
+	if (this->virtualClock == nullptr) {
+		this->deliveryThread = std::thread(&MockNcp::deliveryLoop, this);
+	}
+}
+
+MockNcp::~MockNcp() {
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+		this->terminate = true;
+		for (const auto& delivery : this->virtualDeliveries) {
+			this->virtualClock->cancel(delivery.second);
+		}
+	}
+	this->queueCv.notify_all();
+	if (this->deliveryThread.joinable()) {
+		this->deliveryThread.join();
+	}
+}
+
+void MockNcp::setResponder(Responder responder) {
+	this->responder = responder;
+}
+
+void MockNcp::nakNextDataFrames(unsigned int count) {
+	this->nakCount = count;
+}
+
+void MockNcp::dropNextDataFrames(unsigned int count) {
+	this->dropCount = count;
+}
+
+void MockNcp::ignoreNextCommands(unsigned int count) {
+	this->ignoreCount = count;
+}
+
+void MockNcp::sendCallbacks(uint8_t cmd, unsigned int count, const std::vector<uint8_t>& params) {
+	std::vector<uint8_t> burst;
+	for (unsigned int loop = 0; loop < count; loop++) {
+		/* Asynchronous callback: frame control 0x90 (response flag and callback type 2) */
+		std::vector<uint8_t> ezspFrame({ this->callbackSeq++, 0x90, 0xFF, 0x00, cmd });
+		ezspFrame.insert(ezspFrame.end(), params.begin(), params.end());
+		std::vector<uint8_t> frame = this->encodeNextDataFrame(ezspFrame);
+		burst.insert(burst.end(), frame.begin(), frame.end());
+	}
+	this->scheduleResponse(burst, this->now());
+}
+
+bool MockNcp::waitIdle(const std::chrono::milliseconds& timeout) {
+	if (this->virtualClock != nullptr) {
+		/* Nothing is delivered unless simulated time moves: run the clock until we are idle, for at most timeout */
+		VirtualClock::TTimePoint deadline = this->virtualClock->now() + timeout;
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(this->queueMutex);
+				if (this->scheduled.empty()) {
+					return true;
+				}
+			}
+			if (!this->virtualClock->runNext(deadline)) {
+				return false;
+			}
+		}
+	}
+	std::unique_lock<std::mutex> lock(this->queueMutex);
+	return this->queueCv.wait_for(lock, timeout, [this]() { return this->scheduled.empty(); });
+}
+
+int MockNcp::onWriteCallback(size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(buf);
+
+	for (size_t loop = 0; loop < cnt; loop++) {
+		if (bytes[loop] == ASH_CANCEL_BYTE) {
+			this->rxFrame.clear();
+		}
+		else if (bytes[loop] == ASH_FLAG_BYTE) {
+			this->processFrame(this->rxFrame);
+			this->rxFrame.clear();
+		}
+		else {
+			this->rxFrame.push_back(bytes[loop]);
+		}
+	}
+	writtenCnt = cnt;
+	return 0;
+}
+
+std::vector<uint8_t> MockNcp::encodeNextDataFrame(const std::vector<uint8_t>& ezspFrame) {
+	uint8_t control = static_cast<uint8_t>((this->txFrmNum << 4) | this->rxExpectedFrmNum);
+	this->txFrmNum = (this->txFrmNum + 1) & 0x07;
+	return encodeDataFrame(control, ezspFrame);
+}
+
+std::vector<uint8_t> MockNcp::encodeDataFrame(uint8_t control, const std::vector<uint8_t>& ezspFrame) {
+	std::vector<uint8_t> frame(1, control);
+	frame.insert(frame.end(), ezspFrame.begin(), ezspFrame.end());
+	randomise(frame.begin() + 1, frame.end());
+	return finaliseFrame(frame);
+}
+
+void MockNcp::processFrame(const std::vector<uint8_t>& stuffedFrame) {
+	std::vector<uint8_t> frame;
+	bool escape = false;
+	for (uint8_t byte : stuffedFrame) {
+		if (byte == ASH_ESCAPE_BYTE) {
+			escape = true;
+			continue;
+		}
+		frame.push_back(escape ? static_cast<uint8_t>(byte ^ 0x20) : byte);
+		escape = false;
+	}
+	if (frame.size() < 3 || CAshCrc::compute(frame.data(), frame.size()) != 0) {
+		this->nbDiscardedFrames++;
+		return;
+	}
+	frame.resize(frame.size() - 2);	/* Drop CRC */
+
+	std::chrono::steady_clock::time_point deadline = this->now() + this->latency;
+	uint8_t control = frame[0];
+
+	if (control == 0xC0) {	/* RST */
+		this->rxExpectedFrmNum = 0;
+		this->txFrmNum = 0;
+		std::vector<uint8_t> rstAck = finaliseFrame(std::vector<uint8_t>({ 0xC1, 0x02, 0x02 }));
+		rstAck.insert(rstAck.begin(), ASH_CANCEL_BYTE);
+		this->scheduleResponse(rstAck, deadline);
+	}
+	else if ((control & 0x80) == 0) {	/* DATA */
+		uint8_t frmNum = (control >> 4) & 0x07;
+		if (frmNum != this->rxExpectedFrmNum) {
+			/* Out of sequence (a previous frame was rejected), wait for the retransmission */
+			this->nbDiscardedFrames++;
+			return;
+		}
+		if (this->dropCount > 0) {
+			this->dropCount--;
+			this->nbDiscardedFrames++;
+			return;
+		}
+		if (this->nakCount > 0) {
+			this->nakCount--;
+			this->nbDiscardedFrames++;
+			this->scheduleResponse(finaliseFrame(std::vector<uint8_t>({ static_cast<uint8_t>(0xA0 | this->rxExpectedFrmNum) })), this->now());
+			return;
+		}
+		this->rxExpectedFrmNum = (this->rxExpectedFrmNum + 1) & 0x07;
+		this->nbDataFrames++;
+		if (control & 0x08) {
+			this->nbRetransmittedFrames++;
+		}
+		if (this->ignoreCount > 0) {
+			this->ignoreCount--;
+			this->scheduleResponse(finaliseFrame(std::vector<uint8_t>({ static_cast<uint8_t>(0x80 | this->rxExpectedFrmNum) })), this->now());
+			return;
+		}
+
+		randomise(frame.begin() + 1, frame.end());
+		if (frame.size() < 4) {
+			return;
+		}
+		/* EZSP frame: sequence, frame control, [extended header], command id, parameters */
+		uint8_t seq = frame[1];
+		size_t cmdIdx = (frame.size() >= 6 && frame[3] == 0xFF) ? 5 : 3;
+		uint8_t cmd = frame[cmdIdx];
+		std::vector<uint8_t> params(frame.begin() + static_cast<std::ptrdiff_t>(cmdIdx) + 1, frame.end());
+
+		std::vector<uint8_t> ezspResponse = { seq, 0x80 };
+		if (cmdIdx == 5) {
+			ezspResponse.push_back(0xFF);
+			ezspResponse.push_back(0x00);
+		}
+		ezspResponse.push_back(cmd);
+		std::vector<uint8_t> responseParams = this->responder(cmd, params);
+		ezspResponse.insert(ezspResponse.end(), responseParams.begin(), responseParams.end());
+
+		this->scheduleResponse(this->encodeNextDataFrame(ezspResponse), deadline);
+	}
+	else if ((control & 0xE0) == 0x80) {	/* ACK */
+		this->nbAckFrames++;
+	}
+	/* Acknowledgements from the host are otherwise ignored: we never retransmit */
+}
+
+void MockNcp::scheduleResponse(const std::vector<uint8_t>& bytes, const std::chrono::steady_clock::time_point& deadline) {
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+		auto entry = this->scheduled.insert(std::make_pair(deadline, bytes));
+		/* The entry being delivered (if any) is not pending anymore */
+		unsigned int pending = static_cast<unsigned int>(this->scheduled.size()) - (this->delivering ? 1 : 0);
+		if (pending > this->maxPendingResponses) {
+			this->maxPendingResponses = pending;
+		}
+		if (this->virtualClock != nullptr) {
+			this->scheduleVirtualDelivery(entry, deadline);
+		}
+	}
+	this->queueCv.notify_all();
+}
+
+void MockNcp::scheduleVirtualDelivery(std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t> >::iterator entry, const std::chrono::steady_clock::time_point& deadline) {
+	this->virtualDeliveries[&entry->second] = this->virtualClock->scheduleAt(deadline, [this, entry]() { this->deliverVirtual(entry); });
+}
+
+void MockNcp::deliverVirtual(std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t> >::iterator entry) {
+	std::vector<uint8_t> bytes;
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+		this->virtualDeliveries.erase(&entry->second);
+		bytes = entry->second;
+		this->delivering = true;
+	}
+	/* Run by the thread advancing the clock, which is the only one running the host: no need for deliveryMutex */
+	bool delivered = this->output(bytes);
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	this->delivering = false;
+	if (!delivered) {
+		/* Nobody listening yet, retry shortly */
+		this->scheduleVirtualDelivery(entry, this->virtualClock->now() + std::chrono::milliseconds(1));
+		return;
+	}
+	this->scheduled.erase(entry);
+	this->queueCv.notify_all();
+}
+
+std::chrono::steady_clock::time_point MockNcp::now() const {
+	return (this->virtualClock != nullptr) ? this->virtualClock->now() : std::chrono::steady_clock::now();
+}
+
+void MockNcp::deliveryLoop() {
+	std::unique_lock<std::mutex> lock(this->queueMutex);
+	while (!this->terminate) {
+		if (this->scheduled.empty()) {
+			this->queueCv.wait(lock);
+			continue;
+		}
+		auto next = this->scheduled.begin();
+		if (std::chrono::steady_clock::now() < next->first) {
+			/* Not due yet, wait for its deadline or a new earlier entry */
+			this->queueCv.wait_until(lock, next->first);
+			continue;
+		}
+		std::vector<uint8_t> bytes = next->second;
+		this->delivering = true;
+		lock.unlock();
+		bool delivered;
+		{
+			std::lock_guard<std::mutex> deliveryLock(this->deliveryMutex);
+			delivered = this->output(bytes);
+		}
+		lock.lock();
+		if (!delivered) {
+			/* Nobody listening yet, retry shortly */
+			this->delivering = false;
+			this->queueCv.wait_for(lock, std::chrono::milliseconds(1));
+			continue;
+		}
+		/* Only remove the entry now, so that waitIdle() does not return while the host is still processing it (other entries may have been inserted, but next is still valid) */
+		this->scheduled.erase(next);
+		this->delivering = false;
+		this->queueCv.notify_all();
+	}
+}
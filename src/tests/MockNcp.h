@@ -0,0 +1,164 @@
+/**
+ * @file MockNcp.h
+ *
+ * @brief Emulated EZSP NCP answering ASH frames written to a MockUartDriver (or to a pseudo-terminal, see PtyNcp), for unit
+ *        tests and benchmarks
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <stdint.h>
+
+#include "../spi/mock-uart/MockUartDriver.h"
+
+/**
+ * @brief Emulated NCP
+ *
+ * Its onWriteCallback() method is to be used as the write callback of a MockUartDriver. It decodes ASH frames written by
+ * the host, answers RST with RSTACK and each in-sequence DATA frame with a DATA response carrying a piggybacked
+ * acknowledgement.
+ *
+ * Responses are delivered on the UART incoming data handler from a dedicated thread, each one @p latency after the
+ * command it answers was written, regardless of the other pending responses, so that commands sent back-to-back are
+ * answered back-to-back (which MockUartDriver::scheduleIncomingChunk() cannot emulate, as its delays are relative to the
+ * previous chunk).
+ *
+ * Because the host library is not thread-safe, deliveries are made with deliveryMutex held. The test code must hold this
+ * mutex as well when invoking the library from another thread.
+ *
+ * When the emulated UART runs on a VirtualClock, there is no delivery thread: responses are scheduled as events of the
+ * clock, and delivered (without deliveryMutex) by the thread advancing it, which is then the only one running the host.
+ */
+class MockNcp {
+public:
+	/**
+	 * @brief EZSP command handler, gets the command id and its parameters, returns the response parameters
+	 */
+	typedef std::function<std::vector<uint8_t> (uint8_t cmd, const std::vector<uint8_t>& params)> Responder;
+
+	/**
+	 * @brief Transport of the bytes we send to the host, returns false if the host is not listening yet (the bytes are then
+	 *        delivered again shortly after)
+	 */
+	typedef std::function<bool (const std::vector<uint8_t>& bytes)> Output;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param uartDriver The emulated UART we deliver responses on (its write callback must invoke onWriteCallback()), we
+	 *        share its simulated clock, if any
+	 * @param responseLatency The delay between a command and its response
+	 */
+	MockNcp(MockUartDriver& uartDriver, const std::chrono::microseconds& responseLatency = std::chrono::microseconds(0));
+
+	/**
+	 * @brief Constructor for other transports (see PtyNcp)
+	 *
+	 * @param output Delivers our bytes to the host, bytes written by the host must be given to onWriteCallback()
+	 * @param responseLatency The delay between a command and its response
+	 * @param virtualClock The simulated clock to deliver responses on, nullptr to use a real-time delivery thread
+	 */
+	MockNcp(Output output, const std::chrono::microseconds& responseLatency = std::chrono::microseconds(0), VirtualClock* virtualClock = nullptr);
+
+	~MockNcp();
+
+	MockNcp(const MockNcp& other) = delete; /* No copy construction allowed */
+
+	MockNcp& operator=(const MockNcp& other) = delete; /* No assignment allowed */
+
+	/**
+	 * @brief Write callback to register to the MockUartDriver
+	 */
+	int onWriteCallback(size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta);
+
+	/**
+	 * @brief Set the handler building responses (by default, all commands are answered with a single 0x00 status byte)
+	 */
+	void setResponder(Responder responder);
+
+	/**
+	 * @brief Reject the next @p count DATA frames received with a NAK
+	 */
+	void nakNextDataFrames(unsigned int count);
+
+	/**
+	 * @brief Silently ignore the next @p count DATA frames received, as if they were lost on the line
+	 */
+	void dropNextDataFrames(unsigned int count);
+
+	/**
+	 * @brief Acknowledge the next @p count DATA frames received but never answer them, as a wedged NCP would
+	 */
+	void ignoreNextCommands(unsigned int count);
+
+	/**
+	 * @brief Send a burst of unsolicited asynchronous callbacks to the host, at once
+	 *
+	 * @param cmd The EZSP command id of the callbacks
+	 * @param count The number of callbacks to send
+	 * @param params The parameters of each callback
+	 *
+	 * @note To be invoked with deliveryMutex held, as it shares our frame numbers with the host write path
+	 */
+	void sendCallbacks(uint8_t cmd, unsigned int count, const std::vector<uint8_t>& params = std::vector<uint8_t>({ 0x00 }));
+
+	/**
+	 * @brief Wait until all pending responses have been delivered
+	 *
+	 * With a simulated clock, the clock is advanced instead (also running the events of other objects falling due meanwhile)
+	 *
+	 * @return false if they were not delivered within @p timeout
+	 */
+	bool waitIdle(const std::chrono::milliseconds& timeout);
+
+	/**
+	 * @brief Build an encoded ASH DATA frame
+	 *
+	 * @param control The ASH control byte
+	 * @param ezspFrame The EZSP frame (sequence, frame control, [extended header], command id, parameters), not randomised
+	 */
+	static std::vector<uint8_t> encodeDataFrame(uint8_t control, const std::vector<uint8_t>& ezspFrame);
+
+	std::mutex deliveryMutex;	/*!< Held while delivering bytes to the host */
+
+	unsigned int nbDataFrames;	/*!< Number of in-sequence DATA frames received */
+	unsigned int nbRetransmittedFrames;	/*!< Number of in-sequence DATA frames received with the retransmit flag */
+	unsigned int nbDiscardedFrames;	/*!< Number of invalid, out of sequence, rejected or dropped frames received */
+	unsigned int nbAckFrames;	/*!< Number of ACK frames received */
+	unsigned int maxPendingResponses;	/*!< Maximum number of frames scheduled and not yet delivered to the host at the same time */
+
+private:
+	void processFrame(const std::vector<uint8_t>& frame);
+	std::vector<uint8_t> encodeNextDataFrame(const std::vector<uint8_t>& ezspFrame);
+	void scheduleResponse(const std::vector<uint8_t>& bytes, const std::chrono::steady_clock::time_point& deadline);
+	void deliveryLoop();
+	void scheduleVirtualDelivery(std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t> >::iterator entry, const std::chrono::steady_clock::time_point& deadline);
+	void deliverVirtual(std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t> >::iterator entry);
+	std::chrono::steady_clock::time_point now() const;
+
+	Output output;	/*!< Delivers our bytes to the host */
+	std::chrono::microseconds latency;	/*!< The delay between a command and its response */
+	Responder responder;	/*!< Builds responses parameters */
+	std::vector<uint8_t> rxFrame;	/*!< Stuffed bytes of the frame being received */
+	uint8_t rxExpectedFrmNum;	/*!< Next host frame number we expect (our ASH ack number) */
+	uint8_t txFrmNum;	/*!< Next frame number we send */
+	uint8_t callbackSeq;	/*!< EZSP sequence number of the next callback we send */
+	unsigned int nakCount;	/*!< Number of DATA frames still to be rejected */
+	unsigned int dropCount;	/*!< Number of DATA frames still to be ignored */
+	unsigned int ignoreCount;	/*!< Number of commands still to be left unanswered */
+	std::mutex queueMutex;	/*!< Protects scheduled */
+	std::condition_variable queueCv;	/*!< Signalled when scheduled changes or on termination */
+	std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t> > scheduled;	/*!< Bytes to deliver, by delivery time */
+	bool delivering;	/*!< The first entry of scheduled is being delivered */
+	bool terminate;	/*!< Request the delivery thread to terminate */
+	std::thread deliveryThread;	/*!< Delivers the scheduled bytes, without simulated clock */
+	VirtualClock* virtualClock;	/*!< The simulated clock delivering the scheduled bytes, if any */
+	std::map<const std::vector<uint8_t>*, VirtualClock::TEventId> virtualDeliveries;	/*!< Delivery events still scheduled on virtualClock, by scheduled entry, cancelled at destruction */
+};
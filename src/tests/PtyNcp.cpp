@@ -0,0 +1,228 @@
+/**
+ * @file PtyNcp.cpp
+ *
+ * @brief Emulated EZSP NCP on a pseudo-terminal, driven through a real UART driver, for load and latency tests
+ */
+
+#include "PtyNcp.h"
+
+#include <cerrno>
+#include <iterator>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "../domain/ezsp-protocol/ezsp-enum.h"
+#include "../domain/ezsp-protocol/struct/ember-gp-sink-table-entry-struct.h"
+
+const uint8_t EmulatedEzspStack::SINK_TABLE_SIZE;
+
+EmulatedEzspStack::EmulatedEzspStack() :
+	protocolVersion(8),
+	stackVersion(0x6700),
+	networkState(EMBER_JOINED_NETWORK),
+	configValues(),
+	sinkIndexes(),
+	sinkEntries() {
+}
+
+std::vector<uint8_t> EmulatedEzspStack::respond(uint8_t cmd, const std::vector<uint8_t>& params) {
+	switch (cmd) {
+		case EZSP_VERSION:
+			/* Protocol version, stack type (mesh), stack version */
+			return std::vector<uint8_t>({ this->protocolVersion, 0x02, static_cast<uint8_t>(this->stackVersion & 0xFF), static_cast<uint8_t>(this->stackVersion >> 8) });
+		case EZSP_SET_CONFIGURATION_VALUE:
+			if (params.size() >= 3) {
+				this->configValues[params[0]] = static_cast<uint16_t>(params[1] | (params[2] << 8));
+			}
+			return std::vector<uint8_t>({ EMBER_SUCCESS });
+		case EZSP_GET_CONFIGURATION_VALUE: {
+			uint16_t value = params.empty() ? 0 : this->configValues[params[0]];
+			return std::vector<uint8_t>({ EMBER_SUCCESS, static_cast<uint8_t>(value & 0xFF), static_cast<uint8_t>(value >> 8) });
+		}
+		case EZSP_NETWORK_STATE:
+			return std::vector<uint8_t>({ this->networkState });
+		case EZSP_GP_PROXY_TABLE_GET_ENTRY:
+			/* Empty proxy table, any status but EMBER_SUCCESS marks its end */
+			return std::vector<uint8_t>({ EMBER_ERR_FATAL });
+		case EZSP_GP_PROXY_TABLE_LOOKUP:
+			return std::vector<uint8_t>({ 0xFF });
+		case EZSP_GP_SINK_TABLE_LOOKUP: {
+			auto it = this->sinkIndexes.find(params);
+			return std::vector<uint8_t>({ (it == this->sinkIndexes.end()) ? static_cast<uint8_t>(0xFF) : it->second });
+		}
+		case EZSP_GP_SINK_TABLE_FIND_OR_ALLOCATE_ENTRY: {
+			auto it = this->sinkIndexes.find(params);
+			if (it != this->sinkIndexes.end()) {
+				return std::vector<uint8_t>({ it->second });
+			}
+			for (uint8_t index = 0; index < SINK_TABLE_SIZE; index++) {
+				bool allocated = false;
+				for (const auto& entry : this->sinkIndexes) {
+					allocated = allocated || (entry.second == index);
+				}
+				if (!allocated) {
+					this->sinkIndexes[params] = index;
+					return std::vector<uint8_t>({ index });
+				}
+			}
+			return std::vector<uint8_t>({ 0xFF });	/* Table full */
+		}
+		case EZSP_GP_SINK_TABLE_GET_ENTRY: {
+			if (params.empty() || params[0] >= SINK_TABLE_SIZE) {
+				return std::vector<uint8_t>({ EMBER_ERR_FATAL });
+			}
+			/* Entries never set are unused (default entry) */
+			auto it = this->sinkEntries.find(params[0]);
+			std::vector<uint8_t> entry = (it == this->sinkEntries.end()) ? CEmberGpSinkTableEntryStruct().getRaw() : it->second;
+			std::vector<uint8_t> response({ EMBER_SUCCESS });
+			response.insert(response.end(), entry.begin(), entry.end());
+			return response;
+		}
+		case EZSP_GP_SINK_TABLE_SET_ENTRY:
+			if (params.empty() || params[0] >= SINK_TABLE_SIZE) {
+				return std::vector<uint8_t>({ EMBER_ERR_FATAL });
+			}
+			this->sinkEntries[params[0]] = std::vector<uint8_t>(params.begin() + 1, params.end());
+			return std::vector<uint8_t>({ EMBER_SUCCESS });
+		case EZSP_GP_SINK_TABLE_REMOVE_ENTRY:
+			if (!params.empty()) {
+				this->sinkEntries.erase(params[0]);
+				for (auto it = this->sinkIndexes.begin(); it != this->sinkIndexes.end(); ) {
+					it = (it->second == params[0]) ? this->sinkIndexes.erase(it) : std::next(it);
+				}
+			}
+			return std::vector<uint8_t>();
+		case EZSP_GP_SINK_TABLE_CLEAR_ALL:
+			this->sinkEntries.clear();
+			this->sinkIndexes.clear();
+			return std::vector<uint8_t>();
+		case EZSP_GP_SINK_TABLE_INIT:
+			return std::vector<uint8_t>();
+		default:
+			return std::vector<uint8_t>({ 0x00 });
+	}
+}
+
+PtyNcp::PtyNcp(const std::chrono::microseconds& responseLatency) :
+	master(posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)),
+	slave(-1),
+	stopFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+	portName(),
+	stack(),
+	ncp(new MockNcp([this](const std::vector<uint8_t>& bytes) {
+		size_t writtenCnt = 0;
+		while (writtenCnt < bytes.size()) {
+			ssize_t result = ::write(this->master, bytes.data() + writtenCnt, bytes.size() - writtenCnt);
+			if (result < 0 && errno != EINTR) {
+				break;	/* Dropped, as on a broken line */
+			}
+			writtenCnt += (result > 0) ? static_cast<size_t>(result) : 0;
+		}
+		return true;
+	}, responseLatency)),
+	readThread(),
+	callbackMutex(),
+	callbackCv(),
+	callbacksRunning(false),
+	nbCallbacks(0),
+	callbackThread() {
+	if (this->master < 0 || this->stopFd < 0 || grantpt(this->master) != 0 || unlockpt(this->master) != 0) {
+		return;
+	}
+	this->slave = ::open(ptsname(this->master), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (this->slave < 0) {
+		return;
+	}
+	/* Raw until the host sets its own mode, so that nothing we write is echoed back to us */
+	struct termios tio;
+	tcgetattr(this->slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(this->slave, TCSANOW, &tio);
+	this->portName = ptsname(this->master);
+	this->ncp->setResponder([this](uint8_t cmd, const std::vector<uint8_t>& params) { return this->stack.respond(cmd, params); });
+	this->readThread = std::thread(&PtyNcp::readLoop, this);
+}
+
+PtyNcp::~PtyNcp() {
+	this->stopCallbacks();
+	if (this->readThread.joinable()) {
+		uint64_t one = 1;
+		if (::write(this->stopFd, &one, sizeof(one)) == sizeof(one)) {
+			this->readThread.join();
+		}
+	}
+	/* Stop the deliveries before closing the master side they are written to */
+	this->ncp.reset();
+	for (int fd : { this->master, this->slave, this->stopFd }) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+}
+
+void PtyNcp::startCallbacks(uint8_t cmd, const std::vector<uint8_t>& params, unsigned int rate, unsigned int burst) {
+	this->stopCallbacks();
+	if (rate == 0 || burst == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(this->callbackMutex);
+	this->callbacksRunning = true;
+	this->nbCallbacks = 0;
+	this->callbackThread = std::thread(&PtyNcp::callbackLoop, this, cmd, params, rate, burst);
+}
+
+unsigned int PtyNcp::stopCallbacks() {
+	{
+		std::lock_guard<std::mutex> lock(this->callbackMutex);
+		this->callbacksRunning = false;
+	}
+	this->callbackCv.notify_all();
+	if (this->callbackThread.joinable()) {
+		this->callbackThread.join();
+	}
+	return this->nbCallbacks;
+}
+
+void PtyNcp::readLoop() {
+	uint8_t buf[4096];
+	struct pollfd pfds[2] = { { this->master, POLLIN, 0 }, { this->stopFd, POLLIN, 0 } };
+
+	while (true) {
+		if (poll(pfds, 2, -1) < 0 && errno != EINTR) {
+			return;
+		}
+		if (pfds[1].revents != 0) {
+			return;
+		}
+		if (pfds[0].revents & POLLIN) {
+			ssize_t rdcnt = ::read(this->master, buf, sizeof(buf));
+			if (rdcnt > 0) {
+				size_t writtenCnt;
+				std::lock_guard<std::mutex> lock(this->ncp->deliveryMutex);
+				this->ncp->onWriteCallback(writtenCnt, buf, static_cast<size_t>(rdcnt), std::chrono::duration<double, std::milli>(0));
+			}
+		}
+	}
+}
+
+void PtyNcp::callbackLoop(uint8_t cmd, std::vector<uint8_t> params, unsigned int rate, unsigned int burst) {
+	const std::chrono::microseconds period(1000000ULL * burst / rate);
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(this->callbackMutex);
+
+	while (this->callbacksRunning) {
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> deliveryLock(this->ncp->deliveryMutex);
+			this->ncp->sendCallbacks(cmd, burst, params);
+		}
+		lock.lock();
+		this->nbCallbacks += burst;
+		next += period;
+		this->callbackCv.wait_until(lock, next, [this]() { return !this->callbacksRunning; });
+	}
+}
@@ -0,0 +1,121 @@
+/**
+ * @file PtyNcp.h
+ *
+ * @brief Emulated EZSP NCP on a pseudo-terminal, driven through a real UART driver, for load and latency tests
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+
+#include "MockNcp.h"
+
+/**
+ * @brief Emulated EZSP stack, answering a subset of the EZSP commands as a real NCP would
+ *
+ * Supported commands: version, get/set configuration value, network state and the GP proxy and sink tables (the proxy
+ * table is always empty, sink table entries are allocated by GPD address). Other commands are answered with a single
+ * 0x00 status byte, as MockNcp does by default.
+ *
+ * Use respond() as the MockNcp responder, from the thread processing the host frames only.
+ */
+class EmulatedEzspStack {
+public:
+	static const uint8_t SINK_TABLE_SIZE = 8;	/*!< Number of entries in the emulated GP sink table */
+
+	EmulatedEzspStack();
+
+	/**
+	 * @brief Build the response parameters of an EZSP command
+	 */
+	std::vector<uint8_t> respond(uint8_t cmd, const std::vector<uint8_t>& params);
+
+	uint8_t protocolVersion;	/*!< EZSP protocol version answered to EZSP_VERSION */
+	uint16_t stackVersion;	/*!< Stack version answered to EZSP_VERSION */
+	uint8_t networkState;	/*!< State answered to EZSP_NETWORK_STATE (an EmberNetworkStatus) */
+	std::map<uint8_t, uint16_t> configValues;	/*!< Configuration values, by EzspConfigId */
+	std::map<std::vector<uint8_t>, uint8_t> sinkIndexes;	/*!< Allocated sink table entries, by GPD address */
+	std::map<uint8_t, std::vector<uint8_t> > sinkEntries;	/*!< Sink table entries set, by index */
+};
+
+/**
+ * @brief Emulated NCP sitting on the master side of a pseudo-terminal pair
+ *
+ * The host opens the slave side (getPortName()) with any UART driver, as it would open a real adapter. Bytes written by
+ * the host are read from the master side and processed by a MockNcp, which writes its responses back to the master side.
+ * By default, commands are answered by an EmulatedEzspStack.
+ *
+ * Callbacks can be generated at a constant rate with startCallbacks(), to load the host while it sends commands.
+ */
+class PtyNcp {
+public:
+	/**
+	 * @brief Constructor, creates the pseudo-terminal pair
+	 *
+	 * @param responseLatency The delay between a command and its response
+	 */
+	PtyNcp(const std::chrono::microseconds& responseLatency = std::chrono::microseconds(0));
+
+	~PtyNcp();
+
+	PtyNcp(const PtyNcp& other) = delete; /* No copy construction allowed */
+
+	PtyNcp& operator=(const PtyNcp& other) = delete; /* No assignment allowed */
+
+	/**
+	 * @brief Get the name of the serial port the host must open, empty if the pseudo-terminal pair could not be created
+	 */
+	const std::string& getPortName() const { return this->portName; }
+
+	/**
+	 * @brief Get the emulated NCP, to set its responder, inject errors or read its counters (with its deliveryMutex held)
+	 */
+	MockNcp& getNcp() { return *this->ncp; }
+
+	/**
+	 * @brief Get the emulated EZSP stack answering commands, to be modified with the NCP deliveryMutex held
+	 */
+	EmulatedEzspStack& getStack() { return this->stack; }
+
+	/**
+	 * @brief Send callbacks to the host at a constant rate, until stopCallbacks()
+	 *
+	 * @param cmd The EZSP command id of the callbacks (eg: EZSP_GPEP_INCOMING_MESSAGE_HANDLER, EZSP_INCOMING_MESSAGE_HANDLER)
+	 * @param params The parameters of each callback
+	 * @param rate The number of callbacks per second
+	 * @param burst The number of callbacks sent at once, at rate / burst bursts per second
+	 */
+	void startCallbacks(uint8_t cmd, const std::vector<uint8_t>& params, unsigned int rate, unsigned int burst = 1);
+
+	/**
+	 * @brief Stop sending callbacks
+	 *
+	 * @return The number of callbacks sent since startCallbacks()
+	 */
+	unsigned int stopCallbacks();
+
+private:
+	void readLoop();
+	void callbackLoop(uint8_t cmd, std::vector<uint8_t> params, unsigned int rate, unsigned int burst);
+
+	int master;	/*!< Master side file descriptor, -1 on failure */
+	int slave;	/*!< Slave side file descriptor, kept open so that the master side never hangs up between host sessions */
+	int stopFd;	/*!< An eventfd signalled to stop the read thread */
+	std::string portName;	/*!< Slave side device name */
+	EmulatedEzspStack stack;	/*!< Answers the commands by default */
+	std::unique_ptr<MockNcp> ncp;	/*!< Processes host frames and schedules our responses (destroyed before master is closed) */
+	std::thread readThread;	/*!< Reads the bytes written by the host */
+	std::mutex callbackMutex;	/*!< Protects callbacksRunning */
+	std::condition_variable callbackCv;	/*!< Signalled when callbacks are stopped */
+	bool callbacksRunning;	/*!< Callbacks are being sent */
+	unsigned int nbCallbacks;	/*!< Callbacks sent by callbackThread */
+	std::thread callbackThread;	/*!< Sends callbacks at a constant rate */
+};
@@ -0,0 +1,212 @@
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "BenchHarness.h"
+#include "../domain/ash-crc.h"
+#include "../domain/ash-randomiser.h"
+#include "../domain/ash-stuffing.h"
+#include "../domain/ash.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+#include "../spi/virtual-clock/VirtualClock.h"
+
+/**
+ * @brief ASH callback that only counts decoded DATA frames
+ */
+class AshBenchCounter : public CAshCallback {
+public:
+	AshBenchCounter() : nbFrames(0) { }
+	void ashCbInfo(EAshInfo info) { }
+	void ashCbData(const uint8_t *i_data, std::size_t i_len) { nbFrames++; }
+	unsigned long nbFrames;
+};
+
+/**
+ * @brief Compare CRC-CCITT implementations on ASH-sized frames (from a 3-byte ACK to a 131-byte DATA frame)
+ */
+static void bench_ash_crc() {
+	const size_t frameLengths[] = { 3, 8, 16, 32, 64, 100, 131 };
+	const unsigned long iterations = 200000;
+
+	for (size_t len : frameLengths) {
+		std::vector<uint8_t> frame(len);
+		for (size_t i = 0; i < len; i++) {
+			frame[i] = static_cast<uint8_t>(i * 37 + 11);
+		}
+
+		std::string prefix = "crc " + std::to_string(len) + " bytes ";
+		double bitwise = benchRun((prefix + "bitwise").c_str(), iterations, [&frame]() {
+			benchKeep(CAshCrc::computeBitwise(frame.data(), frame.size()));
+			frame[0]++;
+		});
+		double bytewise = benchRun((prefix + "table").c_str(), iterations, [&frame]() {
+			benchKeep(CAshCrc::computeBytewise(frame.data(), frame.size()));
+			frame[0]++;
+		});
+		double slice8 = benchRun((prefix + "slice-by-8").c_str(), iterations, [&frame]() {
+			benchKeep(CAshCrc::compute(frame.data(), frame.size()));
+			frame[0]++;
+		});
+		printf("%-48s %12.1fx table, %.1fx slice-by-8\n", (prefix + "speedup vs bitwise").c_str(), bitwise / bytewise, bitwise / slice8);
+	}
+}
+
+/**
+ * @brief Compare the byte-by-byte LFSR with the precomputed word-wide randomiser
+ */
+static void bench_ash_randomise() {
+	const size_t frameLengths[] = { 8, 32, 64, 128 };
+	const unsigned long iterations = 500000;
+
+	for (size_t len : frameLengths) {
+		std::vector<uint8_t> data(len, 0x5A);
+
+		std::string prefix = "randomise " + std::to_string(len) + " bytes ";
+		double bytewise = benchRun((prefix + "lfsr").c_str(), iterations, [&data]() {
+			CAshRandomiser::applyBytewise(data.data(), data.size());
+			benchKeep(data[0]);
+		});
+		double table = benchRun((prefix + "table").c_str(), iterations, [&data]() {
+			CAshRandomiser::apply(data.data(), data.size());
+			benchKeep(data[0]);
+		});
+		printf("%-48s %12.1fx\n", (prefix + "speedup").c_str(), bytewise / table);
+	}
+}
+
+/**
+ * @brief Compare reserved byte scanners on randomised data fields, as found in real EZSP frames
+ *
+ * Once randomised, about 1 byte out of 40 is reserved, so each frame is scanned as a few clean runs.
+ */
+static void bench_ash_stuffing() {
+	const size_t frameLengths[] = { 8, 32, 64, 128 };
+	const CAshStuffing::EScanner scanners[] = { CAshStuffing::SCAN_SCALAR, CAshStuffing::SCAN_SSE2, CAshStuffing::SCAN_AVX2 };
+	const char* scannerNames[] = { "scalar", "sse2", "avx2" };
+	const unsigned long iterations = 500000;
+
+	for (size_t len : frameLengths) {
+		/* An EZSP sendRawMessage-like payload: small counters and addresses, then zero padding */
+		std::vector<uint8_t> data(len);
+		for (size_t i = 0; i < len; i++) {
+			data[i] = (i < len / 2) ? static_cast<uint8_t>(i * 7) : 0x00;
+		}
+		CAshRandomiser::apply(data.data(), data.size());
+
+		for (CAshStuffing::EScanner scanner : scanners) {
+			CAshStuffing::ScanFunction scan = CAshStuffing::getScanFunction(scanner);
+			if (scan == nullptr) {
+				continue;
+			}
+			std::string name = "scan " + std::to_string(len) + " bytes " + scannerNames[scanner];
+			benchRun(name.c_str(), iterations, [&data, scan]() {
+				/* Walk all clean runs, as stuff() does */
+				size_t pos = 0;
+				while (pos < data.size()) {
+					pos += scan(data.data() + pos, data.size() - pos) + 1;
+				}
+				benchKeep(pos);
+			});
+		}
+
+		std::vector<uint8_t> out(2 * len);
+		std::string name = "stuff " + std::to_string(len) + " bytes (" + scannerNames[CAshStuffing::getSelectedScanner()] + ")";
+		benchRun(name.c_str(), iterations, [&data, &out]() {
+			benchKeep(CAshStuffing::stuff(data.data(), data.size(), out.data()));
+		});
+	}
+}
+
+/**
+ * @brief Build the encoded ASH ACK frames acknowledging each frame number, indexed by the frame number they acknowledge
+ */
+static std::vector<std::vector<uint8_t>> benchAckFrames() {
+	std::vector<std::vector<uint8_t>> acks;
+
+	for (uint8_t frmNum = 0; frmNum < 8; frmNum++) {
+		const uint8_t control = static_cast<uint8_t>(0x80 | ((frmNum + 1) & 0x07));
+		uint8_t frame[CAsh::ASH_MAX_ENCODED_LENGTH];
+		uint8_t *out = frame;
+		uint16_t crc = CAshCrc::compute(&control, 1);
+		const uint8_t raw[3] = { control, static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc & 0xFF) };
+
+		out += CAshStuffing::stuff(raw, sizeof(raw), out);
+		*out++ = 0x7E;
+		acks.push_back(std::vector<uint8_t>(frame, out));
+	}
+	return acks;
+}
+
+/**
+ * @brief Encode DATA frames, through the vector API and into a caller-provided buffer
+ *
+ * Each frame is acknowledged right away, so that the TX window never gets full. The acknowledgement timer restarted by
+ * each frame runs on a virtual clock, so that starting and stopping it costs no thread
+ */
+static void bench_ash_encode() {
+	VirtualClock clock;
+	AshBenchCounter cb;
+	CAsh encoder(&cb, clock);
+	const std::vector<std::vector<uint8_t>> acks = benchAckFrames();
+	uint8_t frmNum = 0;
+	const size_t paramLengths[] = { 0, 16, 64, 120 };
+	const unsigned long iterations = 200000;
+
+	for (size_t len : paramLengths) {
+		std::vector<uint8_t> params(len, 0x33);
+		std::vector<uint8_t> command(params);
+		command.insert(command.begin(), 0x05);
+		uint8_t frame[CAsh::ASH_MAX_ENCODED_LENGTH];
+
+		std::string prefix = "encode DATA " + std::to_string(len) + " param bytes ";
+		double vectorApi = benchRun((prefix + "vector").c_str(), iterations, [&encoder, &command, &acks, &frmNum]() {
+			benchKeep(encoder.DataFrame(command).size());
+			encoder.decode(acks[frmNum].data(), acks[frmNum].size());
+			frmNum = (frmNum + 1) & 0x07;
+		});
+		double bufferApi = benchRun((prefix + "buffer").c_str(), iterations, [&encoder, &params, &frame, &acks, &frmNum]() {
+			benchKeep(encoder.DataFrame(0x05, params.data(), params.size(), frame));
+			encoder.decode(acks[frmNum].data(), acks[frmNum].size());
+			frmNum = (frmNum + 1) & 0x07;
+		});
+		printf("%-48s %12.1fx\n", (prefix + "speedup").c_str(), vectorApi / bufferApi);
+	}
+}
+
+/**
+ * @brief Decode bursts of back-to-back DATA frames, delivered in one chunk as a UART driver would
+ */
+static void bench_ash_decode() {
+	CppThreadsTimerFactory timerFactory;
+	AshBenchCounter encoderCb;
+	CAsh encoder(&encoderCb, timerFactory);
+	const std::vector<std::vector<uint8_t>> acks = benchAckFrames();
+	uint8_t frmNum = 0;
+	const size_t framesPerBurst[] = { 1, 8, 32 };
+
+	for (size_t nbFrames : framesPerBurst) {
+		std::vector<uint8_t> burst;
+		for (size_t i = 0; i < nbFrames; i++) {
+			std::vector<uint8_t> frame = encoder.DataFrame(std::vector<uint8_t>(64, static_cast<uint8_t>(i)));
+			burst.insert(burst.end(), frame.begin(), frame.end());
+			encoder.decode(acks[frmNum].data(), acks[frmNum].size());
+			frmNum = (frmNum + 1) & 0x07;
+		}
+
+		AshBenchCounter decoderCb;
+		CAsh decoder(&decoderCb, timerFactory);
+		std::string name = "decode burst of " + std::to_string(nbFrames) + " frames (" + std::to_string(burst.size()) + " bytes)";
+		benchRun(name.c_str(), 20000, [&decoder, &burst]() {
+			decoder.decode(burst.data(), burst.size());
+		});
+		benchKeep(decoderCb.nbFrames);
+	}
+}
+
+void bench_ash() {
+	bench_ash_crc();
+	bench_ash_randomise();
+	bench_ash_stuffing();
+	bench_ash_encode();
+	bench_ash_decode();
+}
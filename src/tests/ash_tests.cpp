@@ -0,0 +1,442 @@
+#include "TestHarness.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+
+#include "../domain/ash-crc.h"
+#include "../domain/ash-randomiser.h"
+#include "../domain/ash-stuffing.h"
+#include "../domain/ash.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+
+/**
+ * @brief ASH callback recording everything CAsh reports
+ */
+class AshDecodeRecorder : public CAshCallback {
+public:
+	AshDecodeRecorder() : mutex(), frames(), infos() { }
+
+	void ashCbInfo(EAshInfo info) {
+		std::lock_guard<std::mutex> lock(mutex);	/* Timeouts are reported from the timer thread */
+		infos.push_back(info);
+	}
+
+	size_t countInfo(EAshInfo info) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<size_t>(std::count(infos.begin(), infos.end(), info));
+	}
+
+	void ashCbData(const uint8_t *i_data, std::size_t i_len) {
+		frames.push_back(std::vector<uint8_t>(i_data, i_data + i_len));
+	}
+
+	std::mutex mutex;	/*!< Protects infos */
+	std::vector< std::vector<uint8_t> > frames;	/*!< DATA frames received, in order */
+	std::vector<EAshInfo> infos;	/*!< Info events received, in order */
+};
+
+/**
+ * @brief Build an encoded ASH ACK frame
+ */
+static std::vector<uint8_t> ashAckFrame(uint8_t ackNum) {
+	const uint8_t control = static_cast<uint8_t>(0x80 | (ackNum & 0x07));
+	uint16_t crc = CAshCrc::compute(&control, 1);
+	std::vector<uint8_t> frame;
+
+	for (uint8_t byte : { control, static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc & 0xFF) }) {
+		if (byte == 0x7E || byte == 0x7D || byte == 0x11 || byte == 0x13 || byte == 0x18 || byte == 0x1A) {
+			frame.push_back(0x7D);
+			byte = static_cast<uint8_t>(byte ^ 0x20);
+		}
+		frame.push_back(byte);
+	}
+	frame.push_back(0x7E);
+	return frame;
+}
+
+TEST_GROUP(ash_tests) {
+};
+
+TEST(ash_tests, ash_crc_check_value) {
+	const uint8_t checkString[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+	if (CAshCrc::compute(checkString, sizeof(checkString)) != 0x29B1) {
+		FAILF("Wrong CRC-CCITT check value: 0x%04x", CAshCrc::compute(checkString, sizeof(checkString)));
+	}
+	if (CAshCrc::computeBitwise(checkString, sizeof(checkString)) != 0x29B1) {
+		FAILF("Wrong bitwise CRC-CCITT check value");
+	}
+	if (CAshCrc::computeBytewise(checkString, sizeof(checkString)) != 0x29B1) {
+		FAILF("Wrong bytewise CRC-CCITT check value");
+	}
+
+	/* ASH RST frame is sent as 0xC0 0x38 0xBC */
+	const uint8_t rstFrame[] = { 0xC0, 0x38, 0xBC };
+	if (CAshCrc::compute(rstFrame, 1) != 0x38BC) {
+		FAILF("Wrong CRC on RST frame: 0x%04x", CAshCrc::compute(rstFrame, 1));
+	}
+	if (CAshCrc::compute(rstFrame, sizeof(rstFrame)) != 0) {
+		FAILF("CRC computed over a valid frame including its CRC should be 0");
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_crc_implementations_match) {
+	std::vector<uint8_t> buf;
+	uint8_t pseudoRandom = 0x5A;
+
+	/* Compare all implementations on every length up to an ASH frame (plus its CRC), with and without slice-by-8 tail */
+	for (unsigned int len = 0; len <= 133; len++) {
+		uint16_t expected = CAshCrc::computeBitwise(buf.data(), buf.size());
+		if (CAshCrc::computeBytewise(buf.data(), buf.size()) != expected) {
+			FAILF("Bytewise CRC mismatch on a %u byte buffer", len);
+		}
+		if (CAshCrc::compute(buf.data(), buf.size()) != expected) {
+			FAILF("Slice-by-8 CRC mismatch on a %u byte buffer", len);
+		}
+
+		/* Incremental updates with irregular chunk sizes must give the same result */
+		CAshCrc crc;
+		size_t pos = 0;
+		size_t chunk = 1;
+		while (pos < buf.size()) {
+			size_t n = std::min(chunk, buf.size() - pos);
+			if (n == 1) {
+				crc.update(buf[pos]);
+			}
+			else {
+				crc.update(buf.data() + pos, n);
+			}
+			pos += n;
+			chunk = (chunk * 3 + 1) % 13 + 1;
+		}
+		if (crc.get() != expected) {
+			FAILF("Incremental CRC mismatch on a %u byte buffer", len);
+		}
+		crc.reset();
+		if (crc.get() != CAshCrc::INIT_VALUE) {
+			FAILF("CRC not reset to its initial value");
+		}
+
+		pseudoRandom = static_cast<uint8_t>(pseudoRandom * 73 + 41);
+		buf.push_back(pseudoRandom);
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_randomiser_matches_reference) {
+	/* First bytes of the sequence, from the ASH specification */
+	const uint8_t expectedSequence[] = { 0x42, 0x21, 0xA8, 0x54, 0x2A };
+	uint8_t zeros[sizeof(expectedSequence)] = { 0 };
+	CAshRandomiser::apply(zeros, sizeof(zeros));
+	if (!std::equal(zeros, zeros + sizeof(zeros), expectedSequence)) {
+		FAILF("Wrong pseudo-random sequence");
+	}
+
+	/* Compare with the reference on every length (including past the precomputed sequence) and misaligned buffers */
+	std::vector<uint8_t> buf(CAshRandomiser::SEQUENCE_LENGTH + 40 + 7);
+	for (size_t i = 0; i < buf.size(); i++) {
+		buf[i] = static_cast<uint8_t>(i * 73 + 41);
+	}
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t len = 0; len + offset < buf.size(); len++) {
+			std::vector<uint8_t> fast(buf);
+			std::vector<uint8_t> reference(buf);
+			CAshRandomiser::apply(fast.data() + offset, len);
+			CAshRandomiser::applyBytewise(reference.data() + offset, len);
+			if (fast != reference) {
+				FAILF("Randomiser mismatch on a %zu byte buffer at offset %zu", len, offset);
+			}
+			CAshRandomiser::apply(fast.data() + offset, len);
+			if (fast != buf) {
+				FAILF("Randomising twice should give back the original data");
+			}
+		}
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_stuffing_scanners) {
+	const std::vector<uint8_t> reserved = { 0x7E, 0x7D, 0x11, 0x13, 0x18, 0x1A };
+	const CAshStuffing::EScanner scanners[] = { CAshStuffing::SCAN_SCALAR, CAshStuffing::SCAN_SSE2, CAshStuffing::SCAN_AVX2 };
+
+	for (unsigned int byte = 0; byte < 256; byte++) {
+		bool expected = std::find(reserved.begin(), reserved.end(), static_cast<uint8_t>(byte)) != reserved.end();
+		if (CAshStuffing::isReserved(static_cast<uint8_t>(byte)) != expected) {
+			FAILF("Wrong reserved status for byte 0x%02x", byte);
+		}
+	}
+
+	/* Each scanner available here must find a reserved byte at every position of buffers of every length up to 100 */
+	for (CAshStuffing::EScanner scanner : scanners) {
+		CAshStuffing::ScanFunction scan = CAshStuffing::getScanFunction(scanner);
+		if (scan == nullptr) {
+			continue;
+		}
+		for (size_t len = 0; len <= 100; len++) {
+			/* Plain bytes close to the reserved ones (bit 1 or bit 5 flipped) */
+			std::vector<uint8_t> buf(len);
+			for (size_t i = 0; i < len; i++) {
+				const uint8_t nearMiss[] = { 0x7C, 0x7F, 0x10, 0x12, 0x19, 0x1B, 0x5E, 0x31, 0x00, 0xFF };
+				buf[i] = nearMiss[i % sizeof(nearMiss)];
+			}
+			if (scan(buf.data(), len) != len) {
+				FAILF("Scanner %d found a reserved byte in a clean %zu byte buffer", static_cast<int>(scanner), len);
+			}
+			for (size_t pos = 0; pos < len; pos++) {
+				std::vector<uint8_t> dirty(buf);
+				dirty[pos] = reserved[pos % reserved.size()];
+				if (scan(dirty.data(), len) != pos) {
+					FAILF("Scanner %d missed reserved byte at %zu in a %zu byte buffer", static_cast<int>(scanner), pos, len);
+				}
+			}
+		}
+	}
+
+	/* Stuffing a buffer made of all possible bytes */
+	std::vector<uint8_t> all(256);
+	for (unsigned int byte = 0; byte < 256; byte++) {
+		all[byte] = static_cast<uint8_t>(byte);
+	}
+	std::vector<uint8_t> stuffed(2 * all.size());
+	stuffed.resize(CAshStuffing::stuff(all.data(), all.size(), stuffed.data()));
+	std::vector<uint8_t> expected;
+	for (uint8_t byte : all) {
+		if (std::find(reserved.begin(), reserved.end(), byte) != reserved.end()) {
+			expected.push_back(0x7D);
+			byte = static_cast<uint8_t>(byte ^ 0x20);
+		}
+		expected.push_back(byte);
+	}
+	if (stuffed != expected) {
+		FAILF("Wrong stuffed output");
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_encode_frames) {
+	CppThreadsTimerFactory timerFactory;
+	AshDecodeRecorder cb;
+	CAsh ash(&cb, timerFactory);
+
+	/* Reference frames from the ASH specification */
+	if (ash.resetNCPFrame() != std::vector<uint8_t>({ 0x1A, 0xC0, 0x38, 0xBC, 0x7E })) {
+		FAILF("Wrong RST frame");
+	}
+	if (ash.AckFrame() != std::vector<uint8_t>({ 0x80, 0x70, 0x78, 0x7E })) {
+		FAILF("Wrong ACK frame");
+	}
+
+	/* DATA frames, with the largest data field and with parameters made of reserved bytes only */
+	std::vector<uint8_t> reserved = { 0x7E, 0x7D, 0x11, 0x13, 0x18, 0x1A };
+	std::vector<uint8_t> largest(CAsh::ASH_MAX_LENGTH - 3 - 5);
+	for (size_t i = 0; i < largest.size(); i++) {
+		largest[i] = static_cast<uint8_t>(i * 29);
+	}
+	for (const std::vector<uint8_t>& params : { reserved, largest }) {
+		for (uint8_t frmNum = 0; frmNum < 8; frmNum++) {
+			uint8_t frame[CAsh::ASH_MAX_ENCODED_LENGTH];
+			size_t len = ash.DataFrame(0x05, params.data(), params.size(), frame);
+
+			/* Build the expected frame the straightforward way: header, randomise, CRC, then stuffing */
+			uint8_t seq = static_cast<uint8_t>((params == reserved ? 0 : 8) + frmNum);
+			std::vector<uint8_t> expected = { static_cast<uint8_t>(frmNum << 4), seq, 0x00, 0xFF, 0x00, 0x05 };
+			expected.insert(expected.end(), params.begin(), params.end());
+			CAshRandomiser::applyBytewise(expected.data() + 1, expected.size() - 1);
+			uint16_t crc = CAshCrc::computeBitwise(expected.data(), expected.size());
+			expected.push_back(static_cast<uint8_t>(crc >> 8));
+			expected.push_back(static_cast<uint8_t>(crc & 0xFF));
+			std::vector<uint8_t> stuffed;
+			for (uint8_t byte : expected) {
+				if (std::find(reserved.begin(), reserved.end(), byte) != reserved.end()) {
+					stuffed.push_back(0x7D);
+					byte = static_cast<uint8_t>(byte ^ 0x20);
+				}
+				stuffed.push_back(byte);
+			}
+			stuffed.push_back(0x7E);
+
+			if (std::vector<uint8_t>(frame, frame + len) != stuffed) {
+				FAILF("Wrong DATA frame %u with %zu parameter bytes", frmNum, params.size());
+			}
+			std::vector<uint8_t> ack = ashAckFrame(static_cast<uint8_t>(frmNum + 1));
+			ash.decode(ack.data(), ack.size());
+		}
+	}
+
+	/* An unacknowledged frame fills the default window: the next one is refused, rather than overwriting it */
+	uint8_t frame[CAsh::ASH_MAX_ENCODED_LENGTH];
+	if (ash.DataFrame(0x05, reserved.data(), reserved.size(), frame) == 0 || !ash.DataFrame(std::vector<uint8_t>({ 0x05 })).empty()) {
+		FAILF("Expected a DATA frame beyond the TX window to be refused");
+	}
+	if (ash.getTxPendingFrames() != 1 || ash.getNextSeqNum() != 17 || ash.RetransmitFrames().empty()) {
+		FAILF("Refused DATA frame should leave the pending frame untouched");
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_decode_streaming) {
+	CppThreadsTimerFactory timerFactory;
+	AshDecodeRecorder encoderCb;
+	CAsh encoder(&encoderCb, timerFactory);
+
+	encoder.setTxWindow(2);
+	/* Build a burst made of two DATA frames (with payload bytes that require stuffing), preceded by noise and a cancel byte */
+	std::vector<uint8_t> burst = { 0x55, 0x1A };
+	std::vector<uint8_t> frame1 = encoder.DataFrame(std::vector<uint8_t>({ 0x52, 0x7E, 0x7D, 0x11, 0x13, 0x18, 0x1A, 0x00 }));
+	std::vector<uint8_t> frame2 = encoder.DataFrame(std::vector<uint8_t>({ 0x00, 0x04 }));	/* No extended header */
+	burst.insert(burst.end(), frame1.begin(), frame1.end());
+	burst.insert(burst.end(), frame2.begin(), frame2.end());
+
+	const std::vector<uint8_t> expected1 = { 0x00, 0x00, 0x52, 0x7E, 0x7D, 0x11, 0x13, 0x18, 0x1A, 0x00 };
+	const std::vector<uint8_t> expected2 = { 0x01, 0x00, 0x00, 0x04 };
+
+	/* Feed the same burst with every possible chunk size, the result must not depend on chunking */
+	for (size_t chunk = 1; chunk <= burst.size(); chunk++) {
+		AshDecodeRecorder decoderCb;
+		CAsh decoder(&decoderCb, timerFactory);
+
+		for (size_t pos = 0; pos < burst.size(); pos += chunk) {
+			decoder.decode(burst.data() + pos, std::min(chunk, burst.size() - pos));
+		}
+		if (decoderCb.frames.size() != 2) {
+			FAILF("Expected 2 decoded frames with %zu byte chunks, got %zu", chunk, decoderCb.frames.size());
+		}
+		if (decoderCb.frames[0] != expected1 || decoderCb.frames[1] != expected2) {
+			FAILF("Wrong decoded content with %zu byte chunks", chunk);
+		}
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_decode_discard_invalid) {
+	CppThreadsTimerFactory timerFactory;
+	AshDecodeRecorder encoderCb;
+	CAsh encoder(&encoderCb, timerFactory);
+	AshDecodeRecorder decoderCb;
+	CAsh decoder(&decoderCb, timerFactory);
+
+	std::vector<uint8_t> frame = encoder.DataFrame(std::vector<uint8_t>({ 0x52, 0x01, 0x02 }));
+
+	/* Corrupted CRC */
+	std::vector<uint8_t> corrupted(frame);
+	corrupted[corrupted.size() - 2] ^= 0x01;
+	decoder.decode(corrupted.data(), corrupted.size());
+
+	/* Frame cancelled in the middle */
+	std::vector<uint8_t> cancelled(frame.begin(), frame.begin() + 3);
+	cancelled.push_back(0x1A);
+	decoder.decode(cancelled.data(), cancelled.size());
+
+	/* Frame containing a substitute byte */
+	std::vector<uint8_t> substituted(frame);
+	substituted.insert(substituted.begin() + 2, 0x18);
+	decoder.decode(substituted.data(), substituted.size());
+
+	/* Oversized frame */
+	std::vector<uint8_t> oversized(CAsh::ASH_MAX_LENGTH + 10, 0x42);
+	oversized.push_back(0x7E);
+	decoder.decode(oversized.data(), oversized.size());
+
+	if (!decoderCb.frames.empty()) {
+		FAILF("Invalid frames should have been discarded");
+	}
+	const CEzspLinkStats& stats = decoder.getStats();
+	if (stats.get(LINK_CRC_ERRORS) != 1 || stats.get(LINK_CANCEL_BYTES) != 1 || stats.get(LINK_SUBSTITUTE_BYTES) != 1 ||
+	    stats.get(LINK_OVERSIZED_FRAMES) != 1 || stats.get(LINK_DATA_FRAMES_RECEIVED) != 0) {
+		FAILF("Wrong error counters:\n%s", stats.toString().c_str());
+	}
+
+	/* The decoder must recover and accept the valid frame afterwards */
+	decoder.decode(frame.data(), frame.size());
+	if (decoderCb.frames.size() != 1) {
+		FAILF("Expected the valid frame to be decoded");
+	}
+	if (decoder.getStats().get(LINK_DATA_FRAMES_RECEIVED) != 1) {
+		FAILF("Expected the valid frame to be counted");
+	}
+
+	/* RSTACK (version 2, power-on reset) connects the link */
+	const uint8_t rstAck[] = { 0x1A, 0xC1, 0x02, 0x02, 0x9B, 0x7B, 0x7E };
+	decoder.decode(rstAck, sizeof(rstAck));
+	if (!decoder.isConnected()) {
+		FAILF("Expected RSTACK to connect the ASH link");
+	}
+	NOTIFYPASS();
+}
+
+TEST(ash_tests, ash_ack_timeout_adapts_to_rtt) {
+	CppThreadsTimerFactory timerFactory;
+	AshDecodeRecorder cb;
+	CAsh ash(&cb, timerFactory);
+
+	const uint8_t rstAck[] = { 0x1A, 0xC1, 0x02, 0x02, 0x9B, 0x7B, 0x7E };
+	ash.decode(rstAck, sizeof(rstAck));
+	if (ash.getRxAckTimeout() != 1600) {
+		FAILF("Expected the initial acknowledgement timeout, got %u ms", ash.getRxAckTimeout());
+	}
+
+	/* A 50ms round trip time: t_rx_ack = 7/8 * 1600 + 1/2 * 50 */
+	ash.DataFrame(std::vector<uint8_t>({ 0x00, 0x00, 0x05 }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	std::vector<uint8_t> ack = ashAckFrame(1);
+	ash.decode(ack.data(), ack.size());
+	if (ash.getTxPendingFrames() != 0) {
+		FAILF("Frame should have been acknowledged");
+	}
+	if (ash.getLastRtt() < 50 || ash.getLastRtt() > 150) {
+		FAILF("Unexpected round trip time %u ms", ash.getLastRtt());
+	}
+	if (ash.getRxAckTimeout() != 1400 + ash.getLastRtt() / 2) {
+		FAILF("Unexpected acknowledgement timeout %u ms with a %u ms round trip time", ash.getRxAckTimeout(), ash.getLastRtt());
+	}
+
+	/* Fast acknowledgements bring the timeout down to its minimum */
+	for (uint8_t frmNum = 1; frmNum < 40; frmNum++) {
+		ash.DataFrame(std::vector<uint8_t>({ frmNum, 0x00, 0x05 }));
+		ack = ashAckFrame(static_cast<uint8_t>(frmNum + 1));
+		ash.decode(ack.data(), ack.size());
+	}
+	if (ash.getRxAckTimeout() != 400) {
+		FAILF("Expected the acknowledgement timeout to reach its minimum, got %u ms", ash.getRxAckTimeout());
+	}
+
+	/* An unacknowledged frame times out, doubling the timeout */
+	ash.DataFrame(std::vector<uint8_t>({ 0x28, 0x00, 0x05 }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(600));
+	if (cb.countInfo(ASH_ACK_TIMEOUT) != 1 || ash.getStats().get(LINK_ACK_TIMEOUTS) != 1) {
+		FAILF("Expected an acknowledgement timeout");
+	}
+	if (ash.getRxAckTimeout() != 800) {
+		FAILF("Expected the acknowledgement timeout to back off, got %u ms", ash.getRxAckTimeout());
+	}
+
+	/* The retransmitted frame is acknowledged, but gives no round trip time sample (Karn's algorithm) */
+	ash.RetransmitFrames();
+	if (ash.getStats().get(LINK_RETRANSMITTED_FRAMES) != 1) {
+		FAILF("Expected one retransmitted frame");
+	}
+	ack = ashAckFrame(1);	/* 41 frames sent */
+	ash.decode(ack.data(), ack.size());
+	if (ash.getTxPendingFrames() != 0 || ash.getRxAckTimeout() != 800) {
+		FAILF("Retransmitted frame acknowledgement should not change the timeout");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_ash() {
+	ash_crc_check_value();
+	ash_crc_implementations_match();
+	ash_randomiser_matches_reference();
+	ash_stuffing_scanners();
+	ash_encode_frames();
+	ash_decode_streaming();
+	ash_decode_discard_invalid();
+	ash_ack_timeout_adapts_to_rtt();
+}
+#endif	// USE_CPPUTEST
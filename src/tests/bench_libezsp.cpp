@@ -0,0 +1,29 @@
+/*
+ * @file bench_libezsp.cpp
+ *
+ * Micro-benchmarks runner
+ */
+
+#include <stdio.h>
+
+void bench_ash();	// Declaration of ASH framing benchmarks (see ash_bench.cpp)
+void bench_dongle();	// Declaration of EZSP dongle benchmarks (see dongle_bench.cpp)
+void bench_uart();	// Declaration of UART driver benchmarks (see uart_bench.cpp)
+void bench_timers();	// Declaration of timer benchmarks (see timer_bench.cpp)
+void bench_logger();	// Declaration of logger benchmarks (see logger_bench.cpp)
+
+int main(int argc, char* argv[]) {
+
+	printf("*** Benchmarking ASH framing ***\n");
+	bench_ash();
+	printf("*** Benchmarking EZSP dongle ***\n");
+	bench_dongle();
+	printf("*** Benchmarking UART drivers ***\n");
+	bench_uart();
+	printf("*** Benchmarking timers ***\n");
+	bench_timers();
+	printf("*** Benchmarking logger streams ***\n");
+	bench_logger();
+
+	return 0;
+}
@@ -0,0 +1,219 @@
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#include "BenchHarness.h"
+#include "MockNcp.h"
+#include "../domain/ezsp-dongle.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+
+/**
+ * @brief Dongle observer signalling when the dongle is ready and when a given number of responses was received
+ */
+class DongleBenchObserver : public CEzspDongleObserver {
+public:
+	DongleBenchObserver() : mutex(), cv(), ready(false), nbRx(0) { }
+
+	void handleDongleState(EDongleState i_state) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->ready = (i_state == DONGLE_READY);
+		this->cv.notify_all();
+	}
+
+	void handleEzspRxMessage(EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->nbRx++;
+		this->cv.notify_all();
+	}
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool ready;
+	unsigned int nbRx;
+};
+
+/**
+ * @brief Measure the command throughput of a dongle on an emulated link with a given response latency, TX window and
+ *        acknowledgement delay
+ */
+static void bench_dongle_window_throughput(const std::chrono::microseconds& latency, uint8_t window, unsigned int nbCommands,
+                                           uint16_t ackDelay = 0) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleBenchObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, latency);
+	ncpPtr = &ncp;
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(window);
+		dongle.setAckDelay(ackDelay);
+		dongle.open(&uartDriver);
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&observer]() { return observer.ready; });
+	}
+
+	size_t writeCalls;
+	size_t writtenBuffers;
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		writeCalls = uartDriver.getWriteCallsCount();
+		writtenBuffers = uartDriver.getWrittenBuffersCount();
+		for (unsigned int loop = 0; loop < nbCommands; loop++) {
+			dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(32, static_cast<uint8_t>(loop)));
+		}
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(30), [&observer, nbCommands]() { return observer.nbRx >= nbCommands; });
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	ncp.waitIdle(std::chrono::seconds(1));
+	/* Let a delayed acknowledgement go before the emulated NCP is destroyed */
+	std::this_thread::sleep_for(std::chrono::milliseconds(2 * ackDelay));
+
+	std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+	std::string name = "window " + std::to_string(window) + ", " + std::to_string(latency.count()) + "us latency, ack delay " + std::to_string(ackDelay) + "ms";
+	printf("%-48s %12.1f cmd/s (%u/%u responses in %.1f ms, %u ACK frames, %zu frames in %zu UART writes)\n", name.c_str(),
+	       1000.0 * observer.nbRx / elapsed.count(), observer.nbRx, nbCommands, elapsed.count(), ncp.nbAckFrames,
+	       uartDriver.getWrittenBuffersCount() - writtenBuffers, uartDriver.getWriteCallsCount() - writeCalls);
+}
+
+/**
+ * @brief Measure the duration of a start-up sequence (as CZigbeeNetworking::stackInit() sends: configuration values,
+ *        policies and endpoints) run as a command batch, on an emulated link with a given response latency and TX window
+ */
+static void bench_dongle_startup(const std::chrono::microseconds& latency, uint8_t window) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleBenchObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, latency);
+	ncpPtr = &ncp;
+	std::vector<SEzspBatchStep> steps;
+	bool done = false;	/* Protected by observer.mutex */
+	EEzspCmdStatus status = EZSP_CMD_TIMEOUT;
+
+	for (uint8_t id = 0; id < 41; id++) {
+		steps.push_back({ EZSP_SET_CONFIGURATION_VALUE, std::vector<uint8_t>({ id, 0x10, 0x00 }), nullptr });
+	}
+	for (uint8_t id = 0; id < 4; id++) {
+		steps.push_back({ EZSP_SET_POLICY, std::vector<uint8_t>({ id, 0x01 }), nullptr });
+	}
+	steps.push_back({ EZSP_ADD_ENDPOINT, std::vector<uint8_t>(12, 0x01), nullptr });
+	steps.push_back({ EZSP_ADD_ENDPOINT, std::vector<uint8_t>(12, 0xF2), nullptr });
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(window);
+		dongle.open(&uartDriver);
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&observer]() { return observer.ready; });
+	}
+
+	size_t nbSteps = steps.size();
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.sendBatch(std::move(steps), [&observer, &done, &status](EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses) {
+			std::lock_guard<std::mutex> lock(observer.mutex);
+			done = true;
+			status = i_status;
+			observer.cv.notify_all();
+		});
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(30), [&done]() { return done; });
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	ncp.waitIdle(std::chrono::seconds(1));
+
+	std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+	std::string name = "start-up batch, window " + std::to_string(window) + ", " + std::to_string(latency.count()) + "us latency";
+	/* Floor: one latency per window of steps */
+	double floor = static_cast<double>((nbSteps + window - 1) / window) * static_cast<double>(latency.count()) / 1000.0;
+	printf("%-48s %10.1f ms for %zu steps (%s, link latency floor %.1f ms)\n", name.c_str(), elapsed.count(), nbSteps,
+	       (status == EZSP_CMD_SUCCESS) ? "success" : "failed", floor);
+}
+
+/**
+ * @brief Cost of the always-on link statistics
+ */
+static void bench_dongle_link_stats() {
+	CEzspLinkStats stats;
+	unsigned int loop = 0;
+
+	benchRun("link stats counter increment", 1000000, [&stats]() {
+		stats.increment(LINK_DATA_FRAMES_RECEIVED);
+	});
+	benchRun("link stats latency record", 1000000, [&stats, &loop]() {
+		stats.recordLatency(EZSP_NOP, std::chrono::microseconds(loop++ & 0xFFFF));
+	});
+	benchKeep(stats.get(LINK_DATA_FRAMES_RECEIVED) + stats.getLatencyCount(EZSP_NOP));
+}
+
+/**
+ * @brief Cost of handing a received payload to several observers, copied in a vector for each of them (legacy
+ *        handleEzspRxMessage()) or shared in a single CEzspFrameBuffer, only read or also kept by each observer
+ */
+static void bench_dongle_payload_fanout() {
+	const unsigned int nbObservers = 4;
+	const uint8_t frame[64] = { 0x00 };
+	std::size_t total = 0;
+
+	benchRun("payload fan-out, 4 vector copies", 1000000, [&frame, &total]() {
+		for (unsigned int observer = 0; observer < nbObservers; observer++) {
+			std::vector<uint8_t> copy(frame, frame + sizeof(frame));
+			total += copy.size();
+		}
+	});
+	benchRun("payload fan-out, 1 shared frame buffer", 1000000, [&frame, &total]() {
+		CEzspFrameBuffer buffer(frame, sizeof(frame));
+		for (unsigned int observer = 0; observer < nbObservers; observer++) {
+			const CEzspFrameBuffer& received = buffer;
+			total += received.size();
+		}
+	});
+	benchRun("payload fan-out, 1 frame buffer kept by all", 1000000, [&frame, &total]() {
+		CEzspFrameBuffer buffer(frame, sizeof(frame));
+		for (unsigned int observer = 0; observer < nbObservers; observer++) {
+			CEzspFrameBuffer kept = buffer;
+			total += kept.size();
+		}
+	});
+	benchKeep(total);
+}
+
+void bench_dongle() {
+	bench_dongle_link_stats();
+	bench_dongle_payload_fanout();
+
+	const uint8_t windows[] = { 1, 2, 4, 7 };
+
+	for (uint8_t window : windows) {
+		bench_dongle_window_throughput(std::chrono::microseconds(2000), window, 200);
+	}
+	for (uint8_t window : windows) {
+		bench_dongle_window_throughput(std::chrono::microseconds(2000), window, 200, 10);
+	}
+	for (uint8_t window : windows) {
+		bench_dongle_startup(std::chrono::microseconds(2000), window);
+	}
+}
@@ -0,0 +1,1191 @@
+#include "TestHarness.h"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "MockNcp.h"
+#include "../domain/ezsp-dongle.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+#include "../spi/cppthreads/CppThreadsEventLoop.h"
+
+/**
+ * @brief Dongle observer recording state changes and EZSP messages received
+ */
+class DongleTestObserver : public CEzspDongleObserver {
+public:
+	DongleTestObserver() : mutex(), cv(), ready(false), rxCmds(), rxPayloads() { }
+
+	void handleDongleState(EDongleState i_state) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->ready = (i_state == DONGLE_READY);
+		this->cv.notify_all();
+	}
+
+	void handleEzspRxFrame(EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->rxCmds.push_back(i_cmd);
+		this->rxPayloads.push_back(i_msg_receive);
+		this->cv.notify_all();
+	}
+
+	bool waitReady(const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this]() { return this->ready; });
+	}
+
+	bool waitRxCount(size_t count, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, count]() { return this->rxCmds.size() >= count; });
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each event */
+	bool ready;	/*!< Dongle reported DONGLE_READY */
+	std::vector<EEzspCmd> rxCmds;	/*!< Commands of all EZSP messages received, in order */
+	std::vector<CEzspFrameBuffer> rxPayloads;	/*!< Payloads of all EZSP messages received, in order */
+};
+
+/**
+ * @brief Dongle observer only implementing the legacy handler, getting a copy of each payload
+ */
+class DongleLegacyObserver : public CEzspDongleObserver {
+public:
+	DongleLegacyObserver() : mutex(), rxPayloads() { }
+
+	void handleDongleState(EDongleState i_state) { }
+
+	void handleEzspRxMessage(EEzspCmd i_cmd, std::vector<uint8_t> i_msg_receive) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->rxPayloads.push_back(i_msg_receive);
+	}
+
+	std::mutex mutex;	/*!< Protects rxPayloads */
+	std::vector<std::vector<uint8_t> > rxPayloads;	/*!< Payloads of all EZSP messages received, in order */
+};
+
+/**
+ * @brief Dongle observer spending some time in the handler of one of the EZSP messages it receives
+ */
+class DongleSlowObserver : public CEzspDongleObserver {
+public:
+	DongleSlowObserver(unsigned int slowMessage) : slowMessage(slowMessage), nbMessages(0), inHandler(false) { }
+
+	void handleDongleState(EDongleState i_state) { }
+
+	void handleEzspRxFrame(EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive) {
+		if (++this->nbMessages == this->slowMessage) {
+			this->inHandler = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			this->inHandler = false;
+		}
+	}
+
+	const unsigned int slowMessage;	/*!< The message (counted from 1) whose handler is slow */
+	std::atomic<unsigned int> nbMessages;	/*!< Messages received so far */
+	std::atomic<bool> inHandler;	/*!< The slow handler is running */
+};
+
+/**
+ * @brief Statistics of a command sequence run by runDongleWindowSequence()
+ */
+struct DongleSequenceStats {
+	unsigned int maxPendingResponses;	/*!< The maximum number of responses the emulated NCP had in flight */
+	unsigned int nbRetransmittedFrames;	/*!< The number of retransmitted frames received by the emulated NCP */
+	unsigned int nbAckFrames;	/*!< The number of ACK frames received by the emulated NCP */
+	unsigned int nbAckTimeouts;	/*!< The number of acknowledgement timeouts seen by the host */
+	unsigned int nbAckSaved;	/*!< The number of ACK frames the host did not need to send */
+	unsigned int nbLatencies;	/*!< The number of command to response latencies recorded by the host */
+	unsigned int latencyBucket;	/*!< The histogram bucket holding the most latencies */
+};
+
+/**
+ * @brief Open a dongle on an emulated NCP, send @p nbCommands commands at once and wait for all responses
+ *
+ * @param window The dongle TX window
+ * @param nbCommands The number of commands to send
+ * @param nbNak The number of DATA frames the emulated NCP rejects with a NAK
+ * @param nbDrop The number of DATA frames the emulated NCP ignores, so that they are only resent on acknowledgement timeout
+ * @param ackDelay The dongle acknowledgement delay (in ms)
+ * @param nbCallbacks The number of callbacks the emulated NCP sends in a burst after the last response
+ */
+static DongleSequenceStats runDongleWindowSequence(uint8_t window, unsigned int nbCommands, unsigned int nbNak, unsigned int nbDrop,
+                                                   uint16_t ackDelay = 0, unsigned int nbCallbacks = 0) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(20));	/* Destroyed first, so no delivery can reach a destroyed dongle */
+	ncpPtr = &ncp;
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(window);
+		dongle.setAckDelay(ackDelay);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		ncp.nakNextDataFrames(nbNak);
+		ncp.dropNextDataFrames(nbDrop);
+		for (unsigned int loop = 0; loop < nbCommands; loop++) {
+			dongle.sendCommand(EZSP_NOP);
+		}
+	}
+	if (!observer.waitRxCount(nbCommands, std::chrono::seconds(5))) {
+		FAILF("Got %zu responses out of %u with a window of %u", observer.rxCmds.size(), nbCommands, window);
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+	if (nbCallbacks > 0) {
+		/* Let the delayed acknowledgement of the last response go first */
+		std::this_thread::sleep_for(std::chrono::milliseconds(2 * ackDelay));
+		{
+			std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+			ncp.sendCallbacks(EZSP_STACK_STATUS_HANDLER, nbCallbacks);
+		}
+		if (!observer.waitRxCount(nbCommands + nbCallbacks, std::chrono::seconds(1))) {
+			FAILF("Got %zu callbacks out of %u", observer.rxCmds.size() - nbCommands, nbCallbacks);
+		}
+	}
+	/* Let a delayed acknowledgement go */
+	std::this_thread::sleep_for(std::chrono::milliseconds(2 * ackDelay));
+	if (observer.rxCmds.size() != nbCommands + nbCallbacks) {
+		FAILF("Got %zu messages, expected %u", observer.rxCmds.size(), nbCommands + nbCallbacks);
+	}
+
+	std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+	DongleSequenceStats stats;
+	stats.maxPendingResponses = ncp.maxPendingResponses;
+	stats.nbRetransmittedFrames = ncp.nbRetransmittedFrames;
+	stats.nbAckFrames = ncp.nbAckFrames;
+	stats.nbAckTimeouts = dongle.getLinkStats().get(LINK_ACK_TIMEOUTS);
+	stats.nbAckSaved = dongle.getLinkStats().get(LINK_ACK_FRAMES_SAVED);
+	stats.nbLatencies = dongle.getLinkStats().getLatencyCount(EZSP_NOP);
+	stats.latencyBucket = 0;
+	for (unsigned int bucket = 0; bucket < CEzspLinkStats::LATENCY_BUCKETS; bucket++) {
+		if (dongle.getLinkStats().getLatencyCount(EZSP_NOP, bucket) > dongle.getLinkStats().getLatencyCount(EZSP_NOP, stats.latencyBucket)) {
+			stats.latencyBucket = bucket;
+		}
+	}
+	return stats;
+}
+
+TEST_GROUP(dongle_tests) {
+};
+
+TEST(dongle_tests, dongle_link_stats) {
+	CEzspLinkStats stats;
+
+	if (CEzspLinkStats::getLatencyBucket(std::chrono::microseconds(0)) != 0 || CEzspLinkStats::getLatencyBucket(std::chrono::microseconds(1)) != 0 ||
+	    CEzspLinkStats::getLatencyBucket(std::chrono::microseconds(2)) != 1 || CEzspLinkStats::getLatencyBucket(std::chrono::microseconds(1023)) != 9 ||
+	    CEzspLinkStats::getLatencyBucket(std::chrono::microseconds(1024)) != 10 ||
+	    CEzspLinkStats::getLatencyBucket(std::chrono::seconds(3600)) != CEzspLinkStats::LATENCY_BUCKETS - 1) {
+		FAILF("Wrong latency buckets");
+	}
+
+	stats.recordLatency(EZSP_VERSION, std::chrono::microseconds(1500));
+	stats.recordLatency(EZSP_VERSION, std::chrono::microseconds(1800));
+	stats.recordLatency(EZSP_NETWORK_INIT, std::chrono::milliseconds(30));
+	if (stats.getLatencyCount(EZSP_VERSION, 10) != 2 || stats.getLatencyCount(EZSP_VERSION) != 2 || stats.getLatencyCount(EZSP_NETWORK_INIT) != 1) {
+		FAILF("Wrong latency histograms:\n%s", stats.toString().c_str());
+	}
+
+	stats.updateQueueDepth(3);
+	stats.updateQueueDepth(12);
+	stats.updateQueueDepth(5);
+	stats.increment(LINK_CRC_ERRORS);
+	if (stats.getQueueHighWatermark() != 12 || stats.get(LINK_CRC_ERRORS) != 1) {
+		FAILF("Wrong counters:\n%s", stats.toString().c_str());
+	}
+
+	stats.reset();
+	if (stats.getQueueHighWatermark() != 0 || stats.get(LINK_CRC_ERRORS) != 0 || stats.getLatencyCount(EZSP_VERSION) != 0) {
+		FAILF("Statistics not reset");
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_stop_and_wait) {
+	DongleSequenceStats stats = runDongleWindowSequence(1, 8, 0, 0);
+	if (stats.maxPendingResponses != 1) {
+		FAILF("Expected one command in flight at a time, got %u", stats.maxPendingResponses);
+	}
+	if (stats.nbAckFrames != 8) {
+		FAILF("Expected each response to be acknowledged immediately, got %u ACK frames", stats.nbAckFrames);
+	}
+	/* The emulated NCP answers after 20ms, in the [16384, 32768) us bucket */
+	if (stats.nbLatencies != 8 || stats.latencyBucket != 14) {
+		FAILF("Expected 8 latencies around 20ms, got %u, mostly in bucket %u", stats.nbLatencies, stats.latencyBucket);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_tx_window) {
+	DongleSequenceStats stats = runDongleWindowSequence(4, 16, 0, 0);
+	if (stats.maxPendingResponses != 4) {
+		FAILF("Expected 4 commands in flight, got %u", stats.maxPendingResponses);
+	}
+	if (stats.nbRetransmittedFrames != 0 || stats.nbAckTimeouts != 0) {
+		FAILF("Unexpected retransmissions");
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_tx_window_nak_retransmit) {
+	/* The first frame of the window is rejected, the two others are discarded as out of sequence: all 3 are resent */
+	DongleSequenceStats stats = runDongleWindowSequence(3, 3, 1, 0);
+	if (stats.nbRetransmittedFrames != 3) {
+		FAILF("Expected 3 retransmitted frames, got %u", stats.nbRetransmittedFrames);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_ack_timeout_retransmit) {
+	/* The first frame is lost without any NAK, only the acknowledgement timeout can recover */
+	DongleSequenceStats stats = runDongleWindowSequence(2, 4, 0, 1);
+	if (stats.nbAckTimeouts != 1) {
+		FAILF("Expected one acknowledgement timeout, got %u", stats.nbAckTimeouts);
+	}
+	if (stats.nbRetransmittedFrames != 2) {
+		FAILF("Expected 2 retransmitted frames, got %u", stats.nbRetransmittedFrames);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_delayed_ack) {
+	/* Each response is acknowledged by the next command, the last one and the callback burst by one ACK frame each */
+	DongleSequenceStats stats = runDongleWindowSequence(1, 8, 0, 0, 50, 5);
+	if (stats.nbAckFrames != 2) {
+		FAILF("Expected 2 ACK frames, got %u", stats.nbAckFrames);
+	}
+	if (stats.nbAckSaved != 11) {
+		FAILF("Expected 11 ACK frames saved, got %u", stats.nbAckSaved);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_response_callback) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(20));
+	ncpPtr = &ncp;
+	std::vector<std::vector<uint8_t> > responses;	/* Protected by observer.mutex */
+	EEzspCmdStatus invalidStatus = EZSP_CMD_SUCCESS;
+
+	ncp.setResponder([](uint8_t cmd, const std::vector<uint8_t>& params) { return params; });
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(4);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		/* Parameters too long for a DATA frame: the command fails without being sent (nor cut to fit) */
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(CAsh::ASH_MAX_LENGTH, 0x42), [&invalidStatus](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+			invalidStatus = i_status;
+		});
+		if (invalidStatus != EZSP_CMD_INVALID_COMMAND || dongle.getQueueDepth() != 0) {
+			FAILF("Expected a command with too long parameters to fail");
+		}
+		for (uint8_t loop = 1; loop <= 3; loop++) {
+			dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>({ loop }), [&observer, &responses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+				std::lock_guard<std::mutex> lock(observer.mutex);
+				responses.push_back(i_response.toVector());
+				observer.cv.notify_all();
+			});
+		}
+		/* Callbacks with the command id of the pending commands, received before their responses */
+		ncp.sendCallbacks(EZSP_NOP, 2);
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&responses]() { return responses.size() >= 3; });
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	if (responses != std::vector<std::vector<uint8_t> >({ { 1 }, { 2 }, { 3 } })) {
+		FAILF("Expected the 3 responses to be given to their requesters in order, got %zu", responses.size());
+	}
+	if (observer.rxCmds.size() != 2) {
+		FAILF("Expected only the 2 callbacks to reach observers, got %zu messages", observer.rxCmds.size());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_command_timeout) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(20));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmdStatus> statuses;	/* Protected by observer.mutex */
+	FEzspResponseCallback onResponse = [&observer, &statuses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		statuses.push_back(i_status);
+		observer.cv.notify_all();
+	};
+	auto waitStatuses = [&observer, &statuses](size_t count) {
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		return observer.cv.wait_for(lock, std::chrono::seconds(2), [&statuses, count]() { return statuses.size() >= count; });
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* The first command is never answered: it fails on its own timeout, and the queue moves on to the second one */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		ncp.ignoreNextCommands(1);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse, 100);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse);
+		if (dongle.getQueueDepth() != 2 || dongle.getLinkStats().getQueueDepth() != 1) {
+			FAILF("Expected one command sent and one queued, got %zu commands, %u queued", dongle.getQueueDepth(), dongle.getLinkStats().getQueueDepth());
+		}
+	}
+	if (!waitStatuses(2)) {
+		FAILF("Got %zu completions out of 2", statuses.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (statuses != std::vector<EEzspCmdStatus>({ EZSP_CMD_TIMEOUT, EZSP_CMD_SUCCESS })) {
+			FAILF("Expected the first command to time out and the second one to succeed");
+		}
+	}
+
+	/* With a retry, a command left unanswered once is sent again and succeeds */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setCommandRetries(1);
+		dongle.setCommandTimeout(EZSP_NOP, 100);
+		ncp.ignoreNextCommands(1);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse);
+	}
+	if (!waitStatuses(3)) {
+		FAILF("Got no completion for the retried command");
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	if (statuses.back() != EZSP_CMD_SUCCESS) {
+		FAILF("Expected the retried command to succeed");
+	}
+	if (dongle.getLinkStats().get(LINK_COMMAND_TIMEOUTS) != 1 || dongle.getLinkStats().get(LINK_COMMAND_RETRIES) != 1 || dongle.getQueueDepth() != 0) {
+		FAILF("Wrong command counters:\n%s", dongle.getLinkStats().toString().c_str());
+	}
+	if (!observer.rxCmds.empty()) {
+		FAILF("Expected no message to reach observers, got %zu", observer.rxCmds.size());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_late_response) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(60));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmdStatus> statuses;	/* Protected by observer.mutex */
+	std::vector<std::vector<uint8_t> > responses;	/* Protected by observer.mutex */
+	FEzspResponseCallback onResponse = [&observer, &statuses, &responses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		statuses.push_back(i_status);
+		responses.push_back(i_response.toVector());
+		observer.cv.notify_all();
+	};
+	auto waitStatuses = [&observer, &statuses](size_t count) {
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		return observer.cv.wait_for(lock, std::chrono::seconds(2), [&statuses, count]() { return statuses.size() >= count; });
+	};
+
+	ncp.setResponder([](uint8_t cmd, const std::vector<uint8_t>& params) { return params; });
+	dongle.setTxWindow(2);
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* The first command times out before its response, the second one with the same id is pending when that late
+	 * response is received: it must only complete on its own response */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>({ 1 }), onResponse, 20);
+	}
+	if (!waitStatuses(1)) {
+		FAILF("Got no completion for the first command");
+	}
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>({ 2 }), onResponse);
+	}
+	if (!waitStatuses(2)) {
+		FAILF("Got no completion for the second command");
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	if (statuses != std::vector<EEzspCmdStatus>({ EZSP_CMD_TIMEOUT, EZSP_CMD_SUCCESS }) || responses.back() != std::vector<uint8_t>({ 2 })) {
+		FAILF("Expected the second command to complete with its own response");
+	}
+	if (dongle.getLinkStats().get(LINK_UNMATCHED_RESPONSES) != 1 || !observer.rxCmds.empty()) {
+		FAILF("Expected the late response to be dropped, not given to observers:\n%s", dongle.getLinkStats().toString().c_str());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_priority_lanes) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(5));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmd> completed;	/* Protected by observer.mutex */
+	FEzspResponseCallback onResponse = [&observer, &completed](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		completed.push_back(i_cmd);
+		observer.cv.notify_all();
+	};
+	auto waitCompleted = [&observer, &completed](size_t count) {
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		return observer.cv.wait_for(lock, std::chrono::seconds(2), [&completed, count]() { return completed.size() >= count; });
+	};
+	auto position = [&completed](EEzspCmd cmd, size_t from) {
+		return static_cast<size_t>(std::find(completed.begin() + static_cast<std::ptrdiff_t>(from), completed.end(), cmd) - completed.begin());
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* GP sends queued during a proxy table sweep only wait for the sweep entry in flight */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		for (uint8_t index = 0; index < 10; index++) {
+			dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY, std::vector<uint8_t>({ index }), onResponse, 0, EZSP_PRIORITY_BULK);
+		}
+		dongle.sendCommand(EZSP_D_GP_SEND, std::vector<uint8_t>(), onResponse, 0, EZSP_PRIORITY_REALTIME);
+		dongle.sendCommand(EZSP_D_GP_SEND, std::vector<uint8_t>(), onResponse, 0, EZSP_PRIORITY_REALTIME);
+	}
+	if (!waitCompleted(12)) {
+		FAILF("Got %zu completions out of 12", completed.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (position(EZSP_D_GP_SEND, 0) != 1 || position(EZSP_D_GP_SEND, 2) != 2) {
+			FAILF("Expected GP sends to overtake the sweep, got them at %zu and %zu", position(EZSP_D_GP_SEND, 0), position(EZSP_D_GP_SEND, 2));
+		}
+	}
+
+	/* A bulk command queued behind a flood of realtime ones still gets its turn after PRIORITY_WEIGHTS[0] of them */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		for (unsigned int loop = 0; loop < 12; loop++) {
+			dongle.sendCommand(EZSP_D_GP_SEND, std::vector<uint8_t>(), onResponse, 0, EZSP_PRIORITY_REALTIME);
+		}
+		dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY, std::vector<uint8_t>({ 0 }), onResponse, 0, EZSP_PRIORITY_BULK);
+	}
+	if (!waitCompleted(25)) {
+		FAILF("Got %zu completions out of 25", completed.size());
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	if (position(EZSP_GP_PROXY_TABLE_GET_ENTRY, 12) > 12U + CEzspDongle::PRIORITY_WEIGHTS[EZSP_PRIORITY_REALTIME]) {
+		FAILF("Bulk command starved, completed at %zu", position(EZSP_GP_PROXY_TABLE_GET_ENTRY, 12) - 12);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_queue_overflow) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(5));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmdStatus> statuses;	/* Protected by observer.mutex */
+	std::vector<bool> congestion;	/* Protected by observer.mutex */
+	FEzspResponseCallback onResponse = [&observer, &statuses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		statuses.push_back(i_status);
+		observer.cv.notify_all();
+	};
+	auto waitStatuses = [&observer, &statuses](size_t count) {
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		return observer.cv.wait_for(lock, std::chrono::seconds(2), [&statuses, count]() { return statuses.size() >= count; });
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* One command in flight, two queued, the next one is rejected */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setQueueCapacity(2, QUEUE_REJECT);
+		dongle.setQueueWatermarks(2, 0, [&observer, &congestion](bool i_congested) {
+			std::lock_guard<std::mutex> lock(observer.mutex);
+			congestion.push_back(i_congested);
+		});
+		for (unsigned int loop = 0; loop < 3; loop++) {
+			if (!dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse)) {
+				FAILF("Command %u rejected", loop);
+			}
+		}
+		if (dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse) || dongle.getLinkStats().get(LINK_COMMANDS_REJECTED) != 1) {
+			FAILF("Expected the command sent to a full queue to be rejected");
+		}
+	}
+	if (!waitStatuses(3)) {
+		FAILF("Got %zu completions out of 3", statuses.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (congestion != std::vector<bool>({ true, false })) {
+			FAILF("Expected the queue to get congested then back to normal, got %zu notifications", congestion.size());
+		}
+	}
+
+	/* The oldest bulk command makes room for an interactive one */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setQueueCapacity(2, QUEUE_DROP_OLDEST);
+		for (unsigned int loop = 0; loop < 3; loop++) {
+			dongle.sendCommand(EZSP_GP_PROXY_TABLE_GET_ENTRY, std::vector<uint8_t>({ 0 }), onResponse, 0, EZSP_PRIORITY_BULK);
+		}
+		if (!dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse)) {
+			FAILF("Expected the interactive command to be accepted");
+		}
+	}
+	if (!waitStatuses(7)) {
+		FAILF("Got %zu completions out of 7", statuses.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (statuses[3] != EZSP_CMD_DROPPED || std::count(statuses.begin(), statuses.end(), EZSP_CMD_DROPPED) != 1 ||
+		    dongle.getLinkStats().get(LINK_COMMANDS_DROPPED) != 1) {
+			FAILF("Expected the first queued bulk command to be dropped");
+		}
+	}
+
+	/* The caller waits (releasing the lock it holds) until a response makes room */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setQueueCapacity(1, QUEUE_BLOCK);
+		dongle.setQueueBlockingLock(&ncp.deliveryMutex, 1000);
+		for (unsigned int loop = 0; loop < 4; loop++) {
+			if (!dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse)) {
+				FAILF("Command %u rejected instead of waiting", loop);
+			}
+		}
+	}
+	if (!waitStatuses(11)) {
+		FAILF("Got %zu completions out of 11", statuses.size());
+	}
+
+	/* Room made by a command timeout (on a timer thread, without the application lock) also ends the wait */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		ncp.ignoreNextCommands(1);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse, 50);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse);
+		if (!dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse)) {
+			FAILF("Command rejected instead of waiting for the timeout of the one in flight");
+		}
+	}
+	if (!waitStatuses(14)) {
+		FAILF("Got %zu completions out of 14", statuses.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (statuses[11] != EZSP_CMD_TIMEOUT) {
+			FAILF("Expected the unanswered command to time out");
+		}
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	if (dongle.getLinkStats().get(LINK_COMMANDS_REJECTED) != 1 || dongle.getQueueDepth() != 0) {
+		FAILF("Wrong queue statistics:\n%s", dongle.getLinkStats().toString().c_str());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_batch) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(5));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmdStatus> statuses;	/* Protected by observer.mutex */
+	std::vector<size_t> failedSteps;	/* Protected by observer.mutex */
+	std::vector<CEzspFrameBuffer> responses;	/* Protected by observer.mutex */
+	FEzspBatchCallback onDone = [&](EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses) {
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		statuses.push_back(i_status);
+		failedSteps.push_back(i_failed_step);
+		responses = i_responses;
+		observer.cv.notify_all();
+	};
+	auto waitBatches = [&observer, &statuses](size_t count) {
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		return observer.cv.wait_for(lock, std::chrono::seconds(2), [&statuses, count]() { return statuses.size() >= count; });
+	};
+	auto isSuccess = [](const CEzspFrameBuffer& i_response) { return i_response.at(0) == 0x00; };
+	std::vector<SEzspBatchStep> steps;
+	for (uint8_t loop = 0; loop < 6; loop++) {
+		steps.push_back({ EZSP_SET_CONFIGURATION_VALUE, std::vector<uint8_t>({ loop, 0x00, 0x00 }), isSuccess });
+	}
+
+	/* The NCP answers with the configuration id as status, so that only the first step is valid */
+	ncp.setResponder([](uint8_t cmd, const std::vector<uint8_t>& params) { return std::vector<uint8_t>({ params.at(0) }); });
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(2);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.sendBatch(steps, onDone);
+	}
+	if (!waitBatches(1)) {
+		FAILF("Batch did not complete");
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+	{
+		std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		if (statuses[0] != EZSP_CMD_INVALID_RESPONSE || failedSteps[0] != 1 || responses.size() != 1) {
+			FAILF("Expected the batch to fail at step 1, got status %u at step %zu", statuses[0], failedSteps[0]);
+		}
+		/* The step following the failed one was already in flight, the others were not sent */
+		if (ncp.nbDataFrames != 3) {
+			FAILF("Expected 3 steps sent, got %u", ncp.nbDataFrames);
+		}
+	}
+
+	/* All steps valid: pipelined within the window, one aggregated result */
+	ncp.setResponder([](uint8_t cmd, const std::vector<uint8_t>& params) { return std::vector<uint8_t>({ 0x00, params.at(0) }); });
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.sendBatch(steps, onDone);
+	}
+	if (!waitBatches(2)) {
+		FAILF("Batch did not complete");
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	if (statuses[1] != EZSP_CMD_SUCCESS || failedSteps[1] != steps.size() || responses.size() != steps.size() || responses[5].toVector() != std::vector<uint8_t>({ 0x00, 5 })) {
+		FAILF("Expected the batch to succeed with all responses in order");
+	}
+	if (ncp.maxPendingResponses != 2) {
+		FAILF("Expected 2 steps in flight, got %u", ncp.maxPendingResponses);
+	}
+	if (!observer.rxCmds.empty()) {
+		FAILF("Expected no batch response to reach observers, got %zu", observer.rxCmds.size());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_frame_buffer) {
+	const uint8_t bytes[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+	CEzspFrameBuffer empty;
+	CEzspFrameBuffer buffer(bytes, sizeof(bytes));
+	CEzspFrameBuffer copy = buffer;
+
+	if (!empty.empty() || empty.useCount() != 0 || buffer.size() != 5 || buffer.at(4) != 0x05) {
+		FAILF("Wrong buffer contents");
+	}
+	if (copy.data() != buffer.data() || buffer.useCount() != 2) {
+		FAILF("Expected copies to share their bytes");
+	}
+	try {
+		buffer.at(5);
+		FAILF("Expected an out of range exception");
+	}
+	catch (const std::out_of_range&) {
+	}
+	/* The released block is reused by the next buffer */
+	std::size_t freeBlocks = CEzspFrameBuffer::getPoolFreeBlocks();
+	buffer = CEzspFrameBuffer();
+	copy = CEzspFrameBuffer();
+	if (CEzspFrameBuffer::getPoolFreeBlocks() != freeBlocks + 1) {
+		FAILF("Expected the released block back in the pool");
+	}
+	CEzspFrameBuffer large(std::vector<uint8_t>(CEzspFrameBuffer::POOL_BLOCK_SIZE + 1, 0xA5));
+	if (large.size() != CEzspFrameBuffer::POOL_BLOCK_SIZE + 1 || large.at(CEzspFrameBuffer::POOL_BLOCK_SIZE) != 0xA5) {
+		FAILF("Wrong large buffer contents");
+	}
+
+	/* Observers share a single payload, legacy observers get their own copy */
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	DongleTestObserver otherObserver;
+	DongleLegacyObserver legacyObserver;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(1));
+	ncpPtr = &ncp;
+
+	dongle.registerObserver(&otherObserver);
+	dongle.registerObserver(&legacyObserver);
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		ncp.sendCallbacks(EZSP_STACK_STATUS_HANDLER, 1);
+	}
+	if (!observer.waitRxCount(1, std::chrono::seconds(1))) {
+		FAILF("Callback not received");
+	}
+
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(observer.mutex);
+	std::lock_guard<std::mutex> otherLock(otherObserver.mutex);
+	std::lock_guard<std::mutex> legacyLock(legacyObserver.mutex);
+	if (otherObserver.rxPayloads.size() != 1 || otherObserver.rxPayloads[0].data() != observer.rxPayloads[0].data()) {
+		FAILF("Expected both observers to get the same payload");
+	}
+	if (legacyObserver.rxPayloads.size() != 1 || legacyObserver.rxPayloads[0] != observer.rxPayloads[0].toVector()) {
+		FAILF("Expected the legacy observer to get a copy of the payload");
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_observer_subscriptions) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	DongleTestObserver gpObserver;
+	DongleTestObserver stackObserver;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(1));
+	ncpPtr = &ncp;
+
+	if (!dongle.registerObserver(&gpObserver, EZSP_GPEP_INCOMING_MESSAGE_HANDLER, EZSP_GP_PROXY_TABLE_PROCESS_GP_PAIRING)
+	    || !dongle.registerObserver(&stackObserver, EZSP_STACK_STATUS_HANDLER)) {
+		FAILF("Failed registering observers");
+	}
+	if (dongle.registerObserver(&gpObserver, EZSP_D_GP_SENT_HANDLER)) {
+		FAILF("Expected a subscription already in place not to be added again");
+	}
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2)) || !gpObserver.waitReady(std::chrono::seconds(1)) || !stackObserver.waitReady(std::chrono::seconds(1))) {
+		FAILF("Dongle state not notified to all observers");
+	}
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		ncp.sendCallbacks(EZSP_STACK_STATUS_HANDLER, 1);
+		ncp.sendCallbacks(EZSP_GPEP_INCOMING_MESSAGE_HANDLER, 1);
+		ncp.sendCallbacks(EZSP_MESSAGE_SENT_HANDLER, 1);
+		ncp.sendCallbacks(EZSP_D_GP_SENT_HANDLER, 1);
+	}
+	if (!observer.waitRxCount(4, std::chrono::seconds(1))) {
+		FAILF("Callbacks not all received");
+	}
+	{
+		std::lock_guard<std::mutex> lock(gpObserver.mutex);
+		if (gpObserver.rxCmds != std::vector<EEzspCmd>({ EZSP_GPEP_INCOMING_MESSAGE_HANDLER, EZSP_D_GP_SENT_HANDLER })) {
+			FAILF("Expected the GP observer to only get GP callbacks, got %zu messages", gpObserver.rxCmds.size());
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(stackObserver.mutex);
+		if (stackObserver.rxCmds != std::vector<EEzspCmd>({ EZSP_STACK_STATUS_HANDLER })) {
+			FAILF("Expected the stack observer to only get stack status callbacks, got %zu messages", stackObserver.rxCmds.size());
+		}
+	}
+
+	/* Unregistering removes all subscriptions */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.unregisterObserver(&gpObserver)) {
+			FAILF("Failed unregistering observer");
+		}
+		ncp.sendCallbacks(EZSP_GPEP_INCOMING_MESSAGE_HANDLER, 1);
+	}
+	if (!observer.waitRxCount(5, std::chrono::seconds(1))) {
+		FAILF("Callback not received");
+	}
+	std::lock_guard<std::mutex> deliveryLock(ncp.deliveryMutex);
+	std::lock_guard<std::mutex> lock(gpObserver.mutex);
+	if (gpObserver.rxCmds.size() != 2) {
+		FAILF("Expected no message after unregistering, got %zu", gpObserver.rxCmds.size() - 2);
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_executor) {
+	const unsigned int nbCommands = 20;
+	CppThreadsEventLoop loop;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	/* The loop is both the timer factory and the executor: no lock is needed around the dongle */
+	CEzspDongle dongle(loop, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(1));
+	ncpPtr = &ncp;
+	std::atomic<unsigned int> nbOutsideLoop(0);
+	std::atomic<unsigned int> nbResponses(0);
+
+	dongle.setExecutor(&loop);
+	dongle.setTxWindow(4);
+	loop.start();
+	loop.post([&dongle, &uartDriver]() { dongle.open(&uartDriver); });
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+	for (unsigned int loopCmd = 0; loopCmd < nbCommands; loopCmd++) {
+		loop.post([&loop, &dongle, &observer, &nbOutsideLoop, &nbResponses, loopCmd]() {
+			dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(1, static_cast<uint8_t>(loopCmd)),
+			                   [&loop, &observer, &nbOutsideLoop, &nbResponses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+				if (!loop.isInExecutorThread()) {
+					nbOutsideLoop++;
+				}
+				nbResponses++;
+				std::lock_guard<std::mutex> lock(observer.mutex);
+				observer.cv.notify_all();
+			});
+		});
+	}
+	/* Run on the loop, as the emulated NCP shares its frame numbers with the host write path */
+	loop.post([&ncp]() { ncp.sendCallbacks(EZSP_STACK_STATUS_HANDLER, 3); });
+	if (!observer.waitRxCount(3, std::chrono::seconds(2))) {
+		FAILF("Callbacks not received");
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&nbResponses, nbCommands]() { return nbResponses >= nbCommands; });
+	}
+
+	/* Sent from another thread, commands are admitted against the ones already posted, then queued by the loop */
+	std::promise<void> loopBlocked;
+	std::promise<void> loopReleased;
+	std::future<void> released = loopReleased.get_future();
+	std::atomic<unsigned int> nbPostedResponses(0);
+	FEzspResponseCallback onPostedResponse = [&loop, &observer, &nbOutsideLoop, &nbPostedResponses](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		if (!loop.isInExecutorThread() || i_status != EZSP_CMD_SUCCESS) {
+			nbOutsideLoop++;
+		}
+		nbPostedResponses++;
+		std::lock_guard<std::mutex> lock(observer.mutex);
+		observer.cv.notify_all();
+	};
+	loop.post([&loopBlocked, &released]() {
+		loopBlocked.set_value();
+		released.wait();
+	});
+	loopBlocked.get_future().wait();
+	dongle.setQueueCapacity(2, QUEUE_REJECT);
+	for (unsigned int loopCmd = 0; loopCmd < 2; loopCmd++) {
+		if (!dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onPostedResponse)) {
+			FAILF("Command %u rejected", loopCmd);
+		}
+	}
+	if (dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onPostedResponse) || dongle.getLinkStats().get(LINK_COMMANDS_REJECTED) != 1) {
+		FAILF("Expected the command sent while two are posted to be rejected");
+	}
+	/* The caller waits (releasing the lock it holds) until the loop has queued the posted commands */
+	std::mutex appLock;
+	std::unique_lock<std::mutex> appLocked(appLock);
+	dongle.setQueueCapacity(2, QUEUE_BLOCK);
+	dongle.setQueueBlockingLock(&appLock, 1000);
+	std::thread releaser([&loopReleased]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		loopReleased.set_value();
+	});
+	bool waited = dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onPostedResponse);
+	releaser.join();
+	if (!waited) {
+		FAILF("Expected the command to wait for the posted ones to be queued");
+	}
+	appLocked.unlock();
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&nbPostedResponses]() { return nbPostedResponses >= 3; });
+	}
+	loop.stop();
+	ncp.waitIdle(std::chrono::seconds(1));
+
+	if (nbResponses != nbCommands || nbPostedResponses != 3 || nbOutsideLoop != 0) {
+		FAILF("Got %u responses out of %u, %u posted ones out of 3, %u outside of the loop", nbResponses.load(), nbCommands,
+		      nbPostedResponses.load(), nbOutsideLoop.load());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_serialised_timers) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	DongleSlowObserver slowObserver(2);
+	std::atomic<unsigned int> nbConcurrentWrites(0);
+	MockUartDriver uartDriver([&ncpPtr, &slowObserver, &nbConcurrentWrites](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		if (slowObserver.inHandler) {
+			nbConcurrentWrites++;
+		}
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(20));
+	ncpPtr = &ncp;
+	std::vector<EEzspCmdStatus> statuses;	/* Protected by observer.mutex */
+	bool timedOutInHandler = false;	/* Protected by observer.mutex */
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* Without executor, the delayed acknowledgement of the first callback and the timeout of the command, both expiring
+	 * while the handler of the second callback runs, wait for it */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setAckDelay(10);
+		dongle.registerObserver(&slowObserver);
+		ncp.ignoreNextCommands(1);
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), [&observer, &slowObserver, &statuses, &timedOutInHandler](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+			std::lock_guard<std::mutex> lock(observer.mutex);
+			timedOutInHandler = slowObserver.inHandler;
+			statuses.push_back(i_status);
+			observer.cv.notify_all();
+		}, 30);
+		ncp.sendCallbacks(EZSP_STACK_STATUS_HANDLER, 2);
+	}
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		if (!observer.cv.wait_for(lock, std::chrono::seconds(2), [&statuses]() { return !statuses.empty(); }) ||
+		    statuses[0] != EZSP_CMD_TIMEOUT || timedOutInHandler) {
+			FAILF("Expected the command to time out once the message handler has returned");
+		}
+	}
+	if (!observer.waitRxCount(2, std::chrono::seconds(1))) {
+		FAILF("Callbacks not received");
+	}
+	/* Let the delayed acknowledgement go */
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	if (nbConcurrentWrites != 0) {
+		FAILF("Expected no frame to be written while received ones are handled, got %u", nbConcurrentWrites.load());
+	}
+	NOTIFYPASS();
+}
+
+TEST(dongle_tests, dongle_tx_coalescing) {
+	CppThreadsTimerFactory timerFactory;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	});
+	DongleTestObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(5));
+	ncpPtr = &ncp;
+	std::atomic<unsigned int> nbBatches(0);
+	size_t writeCalls;
+	size_t writtenBuffers;
+
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		if (!dongle.open(&uartDriver)) {
+			FAILF("Failed opening dongle");
+		}
+	}
+	if (!observer.waitReady(std::chrono::seconds(2))) {
+		FAILF("Dongle did not get ready");
+	}
+
+	/* Stop-and-wait: each response is acknowledged along with the next command, in a single write */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		writeCalls = uartDriver.getWriteCallsCount();
+		writtenBuffers = uartDriver.getWrittenBuffersCount();
+		for (unsigned int loop = 0; loop < 8; loop++) {
+			dongle.sendCommand(EZSP_NOP);
+		}
+	}
+	if (!observer.waitRxCount(8, std::chrono::seconds(2)) || !ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Got %zu responses out of 8", observer.rxCmds.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		/* First command, 7 ACK and command pairs, last ACK */
+		if (uartDriver.getWriteCallsCount() - writeCalls != 9 || uartDriver.getWrittenBuffersCount() - writtenBuffers != 16) {
+			FAILF("Expected 16 frames in 9 writes, got %zu frames in %zu writes", uartDriver.getWrittenBuffersCount() - writtenBuffers,
+			      uartDriver.getWriteCallsCount() - writeCalls);
+		}
+		if (ncp.nbAckFrames != 8 || ncp.nbDataFrames != 8) {
+			FAILF("Emulated NCP got %u ACK and %u DATA frames, expected 8 of each", ncp.nbAckFrames, ncp.nbDataFrames);
+		}
+	}
+
+	/* Batch steps filling the window are written at once */
+	{
+		std::lock_guard<std::mutex> lock(ncp.deliveryMutex);
+		dongle.setTxWindow(4);
+		writeCalls = uartDriver.getWriteCallsCount();
+		writtenBuffers = uartDriver.getWrittenBuffersCount();
+		std::vector<SEzspBatchStep> steps;
+		for (unsigned int loop = 0; loop < 4; loop++) {
+			steps.push_back({ EZSP_NOP, std::vector<uint8_t>(), nullptr });
+		}
+		dongle.sendBatch(steps, [&nbBatches](EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses) {
+			nbBatches++;
+		});
+		if (uartDriver.getWriteCallsCount() - writeCalls != 1 || uartDriver.getWrittenBuffersCount() - writtenBuffers != 4) {
+			FAILF("Expected 4 frames in 1 write, got %zu frames in %zu writes", uartDriver.getWrittenBuffersCount() - writtenBuffers,
+			      uartDriver.getWriteCallsCount() - writeCalls);
+		}
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(1))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+	if (!observer.waitRxCount(8, std::chrono::seconds(1)) || nbBatches != 1) {
+		FAILF("Batch did not complete");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_dongle() {
+	dongle_link_stats();
+	dongle_stop_and_wait();
+	dongle_tx_window();
+	dongle_tx_window_nak_retransmit();
+	dongle_ack_timeout_retransmit();
+	dongle_delayed_ack();
+	dongle_response_callback();
+	dongle_command_timeout();
+	dongle_late_response();
+	dongle_priority_lanes();
+	dongle_queue_overflow();
+	dongle_batch();
+	dongle_frame_buffer();
+	dongle_observer_subscriptions();
+	dongle_executor();
+	dongle_serialised_timers();
+	dongle_tx_coalescing();
+}
+#endif	// USE_CPPUTEST
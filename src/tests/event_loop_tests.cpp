@@ -0,0 +1,173 @@
+#include "TestHarness.h"
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#include "../spi/cppthreads/CppThreadsEventLoop.h"
+
+/**
+ * @brief Flag set from the event loop, that the test thread can wait for
+ */
+class EventLoopSignal {
+public:
+	EventLoopSignal() : mutex(), cv(), count(0) { }
+
+	void notify() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->count++;
+		this->cv.notify_all();
+	}
+
+	bool wait(unsigned int expected, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, expected]() { return this->count >= expected; });
+	}
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	unsigned int count;	/*!< Number of notify() invocations */
+};
+
+TEST_GROUP(event_loop_tests) {
+};
+
+TEST(event_loop_tests, event_loop_tasks) {
+	const unsigned int nbProducers = 4;
+	const unsigned int nbTasks = 10000;
+	CppThreadsEventLoop loop;
+	EventLoopSignal done;
+	/* Only accessed from the loop (no locking), then by the test once the loop stopped */
+	std::vector<std::vector<unsigned int> > ran(nbProducers);
+	unsigned int nbOutsideLoop = 0;
+
+	loop.start();
+	std::vector<std::thread> producers;
+	for (unsigned int producer = 0; producer < nbProducers; producer++) {
+		producers.push_back(std::thread([&loop, &ran, &nbOutsideLoop, producer]() {
+			for (unsigned int task = 0; task < nbTasks; task++) {
+				loop.post([&loop, &ran, &nbOutsideLoop, producer, task]() {
+					ran[producer].push_back(task);
+					if (!loop.isInExecutorThread()) {
+						nbOutsideLoop++;
+					}
+				});
+			}
+		}));
+	}
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+	loop.post([&done]() { done.notify(); });
+	if (!done.wait(1, std::chrono::seconds(10))) {
+		FAILF("Tasks not all run");
+	}
+	loop.stop();
+
+	if (loop.isInExecutorThread() || nbOutsideLoop != 0) {
+		FAILF("Expected tasks to run on the loop thread only");
+	}
+	for (unsigned int producer = 0; producer < nbProducers; producer++) {
+		if (ran[producer].size() != nbTasks) {
+			FAILF("Got %zu tasks out of %u from producer %u", ran[producer].size(), nbTasks, producer);
+		}
+		for (unsigned int task = 0; task < nbTasks; task++) {
+			if (ran[producer][task] != task) {
+				FAILF("Tasks of producer %u not run in posting order", producer);
+			}
+		}
+	}
+	NOTIFYPASS();
+}
+
+TEST(event_loop_tests, event_loop_timers) {
+	CppThreadsEventLoop loop;
+	EventLoopSignal done;
+	std::unique_ptr<ITimer> shortTimer = loop.create();
+	std::unique_ptr<ITimer> longTimer = loop.create();
+	std::unique_ptr<ITimer> stoppedTimer = loop.create();
+	std::vector<char> expired;	/* Only accessed from the loop, then by the test once the loop stopped */
+	bool onLoop = true;
+
+	loop.start();
+	/* Started from the test thread, out of deadline order: the loop must wake up for the earlier one */
+	longTimer->start(60, [&loop, &expired, &onLoop, &done](ITimer*) {
+		expired.push_back('L');
+		onLoop = onLoop && loop.isInExecutorThread();
+		done.notify();
+	});
+	shortTimer->start(10, [&loop, &expired, &onLoop](ITimer* triggeringTimer) {
+		expired.push_back('S');
+		onLoop = onLoop && loop.isInExecutorThread();
+		/* Restarted from its own callback */
+		triggeringTimer->start(5, [&expired](ITimer*) { expired.push_back('R'); });
+	});
+	stoppedTimer->start(20, [&expired](ITimer*) { expired.push_back('X'); });
+	if (!stoppedTimer->isRunning() || !stoppedTimer->stop() || stoppedTimer->isRunning()) {
+		FAILF("Failed stopping timer");
+	}
+	if (!done.wait(1, std::chrono::seconds(2))) {
+		FAILF("Timer did not expire");
+	}
+	loop.stop();
+
+	if (expired != std::vector<char>({ 'S', 'R', 'L' }) || !onLoop) {
+		FAILF("Expected timers to expire in deadline order on the loop thread, got %zu expirations", expired.size());
+	}
+	if (shortTimer->isRunning() || longTimer->isRunning()) {
+		FAILF("Expected timers to stop running on expiration");
+	}
+	NOTIFYPASS();
+}
+
+TEST(event_loop_tests, event_loop_timer_starvation) {
+	CppThreadsEventLoop loop;
+	EventLoopSignal done;
+	std::unique_ptr<ITimer> timer = loop.create();
+	std::atomic<bool> expired(false);
+	std::function<void ()> busyTask;
+	unsigned int nbBusyTasks = 0;	/* Only accessed from the loop, then by the test once the loop stopped */
+
+	/* The queue never gets empty: a task posting itself again, and another thread posting tasks continuously */
+	busyTask = [&loop, &expired, &busyTask, &nbBusyTasks]() {
+		nbBusyTasks++;
+		if (!expired.load()) {
+			loop.post(busyTask);
+		}
+	};
+	loop.start();
+	loop.post(busyTask);
+	std::thread producer([&loop, &expired]() {
+		while (!expired.load()) {
+			loop.post([]() { });
+		}
+	});
+	timer->start(10, [&expired, &done](ITimer*) {
+		expired.store(true);
+		done.notify();
+	});
+	bool fired = done.wait(1, std::chrono::seconds(2));
+	expired.store(true);
+	producer.join();
+	loop.stop();
+
+	if (!fired) {
+		FAILF("Timer starved by tasks posted continuously");
+	}
+	if (nbBusyTasks < 2) {
+		FAILF("Expected the self-posting task to run repeatedly, got %u runs", nbBusyTasks);
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_event_loop() {
+	event_loop_tasks();
+	event_loop_timers();
+	event_loop_timer_starvation();
+}
+#endif	// USE_CPPUTEST
@@ -0,0 +1,255 @@
+#include "TestHarness.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+#include "../spi/ExtendedTimerAdapter.h"
+#include "../spi/virtual-clock/VirtualClock.h"
+#include "../spi/cppthreads/CppThreadsExtendedTimer.h"
+#include "../spi/cppthreads/CppThreadsTimer.h"
+
+/**
+ * @brief Expirations of an extended timer, recorded by its callback
+ */
+class ExtendedTimerRecorder {
+public:
+	ExtendedTimerRecorder() : mutex(), cv(), times(), lateness() { }
+
+	void record(const std::chrono::steady_clock::time_point& time, const IExtendedTimer::TDuration& timerLateness) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->times.push_back(time);
+		this->lateness.push_back(timerLateness);
+		this->cv.notify_all();
+	}
+
+	bool wait(size_t count, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, count]() { return this->times.size() >= count; });
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each expiration */
+	std::vector<std::chrono::steady_clock::time_point> times;	/*!< Time of each expiration */
+	std::vector<IExtendedTimer::TDuration> lateness;	/*!< Lateness reported by the timer at each expiration */
+};
+
+TEST_GROUP(extended_timer_tests) {
+};
+
+TEST(extended_timer_tests, extended_timer_adapter_long) {
+	VirtualClock clock;
+	ExtendedTimerAdapter timer(clock);
+	ExtendedTimerRecorder recorder;
+	const VirtualClock::TTimePoint start = clock.now();
+
+	/* 255s, overflowing the 16-bit ms timeout of ITimer */
+	timer.start(std::chrono::seconds(255), [&clock, &recorder](IExtendedTimer* triggeringTimer) {
+		recorder.record(clock.now(), triggeringTimer->getLateness());
+	});
+	clock.advance(std::chrono::seconds(254));
+	if (!recorder.times.empty() || !timer.isRunning()) {
+		FAILF("Expected the timer to still be running after 254s");
+	}
+	clock.advance(std::chrono::seconds(1));
+	if (recorder.times.size() != 1 || recorder.times[0] - start != std::chrono::seconds(255) || recorder.lateness[0].count() != 0) {
+		FAILF("Expected a single expiration exactly after 255s");
+	}
+	/* Two hours, then stopped halfway */
+	timer.start(std::chrono::hours(2), [&clock, &recorder](IExtendedTimer* triggeringTimer) {
+		recorder.record(clock.now(), triggeringTimer->getLateness());
+	});
+	clock.advance(std::chrono::hours(1));
+	if (!timer.stop() || timer.isRunning() || timer.stop()) {
+		FAILF("Expected stop() to succeed once");
+	}
+	clock.advance(std::chrono::hours(2));
+	if (recorder.times.size() != 1 || timer.isRunning()) {
+		FAILF("Expected the stopped timer not to expire");
+	}
+	if (timer.startPeriodic(IExtendedTimer::TDuration::zero(), [](IExtendedTimer* triggeringTimer) { }) || timer.start(std::chrono::seconds(1), nullptr)) {
+		FAILF("Expected a 0 period and an empty callback to be rejected");
+	}
+	NOTIFYPASS();
+}
+
+TEST(extended_timer_tests, extended_timer_adapter_periodic) {
+	VirtualClock clock;
+	ExtendedTimerAdapter timer(clock);
+	ExtendedTimerRecorder recorder;
+	const VirtualClock::TTimePoint start = clock.now();
+
+	/* 1.5ms period: steps are rounded up to 1ms, without accumulating the rounding */
+	timer.startPeriodic(std::chrono::microseconds(1500), [&clock, &recorder](IExtendedTimer* triggeringTimer) {
+		recorder.record(clock.now(), triggeringTimer->getLateness());
+		if (recorder.times.size() == 10) {
+			triggeringTimer->stop();
+		}
+	});
+	clock.advance(std::chrono::milliseconds(100));
+	if (recorder.times.size() != 10 || timer.isRunning()) {
+		FAILF("Got %zu expirations out of 10", recorder.times.size());
+	}
+	for (unsigned int loop = 0; loop < 10; loop++) {
+		std::chrono::microseconds due((loop + 1) * 1500);
+		std::chrono::microseconds expected((loop % 2 == 0) ? 500 : 0);
+		if (recorder.times[loop] - start != due + expected || recorder.lateness[loop] != expected) {
+			FAILF("Expiration %u did not occur at %lldus", loop, static_cast<long long>((due + expected).count()));
+		}
+	}
+	/* Restarted from its callback, with a one-shot timeout */
+	timer.startPeriodic(std::chrono::milliseconds(10), [&clock, &recorder](IExtendedTimer* triggeringTimer) {
+		recorder.record(clock.now(), triggeringTimer->getLateness());
+		triggeringTimer->start(std::chrono::milliseconds(25), [&clock, &recorder](IExtendedTimer* triggeringTimer) {
+			recorder.record(clock.now(), triggeringTimer->getLateness());
+		});
+	});
+	clock.advance(std::chrono::milliseconds(100));
+	if (recorder.times.size() != 12 || recorder.times[11] - recorder.times[10] != std::chrono::milliseconds(25) || timer.isRunning()) {
+		FAILF("Expected the periodic timer to be replaced by a one-shot timer");
+	}
+	NOTIFYPASS();
+}
+
+TEST(extended_timer_tests, extended_timer_cppthreads) {
+	CppThreadsExtendedTimer timer;
+	ExtendedTimerRecorder recorder;
+	const std::chrono::microseconds period(2500);
+	const unsigned int nbPeriods = 40;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	unsigned int nbRuns = 0;	/* Only accessed from the timer thread */
+	timer.startPeriodic(period, [&recorder, &nbRuns, nbPeriods](IExtendedTimer* triggeringTimer) {
+		recorder.record(std::chrono::steady_clock::now(), triggeringTimer->getLateness());
+		if (++nbRuns == nbPeriods) {
+			triggeringTimer->stop();
+		}
+	});
+	if (!recorder.wait(nbPeriods, std::chrono::seconds(2))) {
+		FAILF("Got %zu expirations out of %u", recorder.times.size(), nbPeriods);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		if (recorder.times.size() != nbPeriods || timer.isRunning()) {
+			FAILF("Expected the timer to stop from its callback");
+		}
+		for (unsigned int loop = 0; loop < nbPeriods; loop++) {
+			std::chrono::steady_clock::time_point due = start + period * (loop + 1);
+			/* Lateness may make the timer skip periods, but expirations never occur early */
+			if (recorder.times[loop] < due || recorder.lateness[loop].count() < 0) {
+				FAILF("Expiration %u occurred early", loop);
+			}
+		}
+		/* The schedule does not drift with the lateness of each callback */
+		if (recorder.times.back() - start > period * nbPeriods + std::chrono::milliseconds(50)) {
+			FAILF("Periodic timer drifted by %lldus", static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(recorder.times.back() - start - period * nbPeriods).count()));
+		}
+		recorder.times.clear();
+		recorder.lateness.clear();
+	}
+	/* Restarted before its expiration, then stopped */
+	start = std::chrono::steady_clock::now();
+	for (unsigned int loop = 0; loop < 5; loop++) {
+		timer.start(std::chrono::milliseconds(30), [&recorder](IExtendedTimer* triggeringTimer) {
+			recorder.record(std::chrono::steady_clock::now(), triggeringTimer->getLateness());
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (!recorder.wait(1, std::chrono::seconds(1)) || recorder.times[0] - start < std::chrono::milliseconds(70)) {
+		FAILF("Expected the timer to expire 30ms after its last restart");
+	}
+	timer.start(std::chrono::milliseconds(20), [&recorder](IExtendedTimer* triggeringTimer) {
+		recorder.record(std::chrono::steady_clock::now(), triggeringTimer->getLateness());
+	});
+	if (!timer.stop()) {
+		FAILF("Expected stop() to succeed");
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.times.size() != 1) {
+		FAILF("Expected the stopped timer not to expire");
+	}
+	NOTIFYPASS();
+}
+
+TEST(extended_timer_tests, cppthreads_timer_restart_from_callback) {
+	CppThreadsTimer timer;
+	ExtendedTimerRecorder recorder;
+	const unsigned int nbRuns = 5;
+	std::atomic<unsigned int> nbRunning(0);
+	std::atomic<bool> overlapped(false);
+
+	std::function<void (ITimer*)> callback = [&](ITimer* triggeringTimer) {
+		if (++nbRunning > 1) {
+			overlapped = true;
+		}
+		recorder.record(std::chrono::steady_clock::now(), IExtendedTimer::TDuration(0));
+		if (recorder.times.size() < nbRuns) {	/* Only written from this callback */
+			triggeringTimer->start(1, callback);
+			/* Still running when the restarted timer expires */
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		--nbRunning;
+	};
+	timer.start(1, callback);
+	if (!recorder.wait(nbRuns, std::chrono::seconds(1))) {
+		FAILF("Got %zu expirations out of %u", recorder.times.size(), nbRuns);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	if (overlapped || timer.isRunning()) {
+		FAILF("Expected the callbacks of a timer restarted from its callback to run one after the other");
+	}
+	/* Restarted, then stopped from its callback */
+	recorder.times.clear();
+	timer.start(1, [&recorder](ITimer* triggeringTimer) {
+		triggeringTimer->start(1, [&recorder](ITimer*) {
+			recorder.record(std::chrono::steady_clock::now(), IExtendedTimer::TDuration(0));
+		});
+		if (!triggeringTimer->stop()) {
+			FAILF("Expected stop() to succeed");
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	if (!recorder.times.empty() || timer.isRunning()) {
+		FAILF("Expected the timer stopped from its callback not to expire");
+	}
+	/* Restarted then stopped by another thread, holding a lock the running callback waits for */
+	std::mutex callbackLock;
+	std::unique_lock<std::mutex> heldLock(callbackLock);
+	auto blockedCallback = [&callbackLock](ITimer*) {
+		std::lock_guard<std::mutex> lock(callbackLock);
+	};
+	auto recordingCallback = [&recorder](ITimer*) {
+		recorder.record(std::chrono::steady_clock::now(), IExtendedTimer::TDuration(0));
+	};
+	timer.start(1, blockedCallback);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	timer.start(1, recordingCallback);	/* Would deadlock if it waited for the running callback */
+	if (!timer.stop()) {
+		FAILF("Expected stop() to succeed");
+	}
+	timer.start(5, recordingCallback);
+	heldLock.unlock();
+	if (!recorder.wait(1, std::chrono::seconds(1))) {
+		FAILF("Expected the timer restarted during its callback to expire after it");
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.times.size() != 1 || timer.isRunning()) {
+		FAILF("Expected the timer restarted during its callback to expire once");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_extended_timer() {
+	extended_timer_adapter_long();
+	extended_timer_adapter_periodic();
+	extended_timer_cppthreads();
+	cppthreads_timer_restart_from_callback();
+}
+#endif	// USE_CPPUTEST
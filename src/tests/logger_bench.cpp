@@ -0,0 +1,97 @@
+#include <ostream>
+#include <iomanip>
+#include <cstdio>
+#include <stdint.h>
+
+#include "BenchHarness.h"
+#include "../spi/LineBufferedLoggerStream.h"
+#include "../spi/AsyncLogWriter.h"
+
+/**
+ * @brief Logger stream writing one character per virtual call to @p sink, as ConsoleStdoutLogger used to do on stdout
+ */
+class CharLoggerBenchStream : public ILoggerStream {
+public:
+	CharLoggerBenchStream(FILE* sink) : ILoggerStream(LOG_LEVEL::DEBUG), sink(sink) { }
+
+	CharLoggerBenchStream(const CharLoggerBenchStream& other) = delete;
+	CharLoggerBenchStream& operator=(const CharLoggerBenchStream& other) = delete;
+
+	void log(const char *format, ...) { }
+
+	FILE* sink;	/*!< Where characters are written */
+
+protected:
+	int overflow(int c) {
+		if (c != EOF && this->isOutputting()) {
+			putc(c, this->sink);
+		}
+		return c;
+	}
+};
+
+/**
+ * @brief Line buffered logger stream writing each line to @p sink, as ConsoleStdoutLogger does on stdout
+ */
+class LineLoggerBenchStream : public LineBufferedLoggerStream {
+public:
+	LineLoggerBenchStream(FILE* sink) : LineBufferedLoggerStream(LOG_LEVEL::DEBUG), sink(sink) { }
+
+	LineLoggerBenchStream(const LineLoggerBenchStream& other) = delete;
+	LineLoggerBenchStream& operator=(const LineLoggerBenchStream& other) = delete;
+
+	void log(const char *format, ...) { }
+
+	FILE* sink;	/*!< Where lines are written */
+
+protected:
+	void outputLine(const SLogLine& line) {
+		fprintf(this->sink, "%.*s\n", static_cast<int>(line.length), line.text);
+	}
+};
+
+/**
+ * @brief Log a line similar to the ones CAsh::decode() logs for each frame
+ */
+static void logBenchLine(std::ostream& os, uint8_t frmNum) {
+	os << "CAsh::decode DATA frmNum=" << static_cast<unsigned int>(frmNum) << " ackNum=" << static_cast<unsigned int>(frmNum + 1) << " reTx=0 payload:";
+	for (uint8_t loop = 0; loop < 8; loop++) {
+		os << " " << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(frmNum + loop) << std::dec;
+	}
+	os << "\n";
+}
+
+void bench_logger() {
+	const unsigned long iterations = 200000;
+	uint8_t frmNum = 0;
+	FILE* sink = fopen("/dev/null", "w");
+
+	if (!sink) {
+		printf("Cannot open /dev/null, skipping logger benchmarks\n");
+		return;
+	}
+	CharLoggerBenchStream charStream(sink);
+	std::ostream charOs(&charStream);
+	benchRun("logger one char per call", iterations, [&charOs, &frmNum]() { logBenchLine(charOs, frmNum++); });
+
+	LineLoggerBenchStream lineStream(sink);
+	std::ostream lineOs(&lineStream);
+	benchRun("logger line buffered", iterations, [&lineOs, &frmNum]() { logBenchLine(lineOs, frmNum++); });
+
+	LineLoggerBenchStream asyncStream(sink);
+	std::ostream asyncOs(&asyncStream);
+	{
+		AsyncLogWriter writer;
+		asyncStream.setAsyncWriter(&writer);
+		benchRun("logger line buffered, async writer", iterations, [&asyncOs, &frmNum]() { logBenchLine(asyncOs, frmNum++); });
+		writer.flush();
+		printf("%-48s %12llu lines dropped out of %lu\n", "logger async writer", static_cast<unsigned long long>(writer.getDroppedCount()), iterations);
+		asyncStream.setAsyncWriter(nullptr);
+	}
+
+	charStream.mute();
+	benchRun("logger one char per call, muted", iterations, [&charOs, &frmNum]() { logBenchLine(charOs, frmNum++); });
+	lineStream.mute();
+	benchRun("logger line buffered, muted", iterations, [&lineOs, &frmNum]() { logBenchLine(lineOs, frmNum++); });
+	fclose(sink);
+}
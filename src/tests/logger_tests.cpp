@@ -0,0 +1,291 @@
+#include "TestHarness.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <new>
+#include <type_traits>
+
+#include "../spi/LineBufferedLoggerStream.h"
+#include "../spi/AsyncLogWriter.h"
+
+/**
+ * @brief Logger stream recording the lines it outputs, optionally blocking the output until released
+ */
+class RecordingLoggerStream : public LineBufferedLoggerStream {
+public:
+	RecordingLoggerStream(const LOG_LEVEL logLevel) : LineBufferedLoggerStream(logLevel), mutex(), released(), blocked(false), lines() { }
+
+	void log(const char *format, ...) { }
+
+	void block() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->blocked = true;
+	}
+
+	void release() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->blocked = false;
+		this->released.notify_all();
+	}
+
+	std::vector<std::string> getTexts() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::vector<std::string> texts;
+		for (const auto& line : this->lines) {
+			texts.push_back(line.text);
+		}
+		return texts;
+	}
+
+	/**
+	 * @brief Copy of a SLogLine, owning its text
+	 */
+	struct SRecordedLine {
+		LOG_LEVEL level;
+		std::chrono::system_clock::time_point timestamp;
+		std::thread::id threadId;
+		std::string text;
+	};
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable released;	/*!< Signalled when blocked is reset */
+	bool blocked;	/*!< Block outputLine() until release() is invoked */
+	std::vector<SRecordedLine> lines;	/*!< Lines output, in order */
+
+protected:
+	void outputLine(const SLogLine& line) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->released.wait(lock, [this]() { return !this->blocked; });
+		this->lines.push_back(SRecordedLine{line.level, line.timestamp, line.threadId, std::string(line.text, line.length)});
+	}
+};
+
+/**
+ * @brief Log lines from several threads, each through its own ostream sharing @p stream, and check that no line is mixed
+ */
+static void loggerCheckThreads(RecordingLoggerStream& stream, AsyncLogWriter* writer) {
+	const unsigned int nbThreads = 4;
+	const unsigned int nbLines = 1000;
+	std::vector<std::thread> threads;
+
+	for (unsigned int thread = 0; thread < nbThreads; thread++) {
+		threads.push_back(std::thread([&stream, thread, nbLines]() {
+			std::ostream os(&stream);
+			for (unsigned int line = 0; line < nbLines; line++) {
+				/* Inserted piece by piece, as the library does */
+				os << "thread " << thread << " line ";
+				os << line;
+				os << "\n";
+			}
+		}));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	if (writer && !writer->flush()) {
+		FAILF("Timed out waiting for the writer to output the lines");
+	}
+	std::vector<std::string> texts = stream.getTexts();
+	std::vector<unsigned int> nextLine(nbThreads, 0);
+	if (texts.size() != nbThreads * nbLines) {
+		FAILF("Got %zu lines out of %u", texts.size(), nbThreads * nbLines);
+	}
+	for (const auto& text : texts) {
+		unsigned int thread = nbThreads;
+		unsigned int line = nbLines;
+		std::string word1, word2;
+		std::istringstream parser(text);
+		parser >> word1 >> thread >> word2 >> line;
+		if (word1 != "thread" || word2 != "line" || thread >= nbThreads || line != nextLine[thread] || !parser.eof()) {
+			FAILF("Unexpected line \"%s\"", text.c_str());
+		}
+		nextLine[thread]++;
+	}
+}
+
+static RecordingLoggerStream* exitLoggerStream = nullptr;	/*!< The stream SExitLogger logs to */
+
+/**
+ * @brief Logs a line when destroyed, as the destructor of a static or thread_local object may do
+ */
+struct SExitLogger {
+	~SExitLogger() {
+		std::ostream os(exitLoggerStream);
+		os << "exit " << 1 << std::endl;
+	}
+};
+
+TEST_GROUP(logger_tests) {
+};
+
+TEST(logger_tests, logger_line_split) {
+	RecordingLoggerStream stream(LOG_LEVEL::DEBUG);
+	std::ostream os(&stream);
+
+	os << "abc" << 12 << '\n' << "de\nf";
+	if (stream.getTexts().size() != 2) {
+		FAILF("Expected only complete lines to be output");
+	}
+	os << std::flush;	/* Completes the pending line */
+	os << "g" << std::endl;
+	stream.mute();
+	os << "muted\n";
+	stream.unmute();
+	stream.setMaxEnabledLogLevel(LOG_LEVEL::INFO);
+	os << "disabled\n";
+	stream.setMaxEnabledLogLevel(LOG_LEVEL::TRACE);
+	os << "\n";
+	if (stream.getTexts() != std::vector<std::string>({ "abc12", "de", "f", "g", "" })) {
+		FAILF("Unexpected lines output");
+	}
+	if (stream.lines[0].level != LOG_LEVEL::DEBUG || stream.lines[0].threadId != std::this_thread::get_id()) {
+		FAILF("Expected lines to carry their level and thread");
+	}
+	NOTIFYPASS();
+}
+
+TEST(logger_tests, logger_threads) {
+	RecordingLoggerStream stream(LOG_LEVEL::INFO);
+	loggerCheckThreads(stream, nullptr);
+
+	RecordingLoggerStream asyncStream(LOG_LEVEL::INFO);
+	AsyncLogWriter writer(16384);
+	asyncStream.setAsyncWriter(&writer);
+	loggerCheckThreads(asyncStream, &writer);
+	if (writer.getDroppedCount() != 0 || writer.getWrittenCount() != 4000) {
+		FAILF("Expected all lines to be written by the writer");
+	}
+	for (const auto& line : asyncStream.lines) {
+		if (line.threadId == std::this_thread::get_id()) {
+			FAILF("Expected lines to carry the thread that logged them");
+		}
+	}
+	asyncStream.setAsyncWriter(nullptr);
+	NOTIFYPASS();
+}
+
+TEST(logger_tests, logger_async_drop) {
+	RecordingLoggerStream stream(LOG_LEVEL::WARNING);
+	RecordingLoggerStream otherStream(LOG_LEVEL::ERROR);
+	AsyncLogWriter writer(16);
+	std::ostream os(&stream);
+	std::ostream otherOs(&otherStream);
+
+	stream.setAsyncWriter(&writer);
+	otherStream.setAsyncWriter(&writer);
+	/* The output is stuck: logging must not wait for it, lines that do not fit in the ring are dropped */
+	stream.block();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int loop = 0; loop < 100; loop++) {
+		os << "line " << loop << "\n";
+	}
+	if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(500)) {
+		FAILF("Logging waited for the output");
+	}
+	if (writer.getDroppedCount() != 84 || writer.flush(std::chrono::milliseconds(20))) {
+		FAILF("Expected 84 lines dropped out of 100, got %llu", static_cast<unsigned long long>(writer.getDroppedCount()));
+	}
+	stream.release();
+	if (!writer.flush()) {
+		FAILF("Timed out waiting for the writer to output the lines");
+	}
+	otherOs << std::string(1000, 'x') << "\n";
+	if (!writer.flush()) {
+		FAILF("Timed out waiting for the writer to output the lines");
+	}
+	std::vector<std::string> texts = stream.getTexts();
+	if (texts.size() != 16 || texts[0] != "line 0" || texts[15] != "line 15" || writer.getWrittenCount() != 17) {
+		FAILF("Expected the first 16 lines to be output");
+	}
+	for (size_t loop = 1; loop < stream.lines.size(); loop++) {
+		if (stream.lines[loop].timestamp < stream.lines[loop - 1].timestamp || stream.lines[loop].level != LOG_LEVEL::WARNING) {
+			FAILF("Expected lines to carry their level and timestamp");
+		}
+	}
+	if (otherStream.getTexts() != std::vector<std::string>({ std::string(AsyncLogWriter::MAX_LINE_LENGTH, 'x') }) || otherStream.lines[0].level != LOG_LEVEL::ERROR) {
+		FAILF("Expected the long line to be truncated");
+	}
+
+	/* Detaching the writer outputs the lines still pending in it, so that the stream can be destroyed */
+	stream.block();
+	os << "last line\n";
+	std::thread releaser([&stream]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		stream.release();
+	});
+	stream.setAsyncWriter(nullptr);
+	otherStream.setAsyncWriter(nullptr);
+	texts = stream.getTexts();
+	releaser.join();
+	if (texts.size() != 17 || texts[16] != "last line") {
+		FAILF("Expected the pending line to be output when detaching the writer");
+	}
+	NOTIFYPASS();
+}
+
+TEST(logger_tests, logger_stream_reuse) {
+	/* The second stream is constructed at the address of the first one, once destroyed */
+	std::aligned_storage<sizeof(RecordingLoggerStream), alignof(RecordingLoggerStream)>::type storage;
+	RecordingLoggerStream* stream = new (&storage) RecordingLoggerStream(LOG_LEVEL::INFO);
+	std::promise<void> lineStarted;
+	std::promise<void> streamReplaced;
+	std::future<void> replaced = streamReplaced.get_future();
+
+	std::thread logger([stream, &lineStarted, &replaced]() {
+		{
+			std::ostream os(stream);
+			os << "abc";	/* Not completed before the stream is destroyed */
+		}
+		lineStarted.set_value();
+		replaced.wait();
+		std::ostream os(stream);
+		os << "def\n";
+	});
+	lineStarted.get_future().wait();
+	stream->~RecordingLoggerStream();
+	stream = new (&storage) RecordingLoggerStream(LOG_LEVEL::INFO);
+	streamReplaced.set_value();
+	logger.join();
+	std::vector<std::string> texts = stream->getTexts();
+	stream->~RecordingLoggerStream();
+	if (texts != std::vector<std::string>({ "def" })) {
+		FAILF("Expected the line started on the destroyed stream not to be continued on the new one");
+	}
+	NOTIFYPASS();
+}
+
+TEST(logger_tests, logger_thread_exit) {
+	RecordingLoggerStream stream(LOG_LEVEL::INFO);
+	exitLoggerStream = &stream;
+
+	std::thread logger([&stream]() {
+		/* Constructed before the line buffers of this thread, thus destroyed after them */
+		static thread_local SExitLogger exitLogger;
+		(void)exitLogger;
+		std::ostream os(&stream);
+		os << "running\n";
+	});
+	logger.join();
+	exitLoggerStream = nullptr;
+	/* Without its buffers, each piece written by the thread is output at once */
+	if (stream.getTexts() != std::vector<std::string>({ "running", "exit ", "1" })) {
+		FAILF("Expected the lines logged after the destruction of the thread buffers to be output");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_logger() {
+	logger_line_split();
+	logger_threads();
+	logger_async_drop();
+	logger_stream_reuse();
+	logger_thread_exit();
+}
+#endif	// USE_CPPUTEST
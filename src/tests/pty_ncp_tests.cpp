@@ -0,0 +1,154 @@
+#include "TestHarness.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#include "PtyNcp.h"
+#include "../domain/ezsp-dongle.h"
+#include "../spi/termios/TermiosUartDriver.h"
+#include "../spi/cppthreads/CppThreadsEventLoop.h"
+
+/**
+ * @brief Dongle observer counting the EZSP messages received, notified from the event loop
+ */
+class PtyNcpTestObserver : public CEzspDongleObserver {
+public:
+	PtyNcpTestObserver() : mutex(), cv(), ready(false), nbRx(0) { }
+
+	void handleDongleState(EDongleState i_state) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->ready = (i_state == DONGLE_READY);
+		this->cv.notify_all();
+	}
+
+	void handleEzspRxFrame(EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->nbRx++;
+		this->cv.notify_all();
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each event */
+	bool ready;	/*!< Dongle reported DONGLE_READY */
+	unsigned int nbRx;	/*!< Number of EZSP messages received */
+};
+
+/**
+ * @brief A dongle on the event loop, talking through the termios driver to an emulated NCP on a pseudo-terminal
+ */
+class PtyNcpHost {
+public:
+	PtyNcpHost() : ncp(), loop(), observer(), dongle(loop, &observer), uartDriver() {
+		this->dongle.setExecutor(&this->loop);
+		this->dongle.setTxWindow(4);
+		this->loop.start();
+	}
+
+	~PtyNcpHost() {
+		this->uartDriver.close();
+		this->loop.stop();
+	}
+
+	PtyNcpHost(const PtyNcpHost& other) = delete; /* No copy construction allowed */
+
+	PtyNcpHost& operator=(const PtyNcpHost& other) = delete; /* No assignment allowed */
+
+	bool open() {
+		if (this->ncp.getPortName().empty() || this->uartDriver.open(this->ncp.getPortName(), 115200) != 0) {
+			return false;
+		}
+		this->loop.post([this]() { this->dongle.open(&this->uartDriver); });
+		std::unique_lock<std::mutex> lock(this->observer.mutex);
+		return this->observer.cv.wait_for(lock, std::chrono::seconds(2), [this]() { return this->observer.ready; });
+	}
+
+	PtyNcp ncp;
+	CppThreadsEventLoop loop;
+	PtyNcpTestObserver observer;
+	CEzspDongle dongle;
+	TermiosUartDriver uartDriver;	/* Declared last, so that its read thread is stopped first */
+};
+
+TEST_GROUP(pty_ncp_tests) {
+};
+
+TEST(pty_ncp_tests, pty_ncp_ezsp_stack) {
+	PtyNcpHost host;
+	std::vector<SEzspBatchStep> steps;
+	EEzspCmdStatus status = EZSP_CMD_TIMEOUT;	/* Protected by host.observer.mutex */
+	std::vector<CEzspFrameBuffer> responses;	/* Protected by host.observer.mutex */
+	bool done = false;	/* Protected by host.observer.mutex */
+	const std::vector<uint8_t> gpdAddress({ 0x00, 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0x00, 0x00, 0x01 });
+
+	if (!host.open()) {
+		FAILF("Dongle did not get ready on %s", host.ncp.getPortName().c_str());
+	}
+	steps.push_back({ EZSP_VERSION, std::vector<uint8_t>({ 8 }), nullptr });
+	steps.push_back({ EZSP_SET_CONFIGURATION_VALUE, std::vector<uint8_t>({ 0x01, 0x34, 0x12 }), nullptr });
+	steps.push_back({ EZSP_GET_CONFIGURATION_VALUE, std::vector<uint8_t>({ 0x01 }), nullptr });
+	steps.push_back({ EZSP_NETWORK_STATE, std::vector<uint8_t>(), nullptr });
+	steps.push_back({ EZSP_GP_SINK_TABLE_FIND_OR_ALLOCATE_ENTRY, gpdAddress, nullptr });
+	steps.push_back({ EZSP_GP_SINK_TABLE_LOOKUP, gpdAddress, nullptr });
+	steps.push_back({ EZSP_GP_PROXY_TABLE_GET_ENTRY, std::vector<uint8_t>({ 0x00 }), nullptr });
+	host.loop.post([&host, &steps, &status, &responses, &done]() {
+		host.dongle.sendBatch(steps, [&host, &status, &responses, &done](EEzspCmdStatus i_status, std::size_t i_failed_step, const std::vector<CEzspFrameBuffer>& i_responses) {
+			std::lock_guard<std::mutex> lock(host.observer.mutex);
+			status = i_status;
+			responses = i_responses;
+			done = true;
+			host.observer.cv.notify_all();
+		});
+	});
+	{
+		std::unique_lock<std::mutex> lock(host.observer.mutex);
+		if (!host.observer.cv.wait_for(lock, std::chrono::seconds(2), [&done]() { return done; }) || status != EZSP_CMD_SUCCESS) {
+			FAILF("Batch failed");
+		}
+		if (responses[0].toVector() != std::vector<uint8_t>({ 8, 0x02, 0x00, 0x67 })) {
+			FAILF("Unexpected version response");
+		}
+		if (responses[2].toVector() != std::vector<uint8_t>({ EMBER_SUCCESS, 0x34, 0x12 })) {
+			FAILF("Expected the configuration value set to be read back");
+		}
+		if (responses[3].toVector() != std::vector<uint8_t>({ EMBER_JOINED_NETWORK })) {
+			FAILF("Unexpected network state");
+		}
+		if (responses[4].toVector() != std::vector<uint8_t>({ 0x00 }) || responses[5].toVector() != std::vector<uint8_t>({ 0x00 })) {
+			FAILF("Expected the GPD to be allocated and found in the first sink table entry");
+		}
+		if (responses[6].size() != 1 || responses[6][0] == EMBER_SUCCESS) {
+			FAILF("Expected an empty proxy table");
+		}
+	}
+	NOTIFYPASS();
+}
+
+TEST(pty_ncp_tests, pty_ncp_callbacks) {
+	PtyNcpHost host;
+
+	if (!host.open()) {
+		FAILF("Dongle did not get ready on %s", host.ncp.getPortName().c_str());
+	}
+	/* 2000 GP callbacks per second, by bursts of 4 */
+	host.ncp.startCallbacks(EZSP_GPEP_INCOMING_MESSAGE_HANDLER, std::vector<uint8_t>(30, 0x00), 2000, 4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	unsigned int nbSent = host.ncp.stopCallbacks();
+	if (nbSent < 200) {
+		FAILF("Only %u callbacks sent in 200ms", nbSent);
+	}
+	std::unique_lock<std::mutex> lock(host.observer.mutex);
+	if (!host.observer.cv.wait_for(lock, std::chrono::seconds(2), [&host, nbSent]() { return host.observer.nbRx >= nbSent; })) {
+		FAILF("Got %u callbacks out of %u", host.observer.nbRx, nbSent);
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_pty_ncp() {
+	pty_ncp_ezsp_stack();
+	pty_ncp_callbacks();
+}
+#endif	// USE_CPPUTEST
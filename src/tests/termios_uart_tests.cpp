@@ -0,0 +1,172 @@
+#include "TestHarness.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cerrno>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "../spi/termios/TermiosUartDriver.h"
+
+/**
+ * @brief Pseudo-terminal pair, the slave side standing for the serial port and the master side for the NCP
+ */
+class PtyPair {
+public:
+	PtyPair() : master(posix_openpt(O_RDWR | O_NOCTTY)), slaveName() {
+		if (this->master >= 0 && grantpt(this->master) == 0 && unlockpt(this->master) == 0) {
+			this->slaveName = ptsname(this->master);
+		}
+	}
+
+	~PtyPair() {
+		if (this->master >= 0) {
+			close(this->master);
+		}
+	}
+
+	PtyPair(const PtyPair& other) = delete; /* No copy construction allowed */
+
+	PtyPair& operator=(const PtyPair& other) = delete; /* No assignment allowed */
+
+	/**
+	 * @brief Read @p count bytes written by the driver to the slave side
+	 */
+	std::vector<uint8_t> readMaster(size_t count, int timeoutMs) {
+		std::vector<uint8_t> bytes;
+		uint8_t buf[256];
+		while (bytes.size() < count) {
+			struct pollfd pfd = { this->master, POLLIN, 0 };
+			if (poll(&pfd, 1, timeoutMs) <= 0) {
+				break;
+			}
+			ssize_t rdcnt = read(this->master, buf, sizeof(buf));
+			if (rdcnt <= 0) {
+				break;
+			}
+			bytes.insert(bytes.end(), buf, buf + rdcnt);
+		}
+		return bytes;
+	}
+
+	int master;	/*!< Master side file descriptor, -1 on failure */
+	std::string slaveName;	/*!< Slave side device name, empty on failure */
+};
+
+/**
+ * @brief Observer recording the bytes received by the driver, and in how many notifications
+ */
+class UartInputRecorder : public IAsyncDataInputObserver {
+public:
+	UartInputRecorder() : mutex(), cv(), bytes(), nbNotifications(0) { }
+
+	void handleInputData(const unsigned char* dataIn, const size_t dataLen) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->bytes.insert(this->bytes.end(), dataIn, dataIn + dataLen);
+		this->nbNotifications++;
+		this->cv.notify_all();
+	}
+
+	bool waitBytes(size_t count, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, count]() { return this->bytes.size() >= count; });
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each notification */
+	std::vector<uint8_t> bytes;	/*!< All bytes received, in order */
+	unsigned int nbNotifications;	/*!< Number of handleInputData() invocations */
+};
+
+TEST_GROUP(termios_uart_tests) {
+};
+
+TEST(termios_uart_tests, termios_uart_open_errors) {
+	TermiosUartDriver uartDriver;
+
+	if (uartDriver.open("/dev/null", 12345) != EINVAL) {
+		FAILF("Expected an unsupported baudrate to be refused");
+	}
+	if (uartDriver.open("/nonexistent/ttyUSB0", 115200) != ENOENT) {
+		FAILF("Expected a missing port to be reported");
+	}
+	size_t writtenCnt = 1;
+	if (uartDriver.write(writtenCnt, "\x7E", 1) == 0 || writtenCnt != 0) {
+		FAILF("Expected a write on a closed port to fail");
+	}
+	NOTIFYPASS();
+}
+
+TEST(termios_uart_tests, termios_uart_chunked_io) {
+	const size_t nbBytes = 3000;
+	PtyPair pty;
+	GenericAsyncDataInputObservable uartIncomingDataHandler;
+	UartInputRecorder recorder;
+	TermiosUartDriver uartDriver;
+	std::vector<uint8_t> sent;
+
+	if (pty.slaveName.empty()) {
+		FAILF("Failed creating pseudo-terminal pair");
+	}
+	uartIncomingDataHandler.registerObserver(&recorder);
+	uartDriver.setIncomingDataHandler(&uartIncomingDataHandler);
+	if (uartDriver.open(pty.slaveName, 115200) != 0) {
+		FAILF("Failed opening %s", pty.slaveName.c_str());
+	}
+
+	/* Input written at once is delivered in chunks, not byte per byte */
+	for (size_t loop = 0; loop < nbBytes; loop++) {
+		sent.push_back(static_cast<uint8_t>(loop));
+	}
+	if (write(pty.master, sent.data(), sent.size()) != static_cast<ssize_t>(sent.size())) {
+		FAILF("Failed writing to the pseudo-terminal");
+	}
+	if (!recorder.waitBytes(nbBytes, std::chrono::seconds(2))) {
+		FAILF("Got %zu bytes out of %zu", recorder.bytes.size(), nbBytes);
+	}
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		if (recorder.bytes != sent) {
+			FAILF("Bytes corrupted on the way");
+		}
+		if (recorder.nbNotifications > nbBytes / 16) {
+			FAILF("Expected chunked delivery, got %u notifications for %zu bytes", recorder.nbNotifications, nbBytes);
+		}
+	}
+
+	/* Output */
+	size_t writtenCnt = 0;
+	if (uartDriver.write(writtenCnt, sent.data(), 300) != 0 || writtenCnt != 300) {
+		FAILF("Failed writing to the driver");
+	}
+	if (pty.readMaster(300, 1000) != std::vector<uint8_t>(sent.begin(), sent.begin() + 300)) {
+		FAILF("Bytes written not received on the other side");
+	}
+	UartIoVec iov[3] = { { sent.data(), 10 }, { sent.data() + 10, 0 }, { sent.data() + 10, 290 } };
+	if (uartDriver.writev(writtenCnt, iov, 3) != 0 || writtenCnt != 300) {
+		FAILF("Failed writing buffers to the driver");
+	}
+	if (pty.readMaster(300, 1000) != std::vector<uint8_t>(sent.begin(), sent.begin() + 300)) {
+		FAILF("Buffers written not received in order on the other side");
+	}
+
+	/* close() wakes the read thread up, without waiting for input */
+	auto start = std::chrono::steady_clock::now();
+	uartDriver.close();
+	if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(500)) {
+		FAILF("close() took too long");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_termios_uart() {
+	termios_uart_open_errors();
+	termios_uart_chunked_io();
+}
+#endif	// USE_CPPUTEST
@@ -13,13 +13,43 @@
 #ifndef USE_CPPUTEST
 void unit_tests_gp();	// Declaration of gp unit test procedure (see gp_tests.cpp)
 void unit_tests_mock_serial();	// Declaration of mock serial self tests (see mock_serial_self_tests.cpp)
+void unit_tests_ash();	// Declaration of ASH framing unit test procedure (see ash_tests.cpp)
+void unit_tests_dongle();	// Declaration of EZSP dongle unit test procedure (see dongle_tests.cpp)
+void unit_tests_event_loop();	// Declaration of event loop unit test procedure (see event_loop_tests.cpp)
+void unit_tests_termios_uart();	// Declaration of termios UART driver unit test procedure (see termios_uart_tests.cpp)
+void unit_tests_pty_ncp();	// Declaration of pseudo-terminal NCP emulator unit test procedure (see pty_ncp_tests.cpp)
+void unit_tests_uart_trace();	// Declaration of UART capture and replay unit test procedure (see uart_trace_tests.cpp)
+void unit_tests_virtual_clock();	// Declaration of virtual clock unit test procedure (see virtual_clock_tests.cpp)
+void unit_tests_timer_wheel();	// Declaration of timer wheel unit test procedure (see timer_wheel_tests.cpp)
+void unit_tests_extended_timer();	// Declaration of extended timer unit test procedure (see extended_timer_tests.cpp)
+void unit_tests_logger();	// Declaration of logger unit test procedure (see logger_tests.cpp)
 #endif
 
 int main(int argc, char* argv[]) {
 
 #ifndef USE_CPPUTEST
+	printf("*** Testing logger streams ***\n");
+	unit_tests_logger();
 	printf("*** Self test on mock serial ***\n");
 	unit_tests_mock_serial();
+	printf("*** Testing ASH framing ***\n");
+	unit_tests_ash();
+	printf("*** Testing termios UART driver ***\n");
+	unit_tests_termios_uart();
+	printf("*** Testing UART capture and replay ***\n");
+	unit_tests_uart_trace();
+	printf("*** Testing event loop ***\n");
+	unit_tests_event_loop();
+	printf("*** Testing timer wheel ***\n");
+	unit_tests_timer_wheel();
+	printf("*** Testing extended timers ***\n");
+	unit_tests_extended_timer();
+	printf("*** Testing EZSP dongle ***\n");
+	unit_tests_dongle();
+	printf("*** Testing EZSP dongle on an emulated NCP ***\n");
+	unit_tests_pty_ncp();
+	printf("*** Testing virtual clock ***\n");
+	unit_tests_virtual_clock();
 	printf("*** Testing GP frames processing ***\n");
 	unit_tests_gp();
 	printf("\n*** All unit tests passed successfully ***\n");
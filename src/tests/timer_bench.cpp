@@ -0,0 +1,87 @@
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <time.h>
+#include <stdint.h>
+
+#include "BenchHarness.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+#include "../spi/cppthreads/TimerWheelFactory.h"
+
+/**
+ * @brief Get the CPU time consumed by @p clock (CLOCK_PROCESS_CPUTIME_ID...), in ms
+ */
+static double timerBenchCpuTimeMs(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief Restart a single timer back-to-back, as CAsh does on each frame sent or received
+ */
+static void bench_timer_restart(const char* name, const ITimerFactory& factory, unsigned long iterations) {
+	std::unique_ptr<ITimer> timer = factory.create();
+	unsigned long nbExpired = 0;
+
+	double ns = benchRun((std::string(name) + " restart").c_str(), iterations, [&timer, &nbExpired]() {
+		timer->start(1600, [&nbExpired](ITimer* triggeringTimer) { nbExpired++; });
+	});
+	timer->stop();
+	printf("%-48s %12.0f starts/s\n", (std::string(name) + " restart rate").c_str(), 1e9 / ns);
+}
+
+/**
+ * @brief Start random timers at a steady 10k starts per second for one second, many of them restarted before expiring
+ */
+static void bench_timer_churn(const char* name, const ITimerFactory& factory) {
+	const unsigned int nbTimers = 64;
+	const unsigned int startsPerSecond = 10000;
+	std::vector<std::unique_ptr<ITimer> > timers;
+	std::vector<std::chrono::steady_clock::time_point> deadlines(nbTimers);
+	std::atomic<unsigned int> nbExpired(0);
+	std::atomic<long long> maxLatenessUs(0);
+	std::mt19937 random(1);
+	unsigned int nbStarts = 0;
+
+	for (unsigned int loop = 0; loop < nbTimers; loop++) {
+		timers.push_back(factory.create());
+	}
+	double cpuStart = timerBenchCpuTimeMs(CLOCK_PROCESS_CPUTIME_ID);
+	auto start = std::chrono::steady_clock::now();
+	auto end = start + std::chrono::seconds(1);
+	for (auto next = start; next < end; next += std::chrono::microseconds(1000000 / startsPerSecond)) {
+		std::this_thread::sleep_until(next);
+		unsigned int index = random() % nbTimers;
+		uint16_t timeout = static_cast<uint16_t>(1 + random() % 10);
+		/* deadlines[index] is only read by the callback of the start below, which cannot run before this write */
+		deadlines[index] = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		auto deadline = deadlines[index];
+		timers[index]->start(timeout, [&nbExpired, &maxLatenessUs, deadline](ITimer* triggeringTimer) {
+			long long lateness = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - deadline).count();
+			long long max = maxLatenessUs.load();
+			while (lateness > max && !maxLatenessUs.compare_exchange_weak(max, lateness)) {
+			}
+			nbExpired++;
+		});
+		nbStarts++;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));	/* Let the last timers expire */
+	double cpu = timerBenchCpuTimeMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+	timers.clear();
+	printf("%-48s %10.0f starts/s (%.2f us CPU/start, %u expired out of %u, max lateness %.1f ms)\n", (std::string(name) + " churn").c_str(),
+	       1000.0 * nbStarts / elapsed.count(), 1000.0 * cpu / nbStarts, nbExpired.load(), nbStarts, maxLatenessUs.load() / 1000.0);
+}
+
+void bench_timers() {
+	CppThreadsTimerFactory threadsFactory;
+	TimerWheelFactory wheelFactory;
+
+	bench_timer_restart("thread per timer", threadsFactory, 2000);
+	bench_timer_restart("timer wheel", wheelFactory, 1000000);
+	bench_timer_churn("thread per timer", threadsFactory);
+	bench_timer_churn("timer wheel", wheelFactory);
+}
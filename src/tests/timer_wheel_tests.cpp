@@ -0,0 +1,215 @@
+#include "TestHarness.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <stdint.h>
+
+#include "../spi/cppthreads/TimerWheelFactory.h"
+#include "../spi/cppthreads/CppThreadsEventLoop.h"
+
+/**
+ * @brief Expirations recorded by timer callbacks, that the test thread can wait for
+ */
+class TimerWheelRecorder {
+public:
+	TimerWheelRecorder() : mutex(), cv(), start(std::chrono::steady_clock::now()), ids(), elapsed(), threads() { }
+
+	void record(unsigned int id) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->ids.push_back(id);
+		this->elapsed.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->start).count());
+		this->threads.push_back(std::this_thread::get_id());
+		this->cv.notify_all();
+	}
+
+	bool wait(size_t count, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, count]() { return this->ids.size() >= count; });
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each expiration */
+	std::chrono::steady_clock::time_point start;	/*!< Reference time of elapsed */
+	std::vector<unsigned int> ids;	/*!< Identifiers of the expired timers, in expiration order */
+	std::vector<long long> elapsed;	/*!< Time of each expiration since start (in ms) */
+	std::vector<std::thread::id> threads;	/*!< Thread of each callback */
+};
+
+TEST_GROUP(timer_wheel_tests) {
+};
+
+TEST(timer_wheel_tests, timer_wheel_expiry) {
+	TimerWheelFactory factory;
+	TimerWheelRecorder recorder;
+	const uint16_t timeouts[] = { 250, 10, 100, 30 };	/* 100 and 250 start in the upper level, and are cascaded */
+	std::vector<std::unique_ptr<ITimer> > timers;
+
+	for (unsigned int loop = 0; loop < 4; loop++) {
+		timers.push_back(factory.create());
+		timers.back()->start(timeouts[loop], [&recorder, loop](ITimer* triggeringTimer) { recorder.record(loop); });
+	}
+	if (factory.getRunningTimersCount() != 4 || !timers[0]->isRunning() || timers[0]->duration != 250) {
+		FAILF("Expected 4 timers running");
+	}
+	if (!recorder.wait(4, std::chrono::seconds(2))) {
+		FAILF("Got %zu expirations out of 4", recorder.ids.size());
+	}
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.ids != std::vector<unsigned int>({ 1, 3, 2, 0 })) {
+		FAILF("Timers did not expire in timeout order");
+	}
+	for (unsigned int loop = 0; loop < 4; loop++) {
+		long long timeout = timeouts[recorder.ids[loop]];
+		if (recorder.elapsed[loop] < timeout || recorder.elapsed[loop] > timeout + 50) {
+			FAILF("%lldms timer expired after %lldms", timeout, recorder.elapsed[loop]);
+		}
+		if (recorder.threads[loop] == std::this_thread::get_id()) {
+			FAILF("Expected callbacks to run on the service thread");
+		}
+	}
+	if (factory.getRunningTimersCount() != 0 || timers[0]->isRunning()) {
+		FAILF("Expected no timer running anymore");
+	}
+	NOTIFYPASS();
+}
+
+TEST(timer_wheel_tests, timer_wheel_stop_restart) {
+	TimerWheelFactory factory;
+	TimerWheelRecorder recorder;
+	std::unique_ptr<ITimer> stopped = factory.create();
+	std::unique_ptr<ITimer> restarted = factory.create();
+	std::unique_ptr<ITimer> periodic = factory.create();
+	std::unique_ptr<ITimer> selfDestroyed = factory.create();
+	std::unique_ptr<ITimer> immediate = factory.create();
+
+	stopped->start(30, [&recorder](ITimer* triggeringTimer) { recorder.record(0); });
+	if (!stopped->stop() || stopped->isRunning() || stopped->stop()) {
+		FAILF("Expected stop() to succeed once");
+	}
+	/* Restarted before its expiration for 200ms: only expires 50ms after the last restart */
+	for (unsigned int loop = 0; loop < 20; loop++) {
+		restarted->start(50, [&recorder](ITimer* triggeringTimer) { recorder.record(1); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	/* Restarted from its own callback */
+	unsigned int nbRuns = 0;	/* Only accessed from the service thread */
+	std::function<void (ITimer*)> periodicCallback = [&recorder, &nbRuns, &periodicCallback](ITimer* triggeringTimer) {
+		if (++nbRuns < 5) {
+			triggeringTimer->start(5, periodicCallback);
+		}
+		else {
+			recorder.record(2);
+		}
+	};
+	periodic->start(5, periodicCallback);
+	/* Destroyed from its own callback */
+	selfDestroyed->start(5, [&recorder, &selfDestroyed](ITimer* triggeringTimer) {
+		selfDestroyed.reset();
+		recorder.record(3);
+	});
+	/* A 0 timeout runs the callback at once */
+	immediate->start(0, [&recorder](ITimer* triggeringTimer) { recorder.record(4); });
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		if (recorder.ids.empty() || recorder.ids[0] != 4 || recorder.threads[0] != std::this_thread::get_id()) {
+			FAILF("Expected a 0 timeout to run the callback at once");
+		}
+	}
+	if (!recorder.wait(4, std::chrono::seconds(1))) {
+		FAILF("Got %zu expirations out of 4", recorder.ids.size());
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.ids.size() != 4 || std::count(recorder.ids.begin(), recorder.ids.end(), 1) != 1
+	    || std::count(recorder.ids.begin(), recorder.ids.end(), 2) != 1 || std::count(recorder.ids.begin(), recorder.ids.end(), 3) != 1) {
+		FAILF("Expected the stopped timer never to expire, and the other ones to expire once");
+	}
+	if (selfDestroyed || factory.getRunningTimersCount() != 0) {
+		FAILF("Expected no timer running anymore");
+	}
+	NOTIFYPASS();
+}
+
+TEST(timer_wheel_tests, timer_wheel_executor) {
+	CppThreadsEventLoop loop;
+	unsigned int nbOutsideLoop = 0;	/* Only accessed from the loop */
+	TimerWheelRecorder recorder;
+
+	loop.start();
+	{
+		TimerWheelFactory factory(&loop);
+		std::unique_ptr<ITimer> timer = factory.create();
+		std::unique_ptr<ITimer> cancelled = factory.create();
+
+		timer->start(10, [&loop, &recorder, &nbOutsideLoop](ITimer* triggeringTimer) {
+			if (!loop.isInExecutorThread()) {
+				nbOutsideLoop++;
+			}
+			recorder.record(0);
+		});
+		if (!recorder.wait(1, std::chrono::seconds(1))) {
+			FAILF("Timer callback was not run by the executor");
+		}
+		/* Expires while the loop is busy: stopped after its callback was posted, which must then not run */
+		loop.post([]() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+		cancelled->start(10, [&recorder](ITimer* triggeringTimer) { recorder.record(1); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if (!cancelled->stop()) {
+			FAILF("Expected the timer to be running until its callback is run");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		loop.stop();	/* Before the factory is destroyed */
+	}
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.ids != std::vector<unsigned int>({ 0 }) || nbOutsideLoop != 0) {
+		FAILF("Expected the callback to run on the loop thread, and the stopped timer callback to be dropped");
+	}
+	NOTIFYPASS();
+}
+
+TEST(timer_wheel_tests, timer_wheel_many) {
+	const unsigned int nbTimers = 2000;
+	TimerWheelFactory factory;
+	TimerWheelRecorder recorder;
+	std::vector<std::unique_ptr<ITimer> > timers;
+	std::vector<uint16_t> timeouts;
+	std::mt19937 random(42);
+
+	for (unsigned int loop = 0; loop < nbTimers; loop++) {
+		timeouts.push_back(static_cast<uint16_t>(1 + random() % 500));
+	}
+	timeouts[0] = 4200;	/* Cascaded down from the third level */
+	for (unsigned int loop = 0; loop < nbTimers; loop++) {
+		timers.push_back(factory.create());
+		timers.back()->start(timeouts[loop], [&recorder, loop](ITimer* triggeringTimer) { recorder.record(loop); });
+	}
+	if (!recorder.wait(nbTimers, std::chrono::seconds(10))) {
+		FAILF("Got %zu expirations out of %u", recorder.ids.size(), nbTimers);
+	}
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	long long maxLateness = 0;
+	for (size_t loop = 0; loop < recorder.ids.size(); loop++) {
+		long long lateness = recorder.elapsed[loop] - timeouts[recorder.ids[loop]];
+		if (lateness < 0) {
+			FAILF("%ums timer expired %lldms early", timeouts[recorder.ids[loop]], -lateness);
+		}
+		maxLateness = std::max(maxLateness, lateness);
+	}
+	if (recorder.ids.back() != 0 || maxLateness > 100) {
+		FAILF("Expected all timers to expire on time, max lateness %lldms", maxLateness);
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_timer_wheel() {
+	timer_wheel_expiry();
+	timer_wheel_stop_restart();
+	timer_wheel_executor();
+	timer_wheel_many();
+}
+#endif	// USE_CPPUTEST
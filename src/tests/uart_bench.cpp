@@ -0,0 +1,404 @@
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <ctime>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "MockNcp.h"
+#include "PtyNcp.h"
+#include "../domain/ash.h"
+#include "../domain/ezsp-dongle.h"
+#include "../domain/zigbee-tools/zigbee-messaging.h"
+#include "../domain/zigbee-tools/green-power-sink.h"
+#include "../spi/termios/TermiosUartDriver.h"
+#include "../spi/cppthreads/CppThreadsTimerFactory.h"
+#include "../spi/cppthreads/CppThreadsEventLoop.h"
+#include "../spi/uart-trace/UartTrace.h"
+#include "../spi/mock-uart/ReplayUartDriver.h"
+
+/**
+ * @brief Feeds received bytes to an ASH decoder (as CEzspDongle does), counting frames, bytes and notifications
+ */
+class UartBenchDecoder : public IAsyncDataInputObserver, public CAshCallback {
+public:
+	UartBenchDecoder() : timerFactory(), ash(this, timerFactory), mutex(), cv(), nbBytes(0), nbFrames(0), nbNotifications(0) { }
+
+	void handleInputData(const unsigned char* dataIn, const size_t dataLen) {
+		this->ash.decode(dataIn, dataLen);
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->nbBytes += dataLen;
+		this->nbNotifications++;
+		this->cv.notify_all();
+	}
+
+	void ashCbInfo(EAshInfo info) { }
+
+	void ashCbData(const uint8_t *i_data, std::size_t i_len) {
+		this->nbFrames++;
+	}
+
+	CppThreadsTimerFactory timerFactory;
+	CAsh ash;
+	std::mutex mutex;
+	std::condition_variable cv;
+	size_t nbBytes;	/*!< Protected by mutex */
+	unsigned int nbFrames;	/*!< Only accessed by the read thread, then by the bench once all bytes were received */
+	unsigned int nbNotifications;	/*!< Protected by mutex */
+};
+
+/**
+ * @brief Read the given port byte per byte, with blocking reads, as SerialUartDriver does
+ */
+class ByteReader {
+public:
+	ByteReader(int i_fd, GenericAsyncDataInputObservable& i_observable) : fd(i_fd), observable(i_observable), stopping(false), thread() {
+		this->thread = std::thread([this]() {
+			unsigned char readData[1];
+			while (::read(this->fd, readData, sizeof(readData)) == 1 && !this->stopping) {
+				this->observable.notifyObservers(readData, sizeof(readData));
+			}
+		});
+	}
+
+	/**
+	 * @brief Stop reading, a byte must then be written to the port to unblock the pending read
+	 */
+	~ByteReader() {
+		this->thread.join();
+		::close(this->fd);
+	}
+
+	ByteReader(const ByteReader& other) = delete; /* No copy construction allowed */
+
+	ByteReader& operator=(const ByteReader& other) = delete; /* No assignment allowed */
+
+	int fd;
+	GenericAsyncDataInputObservable& observable;
+	std::atomic<bool> stopping;
+	std::thread thread;
+};
+
+static double cpuTimeMs(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return static_cast<double>(ts.tv_sec) * 1000.0 + static_cast<double>(ts.tv_nsec) / 1000000.0;
+}
+
+/**
+ * @brief Measure the CPU spent receiving and decoding ASH frames sent over a pseudo-terminal pair, by the termios driver
+ *        or by a byte per byte reader
+ *
+ * @param byteReader Read byte per byte (as SerialUartDriver) instead of using TermiosUartDriver
+ * @param paced Send frames at the pace of a 115200 baud line, instead of as fast as possible
+ */
+static void bench_uart_receive(bool byteReader, bool paced) {
+	const unsigned int nbFrames = paced ? 500 : 5000;
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		printf("Failed creating pseudo-terminal pair\n");
+		return;
+	}
+	std::string slaveName(ptsname(master));
+	GenericAsyncDataInputObservable observable;
+	UartBenchDecoder decoder;
+	TermiosUartDriver uartDriver;
+	std::unique_ptr<ByteReader> reader;
+
+	observable.registerObserver(&decoder);
+	if (byteReader) {
+		int fd = ::open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+		struct termios tio;
+		tcgetattr(fd, &tio);
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+		reader.reset(new ByteReader(fd, observable));
+	}
+	else {
+		uartDriver.setIncomingDataHandler(&observable);
+		uartDriver.open(slaveName, 115200);
+	}
+
+	/* Callback-sized EZSP frames (sequence, frame control, command id, 16 parameters) */
+	std::vector<uint8_t> frames[8];
+	for (uint8_t frmNum = 0; frmNum < 8; frmNum++) {
+		frames[frmNum] = MockNcp::encodeDataFrame(static_cast<uint8_t>(frmNum << 4), std::vector<uint8_t>(19, frmNum));
+	}
+	size_t nbBytes = 0;
+	double cpuStart = cpuTimeMs(CLOCK_PROCESS_CPUTIME_ID);
+	double writerCpuStart = cpuTimeMs(CLOCK_THREAD_CPUTIME_ID);
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int loop = 0; loop < nbFrames; loop++) {
+		const std::vector<uint8_t>& frame = frames[loop % 8];
+		if (::write(master, frame.data(), frame.size()) != static_cast<ssize_t>(frame.size())) {
+			break;
+		}
+		nbBytes += frame.size();
+		if (paced) {
+			/* 10 bits per byte at 115200 baud */
+			std::this_thread::sleep_until(start + std::chrono::microseconds(nbBytes * 10 * 1000000 / 115200));
+		}
+	}
+	{
+		std::unique_lock<std::mutex> lock(decoder.mutex);
+		decoder.cv.wait_for(lock, std::chrono::seconds(10), [&decoder, nbBytes]() { return decoder.nbBytes >= nbBytes; });
+	}
+	/* The bench (writer) thread CPU is left out, only the read thread and the decoding are counted */
+	double readerCpu = (cpuTimeMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart) - (cpuTimeMs(CLOCK_THREAD_CPUTIME_ID) - writerCpuStart);
+
+	std::lock_guard<std::mutex> lock(decoder.mutex);
+	std::string name = std::string(byteReader ? "byte per byte read" : "termios driver") + (paced ? ", 115200 baud" : ", burst");
+	printf("%-48s %10.2f us CPU/frame (%u/%u frames, %.1f bytes/notification)\n", name.c_str(), 1000.0 * readerCpu / nbFrames,
+	       decoder.nbFrames, nbFrames, static_cast<double>(decoder.nbBytes) / decoder.nbNotifications);
+	if (byteReader) {
+		/* Unblock the pending read */
+		reader->stopping = true;
+		if (::write(master, "\x7E", 1) == 1) {
+			reader.reset();
+		}
+	}
+	uartDriver.close();
+	::close(master);
+}
+
+/**
+ * @brief Dongle observer waiting for the dongle to get ready and counting callbacks
+ */
+class UartBenchObserver : public CEzspDongleObserver {
+public:
+	UartBenchObserver() : mutex(), cv(), ready(false), nbCallbacks(0) { }
+
+	void handleDongleState(EDongleState i_state) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->ready = (i_state == DONGLE_READY);
+		this->cv.notify_all();
+	}
+
+	void handleEzspRxFrame(EEzspCmd i_cmd, const CEzspFrameBuffer& i_msg_receive) {
+		this->nbCallbacks++;
+	}
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool ready;	/*!< Protected by mutex */
+	std::atomic<unsigned int> nbCallbacks;
+};
+
+/**
+ * @brief Measure the command throughput and latency of a dongle run on an event loop, with the termios driver, against
+ *        an emulated NCP on a pseudo-terminal pair
+ *
+ * Commands are sent in a closed loop, each response triggering the next command, so that the TX window stays full and
+ * latencies do not include queueing.
+ *
+ * @param window The dongle TX window
+ * @param callbackRate GP callbacks sent per second by the emulated NCP meanwhile, 0 for none
+ */
+static void bench_uart_dongle_load(uint8_t window, unsigned int callbackRate) {
+	const unsigned int nbCommands = 5000;
+	PtyNcp ncp(std::chrono::microseconds(100));
+	CppThreadsEventLoop loop;
+	UartBenchObserver observer;
+	CEzspDongle dongle(loop, &observer);
+	TermiosUartDriver uartDriver;
+	/* Only accessed from the loop, then by the bench once all responses were received */
+	std::vector<std::chrono::steady_clock::time_point> sentTimes(nbCommands);
+	std::vector<double> latencies;
+	unsigned int nbSent = 0;
+	std::function<void ()> sendNext;
+
+	latencies.reserve(nbCommands);
+	dongle.setExecutor(&loop);
+	dongle.setTxWindow(window);
+	loop.start();
+	if (ncp.getPortName().empty() || uartDriver.open(ncp.getPortName(), 115200) != 0) {
+		printf("Failed opening emulated NCP\n");
+		loop.stop();
+		return;
+	}
+	loop.post([&dongle, &uartDriver]() { dongle.open(&uartDriver); });
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(2), [&observer]() { return observer.ready; });
+	}
+
+	sendNext = [&]() {
+		unsigned int cmd = nbSent++;
+		sentTimes[cmd] = std::chrono::steady_clock::now();
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(16, static_cast<uint8_t>(cmd)),
+		                   [&, cmd](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+			std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - sentTimes[cmd];
+			latencies.push_back(latency.count());
+			if (nbSent < nbCommands) {
+				sendNext();
+			}
+			if (latencies.size() == nbCommands) {
+				std::lock_guard<std::mutex> lock(observer.mutex);
+				observer.cv.notify_all();
+			}
+		});
+	};
+	if (callbackRate > 0) {
+		ncp.startCallbacks(EZSP_GPEP_INCOMING_MESSAGE_HANDLER, std::vector<uint8_t>(30, 0x00), callbackRate, 4);
+	}
+	auto start = std::chrono::steady_clock::now();
+	loop.post([&sendNext, window]() {
+		for (uint8_t cmd = 0; cmd < window; cmd++) {
+			sendNext();
+		}
+	});
+	{
+		std::unique_lock<std::mutex> lock(observer.mutex);
+		observer.cv.wait_for(lock, std::chrono::seconds(30), [&latencies, nbCommands]() { return latencies.size() >= nbCommands; });
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	unsigned int nbCallbacks = ncp.stopCallbacks();
+	uartDriver.close();
+	loop.stop();
+
+	std::string name = "emulated NCP, window " + std::to_string(window) + (callbackRate > 0 ? ", " + std::to_string(callbackRate) + " callbacks/s" : "");
+	if (latencies.size() < nbCommands) {
+		printf("%-48s %zu/%u responses\n", name.c_str(), latencies.size(), nbCommands);
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	printf("%-48s %10.1f cmd/s (latency p50 %.0f us, p99 %.0f us, max %.0f us, %u/%u callbacks)\n", name.c_str(),
+	       1000.0 * nbCommands / elapsed.count(), latencies[nbCommands / 2], latencies[nbCommands * 99 / 100], latencies.back(),
+	       observer.nbCallbacks.load(), nbCallbacks);
+}
+
+/**
+ * @brief GP observer counting the frames and the GPD ids notified by the sink
+ */
+class UartBenchGpObserver : public CGpObserver {
+public:
+	UartBenchGpObserver() : nbGpFrames(0), nbGpdIds(0) { }
+
+	void handleRxGpFrame(const CGpFrame &i_gpf) {
+		this->nbGpFrames++;
+	}
+
+	void handleRxGpdId(uint32_t &i_gpd_id) {
+		this->nbGpdIds++;
+	}
+
+	unsigned int nbGpFrames;	/*!< Only accessed by the replay thread, then by the bench once the replay is over */
+	unsigned int nbGpdIds;	/*!< Only accessed by the replay thread, then by the bench once the replay is over */
+};
+
+/**
+ * @brief Write a trace of an NCP reset followed by GP frames received in bursts of 1 to 8, as a gateway surrounded by
+ *        GPDs would capture it with RecordingUartDriver
+ *
+ * Every third GPD sends secured frames (notified as GP frames by the sink), the others send unsecured ones (only
+ * notified by GPD id out of commissioning).
+ *
+ * @return The number of GP frames written, 0 on failure
+ */
+static unsigned int writeGpTrace(const std::string& tracePath, unsigned int nbFrames) {
+	UartTraceWriter trace;
+	if (trace.open(tracePath) != 0) {
+		return 0;
+	}
+	const uint8_t rstAck[] = { 0x1a, 0xc1, 0x02, 0x0b, 0x0a, 0x52, 0x7e };
+	trace.append(UART_TRACE_RX, rstAck, sizeof(rstAck));
+
+	unsigned int nbWritten = 0;
+	uint8_t frmNum = 0;
+	uint8_t seq = 0;
+	std::vector<uint8_t> burst;
+	while (nbWritten < nbFrames) {
+		unsigned int burstSize = std::min(1 + (nbWritten * 7 + 3) % 8, nbFrames - nbWritten);
+		burst.clear();
+		for (unsigned int loop = 0; loop < burstSize; loop++, nbWritten++) {
+			uint32_t sourceId = 0x01500000 + nbWritten % 64;
+			bool secured = (sourceId % 3 == 0);
+			/* Asynchronous callback header (see MockNcp::sendCallbacks()), then the EZSP_GPEP_INCOMING_MESSAGE_HANDLER parameters */
+			std::vector<uint8_t> ezspFrame({ seq++, 0x90, 0xFF, 0x00, EZSP_GPEP_INCOMING_MESSAGE_HANDLER,
+			                                 EMBER_SUCCESS, 0xC8, seq,
+			                                 0x00, static_cast<uint8_t>(sourceId), static_cast<uint8_t>(sourceId >> 8),
+			                                 static_cast<uint8_t>(sourceId >> 16), static_cast<uint8_t>(sourceId >> 24),
+			                                 0x00, 0x00, 0x00, 0x00, 0x00,
+			                                 static_cast<uint8_t>(secured ? 0x02 : 0x00), static_cast<uint8_t>(secured ? 0x04 : 0x00), 0x00, 0x00,
+			                                 static_cast<uint8_t>(nbWritten), static_cast<uint8_t>(nbWritten >> 8), 0x00, 0x00,
+			                                 0x22, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00 });
+			std::vector<uint8_t> frame = MockNcp::encodeDataFrame(static_cast<uint8_t>(frmNum << 4), ezspFrame);
+			frmNum = (frmNum + 1) & 0x07;
+			burst.insert(burst.end(), frame.begin(), frame.end());
+		}
+		trace.append(UART_TRACE_RX, burst.data(), burst.size());
+	}
+	trace.close();
+	return nbWritten;
+}
+
+/**
+ * @brief Measure the GP frame throughput of the ASH, dongle and GP sink pipeline, fed as fast as possible with a replayed
+ *        trace of mixed GP bursts
+ */
+static void bench_uart_replay_gp() {
+	const unsigned int nbFrames = 20000;
+	char tracePath[] = "/tmp/libezsp_gp_trace_XXXXXX";
+	int fd = mkstemp(tracePath);
+	if (fd < 0) {
+		printf("Failed creating trace file\n");
+		return;
+	}
+	::close(fd);
+	if (writeGpTrace(tracePath, nbFrames) != nbFrames) {
+		printf("Failed writing trace file\n");
+		unlink(tracePath);
+		return;
+	}
+
+	CppThreadsTimerFactory timerFactory;
+	ReplayUartDriver uartDriver([](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		writtenCnt = cnt;	/* Our RST and ACKs go nowhere */
+		return 0;
+	});
+	UartBenchObserver observer;
+	CEzspDongle dongle(timerFactory, &observer);
+	CZigbeeMessaging zbMessaging(dongle, timerFactory);
+	CGpSink gpSink(dongle, zbMessaging);
+	UartBenchGpObserver gpObserver;
+
+	gpSink.registerObserver(&gpObserver);
+	dongle.open(&uartDriver);
+	auto start = std::chrono::steady_clock::now();
+	double cpuStart = cpuTimeMs(CLOCK_PROCESS_CPUTIME_ID);
+	uartDriver.replay(tracePath, 0);
+	bool replayed = uartDriver.waitReplayed(std::chrono::seconds(30));
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	double cpu = cpuTimeMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+	uartDriver.stopReplay();
+	unlink(tracePath);
+
+	if (!replayed) {
+		printf("%-48s replay did not complete\n", "replayed GP bursts");
+		return;
+	}
+	printf("%-48s %10.1f frames/s (%.2f us CPU/frame, %u GPD ids and %u GP frames notified out of %u)\n", "replayed GP bursts",
+	       1000.0 * nbFrames / elapsed.count(), 1000.0 * cpu / nbFrames, gpObserver.nbGpdIds, gpObserver.nbGpFrames, nbFrames);
+}
+
+void bench_uart() {
+	for (bool paced : { false, true }) {
+		bench_uart_receive(true, paced);
+		bench_uart_receive(false, paced);
+	}
+	for (uint8_t window : { 1, 7 }) {
+		bench_uart_dongle_load(window, 0);
+		bench_uart_dongle_load(window, 2000);
+	}
+	bench_uart_replay_gp();
+}
@@ -0,0 +1,255 @@
+#include "TestHarness.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../spi/uart-trace/UartTrace.h"
+#include "../spi/uart-trace/RecordingUartDriver.h"
+#include "../spi/mock-uart/ReplayUartDriver.h"
+
+/**
+ * @brief Temporary trace file, removed at destruction
+ */
+class TempTraceFile {
+public:
+	TempTraceFile() : path("/tmp/libezsp_uart_trace_XXXXXX") {
+		int fd = mkstemp(&this->path[0]);
+		if (fd >= 0) {
+			close(fd);
+		}
+		else {
+			this->path.clear();
+		}
+	}
+
+	~TempTraceFile() {
+		if (!this->path.empty()) {
+			unlink(this->path.c_str());
+		}
+	}
+
+	TempTraceFile(const TempTraceFile& other) = delete; /* No copy construction allowed */
+
+	TempTraceFile& operator=(const TempTraceFile& other) = delete; /* No assignment allowed */
+
+	std::string path;	/*!< Path of the file, empty on failure */
+};
+
+/**
+ * @brief Observer recording the bytes received, and in how many notifications
+ */
+class TraceInputRecorder : public IAsyncDataInputObserver {
+public:
+	TraceInputRecorder() : mutex(), cv(), bytes(), nbNotifications(0) { }
+
+	void handleInputData(const unsigned char* dataIn, const size_t dataLen) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->bytes.insert(this->bytes.end(), dataIn, dataIn + dataLen);
+		this->nbNotifications++;
+		this->cv.notify_all();
+	}
+
+	bool waitBytes(size_t count, const std::chrono::milliseconds& timeout) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		return this->cv.wait_for(lock, timeout, [this, count]() { return this->bytes.size() >= count; });
+	}
+
+	std::mutex mutex;	/*!< Protects all attributes below */
+	std::condition_variable cv;	/*!< Signalled on each notification */
+	std::vector<uint8_t> bytes;	/*!< All bytes received */
+	unsigned int nbNotifications;	/*!< Number of notifications */
+};
+
+TEST_GROUP(uart_trace_tests) {
+};
+
+TEST(uart_trace_tests, uart_trace_record) {
+	TempTraceFile file;
+	UartTraceWriter trace;
+	std::vector<uint8_t> written;
+	MockUartDriver target([&written](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		written.insert(written.end(), static_cast<const uint8_t*>(buf), static_cast<const uint8_t*>(buf) + cnt);
+		writtenCnt = cnt;
+		return 0;
+	});
+	GenericAsyncDataInputObservable observable;
+	TraceInputRecorder recorder;
+
+	if (file.path.empty() || trace.open(file.path) != 0) {
+		FAILF("Failed creating trace file");
+	}
+	{
+		RecordingUartDriver recordingDriver(target, trace);
+		observable.registerObserver(&recorder);
+		recordingDriver.setIncomingDataHandler(&observable);
+
+		target.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x1a, 0xc1 }));
+		target.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x02, 0x0b, 0x0a }, std::chrono::milliseconds(10)));
+		if (!recorder.waitBytes(5, std::chrono::seconds(1))) {
+			FAILF("Received bytes were not forwarded to the incoming data handler");
+		}
+		size_t writtenCnt = 0;
+		const uint8_t rst[] = { 0x1a, 0xc0, 0x38, 0xbc, 0x7e };
+		const uint8_t ack[] = { 0x81, 0x60, 0x59, 0x7e };
+		const uint8_t data[] = { 0x00, 0x00, 0x00, 0x02, 0x7e };
+		UartIoVec iov[2] = { { ack, sizeof(ack) }, { data, sizeof(data) } };
+		if (recordingDriver.write(writtenCnt, rst, sizeof(rst)) != 0 || writtenCnt != sizeof(rst)) {
+			FAILF("write() was not forwarded to the decorated driver");
+		}
+		if (recordingDriver.writev(writtenCnt, iov, 2) != 0 || writtenCnt != sizeof(ack) + sizeof(data)) {
+			FAILF("writev() was not forwarded to the decorated driver");
+		}
+		if (target.getWriteCallsCount() != 2 || target.getWrittenBuffersCount() != 3) {
+			FAILF("Expected the vectored write to be forwarded as such");
+		}
+		target.destroyAllScheduledIncomingChunks();	/* Joins the read thread, that may still be returning from our handler */
+	}
+	if (trace.getRecordCount() != 4) {
+		FAILF("Expected 4 chunks recorded, got %llu", static_cast<unsigned long long>(trace.getRecordCount()));
+	}
+	trace.close();
+
+	UartTraceReader reader;
+	UartTraceRecord record;
+	std::vector<UartTraceRecord> records;
+	if (reader.open(file.path) != 0) {
+		FAILF("Failed opening trace file");
+	}
+	while (reader.next(record)) {
+		records.push_back(record);
+	}
+	if (records.size() != 4) {
+		FAILF("Expected 4 chunks read, got %zu", records.size());
+	}
+	const std::vector<uint8_t> expected[4] = {
+		{ 0x1a, 0xc1 },
+		{ 0x02, 0x0b, 0x0a },
+		{ 0x1a, 0xc0, 0x38, 0xbc, 0x7e },
+		{ 0x81, 0x60, 0x59, 0x7e, 0x00, 0x00, 0x00, 0x02, 0x7e }
+	};
+	for (size_t loop = 0; loop < 4; loop++) {
+		if (records[loop].direction != ((loop < 2) ? UART_TRACE_RX : UART_TRACE_TX)) {
+			FAILF("Unexpected direction for chunk %zu", loop);
+		}
+		if (std::vector<uint8_t>(records[loop].data, records[loop].data + records[loop].len) != expected[loop]) {
+			FAILF("Unexpected content for chunk %zu", loop);
+		}
+		if (loop > 0 && records[loop].timestampNs < records[loop - 1].timestampNs) {
+			FAILF("Timestamps went backwards at chunk %zu", loop);
+		}
+	}
+	if (records[1].timestampNs - records[0].timestampNs < 9000000) {
+		FAILF("Expected the second chunk to be recorded at least 10ms after the first one");
+	}
+	if (written != std::vector<uint8_t>({ 0x1a, 0xc0, 0x38, 0xbc, 0x7e, 0x81, 0x60, 0x59, 0x7e, 0x00, 0x00, 0x00, 0x02, 0x7e })) {
+		FAILF("Unexpected bytes written to the decorated driver");
+	}
+	NOTIFYPASS();
+}
+
+TEST(uart_trace_tests, uart_trace_replay) {
+	TempTraceFile file;
+	UartTraceWriter trace;
+
+	if (file.path.empty() || trace.open(file.path) != 0) {
+		FAILF("Failed creating trace file");
+	}
+	/* Received chunks spread over 100ms, with a written chunk in between that must not be replayed */
+	trace.append(UART_TRACE_RX, "abc", 3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	trace.append(UART_TRACE_TX, "xyz", 3);
+	trace.append(UART_TRACE_RX, "de", 2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	trace.append(UART_TRACE_RX, "f", 1);
+	trace.close();
+
+	for (double speed : { 0.0, 1.0, 4.0 }) {
+		ReplayUartDriver replayDriver;
+		GenericAsyncDataInputObservable observable;
+		TraceInputRecorder recorder;
+
+		observable.registerObserver(&recorder);
+		replayDriver.setIncomingDataHandler(&observable);
+		auto start = std::chrono::steady_clock::now();
+		if (replayDriver.replay(file.path, speed) != 0) {
+			FAILF("Failed opening trace file");
+		}
+		if (!replayDriver.waitReplayed(std::chrono::seconds(2))) {
+			FAILF("Replay at speed %.1f did not complete", speed);
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		if (recorder.bytes != std::vector<uint8_t>({ 'a', 'b', 'c', 'd', 'e', 'f' }) || recorder.nbNotifications != 3) {
+			FAILF("Expected the received chunks to be replayed as recorded at speed %.1f", speed);
+		}
+		if (replayDriver.getReplayedChunksCount() != 3 || replayDriver.getReplayedBytesCount() != 6) {
+			FAILF("Unexpected replay counters at speed %.1f", speed);
+		}
+		if (speed == 0.0 && elapsed.count() >= 50) {
+			FAILF("Replay as fast as possible took %.1fms", elapsed.count());
+		}
+		if (speed == 1.0 && elapsed.count() < 95) {
+			FAILF("Replay at the original pace took %.1fms instead of 100ms", elapsed.count());
+		}
+		if (speed == 4.0 && (elapsed.count() < 24 || elapsed.count() >= 95)) {
+			FAILF("Replay 4 times faster took %.1fms instead of 25ms", elapsed.count());
+		}
+	}
+	NOTIFYPASS();
+}
+
+TEST(uart_trace_tests, uart_trace_growth) {
+	TempTraceFile file;
+	UartTraceWriter trace;
+	UartTraceReader reader;
+	UartTraceRecord record;
+	std::vector<uint8_t> chunk(1000);
+	const unsigned int nbChunks = 3000;	/* Almost 3MiB, the file is grown twice */
+
+	if (file.path.empty() || trace.open(file.path) != 0) {
+		FAILF("Failed creating trace file");
+	}
+	for (unsigned int loop = 0; loop < nbChunks; loop++) {
+		chunk[0] = static_cast<uint8_t>(loop);
+		chunk[999] = static_cast<uint8_t>(loop >> 8);
+		trace.append(UART_TRACE_RX, chunk.data(), chunk.size());
+	}
+	/* Read before closing, as after a crash of the recording process: the end of the file is zeroed */
+	for (int pass = 0; pass < 2; pass++) {
+		unsigned int nbRead = 0;
+		if (reader.open(file.path) != 0) {
+			FAILF("Failed opening trace file");
+		}
+		while (reader.next(record)) {
+			if (record.len != chunk.size() || record.data[0] != static_cast<uint8_t>(nbRead) || record.data[999] != static_cast<uint8_t>(nbRead >> 8)) {
+				FAILF("Unexpected content for chunk %u", nbRead);
+			}
+			nbRead++;
+		}
+		if (nbRead != nbChunks) {
+			FAILF("Expected %u chunks read, got %u", nbChunks, nbRead);
+		}
+		reader.close();
+		trace.close();
+	}
+	struct stat st;
+	if (stat(file.path.c_str(), &st) != 0 || static_cast<size_t>(st.st_size) != UART_TRACE_HEADER_SIZE + nbChunks * (UART_TRACE_RECORD_HEADER_SIZE + chunk.size())) {
+		FAILF("Expected the trace file to be trimmed to its content on close");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_uart_trace() {
+	uart_trace_record();
+	uart_trace_replay();
+	uart_trace_growth();
+}
+#endif	// USE_CPPUTEST
@@ -0,0 +1,359 @@
+#include "TestHarness.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <stdint.h>
+
+#include "MockNcp.h"
+#include "../domain/ash-crc.h"
+#include "../domain/ash.h"
+#include "../domain/ezsp-dongle.h"
+#include "../spi/virtual-clock/VirtualClock.h"
+
+/**
+ * @brief ASH callback counting the info events reported
+ */
+class VirtualAshRecorder : public CAshCallback {
+public:
+	VirtualAshRecorder() : infos() { }
+
+	void ashCbInfo(EAshInfo info) {
+		this->infos.push_back(info);
+	}
+
+	void ashCbData(const uint8_t *i_data, std::size_t i_len) { }
+
+	std::vector<EAshInfo> infos;	/*!< Info events received, in order */
+};
+
+/**
+ * @brief Dongle observer recording its state, everything runs on the thread advancing the clock
+ */
+class VirtualDongleObserver : public CEzspDongleObserver {
+public:
+	VirtualDongleObserver() : ready(false) { }
+
+	void handleDongleState(EDongleState i_state) {
+		this->ready = (i_state == DONGLE_READY);
+	}
+
+	bool ready;	/*!< Dongle reported DONGLE_READY */
+};
+
+/**
+ * @brief Outcome of a dongle scenario run on a VirtualClock, compared between runs
+ */
+struct VirtualScenarioResult {
+	VirtualScenarioResult() : statuses(), completionTimes(), nbAckTimeouts(0), nbRetransmittedFrames(0) { }
+
+	std::vector<EEzspCmdStatus> statuses;	/*!< Completion status of each command, in completion order */
+	std::vector<int64_t> completionTimes;	/*!< Simulated completion time of each command (in us) */
+	uint32_t nbAckTimeouts;	/*!< Acknowledgement timeouts seen by the host */
+	uint32_t nbRetransmittedFrames;	/*!< Retransmitted frames received by the emulated NCP */
+};
+
+/**
+ * @brief Build an encoded ASH ACK frame
+ */
+static std::vector<uint8_t> virtualAshAckFrame(uint8_t ackNum) {
+	const uint8_t control = static_cast<uint8_t>(0x80 | (ackNum & 0x07));
+	uint16_t crc = CAshCrc::compute(&control, 1);
+	std::vector<uint8_t> frame;
+
+	for (uint8_t byte : { control, static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc & 0xFF) }) {
+		if (byte == 0x7E || byte == 0x7D || byte == 0x11 || byte == 0x13 || byte == 0x18 || byte == 0x1A) {
+			frame.push_back(0x7D);
+			byte = static_cast<uint8_t>(byte ^ 0x20);
+		}
+		frame.push_back(byte);
+	}
+	frame.push_back(0x7E);
+	return frame;
+}
+
+static int64_t virtualMicroseconds(const VirtualClock& clock) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(clock.now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Run a random command sequence against an emulated NCP, entirely on simulated time
+ *
+ * @param seed The seed of the scenario: NCP latency, TX window, commands pacing, rejected and lost frames
+ */
+static VirtualScenarioResult runVirtualScenario(uint32_t seed) {
+	std::mt19937 random(seed);
+	VirtualClock clock;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	}, &clock);
+	VirtualDongleObserver observer;
+	CEzspDongle dongle(clock, &observer);
+	MockNcp ncp(uartDriver, std::chrono::microseconds(random() % 50000));
+	ncpPtr = &ncp;
+	VirtualScenarioResult result;
+	FEzspResponseCallback onResponse = [&result, &clock](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		result.statuses.push_back(i_status);
+		result.completionTimes.push_back(virtualMicroseconds(clock));
+	};
+	unsigned int nbCommands = 1 + random() % 20;
+
+	dongle.setTxWindow(static_cast<uint8_t>(1 + random() % 7));
+	if (!dongle.open(&uartDriver)) {
+		FAILF("Failed opening dongle (seed %u)", seed);
+	}
+	clock.runUntilIdle(std::chrono::seconds(1));
+	if (!observer.ready) {
+		FAILF("Dongle did not get ready (seed %u)", seed);
+	}
+	ncp.nakNextDataFrames(random() % 3);
+	ncp.dropNextDataFrames(random() % 3);
+	for (unsigned int loop = 0; loop < nbCommands; loop++) {
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse);
+		clock.advance(std::chrono::microseconds(random() % 30000));
+	}
+	if (!clock.runUntilIdle(std::chrono::seconds(60)) || result.statuses.size() != nbCommands) {
+		FAILF("Got %zu completions out of %u (seed %u)", result.statuses.size(), nbCommands, seed);
+	}
+	result.nbAckTimeouts = dongle.getLinkStats().get(LINK_ACK_TIMEOUTS);
+	result.nbRetransmittedFrames = ncp.nbRetransmittedFrames;
+	return result;
+}
+
+TEST_GROUP(virtual_clock_tests) {
+};
+
+TEST(virtual_clock_tests, virtual_clock_timers) {
+	VirtualClock clock;
+	std::vector<std::string> fired;
+	std::unique_ptr<ITimer> slow = clock.create();
+	std::unique_ptr<ITimer> fast = clock.create();
+	std::unique_ptr<ITimer> tie = clock.create();
+	std::unique_ptr<ITimer> stopped = clock.create();
+
+	slow->start(300, [&fired](ITimer* triggeringTimer) { fired.push_back("slow"); });
+	fast->start(100, [&fired](ITimer* triggeringTimer) { fired.push_back("fast"); });
+	tie->start(300, [&fired](ITimer* triggeringTimer) { fired.push_back("tie"); });
+	stopped->start(200, [&fired](ITimer* triggeringTimer) { fired.push_back("stopped"); });
+	if (!stopped->stop() || stopped->isRunning() || clock.getPendingEventsCount() != 3) {
+		FAILF("Expected the stopped timer to be removed from the clock");
+	}
+	if (clock.advance(std::chrono::milliseconds(99)) != 0 || !fired.empty()) {
+		FAILF("No timer should expire before 100ms");
+	}
+	if (clock.advance(std::chrono::milliseconds(1)) != 1 || fired != std::vector<std::string>({ "fast" }) || fast->isRunning()) {
+		FAILF("Expected the 100ms timer to expire exactly after 100ms");
+	}
+	/* Restarting a running timer postpones it */
+	slow->start(300, [&fired](ITimer* triggeringTimer) { fired.push_back("slow"); });
+	clock.advance(std::chrono::milliseconds(200));
+	if (fired != std::vector<std::string>({ "fast", "tie" })) {
+		FAILF("Expected the restarted timer to expire after the one started with the same duration before it");
+	}
+	if (!clock.runNext() || fired.back() != "slow" || clock.now().time_since_epoch() != std::chrono::milliseconds(400)) {
+		FAILF("Expected runNext() to jump to the restarted timer expiration");
+	}
+	if (clock.runNext()) {
+		FAILF("No event should be left");
+	}
+	/* A 0 timeout runs at once, a timer restarted from its own callback runs again */
+	unsigned int nbRuns = 0;
+	fast->start(0, [&nbRuns](ITimer* triggeringTimer) { nbRuns++; });
+	std::function<void (ITimer*)> periodic = [&nbRuns, &periodic](ITimer* triggeringTimer) {
+		if (++nbRuns < 11) {
+			triggeringTimer->start(1000, periodic);
+		}
+	};
+	slow->start(1000, periodic);
+	if (nbRuns != 1) {
+		FAILF("Expected a 0 timeout to run the callback at once");
+	}
+	if (!clock.runUntilIdle(std::chrono::hours(1)) || nbRuns != 11 || clock.now().time_since_epoch() != std::chrono::milliseconds(10400)) {
+		FAILF("Expected 10 periodic runs within 10s of simulated time, got %u", nbRuns - 1);
+	}
+	NOTIFYPASS();
+}
+
+TEST(virtual_clock_tests, virtual_clock_uart_chunks) {
+	VirtualClock clock;
+	std::vector<double> writeDeltas;
+	MockUartDriver uartDriver([&writeDeltas](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		writeDeltas.push_back(delta.count());
+		writtenCnt = cnt;
+		return 0;
+	}, &clock);
+	std::vector<std::vector<unsigned char> > received;
+	std::vector<int64_t> receivedTimes;
+	GenericAsyncDataInputObservable observable;
+
+	class ChunkObserver : public IAsyncDataInputObserver {
+	public:
+		ChunkObserver(VirtualClock& clock, std::vector<std::vector<unsigned char> >& received, std::vector<int64_t>& receivedTimes) :
+			clock(clock), received(received), receivedTimes(receivedTimes) { }
+		void handleInputData(const unsigned char* dataIn, const size_t dataLen) {
+			this->received.push_back(std::vector<unsigned char>(dataIn, dataIn + dataLen));
+			this->receivedTimes.push_back(virtualMicroseconds(this->clock));
+		}
+		VirtualClock& clock;
+		std::vector<std::vector<unsigned char> >& received;
+		std::vector<int64_t>& receivedTimes;
+	} observer(clock, received, receivedTimes);
+
+	observable.registerObserver(&observer);
+	uartDriver.setIncomingDataHandler(&observable);
+	/* Delays are chained: each one is relative to the previous chunk */
+	uartDriver.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x01 }, std::chrono::milliseconds(10)));
+	uartDriver.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x02, 0x03 }, std::chrono::milliseconds(20)));
+	uartDriver.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x04 }));
+	if (uartDriver.getScheduledIncomingChunksCount() != 3 || !received.empty()) {
+		FAILF("Chunks must not be delivered before the clock is advanced");
+	}
+	clock.advance(std::chrono::milliseconds(30));
+	if (received != std::vector<std::vector<unsigned char> >({ { 0x01 }, { 0x02, 0x03 }, { 0x04 } })
+	    || receivedTimes != std::vector<int64_t>({ 10000, 30000, 30000 })
+	    || uartDriver.getDeliveredIncomingBytesCount() != 4) {
+		FAILF("Expected the chunks to be delivered at 10ms, 30ms and 30ms of simulated time");
+	}
+	/* Removed chunks are never delivered */
+	uartDriver.scheduleIncomingChunk(MockUartScheduledByteDelivery({ 0x05 }, std::chrono::milliseconds(10)));
+	uartDriver.destroyAllScheduledIncomingChunks();
+	if (clock.getPendingEventsCount() != 0 || clock.advance(std::chrono::seconds(1)) != 0 || received.size() != 3) {
+		FAILF("Expected removed chunks to be cancelled on the clock");
+	}
+	/* Write deltas are measured on simulated time */
+	size_t writtenCnt;
+	uartDriver.write(writtenCnt, "a", 1);
+	clock.advance(std::chrono::milliseconds(250));
+	uartDriver.write(writtenCnt, "b", 1);
+	if (writeDeltas.size() != 2 || writeDeltas[1] != 250.0) {
+		FAILF("Expected a 250ms write delta");
+	}
+	NOTIFYPASS();
+}
+
+TEST(virtual_clock_tests, virtual_clock_ash_timeout) {
+	VirtualClock clock;
+	VirtualAshRecorder cb;
+	CAsh ash(&cb, clock);
+
+	const uint8_t rstAck[] = { 0x1A, 0xC1, 0x02, 0x02, 0x9B, 0x7B, 0x7E };
+	ash.decode(rstAck, sizeof(rstAck));
+	if (!ash.isConnected() || ash.getRxAckTimeout() != 1600) {
+		FAILF("Expected RSTACK to connect the ASH link with the initial acknowledgement timeout");
+	}
+
+	/* An exact 50ms round trip time: t_rx_ack = 7/8 * 1600 + 1/2 * 50 */
+	ash.DataFrame(std::vector<uint8_t>({ 0x00, 0x00, 0x05 }));
+	clock.advance(std::chrono::milliseconds(50));
+	std::vector<uint8_t> ack = virtualAshAckFrame(1);
+	ash.decode(ack.data(), ack.size());
+	if (ash.getLastRtt() != 50 || ash.getRxAckTimeout() != 1425) {
+		FAILF("Expected a 50ms round trip time and a 1425ms timeout, got %u ms and %u ms", ash.getLastRtt(), ash.getRxAckTimeout());
+	}
+
+	/* An unacknowledged frame times out exactly after the adapted timeout */
+	ash.DataFrame(std::vector<uint8_t>({ 0x01, 0x00, 0x05 }));
+	cb.infos.clear();
+	clock.advance(std::chrono::milliseconds(1424));
+	if (!cb.infos.empty()) {
+		FAILF("Acknowledgement timeout reported too early");
+	}
+	clock.advance(std::chrono::milliseconds(1));
+	if (cb.infos != std::vector<EAshInfo>({ ASH_ACK_TIMEOUT }) || ash.getStats().get(LINK_ACK_TIMEOUTS) != 1) {
+		FAILF("Expected an acknowledgement timeout after exactly 1425ms");
+	}
+	if (ash.getRxAckTimeout() != 2850) {
+		FAILF("Expected the acknowledgement timeout to back off, got %u ms", ash.getRxAckTimeout());
+	}
+	NOTIFYPASS();
+}
+
+TEST(virtual_clock_tests, virtual_clock_dongle_soak) {
+	VirtualClock clock;
+	MockNcp* ncpPtr = nullptr;
+	MockUartDriver uartDriver([&ncpPtr](size_t& writtenCnt, const void* buf, size_t cnt, std::chrono::duration<double, std::milli> delta) -> int {
+		return ncpPtr->onWriteCallback(writtenCnt, buf, cnt, delta);
+	}, &clock);
+	VirtualDongleObserver observer;
+	CEzspDongle dongle(clock, &observer);
+	MockNcp ncp(uartDriver, std::chrono::milliseconds(5));
+	ncpPtr = &ncp;
+	unsigned int nbSent = 0;
+	unsigned int nbSuccess = 0;
+	FEzspResponseCallback onResponse = [&nbSuccess](EEzspCmdStatus i_status, EEzspCmd i_cmd, const CEzspFrameBuffer& i_response) {
+		if (i_status == EZSP_CMD_SUCCESS) {
+			nbSuccess++;
+		}
+	};
+	auto start = std::chrono::steady_clock::now();
+
+	if (!dongle.open(&uartDriver)) {
+		FAILF("Failed opening dongle");
+	}
+	clock.runUntilIdle(std::chrono::seconds(1));
+	if (!observer.ready) {
+		FAILF("Dongle did not get ready");
+	}
+	/* One minute of simulated time: a command every 10ms, a frame lost on the line every 5s */
+	VirtualClock::TTimePoint end = clock.now() + std::chrono::minutes(1);
+	while (clock.now() < end) {
+		if (nbSent % 500 == 250) {
+			ncp.dropNextDataFrames(1);
+		}
+		dongle.sendCommand(EZSP_NOP, std::vector<uint8_t>(), onResponse);
+		nbSent++;
+		clock.advance(std::chrono::milliseconds(10));
+	}
+	if (!ncp.waitIdle(std::chrono::seconds(10))) {
+		FAILF("Emulated NCP still has pending responses");
+	}
+	clock.runUntilIdle(std::chrono::seconds(10));
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	if (nbSent != 6000 || nbSuccess != nbSent) {
+		FAILF("Got %u successful responses out of %u commands", nbSuccess, nbSent);
+	}
+	if (dongle.getLinkStats().get(LINK_ACK_TIMEOUTS) != 12 || ncp.nbRetransmittedFrames < 12) {
+		FAILF("Expected each lost frame to be resent on acknowledgement timeout:\n%s", dongle.getLinkStats().toString().c_str());
+	}
+	if (elapsed.count() > 5000) {
+		FAILF("One minute of simulated time took %.1fms", elapsed.count());
+	}
+	printf("One minute of simulated time (%u commands) run in %.1fms\n", nbSent, elapsed.count());
+	NOTIFYPASS();
+}
+
+TEST(virtual_clock_tests, virtual_clock_randomized) {
+	const uint32_t nbScenarios = 500;
+	unsigned int nbAckTimeouts = 0;
+
+	for (uint32_t seed = 1; seed <= nbScenarios; seed++) {
+		VirtualScenarioResult first = runVirtualScenario(seed);
+		VirtualScenarioResult second = runVirtualScenario(seed);
+		for (EEzspCmdStatus status : first.statuses) {
+			if (status != EZSP_CMD_SUCCESS) {
+				FAILF("Expected all commands to succeed (seed %u)", seed);
+			}
+		}
+		/* The same seed must unfold exactly the same way, to the microsecond */
+		if (first.completionTimes != second.completionTimes || first.nbAckTimeouts != second.nbAckTimeouts
+		    || first.nbRetransmittedFrames != second.nbRetransmittedFrames) {
+			FAILF("Scenario is not deterministic (seed %u)", seed);
+		}
+		nbAckTimeouts += first.nbAckTimeouts;
+	}
+	if (nbAckTimeouts == 0) {
+		FAILF("Expected some scenarios to go through acknowledgement timeouts");
+	}
+	NOTIFYPASS();
+}
+
+#ifndef USE_CPPUTEST
+void unit_tests_virtual_clock() {
+	virtual_clock_timers();
+	virtual_clock_uart_chunks();
+	virtual_clock_ash_timeout();
+	virtual_clock_dongle_soak();
+	virtual_clock_randomized();
+}
+#endif	// USE_CPPUTEST